@@ -30,6 +30,14 @@ typedef enum {
     ISON_ERROR_INVALID = -4
 } ison_error_t;
 
+/* Allocation hooks; ctx is passed back to every call */
+typedef struct {
+    void *(*malloc_fn)(size_t size, void *ctx);
+    void *(*realloc_fn)(void *ptr, size_t size, void *ctx);
+    void (*free_fn)(void *ptr, void *ctx);
+    void *ctx;
+} ison_allocator_t;
+
 /* Value types */
 typedef enum {
     ISON_TYPE_NULL = 0,
@@ -47,18 +55,47 @@ typedef struct {
     char *relationship;
 } ison_reference_t;
 
-/* Value structure */
+/* Value flags */
+#define ISON_VALUE_INLINE 0x1u     /* string stored in data.small_str */
+#define ISON_VALUE_BORROWED 0x2u   /* strings belong to someone else; free is a no-op */
+#define ISON_VALUE_SHARED_REF 0x4u /* reference components share one allocation owned by id */
+
+/* Longest string kept inline, excluding the terminator */
+#define ISON_SMALL_STRING_MAX 23
+
+/* Value structure; read strings through ison_value_string() */
 typedef struct {
     ison_type_t type;
+    uint32_t flags;
     union {
         bool bool_val;
         int64_t int_val;
         double float_val;
         char *string_val;
+        char small_str[ISON_SMALL_STRING_MAX + 1];
         ison_reference_t ref_val;
     } data;
 } ison_value_t;
 
+/*
+ * Packed 16-byte cell used by ison_packed_t. Strings of up to 8 bytes sit in
+ * payload.bytes; longer ones are (offset, len) into the packed string arena.
+ * References hold an index into the packed reference table.
+ */
+typedef struct {
+    uint8_t type;          /* ison_type_t */
+    uint8_t flags;         /* ISON_VALUE_INLINE for strings in payload.bytes */
+    uint16_t reserved;
+    uint32_t len;          /* string length */
+    union {
+        bool bool_val;
+        int64_t int_val;
+        double float_val;
+        uint64_t offset;   /* arena offset or reference table index */
+        char bytes[8];
+    } payload;
+} ison_packed_value_t;
+
 /* Field information */
 typedef struct {
     char *name;
@@ -78,6 +115,44 @@ typedef struct {
     size_t count;
 } ison_row_t;
 
+/*
+ * Heap footprint in bytes by structure, as requested from the allocator
+ * (allocator overhead is not included).
+ */
+typedef struct {
+    size_t blocks;       /* block headers, kind and name, row pointer arrays */
+    size_t fields;       /* field metadata: the array, names and type hints */
+    size_t rows;         /* row headers */
+    size_t entries;      /* row entry nodes, including inline values */
+    size_t keys;         /* entry key strings */
+    size_t strings;      /* string payloads too long to store inline */
+    size_t references;   /* reference payloads */
+    size_t borrowed;     /* part of strings + references held in an arena or elsewhere */
+    size_t spare;        /* emptied rows kept for reuse after ison_document_reset */
+    size_t document;     /* document arrays, name index and parser buffers */
+    size_t arena;        /* string arena chunks */
+    size_t total;        /* sum of the above, counting borrowed bytes once */
+    size_t allocations;  /* live allocations behind total */
+} ison_memory_stats_t;
+
+/* Storage recycled by ison_document_reset (opaque) */
+typedef struct ison_document_pool ison_document_pool_t;
+
+/* Schema-bound row builder (opaque) */
+typedef struct ison_row_builder ison_row_builder_t;
+
+/* Packed copy of a document's tables (opaque) */
+typedef struct ison_packed ison_packed_t;
+
+/* Column hash index (opaque), owned by the block it was built on */
+typedef struct ison_index ison_index_t;
+
+/* Ordered column index (opaque), owned by the block it was built on */
+typedef struct ison_range_index ison_range_index_t;
+
+/* HyperLogLog distinct-count sketch (opaque) */
+typedef struct ison_hll ison_hll_t;
+
 /* Block - table, object, or meta */
 typedef struct {
     char *kind;        /* "table", "object", or "meta" */
@@ -89,15 +164,37 @@ typedef struct {
     size_t row_count;
     size_t row_capacity;
     ison_row_t *summary_row;
+    ison_index_t **indexes;
+    size_t index_count;
+    ison_range_index_t **range_indexes;
+    size_t range_index_count;
+    ison_row_t **spare_rows;   /* emptied rows kept by ison_document_reset */
+    size_t spare_row_count;
+    size_t spare_row_capacity;
+    ison_memory_stats_t memory;   /* kept current as rows and fields come and go */
 } ison_block_t;
 
+/* Document-wide reference resolution index (opaque) */
+typedef struct ison_ref_index ison_ref_index_t;
+
+/* Relationship graph over :REL:id edges (opaque) */
+typedef struct ison_graph ison_graph_t;
+
+/* Graph traversal visitor; return false to stop the traversal */
+typedef bool (*ison_graph_visit_t)(size_t node, size_t depth, void *userdata);
+
 /* Document */
 typedef struct {
     ison_block_t **blocks;
     size_t block_count;
     size_t block_capacity;
-    char **order;
+    char **order;              /* order[i] is blocks[i]->name */
     size_t order_count;
+    size_t *index;           /* open-addressing name index: block position + 1, 0 = empty */
+    size_t index_capacity;
+    ison_ref_index_t *ref_index;  /* built on first ison_document_resolve */
+    ison_document_pool_t *pool;   /* string arena, spare blocks, parser buffers */
+    ison_allocator_t allocator;   /* for the fields above; zeroed = global allocator */
 } ison_document_t;
 
 /* Serialization options */
@@ -108,8 +205,9 @@ typedef struct {
 
 /* FromDict options */
 typedef struct {
-    bool auto_refs;
-    bool smart_order;
+    bool auto_refs;    /* split nested objects/arrays into tables linked by :ns:id refs;
+                          referenced ids must be non-empty and free of whitespace/quotes */
+    bool smart_order;  /* order blocks so referenced tables precede their referrers */
 } ison_fromdict_options_t;
 
 /* ISONL record for streaming */
@@ -124,6 +222,98 @@ typedef struct {
 /* Callback for ISONL streaming */
 typedef void (*isonl_callback_t)(const isonl_record_t *record, void *userdata);
 
+/* Output sink for incremental writers */
+typedef void (*ison_write_callback_t)(const char *data, size_t len, void *userdata);
+
+/* Streaming JSON-to-ISON options */
+typedef struct {
+    const char *kind;      /* block kind, default: "table" */
+    const char *name;      /* block name, default: "data" */
+    size_t header_sample;  /* records buffered to infer the header, default: 16 */
+    bool isonl;            /* emit ISONL lines instead of one ISON block */
+} ison_json_stream_options_t;
+
+/* Document diff options */
+typedef struct {
+    const char *key;   /* column aligning rows when its values are unique keys, default: "id";
+                          NULL always aligns by row hash */
+} ison_diff_options_t;
+
+/* Streaming JSON-to-ISON converter (opaque) */
+typedef struct ison_json_stream ison_json_stream_t;
+
+/* Comparison operators for ison_predicate_t */
+typedef enum {
+    ISON_CMP_EQ = 0,
+    ISON_CMP_NE,
+    ISON_CMP_LT,
+    ISON_CMP_LE,
+    ISON_CMP_GT,
+    ISON_CMP_GE,
+    ISON_CMP_IN,         /* equal to one of values[0..value_count) */
+    ISON_CMP_IS_NULL,    /* null or missing */
+    ISON_CMP_NOT_NULL,
+    ISON_CMP_PREFIX      /* string starting with value's string */
+} ison_cmp_t;
+
+/* `field op value`; operands are borrowed, not freed */
+typedef struct {
+    const char *field;
+    ison_cmp_t op;
+    ison_value_t value;
+    const ison_value_t *values;   /* ISON_CMP_IN */
+    size_t value_count;
+} ison_predicate_t;
+
+/* One column of a multi-key sort */
+typedef struct {
+    const char *field;
+    bool descending;
+    bool nulls_first;    /* nulls and missing cells first (else last), either direction */
+} ison_sort_key_t;
+
+/* Ascending row positions into one block */
+typedef struct {
+    size_t *rows;
+    size_t count;
+    size_t capacity;
+} ison_selection_t;
+
+/* Join kinds for ison_block_join */
+typedef enum {
+    ISON_JOIN_INNER = 0,   /* one row per matching pair */
+    ISON_JOIN_LEFT,        /* and unmatched left rows, right side null */
+    ISON_JOIN_SEMI         /* left rows with at least one match, once each */
+} ison_join_t;
+
+#define ISON_JOIN_NO_MATCH ((size_t)-1)
+
+/* left[i] joins right[i]; right[i] is ISON_JOIN_NO_MATCH for an unmatched left row */
+typedef struct {
+    size_t *left;
+    size_t *right;
+    size_t count;
+    size_t capacity;
+} ison_join_pairs_t;
+
+/* ==================== Allocation ==================== */
+
+/*
+ * Every allocation the library makes goes through the global allocator,
+ * which is libc until ison_set_allocator replaces it (NULL restores libc).
+ * Set it before any other call. Strings and buffers handed back to the
+ * caller, e.g. by ison_dumps, are released with ison_free. The hooks must
+ * be thread-safe: ison_parallel_for workers (sorting, hashing, joins and
+ * the other parallel paths) call them concurrently.
+ */
+void ison_set_allocator(const ison_allocator_t *allocator);
+void ison_get_allocator(ison_allocator_t *out);
+void *ison_malloc(size_t size);
+void *ison_calloc(size_t count, size_t size);
+void *ison_realloc(void *ptr, size_t size);
+void ison_free(void *ptr);
+char *ison_strdup(const char *str);
+
 /* ==================== Value Constructors ==================== */
 
 ison_value_t ison_null(void);
@@ -141,6 +331,9 @@ bool ison_value_as_bool(const ison_value_t *value, bool *out);
 bool ison_value_as_int(const ison_value_t *value, int64_t *out);
 bool ison_value_as_float(const ison_value_t *value, double *out);
 bool ison_value_as_string(const ison_value_t *value, const char **out);
+
+/* String contents, inline or heap; NULL for other types. Valid while *value is */
+const char *ison_value_string(const ison_value_t *value);
 bool ison_value_as_ref(const ison_value_t *value, ison_reference_t *out);
 
 /* ==================== Value Operations ==================== */
@@ -149,9 +342,33 @@ char *ison_value_to_ison(const ison_value_t *value);
 char *ison_value_to_json(const ison_value_t *value);
 void ison_value_free(ison_value_t *value);
 
+/* Deep copy; the result owns its strings even when value borrowed them */
+ison_value_t ison_value_copy(const ison_value_t *value);
+
+/*
+ * Hash and equality over every value type, as grouping and deduplication
+ * use them: ints and floats of equal value are equal and hash alike, NaNs
+ * equal each other, strings compare bytewise and references by id, ns and
+ * relationship. NULL (a missing cell) equals null.
+ *
+ * This is stricter than key matching in lookup indexes, joins and diff
+ * alignment, where the string "42" and the reference :user:42 both match
+ * the int 42 so that references resolve to ids. Here "42" != 42.
+ */
+uint64_t ison_value_hash(const ison_value_t *value);
+bool ison_value_equal(const ison_value_t *a, const ison_value_t *b);
+
 /* ==================== Reference Operations ==================== */
 
+/*
+ * A standalone reference owns id, ns and relationship as separate
+ * allocations, and ison_reference_free frees all three. References inside
+ * values built by the library (ison_ref, ison_value_copy, the parser) are
+ * one allocation owned by id, marked ISON_VALUE_SHARED_REF; free those with
+ * ison_value_free.
+ */
 ison_reference_t ison_reference_make(const char *id, const char *ns, const char *relationship);
+ison_reference_t ison_reference_copy(const ison_reference_t *ref);
 char *ison_reference_to_ison(const ison_reference_t *ref);
 bool ison_reference_is_relationship(const ison_reference_t *ref);
 char *ison_reference_get_ns(const ison_reference_t *ref);
@@ -160,39 +377,420 @@ void ison_reference_free(ison_reference_t *ref);
 /* ==================== Row Operations ==================== */
 
 ison_row_t *ison_row_create(void);
+
+/* Moves *value into the row; the row frees it from now on */
 void ison_row_set(ison_row_t *row, const char *key, const ison_value_t *value);
 bool ison_row_get(const ison_row_t *row, const char *key, ison_value_t *out);
 ison_value_t *ison_row_get_ptr(const ison_row_t *row, const char *key);
+ison_row_t *ison_row_copy(const ison_row_t *row);
 void ison_row_free(ison_row_t *row);
 
 /* ==================== Block Operations ==================== */
 
 ison_block_t *ison_block_create(const char *kind, const char *name);
 void ison_block_add_field(ison_block_t *block, const char *name, const char *type_hint);
+
+/* Append or install a deep copy of row; the caller keeps the original */
 void ison_block_add_row(ison_block_t *block, const ison_row_t *row);
 void ison_block_set_summary(ison_block_t *block, const ison_row_t *row);
+
+/* Adopt row without copying; it is freed if the block cannot take it */
+bool ison_block_take_row(ison_block_t *block, ison_row_t *row);
+void ison_block_take_summary(ison_block_t *block, ison_row_t *row);
+
 char **ison_block_get_field_names(const ison_block_t *block, size_t *count);
 void ison_block_free(ison_block_t *block);
 
+/* ==================== Row Builder ==================== */
+
+/*
+ * Fills rows by field position in O(fields) per row. set_at moves the value
+ * in (a repeated position replaces the earlier value; positions sharing a
+ * field name share a cell). next_row queues the current row; commit appends
+ * the queued rows plus any partly filled one in a single batch and frees the
+ * builder. build hands the current row to the caller instead.
+ */
+ison_row_builder_t *ison_row_builder_begin(ison_block_t *block);
+void ison_row_builder_set_at(ison_row_builder_t *builder, size_t field, const ison_value_t *value);
+bool ison_row_builder_next_row(ison_row_builder_t *builder);
+ison_row_t *ison_row_builder_build(ison_row_builder_t *builder);
+size_t ison_row_builder_commit(ison_row_builder_t *builder);
+void ison_row_builder_abort(ison_row_builder_t *builder);
+
+/* ==================== Indexes ==================== */
+
+/*
+ * Hash index over one column, kept current by ison_block_add_row and freed
+ * with the block. Keys are ints, bools, floats, strings and reference ids;
+ * strings and ids spelled as canonical integers ("42") match int 42, so
+ * :user:42 finds the row whose id is 42. Nulls are not indexed.
+ * Building an index on an already indexed column returns the existing one.
+ */
+ison_index_t *ison_block_build_index(ison_block_t *block, const char *column);
+ison_index_t *ison_block_get_index(const ison_block_t *block, const char *column);
+void ison_block_drop_index(ison_block_t *block, ison_index_t *index);
+
+/*
+ * Row indices (in insertion order) whose column equals `value`. The array
+ * belongs to the index and is valid until the block is next modified.
+ */
+size_t ison_block_find(const ison_block_t *block, const ison_index_t *index,
+                       const ison_value_t *value, const size_t **rows);
+
+/*
+ * Sorted permutation of a column's int, float and string cells (numbers order
+ * before strings; other types are skipped). Rows appended later are buffered
+ * and merged on the next query. Strings are borrowed from the rows, so rebuild
+ * the index after editing indexed cells in place.
+ */
+ison_range_index_t *ison_block_build_range_index(ison_block_t *block, const char *column);
+void ison_block_drop_range_index(ison_block_t *block, ison_range_index_t *index);
+
+/*
+ * Rows whose value lies between lo and hi (either may be NULL for unbounded),
+ * in ascending value order. The array belongs to the index and is valid until
+ * the block is next modified.
+ */
+size_t ison_range_query(ison_range_index_t *index,
+                        const ison_value_t *lo, bool lo_inclusive,
+                        const ison_value_t *hi, bool hi_inclusive,
+                        const size_t **rows);
+
+/* The n smallest (or largest) rows, always in ascending value order */
+size_t ison_range_top(ison_range_index_t *index, size_t n, bool largest, const size_t **rows);
+
 /* ==================== Document Operations ==================== */
 
 ison_document_t *ison_document_create(void);
+
+/*
+ * A document whose own storage - the document itself, its block and name
+ * arrays, parser buffers and string arena - comes from allocator, e.g. a
+ * per-request arena. Blocks, rows and values may move between documents,
+ * so they keep using the global allocator.
+ */
+ison_document_t *ison_document_create_with_allocator(const ison_allocator_t *allocator);
 void ison_document_add_block(ison_document_t *doc, ison_block_t *block);
+
+/* Frees the block called name; false when there is none */
+bool ison_document_remove_block(ison_document_t *doc, const char *name);
 ison_block_t *ison_document_get(const ison_document_t *doc, const char *name);
 const char **ison_document_get_order(const ison_document_t *doc, size_t *count);
 void ison_document_free(ison_document_t *doc);
 
+/*
+ * Empties doc but keeps its capacities: blocks and their rows (with entry
+ * keys) are set aside for reuse, and the string arena is rewound. Pointers
+ * into the old contents are invalid afterwards. Up to 256 blocks are kept,
+ * and blocks set aside by the previous reset that no parse reused since are
+ * freed.
+ */
+void ison_document_reset(ison_document_t *doc);
+
+/* ==================== Reference Resolution ==================== */
+
+/*
+ * Maps (namespace, id) to (block, row) via the id column of every block: the
+ * field named "id", else the first field. Per-table id indexes are built in
+ * parallel and then kept current by ison_block_add_row. A namespace names a
+ * block directly or by its plural ("user" -> "users"); references without a
+ * namespace (":42", ":OWNS:42") probe each block in document order.
+ */
+ison_ref_index_t *ison_ref_index_build(ison_document_t *doc);
+bool ison_ref_index_lookup(const ison_ref_index_t *index, const ison_reference_t *ref,
+                           ison_block_t **block, size_t *row);
+void ison_ref_index_free(ison_ref_index_t *index);
+
+/* Target row of `ref`, or NULL. Builds doc->ref_index on first use. */
+ison_row_t *ison_document_resolve(ison_document_t *doc, const ison_reference_t *ref);
+
+/* ==================== Relationship Graph ==================== */
+
+/*
+ * CSR adjacency over every relationship-typed cell (:MEMBER_OF:42) in the
+ * document. Nodes are rows, numbered block by block in document order; an
+ * edge runs from the row holding the cell to the row the reference resolves
+ * to. A relationship has no namespace, so its id is looked up in the block
+ * its column's type hint names (`owner:users`, or the singular `owner:user`)
+ * and otherwise in the first block in document order holding that id. Each
+ * node's edges are grouped by relationship, so filtered neighbor lists are
+ * contiguous. Pass rel = -1 to follow every relationship.
+ */
+ison_graph_t *ison_graph_build(ison_document_t *doc);
+void ison_graph_free(ison_graph_t *graph);
+size_t ison_graph_node_count(const ison_graph_t *graph);
+size_t ison_graph_edge_count(const ison_graph_t *graph);
+bool ison_graph_node(const ison_graph_t *graph, const ison_block_t *block, size_t row, size_t *node);
+bool ison_graph_node_row(const ison_graph_t *graph, size_t node, ison_block_t **block, size_t *row);
+int ison_graph_relationship(const ison_graph_t *graph, const char *name);
+size_t ison_graph_neighbors(const ison_graph_t *graph, size_t node, int rel, const uint32_t **targets);
+ison_error_t ison_graph_bfs(const ison_graph_t *graph, size_t start, int rel, size_t max_depth,
+                            ison_graph_visit_t visit, void *userdata);
+ison_error_t ison_graph_dfs(const ison_graph_t *graph, size_t start, int rel, size_t max_depth,
+                            ison_graph_visit_t visit, void *userdata);
+
+/* Nodes within k hops of start (excluding start), in BFS order; caller frees */
+size_t ison_graph_khop(const ison_graph_t *graph, size_t start, int rel, size_t k, size_t **nodes);
+
+/* ==================== Packed Storage ==================== */
+
+/*
+ * Row-major grid of ison_packed_value_t per block, one column per field, with
+ * every string in a shared arena and every distinct reference stored once in
+ * a document-wide table. A snapshot: later edits to doc are not reflected.
+ *
+ * Blocks keep their linked rows; ison_block_t.rows and ison_row_t are walked
+ * directly throughout the API. A packed document is instead a standalone
+ * compact form that keeps kinds, fields, type hints and summary rows, so
+ * the source can be freed: scan cells in place (ison_packed_cells,
+ * ison_packed_aggregate) and materialise ison_value_t rows only for the
+ * blocks that need them. Cells outside a block's fields are not kept.
+ */
+ison_packed_t *ison_document_pack(const ison_document_t *doc);
+void ison_packed_free(ison_packed_t *packed);
+
+/* Block `name` rebuilt with owned copies of its cells, or NULL; caller frees */
+ison_block_t *ison_packed_block(const ison_packed_t *packed, const char *name);
+
+/* Every block rebuilt as by ison_packed_block, in packing order */
+ison_document_t *ison_packed_unpack(const ison_packed_t *packed);
+
+/* Footprint by the ison_memory_stats_t buckets: cells count as entries */
+void ison_packed_memory_stats(const ison_packed_t *packed, ison_memory_stats_t *out);
+
+/* Cells of block `name` (rows * fields of them), or NULL */
+const ison_packed_value_t *ison_packed_cells(const ison_packed_t *packed, const char *name,
+                                             size_t *rows, size_t *fields);
+
+/* Decoded view of a cell; strings and references are ISON_VALUE_BORROWED */
+bool ison_packed_decode(const ison_packed_t *packed, const ison_packed_value_t *cell,
+                        ison_value_t *out);
+
+size_t ison_packed_reference_count(const ison_packed_t *packed);
+
+/* ==================== Filtering ==================== */
+
+/*
+ * Selection vectors: the positions of the rows of a block that satisfy a
+ * predicate, evaluated a batch of rows at a time over the column. Nulls and
+ * missing cells match only IS_NULL; values of a different type match only
+ * NE (ints and floats compare numerically, strings bytewise). A selection
+ * stays valid while the block's rows are not added to or reordered.
+ */
+ison_error_t ison_block_filter(const ison_block_t *block, const ison_predicate_t *predicate,
+                               ison_selection_t *out);
+
+/* Narrows selection in place to the rows that also satisfy predicate (AND) */
+ison_error_t ison_block_filter_refine(const ison_block_t *block, const ison_predicate_t *predicate,
+                                      ison_selection_t *selection);
+
+/* Intersection and union; out may be a or b */
+ison_error_t ison_selection_and(const ison_selection_t *a, const ison_selection_t *b,
+                                ison_selection_t *out);
+ison_error_t ison_selection_or(const ison_selection_t *a, const ison_selection_t *b,
+                               ison_selection_t *out);
+void ison_selection_free(ison_selection_t *selection);
+
+/* New block with the fields of block and copies of the selected rows (all when NULL) */
+ison_block_t *ison_block_select(const ison_block_t *block, const ison_selection_t *selection);
+
+/* ==================== Sorting ==================== */
+
+/*
+ * Stable in-place sort of block->rows by keys[0], then keys[1], and so on;
+ * indexes are rebuilt afterwards and the summary row stays put. Within a
+ * column, bools sort before numbers (ints and floats numerically), numbers
+ * before strings (bytewise) and strings before references. Columns of only
+ * ints, only bools or doubles-exact numbers are radix sorted; large blocks
+ * are sorted in parallel chunks.
+ */
+ison_error_t ison_block_sort(ison_block_t *block, const ison_sort_key_t *keys, size_t key_count);
+
+/* ==================== Aggregation ==================== */
+
+/* Per-column aggregate for ison_block_compute_summary */
+typedef enum {
+    ISON_AGG_NONE = 0,         /* summary cell is null */
+    ISON_AGG_COUNT,            /* rows */
+    ISON_AGG_COUNT_NON_NULL,   /* non-null cells */
+    ISON_AGG_SUM,
+    ISON_AGG_MIN,
+    ISON_AGG_MAX,
+    ISON_AGG_MEAN
+} ison_agg_t;
+
+/* Aggregates over the int and float cells of one column */
+typedef struct {
+    size_t count;        /* rows */
+    size_t non_null;     /* cells present and not null */
+    size_t numeric;      /* int and float cells; the others are skipped */
+    bool integral;       /* no floats and int_sum did not overflow */
+    int64_t int_sum;     /* int_* cover the int cells only */
+    int64_t int_min;
+    int64_t int_max;
+    double sum;          /* all numeric cells; valid when numeric > 0 */
+    double min;
+    double max;
+    double mean;
+} ison_aggregate_t;
+
+/*
+ * Both run SIMD kernels over contiguous batches of the column's numbers. The
+ * packed variant reads the cell grid of block `name` directly; the block
+ * variant gathers from row storage, restricted to selection when one is given.
+ * The summary row is not included.
+ */
+bool ison_block_aggregate(const ison_block_t *block, const char *field, ison_aggregate_t *out);
+bool ison_block_aggregate_selection(const ison_block_t *block, const char *field,
+                                    const ison_selection_t *selection, ison_aggregate_t *out);
+bool ison_packed_aggregate(const ison_packed_t *packed, const char *name, size_t field,
+                           ison_aggregate_t *out);
+
+/*
+ * Replaces block->summary_row with one aggregate per field, spec[i] applying
+ * to fields[i]. Sums, minima and maxima of int-only columns stay ints; means
+ * are floats; a column without numbers gets null.
+ */
+ison_error_t ison_block_compute_summary(ison_block_t *block, const ison_agg_t *spec);
+
+/* ==================== Grouping ==================== */
+
+/* One output column of ison_block_group_by */
+typedef struct {
+    const char *field;   /* input column; may be NULL for ISON_AGG_COUNT */
+    ison_agg_t agg;
+    const char *as;      /* output name; NULL = "count", or "sum_<field>", "avg_<field>", ... */
+} ison_group_agg_t;
+
+/*
+ * New block (same kind and name) with one row per distinct combination of
+ * group_cols, in order of first appearance: the group columns followed by
+ * one column per aggregate, computed as ison_block_compute_summary does.
+ * Ints and floats of equal value fall in the same group, as do nulls and
+ * missing cells. Large blocks are hash-partitioned across worker threads.
+ * NULL when a named column is not a field of block.
+ */
+ison_block_t *ison_block_group_by(const ison_block_t *block, const char *const *group_cols,
+                                  size_t group_count, const ison_group_agg_t *aggs,
+                                  size_t agg_count);
+
+/* ==================== Distinct Values ==================== */
+
+/*
+ * Removes every row whose values in cols (all fields when col_count is 0)
+ * equal those of an earlier row, keeping the first, and rebuilds indexes;
+ * *removed receives the number dropped. Values compare as ison_value_equal
+ * does, through a hash set holding one slot per distinct key.
+ */
+ison_error_t ison_block_dedup(ison_block_t *block, const char *const *cols, size_t col_count,
+                              size_t *removed);
+
+/* New block (same kind and name) with col's distinct values in order of first appearance */
+ison_block_t *ison_block_distinct(const ison_block_t *block, const char *col);
+
+/* Exact number of distinct values in col, null included; (size_t)-1 on error */
+size_t ison_block_count_distinct(const ison_block_t *block, const char *col);
+
+/*
+ * HyperLogLog sketch with 2^precision one-byte registers (precision 4..18);
+ * the standard error of the estimate is about 1.04 / sqrt(2^precision).
+ * Sketches of equal precision merge into the sketch of the union.
+ */
+ison_hll_t *ison_hll_create(unsigned precision);
+void ison_hll_add(ison_hll_t *hll, const ison_value_t *value);
+void ison_hll_add_hash(ison_hll_t *hll, uint64_t hash);
+bool ison_hll_merge(ison_hll_t *into, const ison_hll_t *from);
+double ison_hll_estimate(const ison_hll_t *hll);
+void ison_hll_free(ison_hll_t *hll);
+
+/*
+ * Approximate distinct count of col in 16 KiB (precision 14, ~0.8% error),
+ * sketched in parallel for large blocks; negative on error.
+ */
+double ison_block_estimate_distinct(const ison_block_t *block, const char *col);
+
+/* ==================== Joining ==================== */
+
+/*
+ * Hash join of left.left_col against right.right_col. Keys match as they do
+ * in column indexes: whole floats equal ints, and a reference matches by
+ * its id, so an orders.user of :user:42 joins the users row with id 42.
+ * Nulls never match. The right block is hashed and the left one probed;
+ * when the table would outgrow memory_limit bytes (0 = 64 MiB), both sides
+ * are hash-partitioned into temporary files and joined a partition at a
+ * time. Pairs are ordered by left row, then right row; a semi join pairs
+ * each left row with its first match.
+ */
+ison_error_t ison_block_join_pairs(const ison_block_t *left, const char *left_col,
+                                   const ison_block_t *right, const char *right_col,
+                                   ison_join_t kind, size_t memory_limit,
+                                   ison_join_pairs_t *out);
+void ison_join_pairs_free(ison_join_pairs_t *pairs);
+
+/*
+ * New block (left's kind and name) with left's fields followed by right's
+ * other than right_col; a right field whose name is taken is renamed
+ * "<right name>_<field>". A semi join keeps left's fields only.
+ */
+ison_block_t *ison_block_join(const ison_block_t *left, const char *left_col,
+                              const ison_block_t *right, const char *right_col, ison_join_t kind);
+
+/* ==================== Diff and Patch ==================== */
+
+/*
+ * Patch turning a into b, as a document that ison_dumps encodes like any
+ * other. Its meta block "_diff" has one row per block that differs, with
+ * columns `block op key`:
+ *   add, replace  the patch holds b's block whole, summary row included
+ *                 (new, or kind/fields changed)
+ *   remove        the block is gone from b
+ *   patch         the patch holds a block of b's fields behind `_op _cols`
+ * A patch block row is `add` (b's row), `remove` (the key cell only, or
+ * the whole row when aligned by hash) or `change` (the key cell and the
+ * changed cells, named space-separated in _cols; other cells null), or
+ * `summary` (b's whole summary row) / `unsummary` (b has none). Rows
+ * are aligned by the options' key column ("id" by default) when its values
+ * are unique keys on both sides (key then names it), otherwise by row hash
+ * (key is null). Cells match when their types and values are equal. NULL
+ * on allocation failure or when b has a block named _diff.
+ */
+ison_document_t *ison_document_diff(const ison_document_t *a, const ison_document_t *b);
+ison_document_t *ison_document_diff_with_options(const ison_document_t *a, const ison_document_t *b,
+                                                 const ison_diff_options_t *options);
+
+/*
+ * Applies a patch from ison_document_diff (possibly through ISON text) to
+ * doc. Surviving rows keep their order and added rows are appended. Fails
+ * with ISON_ERROR_INVALID when the patch does not fit doc; doc may then be
+ * partly patched.
+ */
+ison_error_t ison_document_apply_patch(ison_document_t *doc, const ison_document_t *patch);
+
 /* ==================== Parsing ==================== */
 
 ison_document_t *ison_parse(const char *text, ison_error_t *error);
 ison_document_t *ison_parse_isonl(const char *text, ison_error_t *error);
 
+/*
+ * Reset doc and parse text into it, reusing the blocks, rows, arena chunks
+ * and parser buffers left by earlier parses. Messages of a steady shape then
+ * parse without touching malloc. Long strings and references are allocated
+ * from the document arena (ISON_VALUE_BORROWED) and live until the next
+ * reset; ison_parse and ison_parse_isonl give every value its own copy.
+ */
+ison_error_t ison_parse_into(ison_document_t *doc, const char *text);
+ison_error_t ison_parse_isonl_into(ison_document_t *doc, const char *text);
+
 /* ==================== Serialization ==================== */
 
 char *ison_dumps(const ison_document_t *doc);
 char *ison_dumps_with_options(const ison_document_t *doc, const ison_dumps_options_t *options);
 char *ison_dumps_isonl(const ison_document_t *doc);
 
+/* One block as ISON text, only the selected rows (all when NULL), no summary */
+char *ison_dumps_selection(const ison_block_t *block, const ison_selection_t *selection,
+                           const ison_dumps_options_t *options);
+
 /* ==================== File I/O ==================== */
 
 ison_document_t *ison_load(const char *path, ison_error_t *error);
@@ -206,12 +804,65 @@ char *ison_to_isonl(const char *ison_text, ison_error_t *error);
 char *isonl_to_ison(const char *isonl_text, ison_error_t *error);
 char *ison_to_json(const char *ison_text, ison_error_t *error);
 ison_document_t *ison_from_json(const char *json_text, ison_error_t *error);
+ison_document_t *ison_from_json_with_options(const char *json_text,
+                                             const ison_fromdict_options_t *options,
+                                             ison_error_t *error);
+
+/* ==================== Streaming JSON Conversion ==================== */
+
+/*
+ * Converts a JSON array of records (or newline-delimited JSON objects) fed in
+ * arbitrary chunks into one ISON table, written to `write` as records complete.
+ * The header is the union of keys over the first `header_sample` records; keys
+ * first seen after that are dropped and nested objects/arrays become `~`.
+ * Memory is bounded by the sample plus the largest single record.
+ */
+ison_json_stream_t *ison_json_stream_create(const ison_json_stream_options_t *options,
+                                            ison_write_callback_t write, void *userdata);
+ison_error_t ison_json_stream_feed(ison_json_stream_t *stream, const char *data, size_t len);
+ison_error_t ison_json_stream_finish(ison_json_stream_t *stream);
+void ison_json_stream_free(ison_json_stream_t *stream);
+ison_error_t ison_json_stream_file(const char *json_path, const char *ison_path,
+                                   const ison_json_stream_options_t *options);
 
 /* ==================== Streaming ==================== */
 
 ison_error_t isonl_stream_file(const char *path, isonl_callback_t callback, void *userdata);
 ison_error_t isonl_stream_buffer(const char *buffer, size_t len, isonl_callback_t callback, void *userdata);
 
+/*
+ * Merges ISONL files that are each sorted ascending by key_col (nulls and
+ * missing cells last, values ordered as ison_block_sort orders them) into
+ * one sorted file at out_path, written as ison_dumps_isonl writes records.
+ * Records with equal keys keep the order of paths. Inputs are streamed
+ * through fixed buffers, so memory grows with the number of inputs and
+ * the longest line, not with the size of the files.
+ */
+ison_error_t isonl_merge(const char *const *paths, size_t count, const char *key_col, const char *out_path);
+
+/*
+ * Sorts the ISONL file at in_path by keys into out_path (which may be the
+ * same file) without loading it whole: batches of about mem_limit bytes of
+ * decoded rows (0 means 256 MiB; a target, not a hard cap) are sorted with
+ * ison_block_sort, spilled to temporary files and merged as isonl_merge
+ * does. Records come out as ison_dumps_isonl writes them, in the order
+ * ison_load_isonl followed by ison_block_sort would give within each block.
+ */
+ison_error_t isonl_sort_file(const char *in_path, const char *out_path, const ison_sort_key_t *keys,
+                             size_t key_count, size_t mem_limit);
+
+/* ==================== Memory Accounting ==================== */
+
+/*
+ * Footprint of a block or document without walking rows: counters are
+ * updated as rows enter and leave a block, so a row edited in place after
+ * it was added is still counted as it was then. Column and reference
+ * indexes are not included. The document figure sums its blocks, spare
+ * blocks, arrays, parser buffers and arena in O(blocks + arena chunks).
+ */
+void ison_block_memory_stats(const ison_block_t *block, ison_memory_stats_t *out);
+void ison_document_memory_stats(const ison_document_t *doc, ison_memory_stats_t *out);
+
 /* ==================== Utility ==================== */
 
 char *ison_read_file(const char *path, size_t *out_len);
@@ -220,6 +871,8 @@ ison_error_t ison_write_file(const char *path, const char *content);
 /* Default options */
 ison_dumps_options_t ison_default_dumps_options(void);
 ison_fromdict_options_t ison_default_fromdict_options(void);
+ison_json_stream_options_t ison_default_json_stream_options(void);
+ison_diff_options_t ison_default_diff_options(void);
 
 /* Error string */
 const char *ison_error_string(ison_error_t error);
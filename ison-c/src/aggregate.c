@@ -0,0 +1,383 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+/*
+ * Column aggregation.
+ *
+ * Cells are gathered by type into fixed-size int64 and double buffers, and
+ * each full buffer is folded by a kernel that runs over contiguous memory:
+ * SSE2 for doubles, SSE4.2 for int64 min/max, unrolled scalar otherwise.
+ * Row storage is walked once per row; packed storage is read cell by cell.
+ */
+
+#define AGG_CHUNK 256
+
+typedef struct {
+    int64_t ints[AGG_CHUNK];
+    size_t int_fill;
+    double floats[AGG_CHUNK];
+    size_t float_fill;
+    
+    size_t non_null;
+    size_t int_count;
+    uint64_t int_sum;         /* wraps; checked against the bound in finish() */
+    int64_t int_min;
+    int64_t int_max;
+    size_t float_count;
+    double float_sum;
+    double float_min;
+    double float_max;
+} column_acc_t;
+
+static void kernel_int(const int64_t *v, size_t n, uint64_t *sum, int64_t *min, int64_t *max) {
+    size_t i = 0;
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    
+#if defined(__SSE4_2__)
+    __m128i vmin = _mm_set1_epi64x(*min);
+    __m128i vmax = _mm_set1_epi64x(*max);
+    __m128i vsum0 = _mm_setzero_si128();
+    __m128i vsum1 = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(v + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(v + i + 2));
+        vsum0 = _mm_add_epi64(vsum0, a);
+        vsum1 = _mm_add_epi64(vsum1, b);
+        vmin = _mm_blendv_epi8(vmin, a, _mm_cmpgt_epi64(vmin, a));
+        vmin = _mm_blendv_epi8(vmin, b, _mm_cmpgt_epi64(vmin, b));
+        vmax = _mm_blendv_epi8(vmax, a, _mm_cmpgt_epi64(a, vmax));
+        vmax = _mm_blendv_epi8(vmax, b, _mm_cmpgt_epi64(b, vmax));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(vsum0, vsum1));
+    s0 = (uint64_t)lanes[0];
+    s1 = (uint64_t)lanes[1];
+    _mm_storeu_si128((__m128i *)lanes, vmin);
+    *min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    _mm_storeu_si128((__m128i *)lanes, vmax);
+    *max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+#else
+    int64_t lo = *min, hi = *max;
+    for (; i + 4 <= n; i += 4) {
+        s0 += (uint64_t)v[i];
+        s1 += (uint64_t)v[i + 1];
+        s2 += (uint64_t)v[i + 2];
+        s3 += (uint64_t)v[i + 3];
+        for (size_t k = 0; k < 4; k++) {
+            if (v[i + k] < lo) lo = v[i + k];
+            if (v[i + k] > hi) hi = v[i + k];
+        }
+    }
+    *min = lo;
+    *max = hi;
+#endif
+    
+    for (; i < n; i++) {
+        s0 += (uint64_t)v[i];
+        if (v[i] < *min) *min = v[i];
+        if (v[i] > *max) *max = v[i];
+    }
+    *sum += s0 + s1 + s2 + s3;
+}
+
+static void kernel_float(const double *v, size_t n, double *sum, double *min, double *max) {
+    size_t i = 0;
+    double s = 0.0;
+    
+#if defined(__SSE2__)
+    __m128d vmin = _mm_set1_pd(*min);
+    __m128d vmax = _mm_set1_pd(*max);
+    __m128d vsum0 = _mm_setzero_pd();
+    __m128d vsum1 = _mm_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+        __m128d a = _mm_loadu_pd(v + i);
+        __m128d b = _mm_loadu_pd(v + i + 2);
+        vsum0 = _mm_add_pd(vsum0, a);
+        vsum1 = _mm_add_pd(vsum1, b);
+        vmin = _mm_min_pd(vmin, _mm_min_pd(a, b));
+        vmax = _mm_max_pd(vmax, _mm_max_pd(a, b));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(vsum0, vsum1));
+    s = lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, vmin);
+    *min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    _mm_storeu_pd(lanes, vmax);
+    *max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+#else
+    double s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    for (; i + 4 <= n; i += 4) {
+        s += v[i];
+        s1 += v[i + 1];
+        s2 += v[i + 2];
+        s3 += v[i + 3];
+        for (size_t k = 0; k < 4; k++) {
+            if (v[i + k] < *min) *min = v[i + k];
+            if (v[i + k] > *max) *max = v[i + k];
+        }
+    }
+    s += s1 + s2 + s3;
+#endif
+    
+    for (; i < n; i++) {
+        s += v[i];
+        if (v[i] < *min) *min = v[i];
+        if (v[i] > *max) *max = v[i];
+    }
+    *sum += s;
+}
+
+static void acc_init(column_acc_t *acc) {
+    memset(acc, 0, sizeof(*acc));
+    acc->int_min = INT64_MAX;
+    acc->int_max = INT64_MIN;
+}
+
+static void acc_flush(column_acc_t *acc) {
+    if (acc->int_fill) {
+        kernel_int(acc->ints, acc->int_fill, &acc->int_sum, &acc->int_min, &acc->int_max);
+        acc->int_count += acc->int_fill;
+        acc->int_fill = 0;
+    }
+    if (acc->float_fill) {
+        if (acc->float_count == 0) {
+            acc->float_min = acc->floats[0];
+            acc->float_max = acc->floats[0];
+        }
+        kernel_float(acc->floats, acc->float_fill, &acc->float_sum, &acc->float_min, &acc->float_max);
+        acc->float_count += acc->float_fill;
+        acc->float_fill = 0;
+    }
+}
+
+static void acc_push_int(column_acc_t *acc, int64_t v) {
+    acc->ints[acc->int_fill++] = v;
+    if (acc->int_fill == AGG_CHUNK) acc_flush(acc);
+}
+
+static void acc_push_float(column_acc_t *acc, double v) {
+    acc->floats[acc->float_fill++] = v;
+    if (acc->float_fill == AGG_CHUNK) acc_flush(acc);
+}
+
+static void acc_push(column_acc_t *acc, const ison_value_t *value) {
+    if (!value || value->type == ISON_TYPE_NULL) return;
+    acc->non_null++;
+    if (value->type == ISON_TYPE_INT) {
+        acc_push_int(acc, value->data.int_val);
+    } else if (value->type == ISON_TYPE_FLOAT) {
+        acc_push_float(acc, value->data.float_val);
+    }
+}
+
+static void acc_push_cell(column_acc_t *acc, const ison_packed_value_t *cell) {
+    if (cell->type == ISON_TYPE_NULL) return;
+    acc->non_null++;
+    if (cell->type == ISON_TYPE_INT) {
+        acc_push_int(acc, cell->payload.int_val);
+    } else if (cell->type == ISON_TYPE_FLOAT) {
+        acc_push_float(acc, cell->payload.float_val);
+    }
+}
+
+/* int_sum cannot have wrapped if count * max|v| fits in an int64 */
+static bool int_sum_exact(const column_acc_t *acc) {
+    if (acc->int_count == 0) return true;
+    if (acc->int_min == INT64_MIN) return false;
+    uint64_t lo = (uint64_t)(acc->int_min < 0 ? -acc->int_min : acc->int_min);
+    uint64_t hi = (uint64_t)(acc->int_max < 0 ? -acc->int_max : acc->int_max);
+    uint64_t bound = lo > hi ? lo : hi;
+    return bound == 0 || bound <= (uint64_t)INT64_MAX / acc->int_count;
+}
+
+/* Int sum redone in doubles when the wrapping sum may have overflowed */
+static double float_int_sum(const ison_block_t *block, const ison_packed_value_t *cells,
+                            size_t rows, size_t stride, size_t field, const size_t *selected) {
+    double sum = 0.0;
+    for (size_t k = 0; k < rows; k++) {
+        size_t r = selected ? selected[k] : k;
+        if (cells) {
+            const ison_packed_value_t *cell = &cells[r * stride + field];
+            if (cell->type == ISON_TYPE_INT) sum += (double)cell->payload.int_val;
+        } else if (r < block->row_count) {
+            const ison_value_t *v = ison_row_get_ptr(block->rows[r], block->fields[field].name);
+            if (v && v->type == ISON_TYPE_INT) sum += (double)v->data.int_val;
+        }
+    }
+    return sum;
+}
+
+/* rows counts the positions aggregated: selected[0..rows) when selected is set */
+static void acc_finish(column_acc_t *acc, size_t rows, ison_aggregate_t *out,
+                       const ison_block_t *block, const ison_packed_value_t *cells,
+                       size_t stride, size_t field, const size_t *selected) {
+    acc_flush(acc);
+    memset(out, 0, sizeof(*out));
+    out->count = rows;
+    out->non_null = acc->non_null;
+    out->numeric = acc->int_count + acc->float_count;
+    if (out->numeric == 0) return;
+    
+    bool exact = int_sum_exact(acc);
+    double int_sum = exact ? (double)(int64_t)acc->int_sum
+                           : float_int_sum(block, cells, rows, stride, field, selected);
+    out->integral = acc->float_count == 0 && exact;
+    if (acc->int_count) {
+        out->int_sum = (int64_t)acc->int_sum;
+        out->int_min = acc->int_min;
+        out->int_max = acc->int_max;
+    }
+    
+    out->sum = int_sum + acc->float_sum;
+    if (acc->int_count && acc->float_count) {
+        out->min = (double)acc->int_min < acc->float_min ? (double)acc->int_min : acc->float_min;
+        out->max = (double)acc->int_max > acc->float_max ? (double)acc->int_max : acc->float_max;
+    } else if (acc->int_count) {
+        out->min = (double)acc->int_min;
+        out->max = (double)acc->int_max;
+    } else {
+        out->min = acc->float_min;
+        out->max = acc->float_max;
+    }
+    out->mean = out->sum / (double)out->numeric;
+}
+
+bool ison_block_aggregate(const ison_block_t *block, const char *field, ison_aggregate_t *out) {
+    return ison_block_aggregate_selection(block, field, NULL, out);
+}
+
+bool ison_block_aggregate_selection(const ison_block_t *block, const char *field,
+                                    const ison_selection_t *selection, ison_aggregate_t *out) {
+    if (!block || !field || !out) return false;
+    size_t f = ison_field_position(block, field);
+    if (f == ISON_NO_FIELD) return false;
+    
+    const size_t *selected = selection ? selection->rows : NULL;
+    size_t rows = selection ? selection->count : block->row_count;
+    column_acc_t *acc = ison_malloc(sizeof(column_acc_t));
+    if (!acc) return false;
+    acc_init(acc);
+    for (size_t k = 0; k < rows; k++) {
+        size_t r = selected ? selected[k] : k;
+        if (r < block->row_count) acc_push(acc, ison_row_get_ptr(block->rows[r], field));
+    }
+    acc_finish(acc, rows, out, block, NULL, 0, f, selected);
+    ison_free(acc);
+    return true;
+}
+
+bool ison_packed_aggregate(const ison_packed_t *packed, const char *name, size_t field,
+                           ison_aggregate_t *out) {
+    if (!out) return false;
+    size_t rows = 0, fields = 0;
+    const ison_packed_value_t *cells = ison_packed_cells(packed, name, &rows, &fields);
+    if (field >= fields) return false;
+    
+    column_acc_t *acc = ison_malloc(sizeof(column_acc_t));
+    if (!acc) return false;
+    acc_init(acc);
+    for (size_t r = 0; r < rows; r++) {
+        acc_push_cell(acc, &cells[r * fields + field]);
+    }
+    acc_finish(acc, rows, out, NULL, cells, fields, field, NULL);
+    ison_free(acc);
+    return true;
+}
+
+ison_value_t ison_aggregate_value(ison_agg_t agg, const ison_aggregate_t *a) {
+    switch (agg) {
+        case ISON_AGG_COUNT:
+            return ison_int((int64_t)a->count);
+        case ISON_AGG_COUNT_NON_NULL:
+            return ison_int((int64_t)a->non_null);
+        case ISON_AGG_SUM:
+            if (a->numeric == 0) break;
+            return a->integral ? ison_int(a->int_sum) : ison_float(a->sum);
+        case ISON_AGG_MIN:
+            if (a->numeric == 0) break;
+            return a->integral ? ison_int(a->int_min) : ison_float(a->min);
+        case ISON_AGG_MAX:
+            if (a->numeric == 0) break;
+            return a->integral ? ison_int(a->int_max) : ison_float(a->max);
+        case ISON_AGG_MEAN:
+            if (a->numeric == 0) break;
+            return ison_float(a->mean);
+        default:
+            break;
+    }
+    return ison_null();
+}
+
+/*
+ * One pass over the rows feeds every requested column. Rows built from the
+ * schema keep their entries in field order, so each entry is matched against
+ * the next expected field before falling back to a lookup by name.
+ */
+ison_error_t ison_block_compute_summary(ison_block_t *block, const ison_agg_t *spec) {
+    if (!block || !spec) return ISON_ERROR_INVALID;
+    
+    size_t n = block->field_count;
+    column_acc_t **accs = ison_calloc(n ? n : 1, sizeof(column_acc_t *));
+    if (!accs) return ISON_ERROR_MEMORY;
+    
+    ison_error_t result = ISON_OK;
+    for (size_t f = 0; f < n; f++) {
+        if (spec[f] == ISON_AGG_NONE || spec[f] == ISON_AGG_COUNT) continue;
+        accs[f] = ison_malloc(sizeof(column_acc_t));
+        if (!accs[f]) {
+            result = ISON_ERROR_MEMORY;
+            goto done;
+        }
+        acc_init(accs[f]);
+    }
+    
+    for (size_t r = 0; r < block->row_count; r++) {
+        const ison_row_entry_t *entry = block->rows[r]->head;
+        for (size_t f = 0; f < n; f++) {
+            const ison_value_t *value;
+            if (entry && strcmp(entry->key, block->fields[f].name) == 0) {
+                value = &entry->value;
+                entry = entry->next;
+            } else {
+                value = ison_row_get_ptr(block->rows[r], block->fields[f].name);
+            }
+            if (accs[f]) acc_push(accs[f], value);
+        }
+    }
+    
+    ison_row_t *summary = ison_row_create();
+    if (!summary) {
+        result = ISON_ERROR_MEMORY;
+        goto done;
+    }
+    for (size_t f = 0; f < n; f++) {
+        ison_aggregate_t agg;
+        memset(&agg, 0, sizeof(agg));
+        agg.count = block->row_count;
+        if (accs[f]) acc_finish(accs[f], block->row_count, &agg, block, NULL, 0, f, NULL);
+        ison_value_t cell = ison_aggregate_value(spec[f], &agg);
+        if (!ison_row_append(summary, block->fields[f].name, &cell)) {
+            ison_value_free(&cell);
+            ison_row_free(summary);
+            result = ISON_ERROR_MEMORY;
+            goto done;
+        }
+    }
+    ison_block_take_summary(block, summary);
+    
+done:
+    for (size_t f = 0; f < n; f++) {
+        ison_free(accs[f]);
+    }
+    ison_free(accs);
+    return result;
+}
@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+static void *libc_malloc(size_t size, void *ctx) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void *libc_realloc(void *ptr, size_t size, void *ctx) {
+    (void)ctx;
+    return realloc(ptr, size);
+}
+
+static void libc_free(void *ptr, void *ctx) {
+    (void)ctx;
+    free(ptr);
+}
+
+static ison_allocator_t global_allocator = { libc_malloc, libc_realloc, libc_free, NULL };
+
+void ison_set_allocator(const ison_allocator_t *allocator) {
+    if (allocator && allocator->malloc_fn && allocator->realloc_fn && allocator->free_fn) {
+        global_allocator = *allocator;
+    } else {
+        global_allocator.malloc_fn = libc_malloc;
+        global_allocator.realloc_fn = libc_realloc;
+        global_allocator.free_fn = libc_free;
+        global_allocator.ctx = NULL;
+    }
+}
+
+void ison_get_allocator(ison_allocator_t *out) {
+    if (out) *out = global_allocator;
+}
+
+/* A document created without an allocator has a zeroed one: use the global */
+static const ison_allocator_t *resolve(const ison_allocator_t *allocator) {
+    return allocator && allocator->malloc_fn ? allocator : &global_allocator;
+}
+
+void *ison_allocator_malloc(const ison_allocator_t *allocator, size_t size) {
+    allocator = resolve(allocator);
+    return allocator->malloc_fn(size, allocator->ctx);
+}
+
+void *ison_allocator_realloc(const ison_allocator_t *allocator, void *ptr, size_t size) {
+    allocator = resolve(allocator);
+    return allocator->realloc_fn(ptr, size, allocator->ctx);
+}
+
+void ison_allocator_free(const ison_allocator_t *allocator, void *ptr) {
+    if (!ptr) return;
+    allocator = resolve(allocator);
+    allocator->free_fn(ptr, allocator->ctx);
+}
+
+void *ison_allocator_calloc(const ison_allocator_t *allocator, size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) return NULL;
+    void *ptr = ison_allocator_malloc(allocator, count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void *ison_malloc(size_t size) {
+    return global_allocator.malloc_fn(size, global_allocator.ctx);
+}
+
+void *ison_calloc(size_t count, size_t size) {
+    return ison_allocator_calloc(&global_allocator, count, size);
+}
+
+void *ison_realloc(void *ptr, size_t size) {
+    return global_allocator.realloc_fn(ptr, size, global_allocator.ctx);
+}
+
+void ison_free(void *ptr) {
+    if (ptr) global_allocator.free_fn(ptr, global_allocator.ctx);
+}
+
+char *ison_strdup(const char *str) {
+    if (!str) return NULL;
+    size_t len = strlen(str);
+    char *copy = ison_malloc(len + 1);
+    if (copy) memcpy(copy, str, len + 1);
+    return copy;
+}
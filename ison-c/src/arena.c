@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_MIN_CHUNK 4096
+#define ARENA_MAX_CHUNK (1024 * 1024)
+
+struct ison_arena_chunk {
+    ison_arena_chunk_t *next;
+    size_t size;
+    size_t used;
+    /* data follows, ARENA_ALIGN-aligned */
+};
+
+static size_t header_size(void) {
+    return (sizeof(ison_arena_chunk_t) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static char *chunk_data(ison_arena_chunk_t *chunk) {
+    return (char *)chunk + header_size();
+}
+
+void *ison_arena_alloc(ison_arena_t *arena, size_t size) {
+    if (!arena) return NULL;
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    
+    /* After a reset, later chunks are reused before anything new is allocated */
+    ison_arena_chunk_t *chunk = arena->current;
+    ison_arena_chunk_t *last = chunk;
+    while (chunk && chunk->size - chunk->used < size) {
+        last = chunk;
+        chunk = chunk->next;
+    }
+    
+    if (!chunk) {
+        size_t chunk_size = last ? last->size * 2 : ARENA_MIN_CHUNK;
+        if (chunk_size > ARENA_MAX_CHUNK) chunk_size = ARENA_MAX_CHUNK;
+        if (chunk_size < size) chunk_size = size;
+        
+        chunk = ison_allocator_malloc(arena->allocator, header_size() + chunk_size);
+        if (!chunk) return NULL;
+        chunk->next = NULL;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        
+        if (last) {
+            last->next = chunk;
+        } else {
+            arena->head = chunk;
+        }
+    }
+    
+    arena->current = chunk;
+    void *ptr = chunk_data(chunk) + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+void ison_arena_reset(ison_arena_t *arena) {
+    if (!arena) return;
+    for (ison_arena_chunk_t *chunk = arena->head; chunk; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+    arena->current = arena->head;
+}
+
+void ison_arena_free(ison_arena_t *arena) {
+    if (!arena) return;
+    ison_arena_chunk_t *chunk = arena->head;
+    while (chunk) {
+        ison_arena_chunk_t *next = chunk->next;
+        ison_allocator_free(arena->allocator, chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->current = NULL;
+}
+
+size_t ison_arena_footprint(const ison_arena_t *arena, size_t *chunks) {
+    size_t bytes = 0;
+    size_t count = 0;
+    for (ison_arena_chunk_t *chunk = arena ? arena->head : NULL; chunk; chunk = chunk->next) {
+        bytes += header_size() + chunk->size;
+        count++;
+    }
+    if (chunks) *chunks = count;
+    return bytes;
+}
@@ -1,21 +1,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ison.h"
-
-static char *strdup_safe(const char *str) {
-    if (!str) return NULL;
-    size_t len = strlen(str);
-    char *copy = malloc(len + 1);
-    if (copy) memcpy(copy, str, len + 1);
-    return copy;
-}
+#include "ison_internal.h"
 
 ison_block_t *ison_block_create(const char *kind, const char *name) {
-    ison_block_t *block = calloc(1, sizeof(ison_block_t));
+    ison_block_t *block = ison_calloc(1, sizeof(ison_block_t));
     if (!block) return NULL;
     
-    block->kind = strdup_safe(kind);
-    block->name = strdup_safe(name);
+    block->kind = ison_strdup(kind);
+    block->name = ison_strdup(name);
     block->fields = NULL;
     block->field_count = 0;
     block->field_capacity = 0;
@@ -23,7 +16,17 @@ ison_block_t *ison_block_create(const char *kind, const char *name) {
     block->row_count = 0;
     block->row_capacity = 0;
     block->summary_row = NULL;
-    
+    block->indexes = NULL;
+    block->index_count = 0;
+    block->range_indexes = NULL;
+    block->range_index_count = 0;
+    block->spare_rows = NULL;
+    block->spare_row_count = 0;
+    block->spare_row_capacity = 0;
+    
+    ison_memory_account(&block->memory, &block->memory.blocks, sizeof(ison_block_t), 1);
+    ison_memory_account_string(&block->memory, &block->memory.blocks, block->kind, 1);
+    ison_memory_account_string(&block->memory, &block->memory.blocks, block->name, 1);
     return block;
 }
 
@@ -32,58 +35,130 @@ void ison_block_add_field(ison_block_t *block, const char *name, const char *typ
     
     if (block->field_count >= block->field_capacity) {
         size_t new_cap = block->field_capacity == 0 ? 8 : block->field_capacity * 2;
-        ison_field_info_t *new_fields = realloc(block->fields, new_cap * sizeof(ison_field_info_t));
+        ison_field_info_t *new_fields = ison_realloc(block->fields, new_cap * sizeof(ison_field_info_t));
         if (!new_fields) return;
+        ison_memory_account_resize(&block->memory, &block->memory.fields,
+                                   block->field_capacity * sizeof(ison_field_info_t),
+                                   new_cap * sizeof(ison_field_info_t));
         block->fields = new_fields;
         block->field_capacity = new_cap;
     }
     
-    block->fields[block->field_count].name = strdup_safe(name);
-    block->fields[block->field_count].type_hint = strdup_safe(type_hint);
+    block->fields[block->field_count].name = ison_strdup(name);
+    block->fields[block->field_count].type_hint = ison_strdup(type_hint);
+    ison_memory_account_string(&block->memory, &block->memory.fields, block->fields[block->field_count].name, 1);
+    ison_memory_account_string(&block->memory, &block->memory.fields, block->fields[block->field_count].type_hint, 1);
     block->field_count++;
 }
 
+bool ison_block_reserve_rows(ison_block_t *block, size_t extra) {
+    if (block->row_count + extra <= block->row_capacity) return true;
+    
+    size_t new_cap = block->row_capacity == 0 ? 8 : block->row_capacity * 2;
+    while (new_cap < block->row_count + extra) new_cap *= 2;
+    ison_row_t **new_rows = ison_realloc(block->rows, new_cap * sizeof(ison_row_t *));
+    if (!new_rows) return false;
+    ison_memory_account_resize(&block->memory, &block->memory.blocks,
+                               block->row_capacity * sizeof(ison_row_t *), new_cap * sizeof(ison_row_t *));
+    block->rows = new_rows;
+    block->row_capacity = new_cap;
+    return true;
+}
+
+bool ison_block_take_row(ison_block_t *block, ison_row_t *row) {
+    if (!row) return false;
+    if (!block || !ison_block_reserve_rows(block, 1)) {
+        ison_row_free(row);
+        return false;
+    }
+    
+    block->rows[block->row_count++] = row;
+    ison_memory_account_row(&block->memory, row, 1, false);
+    ison_block_index_row(block, block->row_count - 1);
+    return true;
+}
+
 void ison_block_add_row(ison_block_t *block, const ison_row_t *row) {
     if (!block || !row) return;
-    
-    if (block->row_count >= block->row_capacity) {
-        size_t new_cap = block->row_capacity == 0 ? 8 : block->row_capacity * 2;
-        ison_row_t **new_rows = realloc(block->rows, new_cap * sizeof(ison_row_t *));
-        if (!new_rows) return;
-        block->rows = new_rows;
-        block->row_capacity = new_cap;
+    ison_block_take_row(block, ison_row_copy(row));
+}
+
+void ison_block_take_summary(ison_block_t *block, ison_row_t *row) {
+    if (!block) {
+        ison_row_free(row);
+        return;
     }
-    
-    ison_row_t *copy = ison_row_create();
-    if (!copy) return;
-    
-    ison_row_entry_t *entry = row->head;
-    while (entry) {
-        ison_row_set(copy, entry->key, &entry->value);
-        entry = entry->next;
+    if (block->summary_row) {
+        ison_memory_account_row(&block->memory, block->summary_row, -1, false);
+        ison_row_free(block->summary_row);
     }
-    
-    block->rows[block->row_count++] = copy;
+    ison_memory_account_row(&block->memory, row, 1, false);
+    block->summary_row = row;
 }
 
 void ison_block_set_summary(ison_block_t *block, const ison_row_t *row) {
     if (!block) return;
-    if (block->summary_row) {
-        ison_row_free(block->summary_row);
+    ison_block_take_summary(block, row ? ison_row_copy(row) : NULL);
+}
+
+void ison_block_clear_fields(ison_block_t *block) {
+    for (size_t i = 0; i < block->field_count; i++) {
+        ison_memory_account_string(&block->memory, &block->memory.fields, block->fields[i].name, -1);
+        ison_memory_account_string(&block->memory, &block->memory.fields, block->fields[i].type_hint, -1);
+        ison_free(block->fields[i].name);
+        ison_free(block->fields[i].type_hint);
     }
-    if (!row) {
+    block->field_count = 0;
+}
+
+/* Keeps the entries (and their keys) so the next row of the same shape reuses them */
+static void recycle_row(ison_block_t *block, ison_row_t *row) {
+    ison_memory_account_row(&block->memory, row, -1, false);
+    if (block->spare_row_count >= block->spare_row_capacity) {
+        size_t new_cap = block->spare_row_capacity == 0 ? 8 : block->spare_row_capacity * 2;
+        ison_row_t **new_spare = ison_realloc(block->spare_rows, new_cap * sizeof(ison_row_t *));
+        if (!new_spare) {
+            ison_row_free(row);
+            return;
+        }
+        ison_memory_account_resize(&block->memory, &block->memory.spare,
+                                   block->spare_row_capacity * sizeof(ison_row_t *),
+                                   new_cap * sizeof(ison_row_t *));
+        block->spare_rows = new_spare;
+        block->spare_row_capacity = new_cap;
+    }
+    for (ison_row_entry_t *entry = row->head; entry; entry = entry->next) {
+        ison_value_free(&entry->value);
+        entry->value = ison_null();
+    }
+    block->spare_rows[block->spare_row_count++] = row;
+    ison_memory_account_row(&block->memory, row, 1, true);
+}
+
+void ison_block_recycle(ison_block_t *block) {
+    ison_block_free_indexes(block);
+    for (size_t i = 0; i < block->row_count; i++) {
+        recycle_row(block, block->rows[i]);
+    }
+    block->row_count = 0;
+    if (block->summary_row) {
+        recycle_row(block, block->summary_row);
         block->summary_row = NULL;
-        return;
     }
-    
-    block->summary_row = ison_row_create();
-    if (!block->summary_row) return;
-    
-    ison_row_entry_t *entry = row->head;
-    while (entry) {
-        ison_row_set(block->summary_row, entry->key, &entry->value);
-        entry = entry->next;
+}
+
+ison_row_t *ison_block_spare_row(ison_block_t *block) {
+    if (!block || block->spare_row_count == 0) return NULL;
+    ison_row_t *row = block->spare_rows[--block->spare_row_count];
+    ison_memory_account_row(&block->memory, row, -1, true);
+    return row;
+}
+
+size_t ison_field_position(const ison_block_t *block, const char *field) {
+    for (size_t f = 0; f < block->field_count; f++) {
+        if (strcmp(block->fields[f].name, field) == 0) return f;
     }
+    return ISON_NO_FIELD;
 }
 
 char **ison_block_get_field_names(const ison_block_t *block, size_t *count) {
@@ -92,11 +167,11 @@ char **ison_block_get_field_names(const ison_block_t *block, size_t *count) {
     *count = block->field_count;
     if (*count == 0) return NULL;
     
-    char **names = malloc(*count * sizeof(char *));
+    char **names = ison_malloc(*count * sizeof(char *));
     if (!names) return NULL;
     
     for (size_t i = 0; i < *count; i++) {
-        names[i] = strdup_safe(block->fields[i].name);
+        names[i] = ison_strdup(block->fields[i].name);
     }
     
     return names;
@@ -105,23 +180,26 @@ char **ison_block_get_field_names(const ison_block_t *block, size_t *count) {
 void ison_block_free(ison_block_t *block) {
     if (!block) return;
     
-    free(block->kind);
-    free(block->name);
+    ison_free(block->kind);
+    ison_free(block->name);
     
-    for (size_t i = 0; i < block->field_count; i++) {
-        free(block->fields[i].name);
-        free(block->fields[i].type_hint);
-    }
-    free(block->fields);
+    ison_block_clear_fields(block);
+    ison_free(block->fields);
     
     for (size_t i = 0; i < block->row_count; i++) {
         ison_row_free(block->rows[i]);
     }
-    free(block->rows);
+    ison_free(block->rows);
+    
+    for (size_t i = 0; i < block->spare_row_count; i++) {
+        ison_row_free(block->spare_rows[i]);
+    }
+    ison_free(block->spare_rows);
     
     if (block->summary_row) {
         ison_row_free(block->summary_row);
     }
     
-    free(block);
+    ison_block_free_indexes(block);
+    ison_free(block);
 }
@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+struct ison_row_builder {
+    ison_block_t *block;
+    size_t field_count;
+    size_t capacity;
+    size_t *slot_of;      /* field position -> first position with that name */
+    ison_value_t *values;
+    bool *present;
+    size_t filled;
+    size_t *table;        /* scratch hash set used by map_slots */
+    size_t table_capacity;
+    ison_row_t **batch;
+    size_t batch_count;
+    size_t batch_capacity;
+};
+
+/* Maps every field to the first field of the same name */
+static bool map_slots(ison_row_builder_t *b) {
+    size_t cap = 16;
+    while (cap < b->field_count * 2) cap *= 2;
+    if (cap > b->table_capacity) {
+        size_t *table = ison_realloc(b->table, cap * sizeof(size_t));
+        if (!table) return false;
+        b->table = table;
+        b->table_capacity = cap;
+    }
+    for (size_t i = 0; i < cap; i++) b->table[i] = (size_t)-1;
+    
+    for (size_t f = 0; f < b->field_count; f++) {
+        const char *name = b->block->fields[f].name;
+        size_t slot = (size_t)ison_hash_string(name) & (cap - 1);
+        while (b->table[slot] != (size_t)-1 && strcmp(b->block->fields[b->table[slot]].name, name) != 0) {
+            slot = (slot + 1) & (cap - 1);
+        }
+        if (b->table[slot] == (size_t)-1) b->table[slot] = f;
+        b->slot_of[f] = b->table[slot];
+    }
+    return true;
+}
+
+/* Frees values set since the last row and any queued rows */
+static void discard(ison_row_builder_t *b) {
+    for (size_t f = 0; b->filled && f < b->field_count; f++) {
+        if (!b->present[f]) continue;
+        ison_value_free(&b->values[f]);
+        b->present[f] = false;
+        b->filled--;
+    }
+    for (size_t i = 0; i < b->batch_count; i++) {
+        ison_row_free(b->batch[i]);
+    }
+    b->batch_count = 0;
+}
+
+ison_row_builder_t *ison_row_builder_rebind(ison_row_builder_t *builder, ison_block_t *block) {
+    if (!block) return builder;
+    
+    ison_row_builder_t *b = builder;
+    if (!b) {
+        b = ison_calloc(1, sizeof(ison_row_builder_t));
+        if (!b) return NULL;
+    } else {
+        discard(b);
+    }
+    b->block = block;
+    b->field_count = block->field_count;
+    
+    if (b->field_count > b->capacity) {
+        size_t n = b->field_count;
+        size_t *slot_of = ison_realloc(b->slot_of, n * sizeof(size_t));
+        if (slot_of) b->slot_of = slot_of;
+        ison_value_t *values = ison_realloc(b->values, n * sizeof(ison_value_t));
+        if (values) b->values = values;
+        bool *present = ison_realloc(b->present, n * sizeof(bool));
+        if (present) b->present = present;
+        if (!slot_of || !values || !present) {
+            ison_row_builder_abort(b);
+            return NULL;
+        }
+        memset(b->present + b->capacity, 0, (n - b->capacity) * sizeof(bool));
+        b->capacity = n;
+    }
+    
+    if (!map_slots(b)) {
+        ison_row_builder_abort(b);
+        return NULL;
+    }
+    return b;
+}
+
+void ison_row_builder_account(const ison_row_builder_t *builder, ison_memory_stats_t *stats, size_t *bucket) {
+    if (!builder) return;
+    ison_memory_account(stats, bucket, sizeof(ison_row_builder_t), 1);
+    size_t buffers[] = {
+        builder->capacity * sizeof(size_t),
+        builder->capacity * sizeof(ison_value_t),
+        builder->capacity * sizeof(bool),
+        builder->table_capacity * sizeof(size_t),
+        builder->batch_capacity * sizeof(ison_row_t *)
+    };
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        if (buffers[i]) ison_memory_account(stats, bucket, buffers[i], 1);
+    }
+}
+
+ison_row_builder_t *ison_row_builder_begin(ison_block_t *block) {
+    return ison_row_builder_rebind(NULL, block);
+}
+
+void ison_row_builder_set_at(ison_row_builder_t *builder, size_t field, const ison_value_t *value) {
+    if (!value) return;
+    if (!builder || field >= builder->field_count) {
+        ison_value_t dropped = *value;
+        ison_value_free(&dropped);
+        return;
+    }
+    
+    size_t slot = builder->slot_of[field];
+    if (builder->present[slot]) {
+        ison_value_free(&builder->values[slot]);
+    } else {
+        builder->present[slot] = true;
+        builder->filled++;
+    }
+    builder->values[slot] = *value;
+}
+
+static bool set_key(ison_row_entry_t *entry, const char *key) {
+    size_t len = strlen(key);
+    char *copy = ison_malloc(len + 1);
+    if (!copy) return false;
+    memcpy(copy, key, len + 1);
+    ison_free(entry->key);
+    entry->key = copy;
+    return true;
+}
+
+/*
+ * Fills a recycled row of the block in place when one is available, so a
+ * row shaped like its predecessor reuses every entry and key.
+ */
+ison_row_t *ison_row_builder_build(ison_row_builder_t *builder) {
+    if (!builder) return NULL;
+    
+    ison_row_t *row = ison_block_spare_row(builder->block);
+    if (!row) row = ison_row_create();
+    
+    ison_row_entry_t *entry = row ? row->head : NULL;
+    ison_row_entry_t *last = NULL;
+    size_t kept = 0;
+    for (size_t f = 0; f < builder->field_count && builder->filled; f++) {
+        if (!builder->present[f]) continue;
+        builder->present[f] = false;
+        builder->filled--;
+        
+        const char *name = builder->block->fields[f].name;
+        if (entry && (strcmp(entry->key, name) == 0 || set_key(entry, name))) {
+            entry->value = builder->values[f];
+            last = entry;
+            entry = entry->next;
+            kept++;
+        } else if (!entry && row && ison_row_append(row, name, &builder->values[f])) {
+            last = row->tail;
+            kept++;
+        } else {
+            ison_value_free(&builder->values[f]);
+        }
+    }
+    if (!row) return NULL;
+    
+    /* Drop entries left over from a wider recycled row */
+    while (entry) {
+        ison_row_entry_t *next = entry->next;
+        ison_free(entry->key);
+        ison_free(entry);
+        entry = next;
+    }
+    if (last) {
+        last->next = NULL;
+    } else {
+        row->head = NULL;
+    }
+    row->tail = last;
+    row->count = kept;
+    return row;
+}
+
+bool ison_row_builder_next_row(ison_row_builder_t *builder) {
+    if (!builder) return false;
+    
+    if (builder->batch_count >= builder->batch_capacity) {
+        size_t new_cap = builder->batch_capacity == 0 ? 16 : builder->batch_capacity * 2;
+        ison_row_t **new_batch = ison_realloc(builder->batch, new_cap * sizeof(ison_row_t *));
+        if (!new_batch) return false;
+        builder->batch = new_batch;
+        builder->batch_capacity = new_cap;
+    }
+    
+    ison_row_t *row = ison_row_builder_build(builder);
+    if (!row) return false;
+    builder->batch[builder->batch_count++] = row;
+    return true;
+}
+
+size_t ison_row_builder_commit(ison_row_builder_t *builder) {
+    if (!builder) return 0;
+    if (builder->filled) ison_row_builder_next_row(builder);
+    
+    size_t committed = 0;
+    if (ison_block_reserve_rows(builder->block, builder->batch_count)) {
+        for (; committed < builder->batch_count; committed++) {
+            ison_block_take_row(builder->block, builder->batch[committed]);
+        }
+        builder->batch_count = 0;
+    }
+    ison_row_builder_abort(builder);
+    return committed;
+}
+
+void ison_row_builder_abort(ison_row_builder_t *builder) {
+    if (!builder) return;
+    discard(builder);
+    ison_free(builder->batch);
+    ison_free(builder->slot_of);
+    ison_free(builder->values);
+    ison_free(builder->present);
+    ison_free(builder->table);
+    ison_free(builder);
+}
@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdio.h>
 #include "ison.h"
+#include "ison_internal.h"
 
 static void append_string(char **buf, size_t *len, size_t *cap, const char *str);
 static void append_char(char **buf, size_t *len, size_t *cap, char ch);
@@ -44,7 +45,7 @@ char *ison_to_json(const char *ison_text, ison_error_t *error) {
     }
     
     size_t len = 0, cap = 1024;
-    char *result = malloc(cap);
+    char *result = ison_malloc(cap);
     if (!result) {
         ison_document_free(doc);
         if (error) *error = ISON_ERROR_MEMORY;
@@ -82,7 +83,7 @@ char *ison_to_json(const char *ison_text, ison_error_t *error) {
                     
                     char *json_val = ison_value_to_json(val);
                     append_string(&result, &len, &cap, json_val);
-                    free(json_val);
+                    ison_free(json_val);
                 }
             }
             append_string(&result, &len, &cap, "}");
@@ -96,248 +97,663 @@ char *ison_to_json(const char *ison_text, ison_error_t *error) {
     return result;
 }
 
-static void skip_ws(const char **p) {
-    while (**p && (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r')) (*p)++;
-}
+/*
+ * Single-pass JSON normalizer. With auto_refs, a nested object under key K
+ * becomes a row of table K and its parent cell a :K:id reference; an array
+ * under K becomes rows of table K, each carrying a :parent:id back-reference
+ * in a "<parent>_id" column (scalars land in a "value" column). Rows without
+ * an "id" (or with a null one) get their 1-based position. Nested rows with
+ * an explicit id are emitted once per table, so repeated entities collapse to
+ * references. A referenced id that is empty or holds whitespace or quotes
+ * cannot be written as a reference token and fails with ISON_ERROR_INVALID.
+ */
+typedef struct {
+    ison_block_t *from;
+    ison_block_t *to;
+} json_edge_t;
+
+typedef struct {
+    ison_block_t *block;
+    size_t row;
+} json_backref_t;
+
+typedef struct {
+    ison_document_t *doc;
+    ison_json_tape_t *tape;
+    ison_fromdict_options_t opts;
+    json_edge_t *edges;
+    size_t edge_count;
+    size_t edge_capacity;
+    char **seen;
+    size_t seen_count;
+    size_t seen_capacity;
+    int bad_id;
+} json_normalizer_t;
 
-static char *parse_json_string(const char **p) {
-    if (**p != '"') return NULL;
-    (*p)++;
+/* Returns 1 if (block, id) was already emitted, otherwise records it */
+static int seen_before(json_normalizer_t *n, const ison_block_t *block, const char *id) {
+    size_t name_len = strlen(block->name);
+    size_t id_len = strlen(id);
+    char *key = ison_malloc(name_len + id_len + 2);
+    if (!key) return 0;
+    memcpy(key, block->name, name_len);
+    key[name_len] = '\x1f';
+    memcpy(key + name_len + 1, id, id_len + 1);
     
-    const char *start = *p;
-    size_t len = 0;
-    while (**p && **p != '"') {
-        if (**p == '\\') {
-            (*p) += 2;
-            len++;
-        } else {
-            (*p)++;
-            len++;
+    if ((n->seen_count + 1) * 2 > n->seen_capacity) {
+        size_t new_cap = n->seen_capacity == 0 ? 64 : n->seen_capacity * 2;
+        char **new_seen = ison_calloc(new_cap, sizeof(char *));
+        if (!new_seen) {
+            ison_free(key);
+            return 0;
+        }
+        for (size_t i = 0; i < n->seen_capacity; i++) {
+            if (!n->seen[i]) continue;
+            size_t slot = ison_hash_string(n->seen[i]) & (new_cap - 1);
+            while (new_seen[slot]) slot = (slot + 1) & (new_cap - 1);
+            new_seen[slot] = n->seen[i];
         }
+        ison_free(n->seen);
+        n->seen = new_seen;
+        n->seen_capacity = new_cap;
     }
     
-    char *result = malloc(len + 1);
-    if (!result) return NULL;
-    
-    const char *src = start;
-    char *dst = result;
-    while (src < *p) {
-        if (*src == '\\') {
-            src++;
-            switch (*src) {
-                case '"': *dst++ = '"'; break;
-                case '\\': *dst++ = '\\'; break;
-                case '/': *dst++ = '/'; break;
-                case 'b': *dst++ = '\b'; break;
-                case 'f': *dst++ = '\f'; break;
-                case 'n': *dst++ = '\n'; break;
-                case 'r': *dst++ = '\r'; break;
-                case 't': *dst++ = '\t'; break;
-                default: *dst++ = *src;
-            }
-            src++;
-        } else {
-            *dst++ = *src++;
+    size_t slot = ison_hash_string(key) & (n->seen_capacity - 1);
+    while (n->seen[slot]) {
+        if (strcmp(n->seen[slot], key) == 0) {
+            ison_free(key);
+            return 1;
         }
+        slot = (slot + 1) & (n->seen_capacity - 1);
     }
-    *dst = '\0';
-    
-    if (**p == '"') (*p)++;
-    return result;
+    n->seen[slot] = key;
+    n->seen_count++;
+    return 0;
 }
 
-static ison_value_t parse_json_value(const char **p);
+static void add_edge(json_normalizer_t *n, ison_block_t *from, ison_block_t *to) {
+    for (size_t i = 0; i < n->edge_count; i++) {
+        if (n->edges[i].from == from && n->edges[i].to == to) return;
+    }
+    if (n->edge_count >= n->edge_capacity) {
+        size_t new_cap = n->edge_capacity == 0 ? 8 : n->edge_capacity * 2;
+        json_edge_t *new_edges = ison_realloc(n->edges, new_cap * sizeof(json_edge_t));
+        if (!new_edges) return;
+        n->edges = new_edges;
+        n->edge_capacity = new_cap;
+    }
+    n->edges[n->edge_count].from = from;
+    n->edges[n->edge_count].to = to;
+    n->edge_count++;
+}
+
+static ison_block_t *get_or_create_block(json_normalizer_t *n, const char *kind, const char *name) {
+    ison_block_t *block = ison_document_get(n->doc, name);
+    if (block) return block;
+    block = ison_block_create(kind, name);
+    ison_document_add_block(n->doc, block);
+    return block;
+}
+
+static void ensure_field(ison_block_t *block, const char *name) {
+    for (size_t i = 0; i < block->field_count; i++) {
+        if (strcmp(block->fields[i].name, name) == 0) return;
+    }
+    ison_block_add_field(block, name, "");
+}
+
+static void set_cell(ison_block_t *block, ison_row_t *row, const char *key, ison_value_t *val) {
+    ensure_field(block, key);
+    ison_row_set(row, key, val);
+}
 
-static ison_row_t *parse_json_object(const char **p) {
-    if (**p != '{') return NULL;
-    (*p)++;
+/* NULL when the id cannot be written as the id part of a :ns:id token */
+static char *id_to_string(const ison_value_t *val) {
+    char buf[32];
+    const char *str;
+    switch (val->type) {
+        case ISON_TYPE_INT:
+            snprintf(buf, sizeof(buf), "%lld", (long long)val->data.int_val);
+            return ison_strdup(buf);
+        case ISON_TYPE_FLOAT:
+            ison_format_float(buf, sizeof(buf), val->data.float_val);
+            return ison_strdup(buf);
+        case ISON_TYPE_BOOL:
+            return ison_strdup(val->data.bool_val ? "true" : "false");
+        case ISON_TYPE_STRING:
+            str = ison_value_string(val);
+            if (!str || !*str || strpbrk(str, " \t\n\r\"")) return NULL;
+            return ison_strdup(str);
+        default:
+            return NULL;
+    }
+}
+
+static void push_backref(json_backref_t **refs, size_t *count, size_t *cap,
+                         ison_block_t *block, size_t row) {
+    if (*count >= *cap) {
+        size_t new_cap = *cap == 0 ? 8 : *cap * 2;
+        json_backref_t *new_refs = ison_realloc(*refs, new_cap * sizeof(json_backref_t));
+        if (!new_refs) return;
+        *refs = new_refs;
+        *cap = new_cap;
+    }
+    (*refs)[*count].block = block;
+    (*refs)[*count].row = row;
+    (*count)++;
+}
+
+static char *normalize_object(json_normalizer_t *n, ison_block_t *block, int nested);
+
+static void normalize_array(json_normalizer_t *n, ison_block_t *child,
+                            json_backref_t **refs, size_t *ref_count, size_t *ref_cap) {
+    ison_json_tape_t *tape = n->tape;
+    tape->pos++;
     
-    ison_row_t *row = ison_row_create();
-    skip_ws(p);
+    while (!tape->error && ison_json_peek(tape) != ']') {
+        char c = ison_json_peek(tape);
+        size_t before = child->row_count;
+        if (c == '{') {
+            ison_free(normalize_object(n, child, 0));
+        } else if (c == '[') {
+            ison_json_skip(tape);
+        } else {
+            ison_row_t *row = ison_row_create();
+            ison_value_t id = ison_int((int64_t)child->row_count + 1);
+            set_cell(child, row, "id", &id);
+            ison_value_t val = ison_json_parse_value(tape);
+            set_cell(child, row, "value", &val);
+            ison_block_take_row(child, row);
+        }
+        if (child->row_count > before) {
+            push_backref(refs, ref_count, ref_cap, child, child->row_count - 1);
+        }
+        
+        if (ison_json_peek(tape) != ',') break;
+        tape->pos++;
+    }
     
-    if (**p == '}') {
-        (*p)++;
-        return row;
+    if (ison_json_peek(tape) != ']') tape->error = 1;
+    tape->pos++;
+}
+
+/*
+ * Parses the object at the cursor into a new row of `block` and returns its
+ * id as a string (NULL if the row has none), after patching back-references
+ * into the rows of any child arrays.
+ */
+static char *normalize_object(json_normalizer_t *n, ison_block_t *block, int nested) {
+    ison_json_tape_t *tape = n->tape;
+    if (ison_json_peek(tape) != '{') {
+        tape->error = 1;
+        return NULL;
     }
+    tape->pos++;
     
-    while (**p) {
-        skip_ws(p);
-        char *key = parse_json_string(p);
-        if (!key) break;
-        
-        skip_ws(p);
-        if (**p == ':') (*p)++;
-        skip_ws(p);
-        
-        ison_value_t val = parse_json_value(p);
-        ison_row_set(row, key, &val);
-        free(key);
+    ison_row_t *row = ison_row_create();
+    json_backref_t *refs = NULL;
+    size_t ref_count = 0, ref_cap = 0;
+    
+    while (!tape->error && ison_json_peek(tape) != '}') {
+        const char *scratch_key = ison_json_parse_key(tape);
+        if (!scratch_key) break;
+        char *key = ison_strdup(scratch_key);
+        char c = ison_json_peek(tape);
         
-        skip_ws(p);
-        if (**p == ',') {
-            (*p)++;
-            continue;
+        if (n->opts.auto_refs && c == '{') {
+            ison_block_t *child = get_or_create_block(n, "table", key);
+            char *child_id = normalize_object(n, child, 1);
+            if (child_id) {
+                ison_reference_t ref = {child_id, key, NULL};
+                ison_value_t val = ison_ref(&ref);
+                set_cell(block, row, key, &val);
+                add_edge(n, block, child);
+                ison_free(child_id);
+            }
+        } else if (n->opts.auto_refs && c == '[') {
+            ison_block_t *child = get_or_create_block(n, "table", key);
+            normalize_array(n, child, &refs, &ref_count, &ref_cap);
+            if (child->row_count > 0) add_edge(n, child, block);
+        } else {
+            ison_value_t val = ison_json_parse_value(tape);
+            set_cell(block, row, key, &val);
         }
-        if (**p == '}') {
-            (*p)++;
-            break;
+        ison_free(key);
+        
+        if (ison_json_peek(tape) != ',') break;
+        tape->pos++;
+    }
+    
+    if (ison_json_peek(tape) != '}') tape->error = 1;
+    tape->pos++;
+    
+    char *id = NULL;
+    ison_value_t *id_val = ison_row_get_ptr(row, "id");
+    if (id_val && id_val->type == ISON_TYPE_NULL) id_val = NULL;
+    if (id_val) {
+        id = id_to_string(id_val);
+        if (!id && n->opts.auto_refs && (nested || ref_count > 0)) {
+            n->bad_id = 1;
+            tape->error = 1;
         }
+    } else if (n->opts.auto_refs) {
+        ison_value_t val = ison_int((int64_t)block->row_count + 1);
+        set_cell(block, row, "id", &val);
+        id = id_to_string(&val);
     }
     
-    return row;
+    if (nested && id_val && id && seen_before(n, block, id)) {
+        ison_row_free(row);
+    } else {
+        ison_block_take_row(block, row);
+    }
+    
+    if (id && ref_count > 0) {
+        size_t col_len = strlen(block->name) + 4;
+        char *col = ison_malloc(col_len);
+        if (col) {
+            snprintf(col, col_len, "%s_id", block->name);
+            for (size_t i = 0; i < ref_count; i++) {
+                ison_reference_t ref = {id, block->name, NULL};
+                ison_value_t val = ison_ref(&ref);
+                set_cell(refs[i].block, refs[i].block->rows[refs[i].row], col, &val);
+            }
+            ison_free(col);
+        }
+    }
+    ison_free(refs);
+    return id;
 }
 
-static ison_value_t parse_json_value(const char **p) {
-    skip_ws(p);
-    
-    if (**p == '"') {
-        char *s = parse_json_string(p);
-        ison_value_t v = ison_string(s);
-        free(s);
-        return v;
-    }
-    if (strncmp(*p, "true", 4) == 0) {
-        *p += 4;
-        return ison_bool(1);
-    }
-    if (strncmp(*p, "false", 5) == 0) {
-        *p += 5;
-        return ison_bool(0);
-    }
-    if (strncmp(*p, "null", 4) == 0) {
-        *p += 4;
-        return ison_null();
-    }
-    if (**p == '{') {
-        ison_row_t *row = parse_json_object(p);
-        return ison_ref(&(ison_reference_t){(char*)row, NULL, NULL});
-    }
-    if (**p == '[') {
-        (*p)++;
-        skip_ws(p);
-        if (**p == ']') {
-            (*p)++;
-            return ison_null();
-        }
-        
-        while (**p && **p != ']') {
-            parse_json_value(p);
-            skip_ws(p);
-            if (**p == ',') (*p)++;
-            skip_ws(p);
+/* Kahn's algorithm; ties and cycles fall back to first-appearance order */
+static void order_blocks(json_normalizer_t *n) {
+    ison_document_t *doc = n->doc;
+    size_t count = doc->block_count;
+    if (count < 2 || n->edge_count == 0) return;
+    
+    size_t *pending = ison_calloc(count, sizeof(size_t));
+    char *placed = ison_calloc(count, 1);
+    ison_block_t **blocks = ison_malloc(count * sizeof(ison_block_t *));
+    char **order = ison_malloc(count * sizeof(char *));
+    if (!pending || !placed || !blocks || !order) goto done;
+    
+    /* A block waits for every block it references */
+    for (size_t e = 0; e < n->edge_count; e++) {
+        for (size_t i = 0; i < count; i++) {
+            if (doc->blocks[i] == n->edges[e].from && n->edges[e].from != n->edges[e].to) {
+                pending[i]++;
+            }
         }
-        if (**p == ']') (*p)++;
-        return ison_null();
     }
     
-    char *end;
-    double d = strtod(*p, &end);
-    if (end != *p) {
-        *p = end;
-        if (d == (double)(int64_t)d) return ison_int((int64_t)d);
-        return ison_float(d);
+    for (size_t out = 0; out < count; out++) {
+        size_t pick = count;
+        for (size_t i = 0; i < count && pick == count; i++) {
+            if (!placed[i] && pending[i] == 0) pick = i;
+        }
+        for (size_t i = 0; i < count && pick == count; i++) {
+            if (!placed[i]) pick = i;
+        }
+        
+        placed[pick] = 1;
+        blocks[out] = doc->blocks[pick];
+        order[out] = doc->order[pick];
+        for (size_t e = 0; e < n->edge_count; e++) {
+            if (n->edges[e].to != doc->blocks[pick] || n->edges[e].from == n->edges[e].to) continue;
+            for (size_t i = 0; i < count; i++) {
+                if (doc->blocks[i] == n->edges[e].from && pending[i] > 0) pending[i]--;
+            }
+        }
     }
     
-    return ison_null();
+    memcpy(doc->blocks, blocks, count * sizeof(ison_block_t *));
+    memcpy(doc->order, order, count * sizeof(char *));
+    ison_document_reindex(doc);
+
+done:
+    ison_free(pending);
+    ison_free(placed);
+    ison_free(blocks);
+    ison_free(order);
 }
 
 ison_document_t *ison_from_json(const char *json_text, ison_error_t *error) {
+    return ison_from_json_with_options(json_text, NULL, error);
+}
+
+ison_document_t *ison_from_json_with_options(const char *json_text,
+                                             const ison_fromdict_options_t *options,
+                                             ison_error_t *error) {
     if (error) *error = ISON_OK;
     if (!json_text) {
         if (error) *error = ISON_ERROR_INVALID;
         return NULL;
     }
     
-    ison_document_t *doc = ison_document_create();
-    const char *p = json_text;
-    
-    skip_ws(&p);
-    if (*p != '{') {
-        if (error) *error = ISON_ERROR_PARSE;
-        ison_document_free(doc);
+    ison_json_tape_t tape = {0};
+    ison_error_t err = ison_json_index(&tape, json_text, strlen(json_text));
+    if (err != ISON_OK || ison_json_peek(&tape) != '{') {
+        if (error) *error = err != ISON_OK ? err : ISON_ERROR_PARSE;
+        ison_json_tape_free(&tape);
         return NULL;
     }
-    p++;
+    tape.pos++;
+    
+    json_normalizer_t n = {0};
+    n.doc = ison_document_create();
+    n.tape = &tape;
+    n.opts = options ? *options : ison_default_fromdict_options();
     
-    while (*p) {
-        skip_ws(&p);
-        if (*p == '}') break;
+    while (!tape.error && ison_json_peek(&tape) != '}') {
+        const char *scratch_name = ison_json_parse_key(&tape);
+        if (!scratch_name) break;
+        char *name = ison_strdup(scratch_name);
         
-        char *name = parse_json_string(&p);
-        if (!name) break;
+        char c = ison_json_peek(&tape);
+        if (c == '[') {
+            ison_block_t *block = get_or_create_block(&n, "table", name);
+            tape.pos++;
+            while (!tape.error && ison_json_peek(&tape) != ']') {
+                if (ison_json_peek(&tape) == '{') ison_free(normalize_object(&n, block, 0));
+                else ison_json_skip(&tape);
+                if (ison_json_peek(&tape) != ',') break;
+                tape.pos++;
+            }
+            if (ison_json_peek(&tape) != ']') tape.error = 1;
+            tape.pos++;
+        } else if (c == '{') {
+            ison_block_t *block = get_or_create_block(&n, "object", name);
+            ison_free(normalize_object(&n, block, 0));
+        } else {
+            ison_json_skip(&tape);
+        }
+        ison_free(name);
         
-        skip_ws(&p);
-        if (*p == ':') p++;
-        skip_ws(&p);
+        if (ison_json_peek(&tape) != ',') break;
+        tape.pos++;
+    }
+    
+    ison_document_t *doc = n.doc;
+    if (tape.error || ison_json_peek(&tape) != '}') {
+        if (error) *error = n.bad_id ? ISON_ERROR_INVALID : ISON_ERROR_PARSE;
+        ison_document_free(doc);
+        doc = NULL;
+    } else if (n.opts.smart_order) {
+        order_blocks(&n);
+    }
+    
+    for (size_t i = 0; i < n.seen_capacity; i++) {
+        ison_free(n.seen[i]);
+    }
+    ison_free(n.seen);
+    ison_free(n.edges);
+    ison_json_tape_free(&tape);
+    return doc;
+}
+
+struct ison_json_stream {
+    ison_json_stream_options_t opts;
+    ison_write_callback_t write;
+    void *userdata;
+    
+    /* Scanner state, carried across chunks */
+    int started;
+    int in_array;
+    int done;
+    int depth;
+    int in_string;
+    int escaped;
+    ison_json_tape_t tape;
+    char *record;
+    size_t record_len;
+    size_t record_cap;
+    
+    /* Header inference */
+    ison_row_t **sample;
+    size_t sample_count;
+    char **fields;
+    size_t field_count;
+    size_t field_capacity;
+    int header_written;
+    
+    char *line;
+    size_t line_len;
+    size_t line_cap;
+};
+
+static void stream_add_field(ison_json_stream_t *s, const char *key) {
+    for (size_t i = 0; i < s->field_count; i++) {
+        if (strcmp(s->fields[i], key) == 0) return;
+    }
+    if (s->field_count >= s->field_capacity) {
+        size_t new_cap = s->field_capacity == 0 ? 8 : s->field_capacity * 2;
+        char **new_fields = ison_realloc(s->fields, new_cap * sizeof(char *));
+        if (!new_fields) return;
+        s->fields = new_fields;
+        s->field_capacity = new_cap;
+    }
+    size_t len = strlen(key);
+    char *copy = ison_malloc(len + 1);
+    if (!copy) return;
+    memcpy(copy, key, len + 1);
+    s->fields[s->field_count++] = copy;
+}
+
+static void stream_flush_line(ison_json_stream_t *s) {
+    append_char(&s->line, &s->line_len, &s->line_cap, '\n');
+    s->write(s->line, s->line_len, s->userdata);
+    s->line_len = 0;
+    s->line[0] = '\0';
+}
+
+static void stream_append_header(ison_json_stream_t *s, char sep) {
+    append_string(&s->line, &s->line_len, &s->line_cap, s->opts.kind);
+    append_char(&s->line, &s->line_len, &s->line_cap, '.');
+    append_string(&s->line, &s->line_len, &s->line_cap, s->opts.name);
+    append_char(&s->line, &s->line_len, &s->line_cap, sep);
+}
+
+static void stream_append_fields(ison_json_stream_t *s) {
+    for (size_t i = 0; i < s->field_count; i++) {
+        if (i > 0) append_char(&s->line, &s->line_len, &s->line_cap, ' ');
+        append_string(&s->line, &s->line_len, &s->line_cap, s->fields[i]);
+    }
+}
+
+static void stream_emit_row(ison_json_stream_t *s, const ison_row_t *row) {
+    if (s->opts.isonl) {
+        stream_append_header(s, '|');
+        stream_append_fields(s);
+        append_char(&s->line, &s->line_len, &s->line_cap, '|');
+    }
+    for (size_t i = 0; i < s->field_count; i++) {
+        if (i > 0) append_char(&s->line, &s->line_len, &s->line_cap, ' ');
+        ison_value_t *val = ison_row_get_ptr(row, s->fields[i]);
+        if (val) {
+            char *str = ison_value_to_ison(val);
+            append_string(&s->line, &s->line_len, &s->line_cap, str);
+            ison_free(str);
+        } else {
+            append_char(&s->line, &s->line_len, &s->line_cap, '~');
+        }
+    }
+    stream_flush_line(s);
+}
+
+static void stream_write_header(ison_json_stream_t *s) {
+    s->header_written = 1;
+    if (!s->opts.isonl) {
+        stream_append_header(s, '\n');
+        stream_append_fields(s);
+        stream_flush_line(s);
+    }
+    for (size_t i = 0; i < s->sample_count; i++) {
+        stream_emit_row(s, s->sample[i]);
+        ison_row_free(s->sample[i]);
+    }
+    s->sample_count = 0;
+}
+
+static ison_error_t stream_process_record(ison_json_stream_t *s) {
+    ison_error_t err = ison_json_index(&s->tape, s->record, s->record_len);
+    if (err != ISON_OK) return err;
+    ison_row_t *row = ison_json_parse_object(&s->tape);
+    if (!row) return ISON_ERROR_PARSE;
+    
+    if (s->header_written) {
+        stream_emit_row(s, row);
+        ison_row_free(row);
+        return ISON_OK;
+    }
+    
+    for (ison_row_entry_t *entry = row->head; entry; entry = entry->next) {
+        stream_add_field(s, entry->key);
+    }
+    s->sample[s->sample_count++] = row;
+    if (s->sample_count >= s->opts.header_sample) {
+        stream_write_header(s);
+    }
+    return ISON_OK;
+}
+
+ison_json_stream_t *ison_json_stream_create(const ison_json_stream_options_t *options,
+                                            ison_write_callback_t write, void *userdata) {
+    if (!write) return NULL;
+    
+    ison_json_stream_t *s = ison_calloc(1, sizeof(ison_json_stream_t));
+    if (!s) return NULL;
+    
+    s->opts = options ? *options : ison_default_json_stream_options();
+    if (!s->opts.kind) s->opts.kind = "table";
+    if (!s->opts.name) s->opts.name = "data";
+    if (s->opts.header_sample == 0) s->opts.header_sample = 1;
+    s->write = write;
+    s->userdata = userdata;
+    
+    s->sample = ison_malloc(s->opts.header_sample * sizeof(ison_row_t *));
+    s->record_cap = 256;
+    s->record = ison_malloc(s->record_cap);
+    s->line_cap = 256;
+    s->line = ison_malloc(s->line_cap);
+    if (!s->sample || !s->record || !s->line) {
+        ison_json_stream_free(s);
+        return NULL;
+    }
+    s->line[0] = '\0';
+    return s;
+}
+
+ison_error_t ison_json_stream_feed(ison_json_stream_t *s, const char *data, size_t len) {
+    if (!s || (!data && len > 0)) return ISON_ERROR_INVALID;
+    
+    for (size_t i = 0; i < len; i++) {
+        char ch = data[i];
         
-        if (*p == '[') {
-            p++;
-            skip_ws(&p);
-            
-            ison_block_t *block = ison_block_create("table", name);
-            
-            if (*p != ']') {
-                const char *peek = p;
-                skip_ws(&peek);
-                if (*peek == '{') {
-                    ison_row_t *first = parse_json_object(&p);
-                    if (first) {
-                        ison_row_entry_t *entry = first->head;
-                        while (entry) {
-                            ison_block_add_field(block, entry->key, "");
-                            entry = entry->next;
-                        }
-                        
-                        ison_block_add_row(block, first);
-                        ison_row_free(first);
-                        
-                        skip_ws(&p);
-                        while (*p && *p != ']') {
-                            if (*p == ',') p++;
-                            skip_ws(&p);
-                            if (*p != '{') break;
-                            
-                            ison_row_t *row = parse_json_object(&p);
-                            if (row) {
-                                ison_block_add_row(block, row);
-                                ison_row_free(row);
-                            }
-                            skip_ws(&p);
-                        }
-                    }
-                }
+        if (s->depth == 0) {
+            if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == ',') continue;
+            if (s->done) return ISON_ERROR_PARSE;
+            if (ch == '[' && !s->started) {
+                s->started = 1;
+                s->in_array = 1;
+                continue;
             }
-            
-            if (*p == ']') p++;
-            ison_document_add_block(doc, block);
-        } else if (*p == '{') {
-            ison_row_t *row = parse_json_object(&p);
-            if (row) {
-                ison_block_t *block = ison_block_create("object", name);
-                ison_row_entry_t *entry = row->head;
-                while (entry) {
-                    ison_block_add_field(block, entry->key, "");
-                    entry = entry->next;
-                }
-                ison_block_add_row(block, row);
-                ison_row_free(row);
-                ison_document_add_block(doc, block);
+            if (ch == ']' && s->in_array) {
+                s->done = 1;
+                continue;
             }
-        } else {
-            parse_json_value(&p);
+            if (ch != '{') return ISON_ERROR_PARSE;
+            s->started = 1;
+            s->record_len = 0;
         }
         
-        free(name);
+        if (s->record_len + 2 > s->record_cap) {
+            size_t new_cap = s->record_cap * 2;
+            char *new_record = ison_realloc(s->record, new_cap);
+            if (!new_record) return ISON_ERROR_MEMORY;
+            s->record = new_record;
+            s->record_cap = new_cap;
+        }
+        s->record[s->record_len++] = ch;
         
-        skip_ws(&p);
-        if (*p == ',') {
-            p++;
+        if (s->in_string) {
+            if (s->escaped) s->escaped = 0;
+            else if (ch == '\\') s->escaped = 1;
+            else if (ch == '"') s->in_string = 0;
             continue;
         }
-        if (*p == '}') break;
+        
+        if (ch == '"') {
+            s->in_string = 1;
+        } else if (ch == '{' || ch == '[') {
+            s->depth++;
+        } else if (ch == '}' || ch == ']') {
+            if (--s->depth == 0) {
+                s->record[s->record_len] = '\0';
+                ison_error_t err = stream_process_record(s);
+                if (err != ISON_OK) return err;
+            }
+        }
     }
+    return ISON_OK;
+}
+
+ison_error_t ison_json_stream_finish(ison_json_stream_t *s) {
+    if (!s) return ISON_ERROR_INVALID;
+    if (s->depth != 0) return ISON_ERROR_PARSE;
+    if (!s->header_written) stream_write_header(s);
+    return ISON_OK;
+}
+
+void ison_json_stream_free(ison_json_stream_t *s) {
+    if (!s) return;
     
-    return doc;
+    for (size_t i = 0; i < s->sample_count; i++) {
+        ison_row_free(s->sample[i]);
+    }
+    ison_free(s->sample);
+    for (size_t i = 0; i < s->field_count; i++) {
+        ison_free(s->fields[i]);
+    }
+    ison_free(s->fields);
+    ison_json_tape_free(&s->tape);
+    ison_free(s->record);
+    ison_free(s->line);
+    ison_free(s);
+}
+
+static void stream_write_file(const char *data, size_t len, void *userdata) {
+    fwrite(data, 1, len, (FILE *)userdata);
+}
+
+ison_error_t ison_json_stream_file(const char *json_path, const char *ison_path,
+                                   const ison_json_stream_options_t *options) {
+    if (!json_path || !ison_path) return ISON_ERROR_INVALID;
+    
+    FILE *in = fopen(json_path, "rb");
+    if (!in) return ISON_ERROR_IO;
+    FILE *out = fopen(ison_path, "wb");
+    if (!out) {
+        fclose(in);
+        return ISON_ERROR_IO;
+    }
+    
+    ison_error_t err = ISON_ERROR_MEMORY;
+    ison_json_stream_t *s = ison_json_stream_create(options, stream_write_file, out);
+    if (s) {
+        char buf[65536];
+        size_t n;
+        err = ISON_OK;
+        while (err == ISON_OK && (n = fread(buf, 1, sizeof(buf), in)) > 0) {
+            err = ison_json_stream_feed(s, buf, n);
+        }
+        if (err == ISON_OK && ferror(in)) err = ISON_ERROR_IO;
+        if (err == ISON_OK) err = ison_json_stream_finish(s);
+        ison_json_stream_free(s);
+    }
+    
+    fclose(in);
+    if (fclose(out) != 0 && err == ISON_OK) err = ISON_ERROR_IO;
+    return err;
 }
 
 static void append_string(char **buf, size_t *len, size_t *cap, const char *str) {
@@ -345,7 +761,7 @@ static void append_string(char **buf, size_t *len, size_t *cap, const char *str)
     size_t str_len = strlen(str);
     if (*len + str_len + 1 > *cap) {
         *cap = (*cap + str_len + 1) * 2;
-        *buf = realloc(*buf, *cap);
+        *buf = ison_realloc(*buf, *cap);
     }
     memcpy(*buf + *len, str, str_len);
     *len += str_len;
@@ -355,7 +771,7 @@ static void append_string(char **buf, size_t *len, size_t *cap, const char *str)
 static void append_char(char **buf, size_t *len, size_t *cap, char ch) {
     if (*len + 2 > *cap) {
         *cap = *cap * 2;
-        *buf = realloc(*buf, *cap);
+        *buf = ison_realloc(*buf, *cap);
     }
     (*buf)[*len] = ch;
     (*len)++;
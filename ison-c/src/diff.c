@@ -0,0 +1,712 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+/*
+ * Document diff and patch.
+ *
+ * Every row of both blocks is hashed once (in parallel chunks for large
+ * blocks) over its cells in field order, with each cell's type mixed in so
+ * that 1 and 1.0 differ. Rows are then aligned through a table of
+ * {hash, first row} slots whose rows chain through next[] in row order:
+ * by the hash of their key column ("id" unless the options name another)
+ * when its values are unique keys on both sides, or by the row hash
+ * itself, as a multiset, otherwise. Rows whose hashes agree are confirmed
+ * cell by cell; only changed rows are examined further.
+ */
+
+#define DIFF_BLOCK "_diff"
+#define DIFF_OP "_op"
+#define DIFF_COLS "_cols"
+#define DIFF_HASH_ROWS 16384
+#define DIFF_NONE ((size_t)-1)
+
+typedef struct {
+    uint64_t hash;
+    size_t head;
+} diff_slot_t;
+
+/* Rows by hash; rows with the same hash chain through next[] in row order */
+typedef struct {
+    diff_slot_t *slots;
+    size_t capacity;
+    size_t *next;
+} row_table_t;
+
+typedef struct {
+    const ison_block_t *block;
+    size_t first;                 /* fields[first..] are the data columns */
+    size_t count;
+    uint64_t *hashes;
+    const ison_value_t **scratch; /* count cells per chunk */
+    size_t chunk_count;
+} hash_job_t;
+
+typedef struct {
+    const ison_block_t *a;
+    const ison_block_t *b;
+    size_t fields;
+    uint64_t *a_hashes;
+    uint64_t *b_hashes;
+    const ison_value_t **a_cells;
+    const ison_value_t **b_cells;
+    bool *include;
+    char *cols;
+    size_t cols_capacity;
+    ison_block_t *patch;
+} diff_ctx_t;
+
+/*
+ * Cells of row for fields[first..first + count), walking the entries once
+ * while they follow the schema; missing cells are NULL.
+ */
+static void gather(const ison_block_t *block, size_t first, size_t count, const ison_row_t *row,
+                   const ison_value_t **cells) {
+    const ison_row_entry_t *entry = row->head;
+    for (size_t f = 0; f < first + count; f++) {
+        const ison_value_t *value;
+        if (entry && strcmp(entry->key, block->fields[f].name) == 0) {
+            value = &entry->value;
+            entry = entry->next;
+        } else {
+            value = ison_row_get_ptr(row, block->fields[f].name);
+        }
+        if (f >= first) cells[f - first] = value;
+    }
+}
+
+static uint64_t cells_hash(const ison_value_t **cells, size_t count) {
+    uint64_t h = 0;
+    for (size_t c = 0; c < count; c++) {
+        uint64_t type = cells[c] ? (uint64_t)cells[c]->type : ISON_TYPE_NULL;
+        uint64_t v = ison_value_hash(cells[c]) ^ (type * 0x9e3779b97f4a7c15ULL);
+        h = ison_hash_combine(h, v);
+    }
+    return h;
+}
+
+/* Equal types and values; a missing cell is null */
+static bool same_cell(const ison_value_t *a, const ison_value_t *b) {
+    ison_type_t ta = a ? a->type : ISON_TYPE_NULL;
+    ison_type_t tb = b ? b->type : ISON_TYPE_NULL;
+    return ta == tb && ison_value_equal(a, b);
+}
+
+static bool same_cells(const ison_value_t **a, const ison_value_t **b, size_t count) {
+    for (size_t c = 0; c < count; c++) {
+        if (!same_cell(a[c], b[c])) return false;
+    }
+    return true;
+}
+
+static void hash_chunk(size_t chunk, void *arg) {
+    hash_job_t *job = arg;
+    size_t n = job->block->row_count;
+    const ison_value_t **cells = job->scratch + chunk * job->count;
+    for (size_t r = n * chunk / job->chunk_count; r < n * (chunk + 1) / job->chunk_count; r++) {
+        gather(job->block, job->first, job->count, job->block->rows[r], cells);
+        job->hashes[r] = cells_hash(cells, job->count);
+    }
+}
+
+static uint64_t *hash_rows(const ison_block_t *block, size_t first, size_t count) {
+    size_t n = block->row_count;
+    hash_job_t job;
+    job.block = block;
+    job.first = first;
+    job.count = count;
+    job.chunk_count = (n + DIFF_HASH_ROWS - 1) / DIFF_HASH_ROWS;
+    job.hashes = ison_malloc((n ? n : 1) * sizeof(uint64_t));
+    size_t scratch_count = job.chunk_count * count;
+    job.scratch = ison_malloc((scratch_count ? scratch_count : 1) * sizeof(ison_value_t *));
+    if (!job.hashes || !job.scratch) {
+        ison_free(job.hashes);
+        ison_free(job.scratch);
+        return NULL;
+    }
+    ison_parallel_for(job.chunk_count, hash_chunk, &job);
+    ison_free(job.scratch);
+    return job.hashes;
+}
+
+/* ==================== Row Table ==================== */
+
+/* Rows are inserted last to first so every chain runs in row order */
+static bool table_build(row_table_t *table, const uint64_t *hashes, size_t n) {
+    table->capacity = 16;
+    while (table->capacity < n * 2) table->capacity *= 2;
+    table->slots = ison_malloc(table->capacity * sizeof(diff_slot_t));
+    table->next = ison_malloc((n ? n : 1) * sizeof(size_t));
+    if (!table->slots || !table->next) return false;
+    for (size_t i = 0; i < table->capacity; i++) table->slots[i].head = DIFF_NONE;
+    
+    size_t mask = table->capacity - 1;
+    for (size_t r = n; r-- > 0;) {
+        size_t slot = (size_t)hashes[r] & mask;
+        while (table->slots[slot].head != DIFF_NONE && table->slots[slot].hash != hashes[r]) {
+            slot = (slot + 1) & mask;
+        }
+        table->next[r] = table->slots[slot].head;
+        table->slots[slot].hash = hashes[r];
+        table->slots[slot].head = r;
+    }
+    return true;
+}
+
+static size_t table_find(const row_table_t *table, uint64_t hash) {
+    size_t mask = table->capacity - 1;
+    size_t slot = (size_t)hash & mask;
+    while (table->slots[slot].head != DIFF_NONE) {
+        if (table->slots[slot].hash == hash) return table->slots[slot].head;
+        slot = (slot + 1) & mask;
+    }
+    return DIFF_NONE;
+}
+
+static void table_free(row_table_t *table) {
+    ison_free(table->slots);
+    ison_free(table->next);
+}
+
+/* Key of every row at pos; false when some row has no usable key */
+static bool row_keys(const ison_block_t *block, size_t pos, ison_key_t *keys, uint64_t *hashes) {
+    const char *name = block->fields[pos].name;
+    for (size_t r = 0; r < block->row_count; r++) {
+        const ison_value_t *v = ison_row_get_ptr(block->rows[r], name);
+        if (!v || !ison_key_make(v, &keys[r])) return false;
+        hashes[r] = keys[r].hash;
+    }
+    return true;
+}
+
+/* Row of the table's block whose key equals key, or DIFF_NONE */
+static size_t find_key(const row_table_t *table, const ison_key_t *keys, const ison_key_t *key) {
+    size_t r = table_find(table, key->hash);
+    while (r != DIFF_NONE && !ison_key_equal(&keys[r], key)) r = table->next[r];
+    return r;
+}
+
+/* ==================== Diff ==================== */
+
+static bool same_schema(const ison_block_t *a, const ison_block_t *b) {
+    if (strcmp(a->kind, b->kind) != 0 || a->field_count != b->field_count) return false;
+    for (size_t f = 0; f < a->field_count; f++) {
+        const char *ha = a->fields[f].type_hint ? a->fields[f].type_hint : "";
+        const char *hb = b->fields[f].type_hint ? b->fields[f].type_hint : "";
+        if (strcmp(a->fields[f].name, b->fields[f].name) != 0 || strcmp(ha, hb) != 0) return false;
+    }
+    return true;
+}
+
+static ison_block_t *patch_block(const ison_block_t *b) {
+    ison_block_t *patch = ison_block_create(b->kind, b->name);
+    if (!patch) return NULL;
+    ison_block_add_field(patch, DIFF_OP, "string");
+    ison_block_add_field(patch, DIFF_COLS, "string");
+    for (size_t f = 0; f < b->field_count; f++) {
+        ison_block_add_field(patch, b->fields[f].name, b->fields[f].type_hint);
+    }
+    if (patch->field_count != b->field_count + 2) {
+        ison_block_free(patch);
+        return NULL;
+    }
+    return patch;
+}
+
+/* Appends a patch row: cells[f] where include[f] (all when NULL), null elsewhere; cells[f] is read only where included */
+static bool emit(diff_ctx_t *ctx, const char *op, const ison_value_t **cells, const bool *include,
+                 const char *cols) {
+    ison_row_t *row = ison_row_create();
+    if (!row) return false;
+    
+    ison_value_t value = ison_string(op);
+    bool ok = ison_row_append(row, DIFF_OP, &value);
+    if (ok) {
+        value = cols ? ison_string(cols) : ison_null();
+        ok = ison_row_append(row, DIFF_COLS, &value);
+    }
+    for (size_t f = 0; ok && f < ctx->fields; f++) {
+        bool keep = (!include || include[f]) && cells[f];
+        value = keep ? ison_value_copy(cells[f]) : ison_null();
+        ok = ison_row_append(row, ctx->patch->fields[f + 2].name, &value);
+    }
+    if (!ok) {
+        ison_value_free(&value);
+        ison_row_free(row);
+        return false;
+    }
+    return ison_block_take_row(ctx->patch, row);
+}
+
+/* Marks the cells of b_cells that differ from a_cells, plus the key, and names them in ctx->cols */
+static bool changed_cells(diff_ctx_t *ctx, size_t key_pos) {
+    size_t len = 0;
+    for (size_t f = 0; f < ctx->fields; f++) {
+        bool changed = !same_cell(ctx->a_cells[f], ctx->b_cells[f]);
+        ctx->include[f] = changed || f == key_pos;
+        if (!changed) continue;
+    
+        const char *name = ctx->b->fields[f].name;
+        size_t name_len = strlen(name);
+        if (len + name_len + 2 > ctx->cols_capacity) {
+            size_t cap = ctx->cols_capacity ? ctx->cols_capacity * 2 : 64;
+            while (cap < len + name_len + 2) cap *= 2;
+            char *cols = ison_realloc(ctx->cols, cap);
+            if (!cols) return false;
+            ctx->cols = cols;
+            ctx->cols_capacity = cap;
+        }
+        if (len) ctx->cols[len++] = ' ';
+        memcpy(ctx->cols + len, name, name_len);
+        len += name_len;
+        ctx->cols[len] = '\0';
+    }
+    return true;
+}
+
+typedef enum {
+    ALIGN_OK = 0,
+    ALIGN_FAILED,        /* allocation failure */
+    ALIGN_NOT_UNIQUE     /* keys are missing or repeated; align by hash instead */
+} align_result_t;
+
+static align_result_t diff_keyed(diff_ctx_t *ctx, size_t key_pos) {
+    size_t na = ctx->a->row_count, nb = ctx->b->row_count;
+    ison_key_t *a_keys = ison_malloc((na ? na : 1) * sizeof(ison_key_t));
+    uint64_t *key_hashes = ison_malloc((na ? na : 1) * sizeof(uint64_t));
+    bool *matched = ison_calloc(na ? na : 1, sizeof(bool));
+    row_table_t table;
+    memset(&table, 0, sizeof(table));
+    align_result_t result = ALIGN_FAILED;
+    if (!a_keys || !key_hashes || !matched) goto done;
+    
+    if (!row_keys(ctx->a, key_pos, a_keys, key_hashes)) {
+        result = ALIGN_NOT_UNIQUE;
+        goto done;
+    }
+    if (!table_build(&table, key_hashes, na)) goto done;
+    for (size_t r = 0; r < na; r++) {
+        if (find_key(&table, a_keys, &a_keys[r]) != r) {
+            result = ALIGN_NOT_UNIQUE;
+            goto done;
+        }
+    }
+    
+    const char *key_name = ctx->b->fields[key_pos].name;
+    for (size_t j = 0; j < nb; j++) {
+        const ison_row_t *row = ctx->b->rows[j];
+        const ison_value_t *v = ison_row_get_ptr(row, key_name);
+        ison_key_t key;
+        if (!v || !ison_key_make(v, &key)) {
+            result = ALIGN_NOT_UNIQUE;
+            goto done;
+        }
+        gather(ctx->b, 0, ctx->fields, row, ctx->b_cells);
+    
+        size_t i = find_key(&table, a_keys, &key);
+        if (i == DIFF_NONE) {
+            if (!emit(ctx, "add", ctx->b_cells, NULL, NULL)) goto done;
+            continue;
+        }
+        if (matched[i]) {
+            result = ALIGN_NOT_UNIQUE;
+            goto done;
+        }
+        matched[i] = true;
+    
+        gather(ctx->a, 0, ctx->fields, ctx->a->rows[i], ctx->a_cells);
+        if (ctx->a_hashes[i] == ctx->b_hashes[j] && same_cells(ctx->a_cells, ctx->b_cells, ctx->fields)) {
+            continue;
+        }
+        if (!changed_cells(ctx, key_pos)) goto done;
+        if (!emit(ctx, "change", ctx->b_cells, ctx->include, ctx->cols)) goto done;
+    }
+    
+    for (size_t f = 0; f < ctx->fields; f++) ctx->include[f] = f == key_pos;
+    for (size_t i = 0; i < na; i++) {
+        if (matched[i]) continue;
+        gather(ctx->a, 0, ctx->fields, ctx->a->rows[i], ctx->a_cells);
+        if (!emit(ctx, "remove", ctx->a_cells, ctx->include, NULL)) goto done;
+    }
+    result = ALIGN_OK;
+    
+done:
+    table_free(&table);
+    ison_free(a_keys);
+    ison_free(key_hashes);
+    ison_free(matched);
+    return result;
+}
+
+static align_result_t diff_hashed(diff_ctx_t *ctx) {
+    size_t na = ctx->a->row_count, nb = ctx->b->row_count;
+    bool *used = ison_calloc(na ? na : 1, sizeof(bool));
+    row_table_t table;
+    memset(&table, 0, sizeof(table));
+    align_result_t result = ALIGN_FAILED;
+    if (!used || !table_build(&table, ctx->a_hashes, na)) goto done;
+    
+    for (size_t j = 0; j < nb; j++) {
+        gather(ctx->b, 0, ctx->fields, ctx->b->rows[j], ctx->b_cells);
+        size_t i = table_find(&table, ctx->b_hashes[j]);
+        for (; i != DIFF_NONE; i = table.next[i]) {
+            if (used[i]) continue;
+            gather(ctx->a, 0, ctx->fields, ctx->a->rows[i], ctx->a_cells);
+            if (same_cells(ctx->a_cells, ctx->b_cells, ctx->fields)) break;
+        }
+        if (i != DIFF_NONE) {
+            used[i] = true;
+        } else if (!emit(ctx, "add", ctx->b_cells, NULL, NULL)) {
+            goto done;
+        }
+    }
+    for (size_t i = 0; i < na; i++) {
+        if (used[i]) continue;
+        gather(ctx->a, 0, ctx->fields, ctx->a->rows[i], ctx->a_cells);
+        if (!emit(ctx, "remove", ctx->a_cells, NULL, NULL)) goto done;
+    }
+    result = ALIGN_OK;
+    
+done:
+    table_free(&table);
+    ison_free(used);
+    return result;
+}
+
+/* A `summary` row with b's whole summary when it differs from a's, or `unsummary` when b has none */
+static bool diff_summary(diff_ctx_t *ctx) {
+    const ison_row_t *sa = ctx->a->summary_row, *sb = ctx->b->summary_row;
+    if (!sb) {
+        if (!sa) return true;
+        for (size_t f = 0; f < ctx->fields; f++) ctx->include[f] = false;
+        return emit(ctx, "unsummary", ctx->b_cells, ctx->include, NULL);
+    }
+    gather(ctx->b, 0, ctx->fields, sb, ctx->b_cells);
+    if (sa) {
+        gather(ctx->a, 0, ctx->fields, sa, ctx->a_cells);
+        if (same_cells(ctx->a_cells, ctx->b_cells, ctx->fields)) return true;
+    }
+    return emit(ctx, "summary", ctx->b_cells, NULL, NULL);
+}
+
+/* Patch block for a -> b, or NULL in *patch when they hold the same rows; false on failure */
+static bool diff_block(const ison_block_t *a, const ison_block_t *b, const char *key,
+                       ison_block_t **patch, bool *keyed) {
+    *patch = NULL;
+    *keyed = false;
+    
+    diff_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.a = a;
+    ctx.b = b;
+    ctx.fields = b->field_count;
+    size_t cells = ctx.fields ? ctx.fields : 1;
+    ctx.a_hashes = hash_rows(a, 0, ctx.fields);
+    ctx.b_hashes = hash_rows(b, 0, ctx.fields);
+    ctx.a_cells = ison_malloc(cells * sizeof(ison_value_t *));
+    ctx.b_cells = ison_malloc(cells * sizeof(ison_value_t *));
+    ctx.include = ison_malloc(cells * sizeof(bool));
+    ctx.patch = patch_block(b);
+    
+    bool ok = false;
+    if (!ctx.a_hashes || !ctx.b_hashes || !ctx.a_cells || !ctx.b_cells || !ctx.include || !ctx.patch) {
+        goto done;
+    }
+    
+    size_t key_pos = DIFF_NONE;
+    for (size_t f = 0; key && f < b->field_count; f++) {
+        if (strcmp(b->fields[f].name, key) == 0) {
+            key_pos = f;
+            break;
+        }
+    }
+    align_result_t aligned = ALIGN_NOT_UNIQUE;
+    if (key_pos != DIFF_NONE) {
+        aligned = diff_keyed(&ctx, key_pos);
+        *keyed = aligned == ALIGN_OK;
+    }
+    if (aligned == ALIGN_NOT_UNIQUE) {
+        /* Start over with the rows a keyed pass may have emitted */
+        ison_block_free(ctx.patch);
+        ctx.patch = patch_block(b);
+        aligned = ctx.patch ? diff_hashed(&ctx) : ALIGN_FAILED;
+    }
+    if (aligned != ALIGN_OK || !diff_summary(&ctx)) goto done;
+    
+    if (ctx.patch->row_count) {
+        *patch = ctx.patch;
+        ctx.patch = NULL;
+    }
+    ok = true;
+    
+done:
+    ison_block_free(ctx.patch);
+    ison_free(ctx.a_hashes);
+    ison_free(ctx.b_hashes);
+    ison_free(ctx.a_cells);
+    ison_free(ctx.b_cells);
+    ison_free(ctx.include);
+    ison_free(ctx.cols);
+    return ok;
+}
+
+/* All of block's rows and its summary row */
+static ison_block_t *copy_block(const ison_block_t *block) {
+    ison_block_t *copy = ison_block_select(block, NULL);
+    if (copy && block->summary_row) {
+        ison_block_set_summary(copy, block->summary_row);
+        if (!copy->summary_row) {
+            ison_block_free(copy);
+            return NULL;
+        }
+    }
+    return copy;
+}
+
+static bool add_entry(ison_block_t *meta, const char *block, const char *op, const char *key) {
+    ison_row_t *row = ison_row_create();
+    if (!row) return false;
+    ison_value_t values[3] = { ison_string(block), ison_string(op), key ? ison_string(key) : ison_null() };
+    for (size_t f = 0; f < 3; f++) {
+        if (!ison_row_append(row, meta->fields[f].name, &values[f])) {
+            for (size_t k = f; k < 3; k++) ison_value_free(&values[k]);
+            ison_row_free(row);
+            return false;
+        }
+    }
+    return ison_block_take_row(meta, row);
+}
+
+ison_document_t *ison_document_diff(const ison_document_t *a, const ison_document_t *b) {
+    return ison_document_diff_with_options(a, b, NULL);
+}
+
+ison_document_t *ison_document_diff_with_options(const ison_document_t *a, const ison_document_t *b,
+                                                 const ison_diff_options_t *options) {
+    if (!a || !b) return NULL;
+    ison_diff_options_t opts = options ? *options : ison_default_diff_options();
+    
+    ison_document_t *patch = ison_document_create();
+    ison_block_t *meta = ison_block_create("meta", DIFF_BLOCK);
+    if (!patch || !meta) {
+        ison_document_free(patch);
+        ison_block_free(meta);
+        return NULL;
+    }
+    ison_block_add_field(meta, "block", "string");
+    ison_block_add_field(meta, "op", "string");
+    ison_block_add_field(meta, "key", "string");
+    ison_document_add_block(patch, meta);
+    bool ok = ison_document_get(patch, DIFF_BLOCK) == meta && meta->field_count == 3;
+    
+    for (size_t i = 0; ok && i < b->block_count; i++) {
+        const ison_block_t *nb = b->blocks[i];
+        if (strcmp(nb->name, DIFF_BLOCK) == 0) {
+            ok = false;
+            break;
+        }
+        const ison_block_t *na = ison_document_get(a, nb->name);
+        ison_block_t *part = NULL;
+        bool keyed = false;
+        const char *op;
+        if (!na || !same_schema(na, nb)) {
+            op = na ? "replace" : "add";
+            part = copy_block(nb);
+            ok = part != NULL;
+        } else {
+            op = "patch";
+            ok = diff_block(na, nb, opts.key, &part, &keyed);
+        }
+        if (ok && part) {
+            ison_document_add_block(patch, part);
+            if (ison_document_get(patch, nb->name) != part) {
+                ison_block_free(part);
+                ok = false;
+            } else {
+                ok = add_entry(meta, nb->name, op, keyed ? opts.key : NULL);
+            }
+        }
+    }
+    for (size_t i = 0; ok && i < a->block_count; i++) {
+        if (!ison_document_get(b, a->blocks[i]->name)) ok = add_entry(meta, a->blocks[i]->name, "remove", NULL);
+    }
+    
+    if (!ok) {
+        ison_document_free(patch);
+        return NULL;
+    }
+    return patch;
+}
+
+/* ==================== Apply ==================== */
+
+static const char *cell_string(const ison_row_t *row, const char *name) {
+    const ison_value_t *v = ison_row_get_ptr(row, name);
+    return v ? ison_value_string(v) : NULL;
+}
+
+/* Sets every column named in cols (space-separated) from cells */
+static ison_error_t apply_change(const ison_block_t *block, ison_row_t *row, const char *cols,
+                                 const ison_value_t **cells) {
+    while (cols && *cols) {
+        const char *end = strchr(cols, ' ');
+        size_t len = end ? (size_t)(end - cols) : strlen(cols);
+        size_t f = 0;
+        while (f < block->field_count &&
+               !(strncmp(block->fields[f].name, cols, len) == 0 && block->fields[f].name[len] == '\0')) {
+            f++;
+        }
+        if (f == block->field_count) return ISON_ERROR_INVALID;
+        ison_value_t value = cells[f] ? ison_value_copy(cells[f]) : ison_null();
+        ison_row_set(row, block->fields[f].name, &value);
+        cols = end ? end + 1 : NULL;
+    }
+    return ISON_OK;
+}
+
+static ison_row_t *added_row(const ison_block_t *block, const ison_value_t **cells) {
+    ison_row_t *row = ison_row_create();
+    for (size_t f = 0; row && f < block->field_count; f++) {
+        ison_value_t value = cells[f] ? ison_value_copy(cells[f]) : ison_null();
+        if (!ison_row_append(row, block->fields[f].name, &value)) {
+            ison_value_free(&value);
+            ison_row_free(row);
+            return NULL;
+        }
+    }
+    return row;
+}
+
+static ison_error_t apply_block(ison_block_t *block, const ison_block_t *patch, const char *key) {
+    size_t n = block->row_count, fields = block->field_count;
+    if (patch->field_count != fields + 2 || strcmp(patch->fields[0].name, DIFF_OP) != 0 ||
+        strcmp(patch->fields[1].name, DIFF_COLS) != 0) {
+        return ISON_ERROR_INVALID;
+    }
+    size_t key_pos = DIFF_NONE;
+    for (size_t f = 0; f < fields; f++) {
+        if (strcmp(patch->fields[f + 2].name, block->fields[f].name) != 0) return ISON_ERROR_INVALID;
+        if (key && strcmp(block->fields[f].name, key) == 0) key_pos = f;
+    }
+    if (key && key_pos == DIFF_NONE) return ISON_ERROR_INVALID;
+    
+    uint64_t *hashes = key ? ison_malloc((n ? n : 1) * sizeof(uint64_t)) : hash_rows(block, 0, fields);
+    ison_key_t *keys = key ? ison_malloc((n ? n : 1) * sizeof(ison_key_t)) : NULL;
+    bool *removed = ison_calloc(n ? n : 1, sizeof(bool));
+    const ison_value_t **cells = ison_malloc((fields ? fields * 2 : 1) * sizeof(ison_value_t *));
+    const ison_value_t **target = cells + fields;
+    row_table_t table;
+    memset(&table, 0, sizeof(table));
+    ison_error_t result = ISON_ERROR_MEMORY;
+    if (!hashes || (key && !keys) || !removed || !cells) goto done;
+    if (key && !row_keys(block, key_pos, keys, hashes)) {
+        result = ISON_ERROR_INVALID;
+        goto done;
+    }
+    if (!table_build(&table, hashes, n)) goto done;
+    
+    /* Removals and changes address the rows as they were */
+    result = ISON_OK;
+    for (size_t p = 0; p < patch->row_count && result == ISON_OK; p++) {
+        const ison_row_t *prow = patch->rows[p];
+        const char *op = cell_string(prow, DIFF_OP);
+        if (!op || strcmp(op, "add") == 0) continue;
+        gather(patch, 2, fields, prow, cells);
+        if (strcmp(op, "summary") == 0) {
+            ison_row_t *row = added_row(block, cells);
+            if (row) ison_block_take_summary(block, row);
+            else result = ISON_ERROR_MEMORY;
+            continue;
+        }
+        if (strcmp(op, "unsummary") == 0) {
+            ison_block_take_summary(block, NULL);
+            continue;
+        }
+    
+        size_t r;
+        if (key) {
+            ison_key_t k;
+            r = cells[key_pos] && ison_key_make(cells[key_pos], &k) ? find_key(&table, keys, &k) : DIFF_NONE;
+            if (r != DIFF_NONE && removed[r]) r = DIFF_NONE;
+        } else {
+            for (r = table_find(&table, cells_hash(cells, fields)); r != DIFF_NONE; r = table.next[r]) {
+                if (removed[r]) continue;
+                gather(block, 0, fields, block->rows[r], target);
+                if (same_cells(cells, target, fields)) break;
+            }
+        }
+        if (r == DIFF_NONE) {
+            result = ISON_ERROR_INVALID;
+        } else if (strcmp(op, "remove") == 0) {
+            removed[r] = true;
+        } else if (strcmp(op, "change") == 0 && key) {
+            ison_memory_account_row(&block->memory, block->rows[r], -1, false);
+            result = apply_change(block, block->rows[r], cell_string(prow, DIFF_COLS), cells);
+            ison_memory_account_row(&block->memory, block->rows[r], 1, false);
+        } else {
+            result = ISON_ERROR_INVALID;
+        }
+    }
+    
+    size_t kept = 0;
+    for (size_t r = 0; r < n; r++) {
+        if (!removed[r]) {
+            block->rows[kept++] = block->rows[r];
+            continue;
+        }
+        ison_memory_account_row(&block->memory, block->rows[r], -1, false);
+        ison_row_free(block->rows[r]);
+    }
+    block->row_count = kept;
+    
+    for (size_t p = 0; p < patch->row_count && result == ISON_OK; p++) {
+        const char *op = cell_string(patch->rows[p], DIFF_OP);
+        if (!op || strcmp(op, "add") != 0) continue;
+        gather(patch, 2, fields, patch->rows[p], cells);
+        ison_row_t *row = added_row(block, cells);
+        if (!row || !ison_block_take_row(block, row)) result = ISON_ERROR_MEMORY;
+    }
+    ison_block_rebuild_indexes(block);
+    
+done:
+    table_free(&table);
+    ison_free(hashes);
+    ison_free(keys);
+    ison_free(removed);
+    ison_free(cells);
+    return result;
+}
+
+ison_error_t ison_document_apply_patch(ison_document_t *doc, const ison_document_t *patch) {
+    if (!doc || !patch) return ISON_ERROR_INVALID;
+    const ison_block_t *meta = ison_document_get(patch, DIFF_BLOCK);
+    if (!meta) return ISON_ERROR_INVALID;
+    
+    for (size_t i = 0; i < meta->row_count; i++) {
+        const char *name = cell_string(meta->rows[i], "block");
+        const char *op = cell_string(meta->rows[i], "op");
+        if (!name || !op) return ISON_ERROR_INVALID;
+    
+        ison_error_t result = ISON_OK;
+        if (strcmp(op, "remove") == 0) {
+            if (!ison_document_remove_block(doc, name)) result = ISON_ERROR_INVALID;
+        } else {
+            const ison_block_t *part = ison_document_get(patch, name);
+            if (!part) return ISON_ERROR_INVALID;
+            if (strcmp(op, "patch") == 0) {
+                ison_block_t *block = ison_document_get(doc, name);
+                result = block ? apply_block(block, part, cell_string(meta->rows[i], "key"))
+                               : ISON_ERROR_INVALID;
+            } else if (strcmp(op, "add") == 0 || strcmp(op, "replace") == 0) {
+                ison_block_t *copy = copy_block(part);
+                if (!copy) return ISON_ERROR_MEMORY;
+                ison_document_add_block(doc, copy);
+            } else {
+                result = ISON_ERROR_INVALID;
+            }
+        }
+        if (result != ISON_OK) return result;
+    }
+    return ISON_OK;
+}
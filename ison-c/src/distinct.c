@@ -0,0 +1,356 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+/*
+ * Distinct values.
+ *
+ * Exact operations keep a flat open-addressing set of {hash, row} slots,
+ * one per distinct key seen so far: a key's values stay in the row they
+ * came from and are only compared on a full hash match, so memory grows
+ * with the number of distinct keys rather than with the rows scanned.
+ *
+ * Approximate counts use HyperLogLog: 2^p one-byte registers, each holding
+ * the longest run of leading zeros seen among the hashes routed to it.
+ */
+
+#define DISTINCT_EMPTY ((size_t)-1)
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 18
+#define HLL_BLOCK_PRECISION 14
+#define HLL_PARALLEL_MIN 65536
+
+typedef struct {
+    uint64_t hash;
+    size_t row;
+} set_slot_t;
+
+typedef struct {
+    set_slot_t *slots;
+    size_t capacity;
+    size_t count;
+} value_set_t;
+
+/* The columns a key is made of */
+typedef struct {
+    const ison_block_t *block;
+    size_t *positions;
+    size_t count;
+} key_cols_t;
+
+struct ison_hll {
+    unsigned precision;
+    uint8_t registers[];
+};
+
+/* Resolves cols, or every field when count is 0 */
+static ison_error_t key_cols_init(key_cols_t *key, const ison_block_t *block,
+                                  const char *const *cols, size_t count) {
+    key->block = block;
+    key->count = count ? count : block->field_count;
+    key->positions = ison_malloc((key->count ? key->count : 1) * sizeof(size_t));
+    if (!key->positions) return ISON_ERROR_MEMORY;
+    for (size_t c = 0; c < key->count; c++) {
+        key->positions[c] = count ? ison_field_position(block, cols[c]) : c;
+        if (key->positions[c] == ISON_NO_FIELD) {
+            ison_free(key->positions);
+            return ISON_ERROR_INVALID;
+        }
+    }
+    return ISON_OK;
+}
+
+static const ison_value_t *key_value(const key_cols_t *key, const ison_row_t *row, size_t c) {
+    size_t pos = key->positions[c];
+    return ison_column_value(row, pos, key->block->fields[pos].name);
+}
+
+static uint64_t key_hash(const key_cols_t *key, const ison_row_t *row) {
+    uint64_t h = 0;
+    for (size_t c = 0; c < key->count; c++) {
+        h = ison_hash_combine(h, ison_value_hash(key_value(key, row, c)));
+    }
+    return h;
+}
+
+static bool keys_equal(const key_cols_t *key, const ison_row_t *a, const ison_row_t *b) {
+    for (size_t c = 0; c < key->count; c++) {
+        if (!ison_value_equal(key_value(key, a, c), key_value(key, b, c))) return false;
+    }
+    return true;
+}
+
+static bool set_grow(value_set_t *set) {
+    size_t cap = set->capacity ? set->capacity * 2 : 64;
+    set_slot_t *slots = ison_malloc(cap * sizeof(set_slot_t));
+    if (!slots) return false;
+    for (size_t i = 0; i < cap; i++) slots[i].row = DISTINCT_EMPTY;
+    
+    for (size_t i = 0; i < set->capacity; i++) {
+        if (set->slots[i].row == DISTINCT_EMPTY) continue;
+        size_t slot = (size_t)set->slots[i].hash & (cap - 1);
+        while (slots[slot].row != DISTINCT_EMPTY) slot = (slot + 1) & (cap - 1);
+        slots[slot] = set->slots[i];
+    }
+    ison_free(set->slots);
+    set->slots = slots;
+    set->capacity = cap;
+    return true;
+}
+
+/*
+ * Looks row's key up among rows[slot.row] and records it as rows[at] when
+ * it is new. *fresh tells which happened; false when the set cannot grow.
+ */
+static bool set_insert(value_set_t *set, const key_cols_t *key, ison_row_t *const *rows,
+                       const ison_row_t *row, size_t at, bool *fresh) {
+    if ((set->count + 1) * 2 > set->capacity && !set_grow(set)) return false;
+    
+    uint64_t hash = key_hash(key, row);
+    size_t mask = set->capacity - 1;
+    size_t slot = (size_t)hash & mask;
+    while (set->slots[slot].row != DISTINCT_EMPTY) {
+        if (set->slots[slot].hash == hash && keys_equal(key, rows[set->slots[slot].row], row)) {
+            *fresh = false;
+            return true;
+        }
+        slot = (slot + 1) & mask;
+    }
+    set->slots[slot].hash = hash;
+    set->slots[slot].row = at;
+    set->count++;
+    *fresh = true;
+    return true;
+}
+
+ison_error_t ison_block_dedup(ison_block_t *block, const char *const *cols, size_t col_count,
+                              size_t *removed) {
+    if (removed) *removed = 0;
+    if (!block || (!cols && col_count)) return ISON_ERROR_INVALID;
+    
+    key_cols_t key;
+    ison_error_t result = key_cols_init(&key, block, cols, col_count);
+    if (result != ISON_OK) return result;
+    
+    /* Kept rows are compacted to the front, where the set refers to them */
+    value_set_t set;
+    memset(&set, 0, sizeof(set));
+    size_t n = block->row_count, kept = 0, r = 0;
+    for (; r < n; r++) {
+        ison_row_t *row = block->rows[r];
+        bool fresh;
+        if (!set_insert(&set, &key, block->rows, row, kept, &fresh)) {
+            result = ISON_ERROR_MEMORY;
+            break;
+        }
+        if (fresh) {
+            block->rows[kept++] = row;
+        } else {
+            ison_memory_account_row(&block->memory, row, -1, false);
+            ison_row_free(row);
+        }
+    }
+    size_t dropped = r - kept;
+    for (; r < n; r++) block->rows[kept++] = block->rows[r];
+    block->row_count = kept;
+    if (dropped) ison_block_rebuild_indexes(block);
+    if (removed) *removed = dropped;
+    
+    ison_free(set.slots);
+    ison_free(key.positions);
+    return result;
+}
+
+ison_block_t *ison_block_distinct(const ison_block_t *block, const char *col) {
+    if (!block || !col) return NULL;
+    
+    key_cols_t key;
+    if (key_cols_init(&key, block, &col, 1) != ISON_OK) return NULL;
+    ison_block_t *out = ison_block_create(block->kind, block->name);
+    if (out) ison_block_add_field(out, col, block->fields[key.positions[0]].type_hint);
+    
+    value_set_t set;
+    memset(&set, 0, sizeof(set));
+    bool ok = out && out->field_count == 1;
+    for (size_t r = 0; ok && r < block->row_count; r++) {
+        bool fresh;
+        ok = set_insert(&set, &key, block->rows, block->rows[r], r, &fresh);
+        if (!ok || !fresh) continue;
+    
+        const ison_value_t *v = key_value(&key, block->rows[r], 0);
+        ison_value_t value = v ? ison_value_copy(v) : ison_null();
+        ison_row_t *row = ison_row_create();
+        ok = row && ison_row_append(row, out->fields[0].name, &value);
+        if (!ok) {
+            ison_value_free(&value);
+            ison_row_free(row);
+        } else {
+            ok = ison_block_take_row(out, row);
+        }
+    }
+    
+    ison_free(set.slots);
+    ison_free(key.positions);
+    if (!ok) {
+        ison_block_free(out);
+        return NULL;
+    }
+    return out;
+}
+
+size_t ison_block_count_distinct(const ison_block_t *block, const char *col) {
+    if (!block || !col) return (size_t)-1;
+    
+    key_cols_t key;
+    if (key_cols_init(&key, block, &col, 1) != ISON_OK) return (size_t)-1;
+    value_set_t set;
+    memset(&set, 0, sizeof(set));
+    size_t count = 0;
+    for (size_t r = 0; r < block->row_count; r++) {
+        bool fresh;
+        if (!set_insert(&set, &key, block->rows, block->rows[r], r, &fresh)) {
+            count = (size_t)-1;
+            break;
+        }
+        count += fresh;
+    }
+    ison_free(set.slots);
+    ison_free(key.positions);
+    return count;
+}
+
+/* ==================== HyperLogLog ==================== */
+
+ison_hll_t *ison_hll_create(unsigned precision) {
+    if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION) return NULL;
+    ison_hll_t *hll = ison_calloc(1, sizeof(ison_hll_t) + ((size_t)1 << precision));
+    if (!hll) return NULL;
+    hll->precision = precision;
+    return hll;
+}
+
+static unsigned leading_zeros(uint64_t x) {
+#if defined(__GNUC__)
+    return (unsigned)__builtin_clzll(x);
+#else
+    unsigned n = 0;
+    while (!(x & 0x8000000000000000ULL)) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+void ison_hll_add_hash(ison_hll_t *hll, uint64_t hash) {
+    if (!hll) return;
+    size_t reg = (size_t)(hash >> (64 - hll->precision));
+    uint64_t rest = hash << hll->precision;
+    uint8_t rank = (uint8_t)(rest ? leading_zeros(rest) + 1 : 64 - hll->precision + 1);
+    if (rank > hll->registers[reg]) hll->registers[reg] = rank;
+}
+
+void ison_hll_add(ison_hll_t *hll, const ison_value_t *value) {
+    ison_hll_add_hash(hll, ison_value_hash(value));
+}
+
+bool ison_hll_merge(ison_hll_t *into, const ison_hll_t *from) {
+    if (!into || !from || into->precision != from->precision) return false;
+    size_t m = (size_t)1 << into->precision;
+    for (size_t i = 0; i < m; i++) {
+        if (from->registers[i] > into->registers[i]) into->registers[i] = from->registers[i];
+    }
+    return true;
+}
+
+/* ln(x) for x > 0 from the binary exponent and an atanh series on [1, 2) */
+static double natural_log(double x) {
+    int e = 0;
+    while (x >= 2.0) {
+        x /= 2.0;
+        e++;
+    }
+    while (x < 1.0) {
+        x *= 2.0;
+        e--;
+    }
+    double t = (x - 1.0) / (x + 1.0);
+    double t2 = t * t, term = t, sum = 0.0;
+    for (int k = 1; k < 40; k += 2) {
+        sum += term / k;
+        term *= t2;
+    }
+    return 2.0 * sum + e * 0.69314718055994530942;
+}
+
+double ison_hll_estimate(const ison_hll_t *hll) {
+    if (!hll) return 0.0;
+    size_t m = (size_t)1 << hll->precision;
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < m; i++) {
+        sum += 1.0 / (double)(1ULL << hll->registers[i]);
+        zeros += hll->registers[i] == 0;
+    }
+    
+    double dm = (double)m;
+    double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / (1.0 + 1.079 / dm);
+    double estimate = alpha * dm * dm / sum;
+    /* Small cardinalities: linear counting over the empty registers */
+    if (estimate <= 2.5 * dm && zeros) estimate = dm * natural_log(dm / (double)zeros);
+    return estimate;
+}
+
+void ison_hll_free(ison_hll_t *hll) {
+    ison_free(hll);
+}
+
+typedef struct {
+    const ison_block_t *block;
+    size_t pos;
+    ison_hll_t **sketches;
+    size_t chunk_count;
+} hll_ctx_t;
+
+static void sketch_chunk(size_t chunk, void *arg) {
+    hll_ctx_t *ctx = arg;
+    const ison_block_t *block = ctx->block;
+    size_t lo = block->row_count * chunk / ctx->chunk_count;
+    size_t hi = block->row_count * (chunk + 1) / ctx->chunk_count;
+    const char *name = block->fields[ctx->pos].name;
+    for (size_t r = lo; r < hi; r++) {
+        ison_hll_add(ctx->sketches[chunk], ison_column_value(block->rows[r], ctx->pos, name));
+    }
+}
+
+double ison_block_estimate_distinct(const ison_block_t *block, const char *col) {
+    if (!block || !col) return -1.0;
+    
+    hll_ctx_t ctx;
+    ctx.block = block;
+    ctx.pos = ison_field_position(block, col);
+    if (ctx.pos == ISON_NO_FIELD) return -1.0;
+    size_t threads = ison_thread_count();
+    ctx.chunk_count = block->row_count >= HLL_PARALLEL_MIN && threads > 1 ? threads : 1;
+    ctx.sketches = ison_calloc(ctx.chunk_count, sizeof(ison_hll_t *));
+    if (!ctx.sketches) return -1.0;
+    
+    double estimate = -1.0;
+    for (size_t c = 0; c < ctx.chunk_count; c++) {
+        ctx.sketches[c] = ison_hll_create(HLL_BLOCK_PRECISION);
+        if (!ctx.sketches[c]) goto done;
+    }
+    ison_parallel_for(ctx.chunk_count, sketch_chunk, &ctx);
+    for (size_t c = 1; c < ctx.chunk_count; c++) {
+        ison_hll_merge(ctx.sketches[0], ctx.sketches[c]);
+    }
+    estimate = ison_hll_estimate(ctx.sketches[0]);
+    
+done:
+    for (size_t c = 0; c < ctx.chunk_count; c++) {
+        ison_hll_free(ctx.sketches[c]);
+    }
+    ison_free(ctx.sketches);
+    return estimate;
+}
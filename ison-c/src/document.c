@@ -1,39 +1,80 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ison.h"
+#include "ison_internal.h"
 
-static char *strdup_safe(const char *str) {
-    if (!str) return NULL;
-    size_t len = strlen(str);
-    char *copy = malloc(len + 1);
-    if (copy) memcpy(copy, str, len + 1);
-    return copy;
-}
+/* Most blocks a reset keeps for reuse by the next parse */
+#define DOC_SPARE_BLOCKS_MAX 256
 
 ison_document_t *ison_document_create(void) {
-    ison_document_t *doc = calloc(1, sizeof(ison_document_t));
+    return ison_document_create_with_allocator(NULL);
+}
+
+ison_document_t *ison_document_create_with_allocator(const ison_allocator_t *allocator) {
+    ison_document_t *doc = ison_allocator_calloc(allocator, 1, sizeof(ison_document_t));
+    if (doc && allocator) doc->allocator = *allocator;
     return doc;
 }
 
+/* Slot holding `name`, or the empty slot where it would be inserted */
+static size_t index_slot(const ison_document_t *doc, const char *name) {
+    size_t mask = doc->index_capacity - 1;
+    size_t slot = (size_t)ison_hash_string(name) & mask;
+    while (doc->index[slot]) {
+        if (strcmp(doc->blocks[doc->index[slot] - 1]->name, name) == 0) break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static int index_resize(ison_document_t *doc, size_t capacity) {
+    size_t *new_index = ison_allocator_calloc(&doc->allocator, capacity, sizeof(size_t));
+    if (!new_index) return 0;
+    
+    ison_allocator_free(&doc->allocator, doc->index);
+    doc->index = new_index;
+    doc->index_capacity = capacity;
+    for (size_t i = 0; i < doc->block_count; i++) {
+        doc->index[index_slot(doc, doc->blocks[i]->name)] = i + 1;
+    }
+    return 1;
+}
+
+void ison_document_reindex(ison_document_t *doc) {
+    if (!doc || doc->index_capacity == 0) return;
+    index_resize(doc, doc->index_capacity);
+}
+
 void ison_document_add_block(ison_document_t *doc, ison_block_t *block) {
     if (!doc || !block || !block->name) return;
     
-    for (size_t i = 0; i < doc->block_count; i++) {
-        if (strcmp(doc->blocks[i]->name, block->name) == 0) {
-            ison_block_free(doc->blocks[i]);
-            doc->blocks[i] = block;
-            return;
-        }
+    ison_ref_index_free(doc->ref_index);
+    doc->ref_index = NULL;
+    
+    /* Keep the load factor at or below one half */
+    if ((doc->block_count + 1) * 2 > doc->index_capacity) {
+        size_t new_cap = doc->index_capacity == 0 ? 16 : doc->index_capacity * 2;
+        if (!index_resize(doc, new_cap)) return;
+    }
+    
+    size_t slot = index_slot(doc, block->name);
+    if (doc->index[slot]) {
+        size_t i = doc->index[slot] - 1;
+        ison_block_free(doc->blocks[i]);
+        doc->blocks[i] = block;
+        doc->order[i] = block->name;
+        return;
     }
     
     if (doc->block_count >= doc->block_capacity) {
         size_t new_cap = doc->block_capacity == 0 ? 8 : doc->block_capacity * 2;
         
-        ison_block_t **new_blocks = realloc(doc->blocks, new_cap * sizeof(ison_block_t *));
+        ison_block_t **new_blocks = ison_allocator_realloc(&doc->allocator, doc->blocks,
+                                                           new_cap * sizeof(ison_block_t *));
         if (!new_blocks) return;
         doc->blocks = new_blocks;
         
-        char **new_order = realloc(doc->order, new_cap * sizeof(char *));
+        char **new_order = ison_allocator_realloc(&doc->allocator, doc->order, new_cap * sizeof(char *));
         if (!new_order) return;
         doc->order = new_order;
         
@@ -41,20 +82,39 @@ void ison_document_add_block(ison_document_t *doc, ison_block_t *block) {
     }
     
     doc->blocks[doc->block_count] = block;
-    doc->order[doc->order_count] = strdup_safe(block->name);
+    doc->order[doc->order_count] = block->name;
     doc->order_count++;
     doc->block_count++;
+    doc->index[slot] = doc->block_count;
 }
 
-ison_block_t *ison_document_get(const ison_document_t *doc, const char *name) {
-    if (!doc || !name) return NULL;
+bool ison_document_remove_block(ison_document_t *doc, const char *name) {
+    size_t pos = ison_document_position(doc, name);
+    if (!pos) return false;
     
+    ison_ref_index_free(doc->ref_index);
+    doc->ref_index = NULL;
+    
+    ison_block_free(doc->blocks[pos - 1]);
+    memmove(doc->blocks + pos - 1, doc->blocks + pos, (doc->block_count - pos) * sizeof(ison_block_t *));
+    memmove(doc->order + pos - 1, doc->order + pos, (doc->order_count - pos) * sizeof(char *));
+    doc->block_count--;
+    doc->order_count--;
+    memset(doc->index, 0, doc->index_capacity * sizeof(size_t));
     for (size_t i = 0; i < doc->block_count; i++) {
-        if (strcmp(doc->blocks[i]->name, name) == 0) {
-            return doc->blocks[i];
-        }
+        doc->index[index_slot(doc, doc->blocks[i]->name)] = i + 1;
     }
-    return NULL;
+    return true;
+}
+
+size_t ison_document_position(const ison_document_t *doc, const char *name) {
+    if (!doc || !name || doc->index_capacity == 0) return 0;
+    return doc->index[index_slot(doc, name)];
+}
+
+ison_block_t *ison_document_get(const ison_document_t *doc, const char *name) {
+    size_t pos = ison_document_position(doc, name);
+    return pos ? doc->blocks[pos - 1] : NULL;
 }
 
 const char **ison_document_get_order(const ison_document_t *doc, size_t *count) {
@@ -72,12 +132,148 @@ void ison_document_free(ison_document_t *doc) {
     for (size_t i = 0; i < doc->block_count; i++) {
         ison_block_free(doc->blocks[i]);
     }
-    free(doc->blocks);
+    ison_allocator_free(&doc->allocator, doc->blocks);
     
-    for (size_t i = 0; i < doc->order_count; i++) {
-        free(doc->order[i]);
+    ison_allocator_free(&doc->allocator, doc->order);
+    ison_allocator_free(&doc->allocator, doc->index);
+    ison_ref_index_free(doc->ref_index);
+    
+    ison_document_pool_trim(doc);
+    if (doc->pool) {
+        for (size_t i = 0; i < doc->pool->spare_capacity; i++) {
+            ison_block_free(doc->pool->spares[i].block);
+        }
+        ison_allocator_free(&doc->allocator, doc->pool->spares);
+        ison_arena_free(&doc->pool->arena);
+        ison_allocator_free(&doc->allocator, doc->pool);
     }
-    free(doc->order);
     
-    free(doc);
+    ison_allocator_t allocator = doc->allocator;
+    ison_allocator_free(&allocator, doc);
+}
+
+ison_document_pool_t *ison_document_pool(ison_document_t *doc) {
+    if (!doc->pool) {
+        doc->pool = ison_allocator_calloc(&doc->allocator, 1, sizeof(ison_document_pool_t));
+        if (doc->pool) doc->pool->arena.allocator = &doc->allocator;
+    }
+    return doc->pool;
+}
+
+void ison_document_pool_trim(ison_document_t *doc) {
+    ison_document_pool_t *pool = doc->pool;
+    if (!pool) return;
+    
+    ison_allocator_free(&doc->allocator, pool->text);
+    ison_allocator_free(&doc->allocator, pool->lines);
+    ison_allocator_free(&doc->allocator, pool->token_text);
+    ison_allocator_free(&doc->allocator, pool->tokens);
+    ison_row_builder_abort(pool->builder);
+    pool->text = NULL;
+    pool->lines = NULL;
+    pool->token_text = NULL;
+    pool->tokens = NULL;
+    pool->builder = NULL;
+    pool->text_capacity = 0;
+    pool->line_capacity = 0;
+    pool->token_text_capacity = 0;
+    pool->token_capacity = 0;
+}
+
+/* Takes the spare block called name out of the pool, or NULL */
+static ison_block_t *take_spare(ison_document_pool_t *pool, const char *name) {
+    if (!pool || pool->spare_count == 0) return NULL;
+    uint64_t hash = ison_hash_string(name);
+    size_t mask = pool->spare_capacity - 1;
+    for (size_t slot = (size_t)hash & mask; pool->spares[slot].used; slot = (slot + 1) & mask) {
+        ison_spare_slot_t *spare = &pool->spares[slot];
+        if (spare->block && spare->hash == hash && strcmp(spare->block->name, name) == 0) {
+            ison_block_t *block = spare->block;
+            spare->block = NULL;
+            pool->spare_count--;
+            return block;
+        }
+    }
+    return NULL;
+}
+
+ison_block_t *ison_document_acquire_block(ison_document_t *doc, const char *kind, const char *name) {
+    ison_block_t *block = take_spare(doc->pool, name);
+    if (block) {
+        if (strcmp(block->kind, kind) != 0) {
+            size_t len = strlen(kind);
+            char *new_kind = ison_malloc(len + 1);
+            if (!new_kind) {
+                ison_block_free(block);
+                return NULL;
+            }
+            memcpy(new_kind, kind, len + 1);
+            ison_memory_account_string(&block->memory, &block->memory.blocks, block->kind, -1);
+            ison_memory_account_string(&block->memory, &block->memory.blocks, new_kind, 1);
+            ison_free(block->kind);
+            block->kind = new_kind;
+        }
+        return block;
+    }
+    return ison_block_create(kind, name);
+}
+
+/*
+ * Spares left over from the previous reset went unused by the parse since
+ * and are freed; the blocks of doc, up to DOC_SPARE_BLOCKS_MAX, replace them.
+ * Resetting an empty document leaves the spares as they are.
+ */
+static void keep_spares(ison_document_t *doc, ison_document_pool_t *pool) {
+    if (doc->block_count == 0) return;
+    for (size_t i = 0; pool && i < pool->spare_capacity; i++) {
+        ison_block_free(pool->spares[i].block);
+        pool->spares[i].block = NULL;
+        pool->spares[i].used = false;
+    }
+    if (pool) pool->spare_count = 0;
+    
+    size_t keep = doc->block_count < DOC_SPARE_BLOCKS_MAX ? doc->block_count : DOC_SPARE_BLOCKS_MAX;
+    size_t capacity = 8;
+    while (capacity < keep * 2) capacity *= 2;
+    if (pool && capacity > pool->spare_capacity) {
+        ison_spare_slot_t *spares = ison_allocator_calloc(&doc->allocator, capacity, sizeof(ison_spare_slot_t));
+        if (spares) {
+            ison_allocator_free(&doc->allocator, pool->spares);
+            pool->spares = spares;
+            pool->spare_capacity = capacity;
+        }
+    }
+    if (!pool || keep * 2 > pool->spare_capacity) keep = 0;
+    
+    size_t mask = keep ? pool->spare_capacity - 1 : 0;
+    for (size_t i = 0; i < doc->block_count; i++) {
+        ison_block_t *block = doc->blocks[i];
+        if (i >= keep) {
+            ison_block_free(block);
+            continue;
+        }
+        ison_block_recycle(block);
+        uint64_t hash = ison_hash_string(block->name);
+        size_t slot = (size_t)hash & mask;
+        while (pool->spares[slot].used) slot = (slot + 1) & mask;
+        pool->spares[slot].block = block;
+        pool->spares[slot].hash = hash;
+        pool->spares[slot].used = true;
+        pool->spare_count++;
+    }
+}
+
+void ison_document_reset(ison_document_t *doc) {
+    if (!doc) return;
+    
+    ison_ref_index_free(doc->ref_index);
+    doc->ref_index = NULL;
+    
+    ison_document_pool_t *pool = ison_document_pool(doc);
+    keep_spares(doc, pool);
+    
+    doc->block_count = 0;
+    doc->order_count = 0;
+    if (doc->index) memset(doc->index, 0, doc->index_capacity * sizeof(size_t));
+    if (pool) ison_arena_reset(&pool->arena);
 }
@@ -2,21 +2,14 @@
 #include <string.h>
 #include <stdio.h>
 #include "ison.h"
-
-static char *strdup_safe(const char *str) {
-    if (!str) return NULL;
-    size_t len = strlen(str);
-    char *copy = malloc(len + 1);
-    if (copy) memcpy(copy, str, len + 1);
-    return copy;
-}
+#include "ison_internal.h"
 
 static void append_string(char **buf, size_t *len, size_t *cap, const char *str) {
     if (!str) return;
     size_t str_len = strlen(str);
     if (*len + str_len + 1 > *cap) {
         *cap = (*cap + str_len + 1) * 2;
-        *buf = realloc(*buf, *cap);
+        *buf = ison_realloc(*buf, *cap);
     }
     memcpy(*buf + *len, str, str_len);
     *len += str_len;
@@ -26,19 +19,84 @@ static void append_string(char **buf, size_t *len, size_t *cap, const char *str)
 static void append_char(char **buf, size_t *len, size_t *cap, char ch) {
     if (*len + 2 > *cap) {
         *cap = *cap * 2;
-        *buf = realloc(*buf, *cap);
+        *buf = ison_realloc(*buf, *cap);
     }
     (*buf)[*len] = ch;
     (*len)++;
     (*buf)[*len] = '\0';
 }
 
+/* Numbers and plain strings are written in place; the rest go through ison_value_to_ison */
+static void append_value(char **buf, size_t *len, size_t *cap, const ison_value_t *val) {
+    char num[64];
+    const char *str;
+    switch (val ? val->type : ISON_TYPE_NULL) {
+        case ISON_TYPE_INT:
+            snprintf(num, sizeof(num), "%ld", (long)val->data.int_val);
+            append_string(buf, len, cap, num);
+            return;
+        case ISON_TYPE_FLOAT:
+            ison_format_float(num, sizeof(num), val->data.float_val);
+            append_string(buf, len, cap, num);
+            return;
+        case ISON_TYPE_STRING:
+            str = ison_value_string(val);
+            if (str && !ison_string_needs_quotes(str)) {
+                append_string(buf, len, cap, str);
+                return;
+            }
+            break;
+        case ISON_TYPE_NULL:
+            append_char(buf, len, cap, '~');
+            return;
+        default:
+            break;
+    }
+    char *text = ison_value_to_ison(val);
+    append_string(buf, len, cap, text);
+    ison_free(text);
+}
+
+static void append_row(char **buf, size_t *len, size_t *cap, const ison_block_t *block,
+                       const ison_row_t *row, const char *delim) {
+    for (size_t j = 0; j < block->field_count; j++) {
+        if (j > 0) append_string(buf, len, cap, delim);
+        append_value(buf, len, cap, ison_row_get_ptr(row, block->fields[j].name));
+    }
+    append_char(buf, len, cap, '\n');
+}
+
+/* Header, field line and the rows at positions selected[0..count), or all rows */
+static void append_block(char **buf, size_t *len, size_t *cap, const ison_block_t *block,
+                         const size_t *selected, size_t count, const char *delim) {
+    char header[256];
+    snprintf(header, sizeof(header), "%s.%s\n", block->kind, block->name);
+    append_string(buf, len, cap, header);
+    
+    for (size_t j = 0; j < block->field_count; j++) {
+        if (j > 0) append_string(buf, len, cap, delim);
+        if (block->fields[j].type_hint && *block->fields[j].type_hint) {
+            char field[256];
+            snprintf(field, sizeof(field), "%s:%s", block->fields[j].name, block->fields[j].type_hint);
+            append_string(buf, len, cap, field);
+        } else {
+            append_string(buf, len, cap, block->fields[j].name);
+        }
+    }
+    append_char(buf, len, cap, '\n');
+    
+    for (size_t k = 0; k < count; k++) {
+        size_t r = selected ? selected[k] : k;
+        if (r < block->row_count) append_row(buf, len, cap, block, block->rows[r], delim);
+    }
+}
+
 char *ison_dumps_with_options(const ison_document_t *doc, const ison_dumps_options_t *opts) {
-    if (!doc) return strdup_safe("");
+    if (!doc) return ison_strdup("");
     
     const char *delim = opts && opts->delimiter ? opts->delimiter : " ";
     size_t len = 0, cap = 1024;
-    char *result = malloc(cap);
+    char *result = ison_malloc(cap);
     if (!result) return NULL;
     *result = '\0';
     
@@ -48,67 +106,66 @@ char *ison_dumps_with_options(const ison_document_t *doc, const ison_dumps_optio
         ison_block_t *block = ison_document_get(doc, doc->order[i]);
         if (!block) continue;
         
-        char header[256];
-        snprintf(header, sizeof(header), "%s.%s\n", block->kind, block->name);
-        append_string(&result, &len, &cap, header);
-        
-        for (size_t j = 0; j < block->field_count; j++) {
-            if (j > 0) append_string(&result, &len, &cap, delim);
-            if (block->fields[j].type_hint && *block->fields[j].type_hint) {
-                char field[256];
-                snprintf(field, sizeof(field), "%s:%s", block->fields[j].name, block->fields[j].type_hint);
-                append_string(&result, &len, &cap, field);
-            } else {
-                append_string(&result, &len, &cap, block->fields[j].name);
-            }
-        }
-        append_char(&result, &len, &cap, '\n');
-        
-        for (size_t r = 0; r < block->row_count; r++) {
-            ison_row_t *row = block->rows[r];
-            for (size_t j = 0; j < block->field_count; j++) {
-                if (j > 0) append_string(&result, &len, &cap, delim);
-                ison_value_t *val = ison_row_get_ptr(row, block->fields[j].name);
-                if (val) {
-                    char *str = ison_value_to_ison(val);
-                    append_string(&result, &len, &cap, str);
-                    free(str);
-                } else {
-                    append_char(&result, &len, &cap, '~');
-                }
-            }
-            append_char(&result, &len, &cap, '\n');
-        }
-        
+        append_block(&result, &len, &cap, block, NULL, block->row_count, delim);
         if (block->summary_row) {
             append_string(&result, &len, &cap, "---\n");
-            for (size_t j = 0; j < block->field_count; j++) {
-                if (j > 0) append_string(&result, &len, &cap, delim);
-                ison_value_t *val = ison_row_get_ptr(block->summary_row, block->fields[j].name);
-                if (val) {
-                    char *str = ison_value_to_ison(val);
-                    append_string(&result, &len, &cap, str);
-                    free(str);
-                } else {
-                    append_char(&result, &len, &cap, '~');
-                }
-            }
-            append_char(&result, &len, &cap, '\n');
+            append_row(&result, &len, &cap, block, block->summary_row, delim);
         }
     }
     
     return result;
 }
 
+char *ison_dumps_selection(const ison_block_t *block, const ison_selection_t *selection,
+                           const ison_dumps_options_t *opts) {
+    if (!block) return ison_strdup("");
+    
+    const char *delim = opts && opts->delimiter ? opts->delimiter : " ";
+    size_t len = 0, cap = 1024;
+    char *result = ison_malloc(cap);
+    if (!result) return NULL;
+    *result = '\0';
+    
+    if (selection) {
+        append_block(&result, &len, &cap, block, selection->rows, selection->count, delim);
+    } else {
+        append_block(&result, &len, &cap, block, NULL, block->row_count, delim);
+    }
+    return result;
+}
+
 char *ison_dumps(const ison_document_t *doc) {
     return ison_dumps_with_options(doc, NULL);
 }
 
+void ison_isonl_append_row(char **buf, size_t *len, size_t *cap, const ison_block_t *block,
+                           const ison_row_t *row) {
+    append_string(buf, len, cap, block->kind);
+    append_char(buf, len, cap, '.');
+    append_string(buf, len, cap, block->name);
+    append_char(buf, len, cap, '|');
+    
+    for (size_t j = 0; j < block->field_count; j++) {
+        if (j > 0) append_char(buf, len, cap, ' ');
+        append_string(buf, len, cap, block->fields[j].name);
+        if (block->fields[j].type_hint && *block->fields[j].type_hint) {
+            append_char(buf, len, cap, ':');
+            append_string(buf, len, cap, block->fields[j].type_hint);
+        }
+    }
+    append_char(buf, len, cap, '|');
+    
+    for (size_t j = 0; j < block->field_count; j++) {
+        if (j > 0) append_char(buf, len, cap, ' ');
+        append_value(buf, len, cap, ison_row_get_ptr(row, block->fields[j].name));
+    }
+}
+
 char *ison_dumps_isonl(const ison_document_t *doc) {
-    if (!doc) return strdup_safe("");
+    if (!doc) return ison_strdup("");
     
     size_t len = 0, cap = 1024;
-    char *result = malloc(cap);
+    char *result = ison_malloc(cap);
     if (!result) return NULL;
     *result = '\0';
     
@@ -116,54 +173,9 @@ char *ison_dumps_isonl(const ison_document_t *doc) {
         ison_block_t *block = ison_document_get(doc, doc->order[i]);
         if (!block) continue;
         
-        char header[256];
-        snprintf(header, sizeof(header), "%s.%s|", block->kind, block->name);
-        
-        for (size_t j = 0; j < block->field_count; j++) {
-            if (j > 0) {
-                append_char(&result, &len, &cap, ' ');
-            }
-            if (block->fields[j].type_hint && *block->fields[j].type_hint) {
-                char field[256];
-                snprintf(field, sizeof(field), "%s:%s", block->fields[j].name, block->fields[j].type_hint);
-                append_string(&result, &len, &cap, field);
-            } else {
-                append_string(&result, &len, &cap, block->fields[j].name);
-            }
-        }
-        append_char(&result, &len, &cap, '|');
-        
-        char *field_header_end = result + len;
-        (void)field_header_end;
-        
         for (size_t r = 0; r < block->row_count; r++) {
-            if (r > 0 || i > 0) append_char(&result, &len, &cap, '\n');
-            append_string(&result, &len, &cap, header);
-            
-            for (size_t j = 0; j < block->field_count; j++) {
-                if (j > 0) append_char(&result, &len, &cap, ' ');
-                if (block->fields[j].type_hint && *block->fields[j].type_hint) {
-                    char field[256];
-                    snprintf(field, sizeof(field), "%s:%s", block->fields[j].name, block->fields[j].type_hint);
-                    append_string(&result, &len, &cap, field);
-                } else {
-                    append_string(&result, &len, &cap, block->fields[j].name);
-                }
-            }
-            append_char(&result, &len, &cap, '|');
-            
-            ison_row_t *row = block->rows[r];
-            for (size_t j = 0; j < block->field_count; j++) {
-                if (j > 0) append_char(&result, &len, &cap, ' ');
-                ison_value_t *val = ison_row_get_ptr(row, block->fields[j].name);
-                if (val) {
-                    char *str = ison_value_to_ison(val);
-                    append_string(&result, &len, &cap, str);
-                    free(str);
-                } else {
-                    append_char(&result, &len, &cap, '~');
-                }
-            }
+            if (len > 0) append_char(&result, &len, &cap, '\n');
+            ison_isonl_append_row(&result, &len, &cap, block, block->rows[r]);
         }
     }
     
@@ -183,3 +195,18 @@ ison_fromdict_options_t ison_default_fromdict_options(void) {
     opts.smart_order = 0;
     return opts;
 }
+
+ison_json_stream_options_t ison_default_json_stream_options(void) {
+    ison_json_stream_options_t opts = {0};
+    opts.kind = "table";
+    opts.name = "data";
+    opts.header_sample = 16;
+    opts.isonl = 0;
+    return opts;
+}
+
+ison_diff_options_t ison_default_diff_options(void) {
+    ison_diff_options_t opts = {0};
+    opts.key = "id";
+    return opts;
+}
@@ -16,7 +16,7 @@ char *ison_read_file(const char *path, size_t *out_len) {
         return NULL;
     }
     
-    char *buf = malloc(size + 1);
+    char *buf = ison_malloc(size + 1);
     if (!buf) {
         fclose(f);
         return NULL;
@@ -56,7 +56,7 @@ ison_document_t *ison_load(const char *path, ison_error_t *error) {
     }
     
     ison_document_t *doc = ison_parse(content, error);
-    free(content);
+    ison_free(content);
     return doc;
 }
 
@@ -65,7 +65,7 @@ ison_error_t ison_dump(const ison_document_t *doc, const char *path) {
     if (!content) return ISON_ERROR_MEMORY;
     
     ison_error_t err = ison_write_file(path, content);
-    free(content);
+    ison_free(content);
     return err;
 }
 
@@ -79,7 +79,7 @@ ison_document_t *ison_load_isonl(const char *path, ison_error_t *error) {
     }
     
     ison_document_t *doc = ison_parse_isonl(content, error);
-    free(content);
+    ison_free(content);
     return doc;
 }
 
@@ -88,6 +88,6 @@ ison_error_t ison_dump_isonl(const ison_document_t *doc, const char *path) {
     if (!content) return ISON_ERROR_MEMORY;
     
     ison_error_t err = ison_write_file(path, content);
-    free(content);
+    ison_free(content);
     return err;
 }
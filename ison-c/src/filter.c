@@ -0,0 +1,289 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+/*
+ * Predicate evaluation over one column.
+ *
+ * Rows are processed in batches: the column's values are first gathered
+ * (one walk of each row's entry list, starting from the field's position),
+ * then the predicate runs over the batch with its operator hoisted out of
+ * the loop and matches appended branch-free to the selection vector. An
+ * all-int batch compared with an int operand runs over a plain int64 array.
+ */
+
+#define FILTER_BATCH 1024
+
+static bool is_numeric(const ison_value_t *v) {
+    return v->type == ISON_TYPE_INT || v->type == ISON_TYPE_FLOAT;
+}
+
+/* Missing reference components compare as empty */
+static int compare_str(const char *a, const char *b) {
+    return strcmp(a ? a : "", b ? b : "");
+}
+
+/*
+ * Orders a against b into *order (<0, 0, >0). False when the two cannot be
+ * compared: either is null, or the types differ (ints and floats compare
+ * numerically).
+ */
+static bool compare_values(const ison_value_t *a, const ison_value_t *b, int *order) {
+    if (a->type == ISON_TYPE_NULL || b->type == ISON_TYPE_NULL) return false;
+    
+    if (a->type == ISON_TYPE_INT && b->type == ISON_TYPE_INT) {
+        *order = (a->data.int_val > b->data.int_val) - (a->data.int_val < b->data.int_val);
+        return true;
+    }
+    if (is_numeric(a) && is_numeric(b)) {
+        double x = a->type == ISON_TYPE_INT ? (double)a->data.int_val : a->data.float_val;
+        double y = b->type == ISON_TYPE_INT ? (double)b->data.int_val : b->data.float_val;
+        *order = (x > y) - (x < y);
+        return true;
+    }
+    if (a->type != b->type) return false;
+    
+    switch (a->type) {
+        case ISON_TYPE_BOOL:
+            *order = (int)a->data.bool_val - (int)b->data.bool_val;
+            return true;
+        case ISON_TYPE_STRING:
+            *order = strcmp(ison_value_string(a), ison_value_string(b));
+            return true;
+        case ISON_TYPE_REFERENCE: {
+            const ison_reference_t *x = &a->data.ref_val;
+            const ison_reference_t *y = &b->data.ref_val;
+            int c = compare_str(x->id, y->id);
+            if (c == 0) c = compare_str(x->ns, y->ns);
+            if (c == 0) c = compare_str(x->relationship, y->relationship);
+            *order = c;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static bool matches(const ison_predicate_t *pred, const ison_value_t *v) {
+    bool is_null = !v || v->type == ISON_TYPE_NULL;
+    int order;
+    
+    switch (pred->op) {
+        case ISON_CMP_IS_NULL:
+            return is_null;
+        case ISON_CMP_NOT_NULL:
+            return !is_null;
+        case ISON_CMP_PREFIX: {
+            const char *str = is_null ? NULL : ison_value_string(v);
+            const char *prefix = ison_value_string(&pred->value);
+            return str && prefix && strncmp(str, prefix, strlen(prefix)) == 0;
+        }
+        case ISON_CMP_IN:
+            if (is_null) return false;
+            for (size_t i = 0; i < pred->value_count; i++) {
+                if (compare_values(v, &pred->values[i], &order) && order == 0) return true;
+            }
+            return false;
+        default:
+            break;
+    }
+    
+    if (is_null) return false;
+    if (!compare_values(v, &pred->value, &order)) return pred->op == ISON_CMP_NE;
+    switch (pred->op) {
+        case ISON_CMP_EQ: return order == 0;
+        case ISON_CMP_NE: return order != 0;
+        case ISON_CMP_LT: return order < 0;
+        case ISON_CMP_LE: return order <= 0;
+        case ISON_CMP_GT: return order > 0;
+        case ISON_CMP_GE: return order >= 0;
+        default: return false;
+    }
+}
+
+/* Int column against an int operand: one comparison per element, no branches */
+static size_t select_int(ison_cmp_t op, const int64_t *keys, int64_t k, const size_t *rows,
+                         size_t n, size_t *out) {
+    size_t count = 0;
+    switch (op) {
+        case ISON_CMP_EQ:
+            for (size_t i = 0; i < n; i++) { out[count] = rows[i]; count += keys[i] == k; }
+            break;
+        case ISON_CMP_NE:
+            for (size_t i = 0; i < n; i++) { out[count] = rows[i]; count += keys[i] != k; }
+            break;
+        case ISON_CMP_LT:
+            for (size_t i = 0; i < n; i++) { out[count] = rows[i]; count += keys[i] < k; }
+            break;
+        case ISON_CMP_LE:
+            for (size_t i = 0; i < n; i++) { out[count] = rows[i]; count += keys[i] <= k; }
+            break;
+        case ISON_CMP_GT:
+            for (size_t i = 0; i < n; i++) { out[count] = rows[i]; count += keys[i] > k; }
+            break;
+        case ISON_CMP_GE:
+            for (size_t i = 0; i < n; i++) { out[count] = rows[i]; count += keys[i] >= k; }
+            break;
+        default:
+            break;
+    }
+    return count;
+}
+
+static bool int_comparison(const ison_predicate_t *pred) {
+    return pred->value.type == ISON_TYPE_INT && pred->op >= ISON_CMP_EQ && pred->op <= ISON_CMP_GE;
+}
+
+typedef struct {
+    const ison_value_t *values[FILTER_BATCH];
+    int64_t keys[FILTER_BATCH];
+    size_t rows[FILTER_BATCH];
+} filter_batch_t;
+
+/* Appends the matching positions among rows[0..n) to out; returns how many */
+static size_t filter_rows(const ison_block_t *block, const ison_predicate_t *pred, size_t pos,
+                          const size_t *rows, size_t n, size_t *out) {
+    filter_batch_t *batch = ison_malloc(sizeof(filter_batch_t));
+    if (!batch) return (size_t)-1;
+    
+    size_t count = 0;
+    bool int_op = int_comparison(pred);
+    for (size_t start = 0; start < n; start += FILTER_BATCH) {
+        size_t len = n - start < FILTER_BATCH ? n - start : FILTER_BATCH;
+        bool all_int = int_op;
+        for (size_t i = 0; i < len; i++) {
+            size_t r = rows ? rows[start + i] : start + i;
+            const ison_value_t *v = NULL;
+            if (r < block->row_count) v = ison_column_value(block->rows[r], pos, pred->field);
+            batch->rows[i] = r;
+            batch->values[i] = v;
+            if (all_int && v && v->type == ISON_TYPE_INT) {
+                batch->keys[i] = v->data.int_val;
+            } else {
+                all_int = false;
+            }
+        }
+    
+        if (all_int) {
+            count += select_int(pred->op, batch->keys, pred->value.data.int_val, batch->rows, len,
+                                out + count);
+            continue;
+        }
+        for (size_t i = 0; i < len; i++) {
+            out[count] = batch->rows[i];
+            count += matches(pred, batch->values[i]);
+        }
+    }
+    ison_free(batch);
+    return count;
+}
+
+ison_error_t ison_block_filter(const ison_block_t *block, const ison_predicate_t *predicate,
+                               ison_selection_t *out) {
+    if (!out) return ISON_ERROR_INVALID;
+    memset(out, 0, sizeof(*out));
+    if (!block || !predicate || !predicate->field) return ISON_ERROR_INVALID;
+    if (block->row_count == 0) return ISON_OK;
+    
+    out->rows = ison_malloc(block->row_count * sizeof(size_t));
+    if (!out->rows) return ISON_ERROR_MEMORY;
+    out->capacity = block->row_count;
+    
+    size_t count = filter_rows(block, predicate, ison_field_position(block, predicate->field),
+                               NULL, block->row_count, out->rows);
+    if (count == (size_t)-1) {
+        ison_selection_free(out);
+        return ISON_ERROR_MEMORY;
+    }
+    out->count = count;
+    return ISON_OK;
+}
+
+ison_error_t ison_block_filter_refine(const ison_block_t *block, const ison_predicate_t *predicate,
+                                      ison_selection_t *selection) {
+    if (!block || !predicate || !predicate->field || !selection) return ISON_ERROR_INVALID;
+    if (selection->count == 0) return ISON_OK;
+    
+    /* Matches are written behind the read position, so the vector filters in place */
+    size_t count = filter_rows(block, predicate, ison_field_position(block, predicate->field),
+                               selection->rows, selection->count, selection->rows);
+    if (count == (size_t)-1) return ISON_ERROR_MEMORY;
+    selection->count = count;
+    return ISON_OK;
+}
+
+/* Sorted merge of two ascending vectors: rows in both, or with union_rows in either */
+static ison_error_t merge(const ison_selection_t *a, const ison_selection_t *b, bool union_rows,
+                          ison_selection_t *out) {
+    if (!a || !b || !out) return ISON_ERROR_INVALID;
+    
+    size_t cap = union_rows ? a->count + b->count : (a->count < b->count ? a->count : b->count);
+    size_t *rows = ison_malloc((cap ? cap : 1) * sizeof(size_t));
+    if (!rows) return ISON_ERROR_MEMORY;
+    
+    size_t i = 0, j = 0, n = 0;
+    while (i < a->count && j < b->count) {
+        if (a->rows[i] == b->rows[j]) {
+            rows[n++] = a->rows[i];
+            i++;
+            j++;
+        } else if (a->rows[i] < b->rows[j]) {
+            if (union_rows) rows[n++] = a->rows[i];
+            i++;
+        } else {
+            if (union_rows) rows[n++] = b->rows[j];
+            j++;
+        }
+    }
+    if (union_rows) {
+        while (i < a->count) rows[n++] = a->rows[i++];
+        while (j < b->count) rows[n++] = b->rows[j++];
+    }
+    
+    /* out may alias a or b */
+    if (out == a || out == b) ison_free(out->rows);
+    out->rows = rows;
+    out->count = n;
+    out->capacity = cap ? cap : 1;
+    return ISON_OK;
+}
+
+ison_error_t ison_selection_and(const ison_selection_t *a, const ison_selection_t *b,
+                                ison_selection_t *out) {
+    return merge(a, b, false, out);
+}
+
+ison_error_t ison_selection_or(const ison_selection_t *a, const ison_selection_t *b,
+                               ison_selection_t *out) {
+    return merge(a, b, true, out);
+}
+
+void ison_selection_free(ison_selection_t *selection) {
+    if (!selection) return;
+    ison_free(selection->rows);
+    selection->rows = NULL;
+    selection->count = 0;
+    selection->capacity = 0;
+}
+
+ison_block_t *ison_block_select(const ison_block_t *block, const ison_selection_t *selection) {
+    if (!block) return NULL;
+    
+    ison_block_t *copy = ison_block_create(block->kind, block->name);
+    if (!copy) return NULL;
+    for (size_t f = 0; f < block->field_count; f++) {
+        ison_block_add_field(copy, block->fields[f].name, block->fields[f].type_hint);
+    }
+    
+    size_t n = selection ? selection->count : block->row_count;
+    if (!ison_block_reserve_rows(copy, n)) {
+        ison_block_free(copy);
+        return NULL;
+    }
+    for (size_t k = 0; k < n; k++) {
+        size_t r = selection ? selection->rows[k] : k;
+        if (r < block->row_count) ison_block_add_row(copy, block->rows[r]);
+    }
+    return copy;
+}
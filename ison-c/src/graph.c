@@ -0,0 +1,397 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+typedef struct {
+    uint32_t src;
+    uint32_t dst;
+    uint32_t rel;
+} raw_edge_t;
+
+struct ison_graph {
+    ison_document_t *doc;
+    size_t *block_offsets;    /* first node of each block, plus the total */
+    size_t block_count;
+    size_t node_count;
+    size_t *offsets;          /* node -> first edge, node_count + 1 entries */
+    uint32_t *targets;
+    uint32_t *rels;
+    size_t edge_count;
+    char **rel_names;
+    size_t rel_count;
+};
+
+static int intern_rel(ison_graph_t *g, const char *name) {
+    for (size_t i = 0; i < g->rel_count; i++) {
+        if (strcmp(g->rel_names[i], name) == 0) return (int)i;
+    }
+    char **new_names = ison_realloc(g->rel_names, (g->rel_count + 1) * sizeof(char *));
+    if (!new_names) return -1;
+    g->rel_names = new_names;
+    
+    size_t len = strlen(name);
+    char *copy = ison_malloc(len + 1);
+    if (!copy) return -1;
+    memcpy(copy, name, len + 1);
+    g->rel_names[g->rel_count] = copy;
+    return (int)g->rel_count++;
+}
+
+static size_t block_position(const ison_graph_t *g, const ison_block_t *block) {
+    size_t pos = ison_document_position(g->doc, block->name);
+    if (pos && g->doc->blocks[pos - 1] == block) return pos - 1;
+    return g->block_count;
+}
+
+/* Per field of block, position + 1 of the block its type hint names, or 0 */
+static size_t *hinted_targets(const ison_graph_t *g, const ison_block_t *block) {
+    size_t *targets = ison_calloc(block->field_count ? block->field_count : 1, sizeof(size_t));
+    if (!targets) return NULL;
+    for (size_t f = 0; f < block->field_count; f++) {
+        const char *hint = block->fields[f].type_hint;
+        if (hint && *hint) targets[f] = ison_namespace_position(g->doc, hint);
+    }
+    return targets;
+}
+
+/*
+ * Resolves a relationship cell: in the block its column's type hint names
+ * (owner:users), else in the first block in document order holding the id.
+ */
+static bool resolve_edge(const ison_graph_t *g, const ison_block_t *block, const size_t *targets,
+                         const ison_row_entry_t *entry, size_t field, ison_block_t **target,
+                         size_t *target_row) {
+    const ison_reference_t *ref = &entry->value.data.ref_val;
+    if (field >= block->field_count || strcmp(block->fields[field].name, entry->key) != 0) {
+        field = ison_field_position(block, entry->key);
+    }
+    if (field != ISON_NO_FIELD && targets[field]) {
+        ison_reference_t typed = { ref->id, g->doc->blocks[targets[field] - 1]->name, NULL };
+        return ison_ref_index_lookup(g->doc->ref_index, &typed, target, target_row);
+    }
+    return ison_ref_index_lookup(g->doc->ref_index, ref, target, target_row);
+}
+
+static raw_edge_t *collect_edges(ison_graph_t *g, size_t *count) {
+    size_t cap = 64;
+    raw_edge_t *edges = ison_malloc(cap * sizeof(raw_edge_t));
+    *count = 0;
+    if (!edges) return NULL;
+    
+    int last_rel = -1;
+    
+    for (size_t b = 0; b < g->block_count; b++) {
+        ison_block_t *block = g->doc->blocks[b];
+        size_t *targets = hinted_targets(g, block);
+        if (!targets) {
+            ison_free(edges);
+            return NULL;
+        }
+        for (size_t r = 0; r < block->row_count; r++) {
+            size_t field = 0;
+            for (ison_row_entry_t *e = block->rows[r]->head; e; e = e->next, field++) {
+                if (e->value.type != ISON_TYPE_REFERENCE) continue;
+                const ison_reference_t *ref = &e->value.data.ref_val;
+                if (!ison_reference_is_relationship(ref)) continue;
+                
+                ison_block_t *target;
+                size_t target_row;
+                if (!resolve_edge(g, block, targets, e, field, &target, &target_row)) continue;
+                size_t tb = block_position(g, target);
+                if (tb >= g->block_count) continue;
+                
+                if (last_rel < 0 || strcmp(g->rel_names[last_rel], ref->relationship) != 0) {
+                    last_rel = intern_rel(g, ref->relationship);
+                    if (last_rel < 0) continue;
+                }
+                
+                if (*count >= cap) {
+                    cap *= 2;
+                    raw_edge_t *grown = ison_realloc(edges, cap * sizeof(raw_edge_t));
+                    if (!grown) {
+                        ison_free(targets);
+                        ison_free(edges);
+                        return NULL;
+                    }
+                    edges = grown;
+                }
+                edges[*count].src = (uint32_t)(g->block_offsets[b] + r);
+                edges[*count].dst = (uint32_t)(g->block_offsets[tb] + target_row);
+                edges[*count].rel = (uint32_t)last_rel;
+                (*count)++;
+            }
+        }
+        ison_free(targets);
+    }
+    return edges;
+}
+
+/* Two stable counting sorts: by relationship, then by source node */
+static int build_csr(ison_graph_t *g, const raw_edge_t *edges, size_t count) {
+    size_t *rel_start = ison_calloc(g->rel_count + 1, sizeof(size_t));
+    raw_edge_t *by_rel = ison_malloc((count ? count : 1) * sizeof(raw_edge_t));
+    g->offsets = ison_calloc(g->node_count + 1, sizeof(size_t));
+    g->targets = ison_malloc((count ? count : 1) * sizeof(uint32_t));
+    g->rels = ison_malloc((count ? count : 1) * sizeof(uint32_t));
+    if (!rel_start || !by_rel || !g->offsets || !g->targets || !g->rels) {
+        ison_free(rel_start);
+        ison_free(by_rel);
+        return 0;
+    }
+    
+    for (size_t i = 0; i < count; i++) rel_start[edges[i].rel + 1]++;
+    for (size_t i = 0; i < g->rel_count; i++) rel_start[i + 1] += rel_start[i];
+    for (size_t i = 0; i < count; i++) by_rel[rel_start[edges[i].rel]++] = edges[i];
+    
+    for (size_t i = 0; i < count; i++) g->offsets[by_rel[i].src + 1]++;
+    for (size_t i = 0; i < g->node_count; i++) g->offsets[i + 1] += g->offsets[i];
+    
+    ison_free(rel_start);
+    size_t *cursor = ison_malloc((g->node_count ? g->node_count : 1) * sizeof(size_t));
+    if (!cursor) {
+        ison_free(by_rel);
+        return 0;
+    }
+    memcpy(cursor, g->offsets, g->node_count * sizeof(size_t));
+    for (size_t i = 0; i < count; i++) {
+        size_t slot = cursor[by_rel[i].src]++;
+        g->targets[slot] = by_rel[i].dst;
+        g->rels[slot] = by_rel[i].rel;
+    }
+    
+    ison_free(cursor);
+    ison_free(by_rel);
+    g->edge_count = count;
+    return 1;
+}
+
+ison_graph_t *ison_graph_build(ison_document_t *doc) {
+    if (!doc) return NULL;
+    
+    ison_graph_t *g = ison_calloc(1, sizeof(ison_graph_t));
+    if (!g) return NULL;
+    g->doc = doc;
+    g->block_count = doc->block_count;
+    g->block_offsets = ison_malloc((g->block_count + 1) * sizeof(size_t));
+    if (!g->block_offsets) {
+        ison_graph_free(g);
+        return NULL;
+    }
+    for (size_t b = 0; b < g->block_count; b++) {
+        g->block_offsets[b] = g->node_count;
+        g->node_count += doc->blocks[b]->row_count;
+    }
+    g->block_offsets[g->block_count] = g->node_count;
+    if (g->node_count > UINT32_MAX) {
+        ison_graph_free(g);
+        return NULL;
+    }
+    
+    if (!doc->ref_index) doc->ref_index = ison_ref_index_build(doc);
+    
+    size_t count;
+    raw_edge_t *edges = collect_edges(g, &count);
+    if (!edges || !build_csr(g, edges, count)) {
+        ison_free(edges);
+        ison_graph_free(g);
+        return NULL;
+    }
+    ison_free(edges);
+    return g;
+}
+
+void ison_graph_free(ison_graph_t *graph) {
+    if (!graph) return;
+    for (size_t i = 0; i < graph->rel_count; i++) {
+        ison_free(graph->rel_names[i]);
+    }
+    ison_free(graph->rel_names);
+    ison_free(graph->block_offsets);
+    ison_free(graph->offsets);
+    ison_free(graph->targets);
+    ison_free(graph->rels);
+    ison_free(graph);
+}
+
+size_t ison_graph_node_count(const ison_graph_t *graph) {
+    return graph ? graph->node_count : 0;
+}
+
+size_t ison_graph_edge_count(const ison_graph_t *graph) {
+    return graph ? graph->edge_count : 0;
+}
+
+bool ison_graph_node(const ison_graph_t *graph, const ison_block_t *block, size_t row, size_t *node) {
+    if (!graph || !block) return false;
+    size_t b = block_position(graph, block);
+    if (b >= graph->block_count || row >= block->row_count) return false;
+    if (node) *node = graph->block_offsets[b] + row;
+    return true;
+}
+
+bool ison_graph_node_row(const ison_graph_t *graph, size_t node, ison_block_t **block, size_t *row) {
+    if (!graph || node >= graph->node_count) return false;
+    
+    size_t lo = 0, hi = graph->block_count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (graph->block_offsets[mid] <= node) lo = mid;
+        else hi = mid;
+    }
+    /* Skip empty blocks that share the same offset */
+    while (lo + 1 < graph->block_count && graph->block_offsets[lo + 1] <= node) lo++;
+    
+    if (block) *block = graph->doc->blocks[lo];
+    if (row) *row = node - graph->block_offsets[lo];
+    return true;
+}
+
+int ison_graph_relationship(const ison_graph_t *graph, const char *name) {
+    if (!graph || !name) return -1;
+    for (size_t i = 0; i < graph->rel_count; i++) {
+        if (strcmp(graph->rel_names[i], name) == 0) return (int)i;
+    }
+    return -1;
+}
+
+size_t ison_graph_neighbors(const ison_graph_t *graph, size_t node, int rel, const uint32_t **targets) {
+    if (targets) *targets = NULL;
+    if (!graph || node >= graph->node_count) return 0;
+    
+    size_t begin = graph->offsets[node];
+    size_t end = graph->offsets[node + 1];
+    if (rel >= 0) {
+        while (begin < end && graph->rels[begin] < (uint32_t)rel) begin++;
+        size_t stop = begin;
+        while (stop < end && graph->rels[stop] == (uint32_t)rel) stop++;
+        end = stop;
+    }
+    if (targets) *targets = graph->targets + begin;
+    return end - begin;
+}
+
+static int mark_visited(uint8_t *visited, size_t node) {
+    uint8_t bit = (uint8_t)(1u << (node & 7));
+    if (visited[node >> 3] & bit) return 0;
+    visited[node >> 3] |= bit;
+    return 1;
+}
+
+ison_error_t ison_graph_bfs(const ison_graph_t *graph, size_t start, int rel, size_t max_depth,
+                            ison_graph_visit_t visit, void *userdata) {
+    if (!graph || !visit || start >= graph->node_count) return ISON_ERROR_INVALID;
+    
+    uint8_t *visited = ison_calloc(graph->node_count / 8 + 1, 1);
+    size_t *queue = ison_malloc(graph->node_count * sizeof(size_t));
+    size_t *depth = ison_malloc(graph->node_count * sizeof(size_t));
+    if (!visited || !queue || !depth) {
+        ison_free(visited);
+        ison_free(queue);
+        ison_free(depth);
+        return ISON_ERROR_MEMORY;
+    }
+    
+    size_t head = 0, tail = 0;
+    mark_visited(visited, start);
+    queue[tail] = start;
+    depth[tail++] = 0;
+    
+    while (head < tail) {
+        size_t node = queue[head];
+        size_t d = depth[head++];
+        if (!visit(node, d, userdata)) break;
+        if (d >= max_depth) continue;
+        
+        const uint32_t *next;
+        size_t n = ison_graph_neighbors(graph, node, rel, &next);
+        for (size_t i = 0; i < n; i++) {
+            if (!mark_visited(visited, next[i])) continue;
+            queue[tail] = next[i];
+            depth[tail++] = d + 1;
+        }
+    }
+    
+    ison_free(visited);
+    ison_free(queue);
+    ison_free(depth);
+    return ISON_OK;
+}
+
+ison_error_t ison_graph_dfs(const ison_graph_t *graph, size_t start, int rel, size_t max_depth,
+                            ison_graph_visit_t visit, void *userdata) {
+    if (!graph || !visit || start >= graph->node_count) return ISON_ERROR_INVALID;
+    
+    /* Explicit stack of (node, depth, next edge) frames; each node is entered once */
+    typedef struct {
+        size_t node;
+        size_t depth;
+        size_t edge;
+    } frame_t;
+    
+    uint8_t *visited = ison_calloc(graph->node_count / 8 + 1, 1);
+    frame_t *stack = ison_malloc(graph->node_count * sizeof(frame_t));
+    if (!visited || !stack) {
+        ison_free(visited);
+        ison_free(stack);
+        return ISON_ERROR_MEMORY;
+    }
+    
+    size_t top = 0;
+    mark_visited(visited, start);
+    if (visit(start, 0, userdata)) {
+        stack[top].node = start;
+        stack[top].depth = 0;
+        stack[top++].edge = 0;
+    }
+    
+    while (top > 0) {
+        frame_t *f = &stack[top - 1];
+        const uint32_t *next;
+        size_t n = f->depth < max_depth ? ison_graph_neighbors(graph, f->node, rel, &next) : 0;
+        
+        while (f->edge < n && !mark_visited(visited, next[f->edge])) f->edge++;
+        if (f->edge >= n) {
+            top--;
+            continue;
+        }
+        
+        size_t child = next[f->edge++];
+        size_t d = f->depth + 1;
+        if (!visit(child, d, userdata)) break;
+        stack[top].node = child;
+        stack[top].depth = d;
+        stack[top++].edge = 0;
+    }
+    
+    ison_free(visited);
+    ison_free(stack);
+    return ISON_OK;
+}
+
+typedef struct {
+    size_t start;
+    size_t *nodes;
+    size_t count;
+} khop_t;
+
+static bool collect_node(size_t node, size_t depth, void *userdata) {
+    khop_t *k = userdata;
+    (void)depth;
+    if (node != k->start) k->nodes[k->count++] = node;
+    return true;
+}
+
+size_t ison_graph_khop(const ison_graph_t *graph, size_t start, int rel, size_t k, size_t **nodes) {
+    if (nodes) *nodes = NULL;
+    if (!graph || !nodes || start >= graph->node_count) return 0;
+    
+    khop_t acc = {start, ison_malloc(graph->node_count * sizeof(size_t)), 0};
+    if (!acc.nodes) return 0;
+    if (ison_graph_bfs(graph, start, rel, k, collect_node, &acc) != ISON_OK) {
+        ison_free(acc.nodes);
+        return 0;
+    }
+    *nodes = acc.nodes;
+    return acc.count;
+}
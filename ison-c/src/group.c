@@ -0,0 +1,483 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+/*
+ * Hash group-by.
+ *
+ * The key and aggregate cells of every row are gathered once into a flat
+ * matrix, and each row's key is hashed. Rows are then folded into groups
+ * through an open-addressing table of {hash, group} slots probed linearly:
+ * a lookup usually touches a single cache line, and keys are compared only
+ * on a full hash match. Large blocks are partitioned by the high hash bits
+ * and every partition is grouped on its own worker thread; since a key
+ * lives in exactly one partition, the results are simply concatenated and
+ * put back in order of first appearance.
+ */
+
+#define GROUP_PARALLEL_MIN 65536
+#define GROUP_GATHER_ROWS 4096
+#define EMPTY_SLOT ((size_t)-1)
+
+typedef struct {
+    uint64_t hash;
+    size_t group;
+} group_slot_t;
+
+/* Running aggregate of one column within one group */
+typedef struct {
+    size_t non_null;
+    size_t int_count;
+    size_t float_count;
+    int64_t int_sum;
+    bool int_overflow;
+    double int_float_sum;     /* used once int_sum has overflowed */
+    int64_t int_min;
+    int64_t int_max;
+    double float_sum;
+    double float_min;
+    double float_max;
+} group_acc_t;
+
+typedef struct {
+    const size_t *rows;       /* ascending row positions; NULL = every row */
+    size_t row_count;
+    group_slot_t *slots;
+    size_t slot_capacity;
+    size_t *first_row;        /* per group: the row its key was taken from */
+    size_t *counts;
+    group_acc_t *accs;        /* accs[group * agg_count + a] */
+    size_t group_count;
+    size_t group_capacity;
+    bool failed;
+} group_part_t;
+
+typedef struct {
+    const ison_block_t *block;
+    const ison_group_agg_t *aggs;
+    size_t key_count;
+    size_t agg_count;
+    size_t stride;                /* key_count + agg_count */
+    size_t *positions;            /* field position per gathered column, or -1 */
+    const ison_value_t **cells;   /* cells[row * stride + c]; NULL = missing */
+    uint64_t *hashes;
+    size_t row_count;
+    size_t chunk_count;
+    group_part_t *parts;
+    size_t part_count;
+} group_ctx_t;
+
+typedef struct {
+    size_t first_row;
+    size_t part;
+    size_t group;
+} group_ref_t;
+
+static void gather_chunk(size_t chunk, void *arg) {
+    group_ctx_t *ctx = arg;
+    size_t lo = ctx->row_count * chunk / ctx->chunk_count;
+    size_t hi = ctx->row_count * (chunk + 1) / ctx->chunk_count;
+    
+    for (size_t r = lo; r < hi; r++) {
+        const ison_row_t *row = ctx->block->rows[r];
+        const ison_value_t **cells = ctx->cells + r * ctx->stride;
+        uint64_t h = 0;
+        for (size_t c = 0; c < ctx->stride; c++) {
+            size_t pos = ctx->positions[c];
+            cells[c] = pos == ISON_NO_FIELD ? NULL
+                                         : ison_column_value(row, pos, ctx->block->fields[pos].name);
+            if (c < ctx->key_count) {
+                h = ison_hash_combine(h, ison_value_hash(cells[c]));
+            }
+        }
+        ctx->hashes[r] = h;
+    }
+}
+
+static size_t partition_of(uint64_t hash, size_t part_count) {
+    return (size_t)(((hash >> 32) * part_count) >> 32);
+}
+
+static bool keys_equal(const group_ctx_t *ctx, size_t a, size_t b) {
+    const ison_value_t **x = ctx->cells + a * ctx->stride;
+    const ison_value_t **y = ctx->cells + b * ctx->stride;
+    for (size_t c = 0; c < ctx->key_count; c++) {
+        if (!ison_value_equal(x[c], y[c])) return false;
+    }
+    return true;
+}
+
+static bool grow_slots(group_part_t *part) {
+    size_t cap = part->slot_capacity ? part->slot_capacity * 2 : 64;
+    group_slot_t *slots = ison_malloc(cap * sizeof(group_slot_t));
+    if (!slots) return false;
+    for (size_t i = 0; i < cap; i++) slots[i].group = EMPTY_SLOT;
+    
+    for (size_t i = 0; i < part->slot_capacity; i++) {
+        if (part->slots[i].group == EMPTY_SLOT) continue;
+        size_t slot = (size_t)part->slots[i].hash & (cap - 1);
+        while (slots[slot].group != EMPTY_SLOT) slot = (slot + 1) & (cap - 1);
+        slots[slot] = part->slots[i];
+    }
+    ison_free(part->slots);
+    part->slots = slots;
+    part->slot_capacity = cap;
+    return true;
+}
+
+static size_t add_group(const group_ctx_t *ctx, group_part_t *part, size_t row) {
+    if (part->group_count >= part->group_capacity) {
+        size_t cap = part->group_capacity ? part->group_capacity * 2 : 32;
+        size_t *first_row = ison_realloc(part->first_row, cap * sizeof(size_t));
+        if (first_row) part->first_row = first_row;
+        size_t *counts = ison_realloc(part->counts, cap * sizeof(size_t));
+        if (counts) part->counts = counts;
+        group_acc_t *accs = ison_realloc(part->accs, (cap * ctx->agg_count + 1) * sizeof(group_acc_t));
+        if (accs) part->accs = accs;
+        if (!first_row || !counts || !accs) return EMPTY_SLOT;
+        part->group_capacity = cap;
+    }
+    
+    size_t g = part->group_count++;
+    part->first_row[g] = row;
+    part->counts[g] = 0;
+    memset(part->accs + g * ctx->agg_count, 0, ctx->agg_count * sizeof(group_acc_t));
+    return g;
+}
+
+static void acc_push(group_acc_t *acc, const ison_value_t *value) {
+    if (!value || value->type == ISON_TYPE_NULL) return;
+    acc->non_null++;
+    
+    if (value->type == ISON_TYPE_INT) {
+        int64_t v = value->data.int_val;
+        if (acc->int_count++ == 0) {
+            acc->int_min = v;
+            acc->int_max = v;
+        } else {
+            if (v < acc->int_min) acc->int_min = v;
+            if (v > acc->int_max) acc->int_max = v;
+        }
+        acc->int_float_sum += (double)v;
+        if ((v > 0 && acc->int_sum > INT64_MAX - v) || (v < 0 && acc->int_sum < INT64_MIN - v)) {
+            acc->int_overflow = true;
+        } else {
+            acc->int_sum += v;
+        }
+    } else if (value->type == ISON_TYPE_FLOAT) {
+        double v = value->data.float_val;
+        if (acc->float_count++ == 0) {
+            acc->float_min = v;
+            acc->float_max = v;
+        } else {
+            if (v < acc->float_min) acc->float_min = v;
+            if (v > acc->float_max) acc->float_max = v;
+        }
+        acc->float_sum += v;
+    }
+}
+
+static void acc_finish(const group_acc_t *acc, size_t count, ison_aggregate_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->count = count;
+    out->non_null = acc->non_null;
+    out->numeric = acc->int_count + acc->float_count;
+    if (out->numeric == 0) return;
+    
+    out->integral = acc->float_count == 0 && !acc->int_overflow;
+    if (acc->int_count) {
+        out->int_sum = acc->int_sum;
+        out->int_min = acc->int_min;
+        out->int_max = acc->int_max;
+    }
+    
+    double int_sum = acc->int_overflow ? acc->int_float_sum : (double)acc->int_sum;
+    out->sum = int_sum + acc->float_sum;
+    if (acc->int_count && acc->float_count) {
+        out->min = (double)acc->int_min < acc->float_min ? (double)acc->int_min : acc->float_min;
+        out->max = (double)acc->int_max > acc->float_max ? (double)acc->int_max : acc->float_max;
+    } else if (acc->int_count) {
+        out->min = (double)acc->int_min;
+        out->max = (double)acc->int_max;
+    } else {
+        out->min = acc->float_min;
+        out->max = acc->float_max;
+    }
+    out->mean = out->sum / (double)out->numeric;
+}
+
+static void group_partition(size_t p, void *arg) {
+    group_ctx_t *ctx = arg;
+    group_part_t *part = &ctx->parts[p];
+    
+    for (size_t k = 0; k < part->row_count; k++) {
+        size_t r = part->rows ? part->rows[k] : k;
+        uint64_t h = ctx->hashes[r];
+    
+        /* Keep the load factor at or below one half */
+        if ((part->group_count + 1) * 2 > part->slot_capacity && !grow_slots(part)) {
+            part->failed = true;
+            return;
+        }
+        size_t mask = part->slot_capacity - 1;
+        size_t slot = (size_t)h & mask;
+        while (part->slots[slot].group != EMPTY_SLOT) {
+            if (part->slots[slot].hash == h && keys_equal(ctx, part->first_row[part->slots[slot].group], r)) {
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    
+        size_t g = part->slots[slot].group;
+        if (g == EMPTY_SLOT) {
+            g = add_group(ctx, part, r);
+            if (g == EMPTY_SLOT) {
+                part->failed = true;
+                return;
+            }
+            part->slots[slot].hash = h;
+            part->slots[slot].group = g;
+        }
+    
+        part->counts[g]++;
+        const ison_value_t **cells = ctx->cells + r * ctx->stride + ctx->key_count;
+        group_acc_t *accs = part->accs + g * ctx->agg_count;
+        for (size_t a = 0; a < ctx->agg_count; a++) {
+            acc_push(&accs[a], cells[a]);
+        }
+    }
+}
+
+static int compare_refs(const void *a, const void *b) {
+    size_t x = ((const group_ref_t *)a)->first_row;
+    size_t y = ((const group_ref_t *)b)->first_row;
+    return (x > y) - (x < y);
+}
+
+static const char *agg_prefix(ison_agg_t agg) {
+    switch (agg) {
+        case ISON_AGG_COUNT: return "count";
+        case ISON_AGG_COUNT_NON_NULL: return "count";
+        case ISON_AGG_SUM: return "sum";
+        case ISON_AGG_MIN: return "min";
+        case ISON_AGG_MAX: return "max";
+        case ISON_AGG_MEAN: return "avg";
+        default: return NULL;
+    }
+}
+
+static const char *agg_type_hint(ison_agg_t agg) {
+    switch (agg) {
+        case ISON_AGG_COUNT:
+        case ISON_AGG_COUNT_NON_NULL:
+            return "int";
+        case ISON_AGG_MEAN:
+            return "float";
+        default:
+            return NULL;
+    }
+}
+
+static bool add_agg_field(ison_block_t *out, const ison_group_agg_t *agg) {
+    size_t before = out->field_count;
+    if (agg->as) {
+        ison_block_add_field(out, agg->as, agg_type_hint(agg->agg));
+        return out->field_count > before;
+    }
+    
+    const char *prefix = agg_prefix(agg->agg);
+    if (!prefix || agg->agg == ISON_AGG_COUNT || !agg->field) {
+        ison_block_add_field(out, prefix ? prefix : agg->field, agg_type_hint(agg->agg));
+        return out->field_count > before;
+    }
+    size_t len = strlen(prefix) + strlen(agg->field) + 2;
+    char *name = ison_malloc(len);
+    if (!name) return false;
+    snprintf(name, len, "%s_%s", prefix, agg->field);
+    ison_block_add_field(out, name, agg_type_hint(agg->agg));
+    ison_free(name);
+    return out->field_count > before;
+}
+
+static ison_row_t *build_row(const group_ctx_t *ctx, const ison_block_t *out,
+                             const group_part_t *part, size_t g) {
+    ison_row_t *row = ison_row_create();
+    if (!row) return NULL;
+    
+    const ison_value_t **keys = ctx->cells + part->first_row[g] * ctx->stride;
+    for (size_t f = 0; f < out->field_count; f++) {
+        ison_value_t value;
+        if (f < ctx->key_count) {
+            value = keys[f] ? ison_value_copy(keys[f]) : ison_null();
+        } else {
+            size_t a = f - ctx->key_count;
+            ison_aggregate_t agg;
+            acc_finish(&part->accs[g * ctx->agg_count + a], part->counts[g], &agg);
+            value = ison_aggregate_value(ctx->aggs[a].agg, &agg);
+        }
+        if (!ison_row_append(row, out->fields[f].name, &value)) {
+            ison_value_free(&value);
+            ison_row_free(row);
+            return NULL;
+        }
+    }
+    return row;
+}
+
+static ison_block_t *build_block(const group_ctx_t *ctx, const char *const *group_cols) {
+    const ison_block_t *block = ctx->block;
+    ison_block_t *out = ison_block_create(block->kind, block->name);
+    if (!out) return NULL;
+    
+    for (size_t c = 0; c < ctx->key_count; c++) {
+        ison_block_add_field(out, group_cols[c], block->fields[ctx->positions[c]].type_hint);
+    }
+    for (size_t a = 0; a < ctx->agg_count; a++) {
+        if (!add_agg_field(out, &ctx->aggs[a])) {
+            ison_block_free(out);
+            return NULL;
+        }
+    }
+    if (out->field_count != ctx->stride) {
+        ison_block_free(out);
+        return NULL;
+    }
+    
+    size_t total = 0;
+    for (size_t p = 0; p < ctx->part_count; p++) total += ctx->parts[p].group_count;
+    group_ref_t *refs = ison_malloc((total ? total : 1) * sizeof(group_ref_t));
+    if (!refs || !ison_block_reserve_rows(out, total)) {
+        ison_free(refs);
+        ison_block_free(out);
+        return NULL;
+    }
+    size_t n = 0;
+    for (size_t p = 0; p < ctx->part_count; p++) {
+        for (size_t g = 0; g < ctx->parts[p].group_count; g++) {
+            refs[n].first_row = ctx->parts[p].first_row[g];
+            refs[n].part = p;
+            refs[n].group = g;
+            n++;
+        }
+    }
+    if (ctx->part_count > 1) qsort(refs, n, sizeof(group_ref_t), compare_refs);
+    
+    for (size_t i = 0; i < n; i++) {
+        ison_row_t *row = build_row(ctx, out, &ctx->parts[refs[i].part], refs[i].group);
+        if (!row) {
+            ison_free(refs);
+            ison_block_free(out);
+            return NULL;
+        }
+        ison_block_take_row(out, row);
+    }
+    ison_free(refs);
+    return out;
+}
+
+/* Splits the rows among ctx->part_count partitions by hash, keeping row order */
+static size_t *partition_rows(group_ctx_t *ctx) {
+    size_t n = ctx->row_count;
+    size_t *rows = ison_malloc((n ? n : 1) * sizeof(size_t));
+    size_t *fill = ison_calloc(ctx->part_count, sizeof(size_t));
+    if (!rows || !fill) {
+        ison_free(rows);
+        ison_free(fill);
+        return NULL;
+    }
+    
+    for (size_t r = 0; r < n; r++) {
+        ctx->parts[partition_of(ctx->hashes[r], ctx->part_count)].row_count++;
+    }
+    size_t offset = 0;
+    for (size_t p = 0; p < ctx->part_count; p++) {
+        ctx->parts[p].rows = rows + offset;
+        offset += ctx->parts[p].row_count;
+    }
+    for (size_t r = 0; r < n; r++) {
+        size_t p = partition_of(ctx->hashes[r], ctx->part_count);
+        rows[(ctx->parts[p].rows - rows) + fill[p]++] = r;
+    }
+    ison_free(fill);
+    return rows;
+}
+
+ison_block_t *ison_block_group_by(const ison_block_t *block, const char *const *group_cols,
+                                  size_t group_count, const ison_group_agg_t *aggs,
+                                  size_t agg_count) {
+    if (!block || (!group_cols && group_count) || (!aggs && agg_count)) return NULL;
+    
+    group_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.block = block;
+    ctx.aggs = aggs;
+    ctx.key_count = group_count;
+    ctx.agg_count = agg_count;
+    ctx.stride = group_count + agg_count;
+    ctx.row_count = block->row_count;
+    
+    ctx.positions = ison_malloc((ctx.stride ? ctx.stride : 1) * sizeof(size_t));
+    if (!ctx.positions) return NULL;
+    for (size_t c = 0; c < ctx.stride; c++) {
+        const char *name;
+        if (c < group_count) {
+            name = group_cols[c];
+        } else {
+            const ison_group_agg_t *agg = &aggs[c - group_count];
+            name = agg->field;
+            if (!name && agg->agg != ISON_AGG_COUNT) {
+                ison_free(ctx.positions);
+                return NULL;
+            }
+        }
+        ctx.positions[c] = name ? ison_field_position(block, name) : ISON_NO_FIELD;
+        if (name && ctx.positions[c] == ISON_NO_FIELD) {
+            ison_free(ctx.positions);
+            return NULL;
+        }
+    }
+    
+    size_t n = ctx.row_count;
+    size_t threads = ison_thread_count();
+    ctx.part_count = n >= GROUP_PARALLEL_MIN && threads > 1 ? threads : 1;
+    size_t cell_count = n * ctx.stride;
+    ctx.cells = ison_malloc((cell_count ? cell_count : 1) * sizeof(ison_value_t *));
+    ctx.hashes = ison_malloc((n ? n : 1) * sizeof(uint64_t));
+    ctx.parts = ison_calloc(ctx.part_count, sizeof(group_part_t));
+    
+    ison_block_t *out = NULL;
+    size_t *rows = NULL;
+    if (!ctx.cells || !ctx.hashes || !ctx.parts) goto done;
+    
+    ctx.chunk_count = (n + GROUP_GATHER_ROWS - 1) / GROUP_GATHER_ROWS;
+    ison_parallel_for(ctx.chunk_count, gather_chunk, &ctx);
+    
+    if (ctx.part_count > 1) {
+        rows = partition_rows(&ctx);
+        if (!rows) goto done;
+    } else {
+        ctx.parts[0].row_count = n;
+    }
+    ison_parallel_for(ctx.part_count, group_partition, &ctx);
+    
+    for (size_t p = 0; p < ctx.part_count; p++) {
+        if (ctx.parts[p].failed) goto done;
+    }
+    out = build_block(&ctx, group_cols);
+    
+done:
+    for (size_t p = 0; ctx.parts && p < ctx.part_count; p++) {
+        ison_free(ctx.parts[p].slots);
+        ison_free(ctx.parts[p].first_row);
+        ison_free(ctx.parts[p].counts);
+        ison_free(ctx.parts[p].accs);
+    }
+    ison_free(rows);
+    ison_free(ctx.parts);
+    ison_free(ctx.hashes);
+    ison_free(ctx.cells);
+    ison_free(ctx.positions);
+    return out;
+}
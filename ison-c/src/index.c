@@ -0,0 +1,264 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+typedef struct {
+    ison_key_t key;       /* key.str is owned by the entry */
+    size_t first;         /* rows[0] while count == 1 */
+    size_t *rows;
+    size_t count;
+    size_t capacity;
+} index_entry_t;
+
+struct ison_index {
+    char *column;
+    index_entry_t *entries;
+    size_t entry_count;
+    size_t entry_capacity;
+};
+
+/* Parses canonical decimal integers only: no sign on zero, no leading zeros */
+static int parse_canonical_int(const char *s, int64_t *out) {
+    const char *p = s;
+    int negative = *p == '-';
+    if (negative) p++;
+    if (*p < '0' || *p > '9') return 0;
+    if (*p == '0' && (p[1] != '\0' || negative)) return 0;
+    
+    uint64_t v = 0;
+    for (; *p; p++) {
+        if (*p < '0' || *p > '9') return 0;
+        uint64_t d = (uint64_t)(*p - '0');
+        if (v > (UINT64_MAX - d) / 10) return 0;
+        v = v * 10 + d;
+    }
+    if (!negative && v > (uint64_t)INT64_MAX) return 0;
+    if (negative && v > (uint64_t)INT64_MAX + 1) return 0;
+    *out = negative ? (int64_t)(0 - v) : (int64_t)v;
+    return 1;
+}
+
+bool ison_key_make(const ison_value_t *value, ison_key_t *key) {
+    const char *str = NULL;
+    
+    key->str = NULL;
+    switch (value->type) {
+        case ISON_TYPE_INT:
+            key->kind = ISON_KEY_INT;
+            key->num = value->data.int_val;
+            break;
+        case ISON_TYPE_BOOL:
+            key->kind = ISON_KEY_BOOL;
+            key->num = value->data.bool_val;
+            break;
+        case ISON_TYPE_FLOAT: {
+            double d = value->data.float_val;
+            if (d != d) return false;
+            if (d >= -9223372036854775808.0 && d < 9223372036854775808.0 && d == (double)(int64_t)d) {
+                key->kind = ISON_KEY_INT;
+                key->num = (int64_t)d;
+            } else {
+                key->kind = ISON_KEY_FLOAT;
+                memcpy(&key->num, &d, sizeof(d));
+            }
+            break;
+        }
+        case ISON_TYPE_STRING:
+            str = ison_value_string(value);
+            break;
+        case ISON_TYPE_REFERENCE:
+            str = value->data.ref_val.id;
+            break;
+        default:
+            return false;
+    }
+    
+    if (value->type == ISON_TYPE_STRING || value->type == ISON_TYPE_REFERENCE) {
+        if (!str) return false;
+        if (parse_canonical_int(str, &key->num)) {
+            key->kind = ISON_KEY_INT;
+        } else {
+            key->kind = ISON_KEY_STRING;
+            key->str = str;
+            key->hash = ison_hash_string(str);
+            return true;
+        }
+    }
+    key->hash = ison_hash_mix((uint64_t)key->num ^ ((uint64_t)key->kind << 56));
+    return true;
+}
+
+bool ison_key_equal(const ison_key_t *a, const ison_key_t *b) {
+    if (a->kind != b->kind || a->hash != b->hash) return false;
+    if (a->kind == ISON_KEY_STRING) return strcmp(a->str, b->str) == 0;
+    return a->num == b->num;
+}
+
+static index_entry_t *find_slot(const ison_index_t *index, const ison_key_t *key) {
+    size_t mask = index->entry_capacity - 1;
+    size_t slot = (size_t)key->hash & mask;
+    while (index->entries[slot].count) {
+        if (ison_key_equal(&index->entries[slot].key, key)) break;
+        slot = (slot + 1) & mask;
+    }
+    return &index->entries[slot];
+}
+
+static int grow(ison_index_t *index) {
+    size_t new_cap = index->entry_capacity == 0 ? 16 : index->entry_capacity * 2;
+    index_entry_t *old = index->entries;
+    size_t old_cap = index->entry_capacity;
+    
+    index->entries = ison_calloc(new_cap, sizeof(index_entry_t));
+    if (!index->entries) {
+        index->entries = old;
+        return 0;
+    }
+    index->entry_capacity = new_cap;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].count) *find_slot(index, &old[i].key) = old[i];
+    }
+    ison_free(old);
+    return 1;
+}
+
+static void index_insert(ison_index_t *index, const ison_value_t *value, size_t row) {
+    ison_key_t key;
+    if (!value || !ison_key_make(value, &key)) return;
+    
+    if ((index->entry_count + 1) * 2 > index->entry_capacity && !grow(index)) return;
+    
+    index_entry_t *entry = find_slot(index, &key);
+    if (entry->count == 0) {
+        if (key.kind == ISON_KEY_STRING) {
+            size_t len = strlen(key.str);
+            char *copy = ison_malloc(len + 1);
+            if (!copy) return;
+            memcpy(copy, key.str, len + 1);
+            key.str = copy;
+        }
+        entry->key = key;
+        entry->first = row;
+        entry->count = 1;
+        index->entry_count++;
+        return;
+    }
+    
+    if (entry->count >= entry->capacity) {
+        size_t new_cap = entry->capacity == 0 ? 4 : entry->capacity * 2;
+        size_t *new_rows = ison_realloc(entry->rows, new_cap * sizeof(size_t));
+        if (!new_rows) return;
+        if (!entry->rows) new_rows[0] = entry->first;
+        entry->rows = new_rows;
+        entry->capacity = new_cap;
+    }
+    entry->rows[entry->count++] = row;
+}
+
+static void index_clear(ison_index_t *index) {
+    for (size_t i = 0; i < index->entry_capacity; i++) {
+        if (!index->entries[i].count) continue;
+        ison_free((char *)index->entries[i].key.str);
+        ison_free(index->entries[i].rows);
+    }
+    memset(index->entries, 0, index->entry_capacity * sizeof(index_entry_t));
+    index->entry_count = 0;
+}
+
+static void index_fill(ison_index_t *index, const ison_block_t *block) {
+    for (size_t r = 0; r < block->row_count; r++) {
+        index_insert(index, ison_row_get_ptr(block->rows[r], index->column), r);
+    }
+}
+
+static void index_free(ison_index_t *index) {
+    if (!index) return;
+    index_clear(index);
+    ison_free(index->entries);
+    ison_free(index->column);
+    ison_free(index);
+}
+
+ison_index_t *ison_block_get_index(const ison_block_t *block, const char *column) {
+    if (!block || !column) return NULL;
+    for (size_t i = 0; i < block->index_count; i++) {
+        if (strcmp(block->indexes[i]->column, column) == 0) return block->indexes[i];
+    }
+    return NULL;
+}
+
+ison_index_t *ison_block_build_index(ison_block_t *block, const char *column) {
+    if (!block || !column) return NULL;
+    
+    ison_index_t *index = ison_block_get_index(block, column);
+    if (index) return index;
+    
+    ison_index_t **new_indexes = ison_realloc(block->indexes, (block->index_count + 1) * sizeof(ison_index_t *));
+    if (!new_indexes) return NULL;
+    block->indexes = new_indexes;
+    
+    index = ison_calloc(1, sizeof(ison_index_t));
+    if (!index) return NULL;
+    size_t len = strlen(column);
+    index->column = ison_malloc(len + 1);
+    if (!index->column || !grow(index)) {
+        index_free(index);
+        return NULL;
+    }
+    memcpy(index->column, column, len + 1);
+    
+    index_fill(index, block);
+    block->indexes[block->index_count++] = index;
+    return index;
+}
+
+void ison_block_drop_index(ison_block_t *block, ison_index_t *index) {
+    if (!block || !index) return;
+    for (size_t i = 0; i < block->index_count; i++) {
+        if (block->indexes[i] != index) continue;
+        index_free(index);
+        block->indexes[i] = block->indexes[--block->index_count];
+        return;
+    }
+}
+
+size_t ison_block_find(const ison_block_t *block, const ison_index_t *index,
+                       const ison_value_t *value, const size_t **rows) {
+    if (rows) *rows = NULL;
+    if (!block || !index || !value) return 0;
+    
+    ison_key_t key;
+    if (!ison_key_make(value, &key)) return 0;
+    
+    const index_entry_t *entry = find_slot(index, &key);
+    if (entry->count == 0) return 0;
+    if (rows) *rows = entry->rows ? entry->rows : &entry->first;
+    return entry->count;
+}
+
+void ison_block_index_row(ison_block_t *block, size_t row) {
+    for (size_t i = 0; i < block->index_count; i++) {
+        ison_index_t *index = block->indexes[i];
+        index_insert(index, ison_row_get_ptr(block->rows[row], index->column), row);
+    }
+    ison_block_range_index_row(block, row);
+}
+
+void ison_block_rebuild_indexes(ison_block_t *block) {
+    for (size_t i = 0; i < block->index_count; i++) {
+        index_clear(block->indexes[i]);
+        index_fill(block->indexes[i], block);
+    }
+    ison_block_rebuild_range_indexes(block);
+}
+
+void ison_block_free_indexes(ison_block_t *block) {
+    for (size_t i = 0; i < block->index_count; i++) {
+        index_free(block->indexes[i]);
+    }
+    ison_free(block->indexes);
+    block->indexes = NULL;
+    block->index_count = 0;
+    ison_block_free_range_indexes(block);
+}
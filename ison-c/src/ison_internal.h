@@ -0,0 +1,268 @@
+/**
+ * ison_internal.h - Helpers shared between ison-c translation units.
+ *
+ * Not installed; nothing here is part of the public API.
+ */
+
+#ifndef ISON_INTERNAL_H
+#define ISON_INTERNAL_H
+
+#include "ison.h"
+
+/* ==================== Hashing ==================== */
+
+uint64_t ison_hash_bytes(const void *data, size_t len);
+uint64_t ison_hash_string(const char *str);
+
+/* Folds v into the running hash h of a sequence of cells */
+uint64_t ison_hash_combine(uint64_t h, uint64_t v);
+
+/* Spreads the bits of a number-like key over the whole word */
+uint64_t ison_hash_mix(uint64_t h);
+
+/* ==================== Keys ==================== */
+
+enum {
+    ISON_KEY_INT = 1,
+    ISON_KEY_FLOAT,
+    ISON_KEY_BOOL,
+    ISON_KEY_STRING
+};
+
+/* Lookup key of a cell, as column indexes and joins match them */
+typedef struct {
+    int kind;
+    int64_t num;          /* int, bool, or the bit pattern of a float */
+    const char *str;      /* borrowed from the value */
+    uint64_t hash;
+} ison_key_t;
+
+/*
+ * False for nulls and NaNs. Whole floats become ints; strings and reference
+ * ids holding a canonical decimal integer do too, so :user:42 matches 42.
+ *
+ * Keys are looser than ison_value_equal, which grouping, distinct and row
+ * hashing use: as keys "42" == 42 == :user:42, as values "42" != 42. Use
+ * keys only where a reference must find the row it points at.
+ */
+bool ison_key_make(const ison_value_t *value, ison_key_t *key);
+bool ison_key_equal(const ison_key_t *a, const ison_key_t *b);
+
+/* ==================== Allocation ==================== */
+
+/* Allocate through `allocator`, or the global one when it is NULL or zeroed */
+void *ison_allocator_malloc(const ison_allocator_t *allocator, size_t size);
+void *ison_allocator_calloc(const ison_allocator_t *allocator, size_t count, size_t size);
+void *ison_allocator_realloc(const ison_allocator_t *allocator, void *ptr, size_t size);
+void ison_allocator_free(const ison_allocator_t *allocator, void *ptr);
+
+/* ==================== Arena ==================== */
+
+typedef struct ison_arena_chunk ison_arena_chunk_t;
+
+/* Bump allocator; reset rewinds every chunk but frees none */
+typedef struct {
+    ison_arena_chunk_t *head;
+    ison_arena_chunk_t *current;
+    const ison_allocator_t *allocator;   /* chunk source; NULL = global */
+} ison_arena_t;
+
+void *ison_arena_alloc(ison_arena_t *arena, size_t size);
+
+/* Bytes held by the arena's chunks; *chunks receives their number */
+size_t ison_arena_footprint(const ison_arena_t *arena, size_t *chunks);
+void ison_arena_reset(ison_arena_t *arena);
+void ison_arena_free(ison_arena_t *arena);
+
+/* ==================== Parallelism ==================== */
+
+typedef void (*ison_task_fn)(size_t task, void *ctx);
+
+/*
+ * Runs fn(0..count-1) split into contiguous ranges across worker threads and
+ * returns when all are done. Serial when built with ISON_NO_THREADS.
+ */
+void ison_parallel_for(size_t count, ison_task_fn fn, void *ctx);
+size_t ison_thread_count(void);
+
+/* ==================== Block ==================== */
+
+/* Index maintenance hooks for block.c */
+void ison_block_index_row(ison_block_t *block, size_t row);
+void ison_block_rebuild_indexes(ison_block_t *block);
+void ison_block_free_indexes(ison_block_t *block);
+
+#define ISON_NO_FIELD ((size_t)-1)
+
+/* Position of field in block->fields, or ISON_NO_FIELD */
+size_t ison_field_position(const ison_block_t *block, const char *field);
+
+/* Range index counterparts, called from the hooks above */
+void ison_block_range_index_row(ison_block_t *block, size_t row);
+void ison_block_rebuild_range_indexes(ison_block_t *block);
+void ison_block_free_range_indexes(ison_block_t *block);
+
+/* ==================== Aggregation ==================== */
+
+/* Cell for agg over a (see ison_block_compute_summary); null without numbers */
+ison_value_t ison_aggregate_value(ison_agg_t agg, const ison_aggregate_t *a);
+
+/* ==================== Document ==================== */
+
+/* Open-addressed by name hash; a used slot whose block was acquired keeps its place in the chain */
+typedef struct {
+    ison_block_t *block;
+    uint64_t hash;
+    bool used;
+} ison_spare_slot_t;
+
+struct ison_document_pool {
+    ison_arena_t arena;
+    ison_spare_slot_t *spares;  /* blocks set aside by the last reset, rebuilt by each reset */
+    size_t spare_count;         /* blocks not yet acquired */
+    size_t spare_capacity;      /* slots, a power of two */
+    
+    /* Parser scratch: a private copy of the input split into lines, and tokens */
+    char *text;
+    size_t text_capacity;
+    char **lines;
+    size_t line_capacity;
+    char *token_text;
+    size_t token_text_capacity;
+    char **tokens;
+    size_t token_capacity;
+    ison_row_builder_t *builder;
+};
+
+/* doc->pool, created on first use */
+ison_document_pool_t *ison_document_pool(ison_document_t *doc);
+
+/* A spare block called `name` from the pool, or a new one */
+ison_block_t *ison_document_acquire_block(ison_document_t *doc, const char *kind, const char *name);
+
+/* Frees the parser scratch but keeps the arena that values point into */
+void ison_document_pool_trim(ison_document_t *doc);
+
+/* Rebuilds the name index after doc->blocks has been reordered */
+void ison_document_reindex(ison_document_t *doc);
+
+/* Position + 1 of the block called `name`, or 0 */
+size_t ison_document_position(const ison_document_t *doc, const char *name);
+
+/* Position + 1 of the block a :ns:id reference points into (ns or its plural), or 0 */
+size_t ison_namespace_position(const ison_document_t *doc, const char *ns);
+
+/* ==================== Memory Accounting ==================== */
+
+/*
+ * Adds (sign = 1) or removes (sign = -1) row from stats. A spare row is
+ * counted whole under stats->spare; its values are already freed.
+ */
+void ison_memory_account_row(ison_memory_stats_t *stats, const ison_row_t *row, int sign, bool spare);
+
+/* Adds or removes one allocation of bytes in *bucket */
+void ison_memory_account(ison_memory_stats_t *stats, size_t *bucket, size_t bytes, int sign);
+
+/* Sets stats->total from the other buckets */
+void ison_memory_finish_total(ison_memory_stats_t *stats);
+
+/* Same for a NUL-terminated string; NULL counts nothing */
+void ison_memory_account_string(ison_memory_stats_t *stats, size_t *bucket, const char *str, int sign);
+
+/* Records an array growing from old_bytes (0 = not yet allocated) to new_bytes */
+void ison_memory_account_resize(ison_memory_stats_t *stats, size_t *bucket, size_t old_bytes, size_t new_bytes);
+
+/* ==================== JSON ==================== */
+
+/*
+ * Structural index over a JSON text (stage 1) and the cursor used to walk it
+ * (stage 2). `index` holds the offset of every structural character, opening
+ * string quote and scalar start outside of strings, in document order.
+ */
+typedef struct {
+    const char *text;
+    size_t len;
+    uint32_t *index;
+    size_t count;
+    size_t capacity;
+    size_t pos;
+    char *scratch;
+    size_t scratch_cap;
+    int error;
+} ison_json_tape_t;
+
+ison_error_t ison_json_index(ison_json_tape_t *tape, const char *text, size_t len);
+void ison_json_tape_free(ison_json_tape_t *tape);
+
+/* Character at the current structural position, or '\0' at the end */
+char ison_json_peek(const ison_json_tape_t *tape);
+
+/* Decodes an object key and consumes the following ':'; valid until the next call */
+const char *ison_json_parse_key(ison_json_tape_t *tape);
+ison_value_t ison_json_parse_value(ison_json_tape_t *tape);
+ison_row_t *ison_json_parse_object(ison_json_tape_t *tape);
+void ison_json_skip(ison_json_tape_t *tape);
+
+/* ==================== Rows ==================== */
+
+/* Value of the field at `pos` in row order, found by position when it matches */
+const ison_value_t *ison_column_value(const ison_row_t *row, size_t pos, const char *name);
+
+/* Appends without the duplicate-key scan; moves *value in on success */
+bool ison_row_append(ison_row_t *row, const char *key, const ison_value_t *value);
+
+/* Grows block->rows to hold at least `extra` more rows */
+bool ison_block_reserve_rows(ison_block_t *block, size_t extra);
+
+/* Moves every row to spare_rows with its values freed, and drops indexes */
+void ison_block_recycle(ison_block_t *block);
+
+/* A spare row whose entries may be refilled in place, or NULL */
+ison_row_t *ison_block_spare_row(ison_block_t *block);
+
+void ison_block_clear_fields(ison_block_t *block);
+
+/* Points builder (or a new one) at block, keeping its buffers */
+ison_row_builder_t *ison_row_builder_rebind(ison_row_builder_t *builder, ison_block_t *block);
+
+/* Adds the builder's own buffers to stats under bucket */
+void ison_row_builder_account(const ison_row_builder_t *builder, ison_memory_stats_t *stats, size_t *bucket);
+
+/* ==================== References ==================== */
+
+/*
+ * Single-allocation reference from an unterminated id and optional prefix,
+ * carved from arena when one is given. All fields are NULL on failure.
+ */
+ison_reference_t ison_reference_make_n(ison_arena_t *arena, const char *id, size_t id_len,
+                                       const char *prefix, size_t prefix_len, bool relationship);
+
+/* Copy of ref in one allocation owned by id, for an ISON_VALUE_SHARED_REF value */
+ison_reference_t ison_reference_copy_shared(const ison_reference_t *ref);
+
+/* ==================== Encoding ==================== */
+
+/*
+ * Writes v in the fewest digits (up to 17) that strtod reads back exactly,
+ * with ".0" added where it would otherwise parse as an int. Returns the
+ * length, as snprintf does; 32 bytes always suffice.
+ */
+int ison_format_float(char *buf, size_t size, double v);
+
+/*
+ * True when str must be quoted to read back as this string: it is empty,
+ * holds whitespace or quotes, or would otherwise parse as null, a bool, a
+ * number, a reference, a comment, a summary marker or a block header.
+ */
+bool ison_string_needs_quotes(const char *str);
+
+/* Appends row as one ISONL line, without the newline, as ison_dumps_isonl writes it */
+void ison_isonl_append_row(char **buf, size_t *len, size_t *cap, const ison_block_t *block,
+                           const ison_row_t *row);
+
+/* ==================== Sorting ==================== */
+
+/* Order of a and b (missing or null cells included) under key, as ison_block_sort sorts */
+int ison_sort_compare(const ison_value_t *a, const ison_value_t *b, const ison_sort_key_t *key);
+
+#endif /* ISON_INTERNAL_H */
@@ -0,0 +1,504 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+/*
+ * Merging sorted ISONL files.
+ *
+ * Each input is read through its own stdio buffer one line at a time and
+ * decoded into a private document with ison_parse_isonl_into, which reuses
+ * the document's rows and buffers from line to line. The current records of
+ * all inputs sit in a binary heap ordered by their key cells (as
+ * ison_block_sort orders them) and then by input position, so equal keys
+ * keep the order of the inputs. Output lines are encoded as
+ * ison_dumps_isonl writes them into a buffer flushed every ISONL_BUFFER
+ * bytes. Memory is the inputs times (buffer + longest line + one record).
+ */
+
+#define ISONL_BUFFER (64 * 1024)
+
+typedef struct {
+    FILE *file;
+    char *line;
+    size_t line_capacity;
+    ison_document_t *record;
+    const ison_block_t *block;
+    const ison_row_t *row;
+} isonl_reader_t;
+
+typedef struct {
+    FILE *file;
+    char *buf;
+    size_t len;
+    size_t cap;
+    bool wrote;
+} isonl_writer_t;
+
+/* Sources ordered by their current key cells, then by position */
+typedef struct {
+    const ison_value_t **cells;   /* cells[source * key_count + k] */
+    size_t *heap;
+    size_t heap_count;
+    const ison_sort_key_t *keys;
+    size_t key_count;
+} isonl_heap_t;
+
+/* Reads one line into reader->line; false at end of file or on error */
+static bool read_line(isonl_reader_t *reader, ison_error_t *err) {
+    size_t len = 0;
+    for (;;) {
+        if (reader->line_capacity - len < 2) {
+            size_t cap = reader->line_capacity ? reader->line_capacity * 2 : 256;
+            char *line = ison_realloc(reader->line, cap);
+            if (!line) {
+                *err = ISON_ERROR_MEMORY;
+                return false;
+            }
+            reader->line = line;
+            reader->line_capacity = cap;
+        }
+        if (!fgets(reader->line + len, (int)(reader->line_capacity - len), reader->file)) {
+            if (ferror(reader->file)) *err = ISON_ERROR_IO;
+            return len > 0 && *err == ISON_OK;
+        }
+        len += strlen(reader->line + len);
+        if (reader->line[len - 1] == '\n') return true;
+    }
+}
+
+/* Decodes the next record; false at the end of the input or on error */
+static bool reader_next(isonl_reader_t *reader, ison_error_t *err) {
+    while (read_line(reader, err)) {
+        *err = ison_parse_isonl_into(reader->record, reader->line);
+        if (*err != ISON_OK) return false;
+        if (reader->record->block_count == 0 || reader->record->blocks[0]->row_count == 0) continue;
+    
+        reader->block = reader->record->blocks[0];
+        reader->row = reader->block->rows[0];
+        return true;
+    }
+    return false;
+}
+
+static bool heap_init(isonl_heap_t *heap, size_t sources, const ison_sort_key_t *keys, size_t key_count) {
+    heap->keys = keys;
+    heap->key_count = key_count;
+    heap->heap_count = 0;
+    size_t cell_count = sources * key_count;
+    heap->cells = ison_malloc((cell_count ? cell_count : 1) * sizeof(ison_value_t *));
+    heap->heap = ison_malloc((sources ? sources : 1) * sizeof(size_t));
+    return heap->cells && heap->heap;
+}
+
+static void heap_free(isonl_heap_t *heap) {
+    ison_free(heap->cells);
+    ison_free(heap->heap);
+}
+
+/* Points the key cells of source at row */
+static void heap_set_row(isonl_heap_t *heap, size_t source, const ison_row_t *row) {
+    for (size_t k = 0; k < heap->key_count; k++) {
+        heap->cells[source * heap->key_count + k] = ison_row_get_ptr(row, heap->keys[k].field);
+    }
+}
+
+static bool source_less(const isonl_heap_t *heap, size_t a, size_t b) {
+    for (size_t k = 0; k < heap->key_count; k++) {
+        int c = ison_sort_compare(heap->cells[a * heap->key_count + k], heap->cells[b * heap->key_count + k],
+                                  &heap->keys[k]);
+        if (c) return c < 0;
+    }
+    return a < b;
+}
+
+static void sift_down(isonl_heap_t *merge, size_t i) {
+    size_t *heap = merge->heap;
+    for (;;) {
+        size_t least = i, left = 2 * i + 1, right = left + 1;
+        if (left < merge->heap_count && source_less(merge, heap[left], heap[least])) least = left;
+        if (right < merge->heap_count && source_less(merge, heap[right], heap[least])) least = right;
+        if (least == i) return;
+        size_t tmp = heap[i];
+        heap[i] = heap[least];
+        heap[least] = tmp;
+        i = least;
+    }
+}
+
+/* Makes the heap of sources 0..count whose first rows were set */
+static void heap_build(isonl_heap_t *heap, const bool *live, size_t count) {
+    heap->heap_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (live[i]) heap->heap[heap->heap_count++] = i;
+    }
+    for (size_t i = heap->heap_count / 2; i-- > 0;) sift_down(heap, i);
+}
+
+static bool writer_init(isonl_writer_t *writer, FILE *file) {
+    writer->file = file;
+    writer->len = 0;
+    writer->cap = ISONL_BUFFER * 2;
+    writer->buf = ison_malloc(writer->cap);
+    writer->wrote = false;
+    return writer->buf != NULL;
+}
+
+static ison_error_t writer_flush(isonl_writer_t *writer) {
+    if (writer->len && fwrite(writer->buf, 1, writer->len, writer->file) != writer->len) return ISON_ERROR_IO;
+    writer->len = 0;
+    return ISON_OK;
+}
+
+static ison_error_t writer_put(isonl_writer_t *writer, const ison_block_t *block, const ison_row_t *row) {
+    if (writer->wrote) {
+        writer->buf[writer->len++] = '\n';
+        writer->buf[writer->len] = '\0';
+    }
+    ison_isonl_append_row(&writer->buf, &writer->len, &writer->cap, block, row);
+    if (!writer->buf) return ISON_ERROR_MEMORY;
+    writer->wrote = true;
+    return writer->len >= ISONL_BUFFER ? writer_flush(writer) : ISON_OK;
+}
+
+static ison_error_t writer_put_line(isonl_writer_t *writer, const char *line) {
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+    if (writer->len + len + 2 > writer->cap) {
+        size_t cap = writer->cap * 2;
+        while (cap < writer->len + len + 2) cap *= 2;
+        char *buf = ison_realloc(writer->buf, cap);
+        if (!buf) return ISON_ERROR_MEMORY;
+        writer->buf = buf;
+        writer->cap = cap;
+    }
+    if (writer->wrote) writer->buf[writer->len++] = '\n';
+    memcpy(writer->buf + writer->len, line, len);
+    writer->len += len;
+    writer->wrote = true;
+    return writer->len >= ISONL_BUFFER ? writer_flush(writer) : ISON_OK;
+}
+
+/*
+ * Merges inputs, each sorted by keys, into out; the files stay open. With
+ * copy_lines the inputs are known to be encoded as ison_dumps_isonl writes
+ * records, so lines are copied rather than encoded again.
+ */
+static ison_error_t merge_files(FILE **inputs, size_t count, const ison_sort_key_t *keys, size_t key_count,
+                                bool copy_lines, FILE *out) {
+    isonl_heap_t heap;
+    isonl_writer_t writer;
+    isonl_reader_t *readers = ison_calloc(count ? count : 1, sizeof(isonl_reader_t));
+    bool *live = ison_calloc(count ? count : 1, sizeof(bool));
+    bool ready = heap_init(&heap, count, keys, key_count);
+    ready = writer_init(&writer, out) && ready;
+    
+    ison_error_t err = ISON_ERROR_MEMORY;
+    if (!readers || !live || !ready) goto done;
+    
+    err = ISON_OK;
+    for (size_t i = 0; i < count && err == ISON_OK; i++) {
+        readers[i].file = inputs[i];
+        readers[i].record = ison_document_create();
+        if (!readers[i].record) {
+            err = ISON_ERROR_MEMORY;
+        } else if (reader_next(&readers[i], &err)) {
+            heap_set_row(&heap, i, readers[i].row);
+            live[i] = true;
+        }
+    }
+    heap_build(&heap, live, count);
+    
+    while (err == ISON_OK && heap.heap_count > 0) {
+        size_t i = heap.heap[0];
+        err = copy_lines ? writer_put_line(&writer, readers[i].line)
+                         : writer_put(&writer, readers[i].block, readers[i].row);
+        if (err != ISON_OK) break;
+        if (reader_next(&readers[i], &err)) {
+            heap_set_row(&heap, i, readers[i].row);
+        } else {
+            heap.heap[0] = heap.heap[--heap.heap_count];
+        }
+        sift_down(&heap, 0);
+    }
+    if (err == ISON_OK) err = writer_flush(&writer);
+    
+done:
+    for (size_t i = 0; readers && i < count; i++) {
+        ison_free(readers[i].line);
+        ison_document_free(readers[i].record);
+    }
+    ison_free(readers);
+    ison_free(live);
+    heap_free(&heap);
+    ison_free(writer.buf);
+    return err;
+}
+
+ison_error_t isonl_merge(const char *const *paths, size_t count, const char *key_col, const char *out_path) {
+    if ((!paths && count) || !key_col || !out_path) return ISON_ERROR_INVALID;
+    
+    FILE **inputs = ison_calloc(count ? count : 1, sizeof(FILE *));
+    if (!inputs) return ISON_ERROR_MEMORY;
+    
+    ison_error_t err = ISON_OK;
+    for (size_t i = 0; i < count && err == ISON_OK; i++) {
+        inputs[i] = fopen(paths[i], "rb");
+        if (!inputs[i]) err = ISON_ERROR_IO;
+        else setvbuf(inputs[i], NULL, _IOFBF, ISONL_BUFFER);
+    }
+    FILE *out = err == ISON_OK ? fopen(out_path, "wb") : NULL;
+    if (err == ISON_OK && !out) err = ISON_ERROR_IO;
+    
+    if (err == ISON_OK) {
+        ison_sort_key_t key = { key_col, false, false };
+        err = merge_files(inputs, count, &key, 1, false, out);
+    }
+    if (out && fclose(out) != 0 && err == ISON_OK) err = ISON_ERROR_IO;
+    for (size_t i = 0; i < count; i++) {
+        if (inputs[i]) fclose(inputs[i]);
+    }
+    ison_free(inputs);
+    return err;
+}
+
+/*
+ * External sort: the input is cut into batches of lines, each decoded into
+ * one reused document, sorted with ison_block_sort (parallel for large
+ * blocks) and written to a temporary run; the runs are then merged as
+ * above, ISONL_MERGE_FANIN at a time. The first batch reads an eighth of
+ * mem_limit in text; later batches are sized from its measured footprint
+ * (decoded rows plus parser buffers, which the reused document keeps) to
+ * fill three quarters, leaving the rest for the sort's own arrays.
+ */
+
+#define ISONL_SORT_MEMORY ((size_t)256 * 1024 * 1024)
+#define ISONL_MERGE_FANIN 64
+#define ISONL_MIN_BATCH 4096
+
+/* Spilled runs, oldest first; a run of level L holds ISONL_MERGE_FANIN^L batches */
+typedef struct {
+    FILE **files;
+    unsigned *levels;
+    size_t count;
+    size_t capacity;
+} run_list_t;
+
+static FILE *run_open(void) {
+    FILE *run = tmpfile();
+    if (run) setvbuf(run, NULL, _IOFBF, ISONL_BUFFER);
+    return run;
+}
+
+static bool run_push(run_list_t *runs, FILE *run, unsigned level) {
+    if (runs->count >= runs->capacity) {
+        size_t cap = runs->capacity ? runs->capacity * 2 : 16;
+        FILE **files = ison_realloc(runs->files, cap * sizeof(FILE *));
+        if (files) runs->files = files;
+        unsigned *levels = ison_realloc(runs->levels, cap * sizeof(unsigned));
+        if (levels) runs->levels = levels;
+        if (!files || !levels) return false;
+        runs->capacity = cap;
+    }
+    runs->files[runs->count] = run;
+    runs->levels[runs->count++] = level;
+    return true;
+}
+
+static void runs_close(run_list_t *runs) {
+    for (size_t i = 0; i < runs->count; i++) fclose(runs->files[i]);
+    ison_free(runs->files);
+    ison_free(runs->levels);
+    memset(runs, 0, sizeof(*runs));
+}
+
+/* Merges files[0..count) into a new run at *out; the inputs stay open */
+static ison_error_t merge_runs(FILE **files, size_t count, const ison_sort_key_t *keys, size_t key_count,
+                               FILE **out) {
+    *out = run_open();
+    if (!*out) return ISON_ERROR_IO;
+    for (size_t i = 0; i < count; i++) rewind(files[i]);
+    ison_error_t err = merge_files(files, count, keys, key_count, true, *out);
+    if (err == ISON_OK && fflush(*out) != 0) err = ISON_ERROR_IO;
+    return err;
+}
+
+/*
+ * While the newest ISONL_MERGE_FANIN runs share a level, merges them into
+ * one run a level up. Runs are merged oldest first and only with their
+ * neighbours, so every record is rewritten once per level and records with
+ * equal keys keep their order.
+ */
+static ison_error_t compact_runs(run_list_t *runs, const ison_sort_key_t *keys, size_t key_count) {
+    while (runs->count >= ISONL_MERGE_FANIN) {
+        size_t first = runs->count - ISONL_MERGE_FANIN;
+        unsigned level = runs->levels[first];
+        for (size_t i = first; i < runs->count; i++) {
+            if (runs->levels[i] != level) return ISON_OK;
+        }
+        FILE *merged;
+        ison_error_t err = merge_runs(runs->files + first, ISONL_MERGE_FANIN, keys, key_count, &merged);
+        if (err != ISON_OK) {
+            if (merged) fclose(merged);
+            return err;
+        }
+        for (size_t i = first; i < runs->count; i++) fclose(runs->files[i]);
+        runs->count = first;
+        run_push(runs, merged, level + 1);
+    }
+    return ISON_OK;
+}
+
+/* Sorts every block of batch and writes their rows to out in key order */
+static ison_error_t write_run(ison_document_t *batch, const ison_sort_key_t *keys, size_t key_count, FILE *out) {
+    size_t count = batch->block_count;
+    for (size_t b = 0; b < count; b++) {
+        ison_error_t err = ison_block_sort(batch->blocks[b], keys, key_count);
+        if (err != ISON_OK) return err;
+    }
+    
+    isonl_heap_t heap;
+    isonl_writer_t writer;
+    size_t *next = ison_calloc(count ? count : 1, sizeof(size_t));
+    bool *live = ison_calloc(count ? count : 1, sizeof(bool));
+    bool ready = heap_init(&heap, count, keys, key_count);
+    ready = writer_init(&writer, out) && ready;
+    
+    ison_error_t err = ISON_ERROR_MEMORY;
+    if (next && live && ready) {
+        for (size_t b = 0; b < count; b++) {
+            live[b] = batch->blocks[b]->row_count > 0;
+            if (live[b]) heap_set_row(&heap, b, batch->blocks[b]->rows[0]);
+        }
+        heap_build(&heap, live, count);
+    
+        err = ISON_OK;
+        while (err == ISON_OK && heap.heap_count > 0) {
+            size_t b = heap.heap[0];
+            const ison_block_t *block = batch->blocks[b];
+            err = writer_put(&writer, block, block->rows[next[b]++]);
+            if (next[b] < block->row_count) {
+                heap_set_row(&heap, b, block->rows[next[b]]);
+            } else {
+                heap.heap[0] = heap.heap[--heap.heap_count];
+            }
+            sift_down(&heap, 0);
+        }
+        if (err == ISON_OK) err = writer_flush(&writer);
+    }
+    ison_free(next);
+    ison_free(live);
+    heap_free(&heap);
+    ison_free(writer.buf);
+    return err;
+}
+
+/* Merges neighbouring runs, fan-in at a time, until at most ISONL_MERGE_FANIN remain */
+static ison_error_t reduce_runs(run_list_t *runs, const ison_sort_key_t *keys, size_t key_count) {
+    while (runs->count > ISONL_MERGE_FANIN) {
+        run_list_t merged;
+        memset(&merged, 0, sizeof(merged));
+        ison_error_t err = ISON_OK;
+        for (size_t first = 0; first < runs->count && err == ISON_OK; first += ISONL_MERGE_FANIN) {
+            size_t group = runs->count - first < ISONL_MERGE_FANIN ? runs->count - first : ISONL_MERGE_FANIN;
+            FILE *out;
+            err = merge_runs(runs->files + first, group, keys, key_count, &out);
+            if (out && !run_push(&merged, out, 0)) {
+                fclose(out);
+                if (err == ISON_OK) err = ISON_ERROR_MEMORY;
+            }
+        }
+        runs_close(runs);
+        *runs = merged;
+        if (err != ISON_OK) return err;
+    }
+    return ISON_OK;
+}
+
+ison_error_t isonl_sort_file(const char *in_path, const char *out_path, const ison_sort_key_t *keys,
+                             size_t key_count, size_t mem_limit) {
+    if (!in_path || !out_path || !keys || key_count == 0) return ISON_ERROR_INVALID;
+    for (size_t k = 0; k < key_count; k++) {
+        if (!keys[k].field) return ISON_ERROR_INVALID;
+    }
+    if (mem_limit == 0) mem_limit = ISONL_SORT_MEMORY;
+    
+    isonl_reader_t reader;
+    memset(&reader, 0, sizeof(reader));
+    reader.file = fopen(in_path, "rb");
+    if (!reader.file) return ISON_ERROR_IO;
+    setvbuf(reader.file, NULL, _IOFBF, ISONL_BUFFER);
+    
+    ison_document_t *batch = ison_document_create();
+    run_list_t runs;
+    memset(&runs, 0, sizeof(runs));
+    char *text = NULL;
+    size_t text_capacity = 0;
+    size_t budget = mem_limit / 8 > ISONL_MIN_BATCH ? mem_limit / 8 : ISONL_MIN_BATCH;
+    FILE *out = NULL;
+    ison_error_t err = batch ? ISON_OK : ISON_ERROR_MEMORY;
+    
+    bool more = true;
+    while (err == ISON_OK && more) {
+        size_t text_len = 0;
+        while (text_len < budget && (more = read_line(&reader, &err))) {
+            size_t len = strlen(reader.line);
+            if (text_len + len + 2 > text_capacity) {
+                size_t cap = text_capacity ? text_capacity * 2 : 4096;
+                while (cap < text_len + len + 2) cap *= 2;
+                char *grown = ison_realloc(text, cap);
+                if (!grown) {
+                    err = ISON_ERROR_MEMORY;
+                    break;
+                }
+                text = grown;
+                text_capacity = cap;
+            }
+            memcpy(text + text_len, reader.line, len);
+            text_len += len;
+            if (text[text_len - 1] != '\n') text[text_len++] = '\n';
+            text[text_len] = '\0';
+        }
+        if (err != ISON_OK || (text_len == 0 && runs.count > 0)) break;
+    
+        err = text_len ? ison_parse_isonl_into(batch, text) : ISON_OK;
+        if (err != ISON_OK) break;
+    
+        if (runs.count == 0 && text_len > 0) {
+            ison_memory_stats_t stats;
+            ison_document_memory_stats(batch, &stats);
+            double scaled = (double)text_len * ((double)mem_limit * 0.75 / (double)(stats.total + text_capacity));
+            budget = scaled > ISONL_MIN_BATCH ? (size_t)scaled : ISONL_MIN_BATCH;
+        }
+    
+        if (!more && runs.count == 0) {
+            /* Everything fit in one batch: sort straight into out_path */
+            out = fopen(out_path, "wb");
+            err = out ? write_run(batch, keys, key_count, out) : ISON_ERROR_IO;
+            break;
+        }
+        FILE *run = run_open();
+        if (run && !run_push(&runs, run, 0)) {
+            fclose(run);
+            run = NULL;
+        }
+        err = run ? write_run(batch, keys, key_count, run) : ISON_ERROR_IO;
+        if (err == ISON_OK && fflush(run) != 0) err = ISON_ERROR_IO;
+        if (err == ISON_OK) err = compact_runs(&runs, keys, key_count);
+    }
+    fclose(reader.file);
+    ison_free(reader.line);
+    ison_free(text);
+    ison_document_free(batch);
+    
+    if (err == ISON_OK && !out) err = reduce_runs(&runs, keys, key_count);
+    if (err == ISON_OK && !out) {
+        for (size_t i = 0; i < runs.count; i++) rewind(runs.files[i]);
+        out = fopen(out_path, "wb");
+        err = out ? merge_files(runs.files, runs.count, keys, key_count, true, out) : ISON_ERROR_IO;
+    }
+    if (out && fclose(out) != 0 && err == ISON_OK) err = ISON_ERROR_IO;
+    runs_close(&runs);
+    return err;
+}
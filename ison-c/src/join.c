@@ -0,0 +1,487 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+/*
+ * Build/probe hash join.
+ *
+ * The keyed rows of the right block become items in row order, hashed into
+ * an open-addressing table of {hash, first item} slots; items with equal
+ * keys are chained through next[] in row order. Left rows then probe the
+ * table one at a time, so pairs come out in left order with no sort.
+ *
+ * When the table would outgrow the memory limit, the join goes grace-style:
+ * keys and row positions of both sides are written to one temporary file
+ * per hash partition, each partition pair is joined on its own, and the
+ * pairs are sorted back into left order at the end. The right side is then
+ * never held in memory whole, and partitions are processed in waves to
+ * bound the number of open files.
+ */
+
+#define JOIN_MEMORY_DEFAULT ((size_t)64 << 20)
+#define JOIN_MAX_PARTITIONS 256
+#define JOIN_OPEN_PARTITIONS 32
+#define JOIN_NONE ((size_t)-1)
+
+typedef struct {
+    ison_key_t key;            /* key.str borrowed from the block or a spill buffer */
+    size_t row;
+} join_item_t;
+
+typedef struct {
+    uint64_t hash;
+    size_t head;
+} join_slot_t;
+
+typedef struct {
+    const join_item_t *items;
+    size_t *next;
+    join_slot_t *slots;
+    size_t capacity;
+} join_table_t;
+
+/* Spilled key; a string key is followed by len bytes */
+typedef struct {
+    uint64_t row;
+    uint64_t hash;
+    int64_t num;
+    int32_t kind;
+    uint32_t len;
+} spill_record_t;
+
+typedef struct {
+    size_t left;
+    size_t right;
+} join_pair_t;
+
+static bool row_key(const ison_block_t *block, size_t row, size_t pos, ison_key_t *key) {
+    const ison_value_t *v = ison_column_value(block->rows[row], pos, block->fields[pos].name);
+    return v && ison_key_make(v, key);
+}
+
+static bool push_pair(ison_join_pairs_t *pairs, size_t left, size_t right) {
+    if (pairs->count >= pairs->capacity) {
+        size_t cap = pairs->capacity ? pairs->capacity * 2 : 64;
+        size_t *l = ison_realloc(pairs->left, cap * sizeof(size_t));
+        if (l) pairs->left = l;
+        size_t *r = ison_realloc(pairs->right, cap * sizeof(size_t));
+        if (r) pairs->right = r;
+        if (!l || !r) return false;
+        pairs->capacity = cap;
+    }
+    pairs->left[pairs->count] = left;
+    pairs->right[pairs->count] = right;
+    pairs->count++;
+    return true;
+}
+
+static size_t table_capacity(size_t items) {
+    size_t cap = 16;
+    while (cap < items * 2) cap *= 2;
+    return cap;
+}
+
+static size_t table_bytes(size_t items) {
+    return items * (sizeof(join_item_t) + sizeof(size_t)) + table_capacity(items) * sizeof(join_slot_t);
+}
+
+/* Items are inserted last to first so every chain runs in row order */
+static bool table_build(join_table_t *table, const join_item_t *items, size_t count) {
+    table->items = items;
+    table->capacity = table_capacity(count);
+    table->slots = ison_malloc(table->capacity * sizeof(join_slot_t));
+    table->next = ison_malloc((count ? count : 1) * sizeof(size_t));
+    if (!table->slots || !table->next) return false;
+    for (size_t i = 0; i < table->capacity; i++) table->slots[i].head = JOIN_NONE;
+    
+    size_t mask = table->capacity - 1;
+    for (size_t i = count; i-- > 0;) {
+        const ison_key_t *key = &items[i].key;
+        size_t slot = (size_t)key->hash & mask;
+        while (table->slots[slot].head != JOIN_NONE &&
+               !(table->slots[slot].hash == key->hash && ison_key_equal(&items[table->slots[slot].head].key, key))) {
+            slot = (slot + 1) & mask;
+        }
+        table->next[i] = table->slots[slot].head;
+        table->slots[slot].hash = key->hash;
+        table->slots[slot].head = i;
+    }
+    return true;
+}
+
+static void table_free(join_table_t *table) {
+    ison_free(table->slots);
+    ison_free(table->next);
+}
+
+/* First item matching key, or JOIN_NONE; the rest follow through next[] */
+static size_t table_find(const join_table_t *table, const ison_key_t *key) {
+    size_t mask = table->capacity - 1;
+    size_t slot = (size_t)key->hash & mask;
+    while (table->slots[slot].head != JOIN_NONE) {
+        if (table->slots[slot].hash == key->hash &&
+            ison_key_equal(&table->items[table->slots[slot].head].key, key)) {
+            return table->slots[slot].head;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return JOIN_NONE;
+}
+
+/* Emits the pairs of left row `row`; a NULL key never matches */
+static bool probe(const join_table_t *table, const ison_key_t *key, size_t row, ison_join_t kind,
+                  ison_join_pairs_t *out) {
+    size_t item = key && table ? table_find(table, key) : JOIN_NONE;
+    if (item == JOIN_NONE) {
+        return kind != ISON_JOIN_LEFT || push_pair(out, row, ISON_JOIN_NO_MATCH);
+    }
+    if (kind == ISON_JOIN_SEMI) return push_pair(out, row, table->items[item].row);
+    for (; item != JOIN_NONE; item = table->next[item]) {
+        if (!push_pair(out, row, table->items[item].row)) return false;
+    }
+    return true;
+}
+
+static ison_error_t join_in_memory(const ison_block_t *left, size_t lpos, join_item_t *items,
+                                   size_t count, ison_join_t kind, ison_join_pairs_t *out) {
+    join_table_t table;
+    memset(&table, 0, sizeof(table));
+    if (!table_build(&table, items, count)) {
+        table_free(&table);
+        return ISON_ERROR_MEMORY;
+    }
+    
+    ison_error_t result = ISON_OK;
+    for (size_t r = 0; r < left->row_count; r++) {
+        ison_key_t key;
+        bool keyed = row_key(left, r, lpos, &key);
+        if (!probe(&table, keyed ? &key : NULL, r, kind, out)) {
+            result = ISON_ERROR_MEMORY;
+            break;
+        }
+    }
+    table_free(&table);
+    return result;
+}
+
+/* ==================== Spilling ==================== */
+
+static size_t partition_of(uint64_t hash, size_t partitions) {
+    return (size_t)(hash >> 56) & (partitions - 1);
+}
+
+static bool spill_write(FILE *file, const ison_key_t *key, size_t row) {
+    spill_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.row = row;
+    rec.hash = key->hash;
+    rec.num = key->num;
+    rec.kind = key->kind;
+    rec.len = key->kind == ISON_KEY_STRING ? (uint32_t)strlen(key->str) : 0;
+    if (fwrite(&rec, sizeof(rec), 1, file) != 1) return false;
+    return rec.len == 0 || fwrite(key->str, 1, rec.len, file) == rec.len;
+}
+
+/* Reads one record; a string key lands in *buf at *used and key->str is left NULL */
+static int spill_read(FILE *file, ison_key_t *key, size_t *row, char **buf, size_t *cap,
+                      size_t *used) {
+    spill_record_t rec;
+    if (fread(&rec, sizeof(rec), 1, file) != 1) return 0;
+    key->kind = rec.kind;
+    key->num = rec.num;
+    key->hash = rec.hash;
+    key->str = NULL;
+    *row = (size_t)rec.row;
+    if (rec.kind != ISON_KEY_STRING) return 1;
+    
+    if (*used + rec.len + 1 > *cap) {
+        size_t new_cap = *cap ? *cap : 256;
+        while (new_cap < *used + rec.len + 1) new_cap *= 2;
+        char *grown = ison_realloc(*buf, new_cap);
+        if (!grown) return -1;
+        *buf = grown;
+        *cap = new_cap;
+    }
+    if (fread(*buf + *used, 1, rec.len, file) != rec.len) return -1;
+    (*buf)[*used + rec.len] = '\0';
+    return 1;
+}
+
+/* Joins one partition: loads its right items, then streams its left records */
+static ison_error_t join_partition(FILE *right_file, FILE *left_file, ison_join_t kind,
+                                   ison_join_pairs_t *out) {
+    join_item_t *items = NULL;
+    size_t count = 0, capacity = 0;
+    size_t *offsets = NULL;
+    char *strings = NULL;
+    size_t strings_cap = 0, strings_used = 0;
+    char *probe_str = NULL;
+    size_t probe_cap = 0;
+    join_table_t table;
+    memset(&table, 0, sizeof(table));
+    ison_error_t result = ISON_OK;
+    
+    rewind(right_file);
+    for (;;) {
+        if (count >= capacity) {
+            size_t cap = capacity ? capacity * 2 : 256;
+            join_item_t *grown = ison_realloc(items, cap * sizeof(join_item_t));
+            if (grown) items = grown;
+            size_t *grown_offsets = ison_realloc(offsets, cap * sizeof(size_t));
+            if (grown_offsets) offsets = grown_offsets;
+            if (!grown || !grown_offsets) {
+                result = ISON_ERROR_MEMORY;
+                goto done;
+            }
+            capacity = cap;
+        }
+        offsets[count] = strings_used;
+        int got = spill_read(right_file, &items[count].key, &items[count].row, &strings,
+                             &strings_cap, &strings_used);
+        if (got == 0) break;
+        if (got < 0) {
+            result = ISON_ERROR_IO;
+            goto done;
+        }
+        if (items[count].key.kind == ISON_KEY_STRING) {
+            strings_used += strlen(strings + strings_used) + 1;
+        }
+        count++;
+    }
+    /* The string buffer has stopped moving; point the keys into it */
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].key.kind == ISON_KEY_STRING) items[i].key.str = strings + offsets[i];
+    }
+    if (!table_build(&table, items, count)) {
+        result = ISON_ERROR_MEMORY;
+        goto done;
+    }
+    
+    rewind(left_file);
+    for (;;) {
+        ison_key_t key;
+        size_t row, used = 0;
+        int got = spill_read(left_file, &key, &row, &probe_str, &probe_cap, &used);
+        if (got == 0) break;
+        if (got < 0) {
+            result = ISON_ERROR_IO;
+            goto done;
+        }
+        if (key.kind == ISON_KEY_STRING) key.str = probe_str;
+        if (!probe(&table, &key, row, kind, out)) {
+            result = ISON_ERROR_MEMORY;
+            goto done;
+        }
+    }
+    
+done:
+    table_free(&table);
+    ison_free(items);
+    ison_free(offsets);
+    ison_free(strings);
+    ison_free(probe_str);
+    return result;
+}
+
+static int compare_pairs(const void *a, const void *b) {
+    const join_pair_t *x = a;
+    const join_pair_t *y = b;
+    if (x->left != y->left) return x->left < y->left ? -1 : 1;
+    return (x->right > y->right) - (x->right < y->right);
+}
+
+static ison_error_t sort_pairs(ison_join_pairs_t *pairs) {
+    if (pairs->count < 2) return ISON_OK;
+    join_pair_t *tmp = ison_malloc(pairs->count * sizeof(join_pair_t));
+    if (!tmp) return ISON_ERROR_MEMORY;
+    for (size_t i = 0; i < pairs->count; i++) {
+        tmp[i].left = pairs->left[i];
+        tmp[i].right = pairs->right[i];
+    }
+    qsort(tmp, pairs->count, sizeof(join_pair_t), compare_pairs);
+    for (size_t i = 0; i < pairs->count; i++) {
+        pairs->left[i] = tmp[i].left;
+        pairs->right[i] = tmp[i].right;
+    }
+    ison_free(tmp);
+    return ISON_OK;
+}
+
+/* Writes the keyed rows of block whose partition is in [first, first + wave) to files */
+static bool spill_rows(const ison_block_t *block, size_t pos, size_t partitions, size_t first,
+                       size_t wave, FILE **files) {
+    for (size_t r = 0; r < block->row_count; r++) {
+        ison_key_t key;
+        if (!row_key(block, r, pos, &key)) continue;
+        size_t p = partition_of(key.hash, partitions);
+        if (p >= first && p < first + wave && !spill_write(files[p - first], &key, r)) return false;
+    }
+    return true;
+}
+
+/*
+ * Partitions are spilled and joined a wave of JOIN_OPEN_PARTITIONS at a
+ * time, so no more than twice that many temporary files are open; each
+ * wave rescans both blocks for the keys that fall in it.
+ */
+static ison_error_t join_spilled(const ison_block_t *left, size_t lpos, const ison_block_t *right,
+                                 size_t rpos, size_t partitions, ison_join_t kind,
+                                 ison_join_pairs_t *out) {
+    size_t wave = partitions < JOIN_OPEN_PARTITIONS ? partitions : JOIN_OPEN_PARTITIONS;
+    FILE **files = ison_calloc(wave * 2, sizeof(FILE *));
+    if (!files) return ISON_ERROR_MEMORY;
+    FILE **right_files = files;
+    FILE **left_files = files + wave;
+    
+    /* Unkeyed left rows match nothing, whatever the partition */
+    ison_error_t result = ISON_OK;
+    for (size_t r = 0; r < left->row_count && result == ISON_OK; r++) {
+        ison_key_t key;
+        if (!row_key(left, r, lpos, &key) && !probe(NULL, NULL, r, kind, out)) result = ISON_ERROR_MEMORY;
+    }
+    
+    for (size_t first = 0; first < partitions && result == ISON_OK; first += wave) {
+        for (size_t f = 0; f < wave * 2 && result == ISON_OK; f++) {
+            files[f] = tmpfile();
+            if (!files[f]) result = ISON_ERROR_IO;
+        }
+        if (result == ISON_OK && (!spill_rows(right, rpos, partitions, first, wave, right_files) ||
+                                  !spill_rows(left, lpos, partitions, first, wave, left_files))) {
+            result = ISON_ERROR_IO;
+        }
+        for (size_t p = 0; p < wave && result == ISON_OK; p++) {
+            result = join_partition(right_files[p], left_files[p], kind, out);
+        }
+        for (size_t f = 0; f < wave * 2; f++) {
+            if (files[f]) fclose(files[f]);
+            files[f] = NULL;
+        }
+    }
+    if (result == ISON_OK) result = sort_pairs(out);
+    ison_free(files);
+    return result;
+}
+
+/* ==================== Public API ==================== */
+
+ison_error_t ison_block_join_pairs(const ison_block_t *left, const char *left_col,
+                                   const ison_block_t *right, const char *right_col,
+                                   ison_join_t kind, size_t memory_limit,
+                                   ison_join_pairs_t *out) {
+    if (!out) return ISON_ERROR_INVALID;
+    memset(out, 0, sizeof(*out));
+    if (!left || !right || !left_col || !right_col) return ISON_ERROR_INVALID;
+    if (kind != ISON_JOIN_INNER && kind != ISON_JOIN_LEFT && kind != ISON_JOIN_SEMI) {
+        return ISON_ERROR_INVALID;
+    }
+    size_t lpos = ison_field_position(left, left_col);
+    size_t rpos = ison_field_position(right, right_col);
+    if (lpos == ISON_NO_FIELD || rpos == ISON_NO_FIELD) return ISON_ERROR_INVALID;
+    if (memory_limit == 0) memory_limit = JOIN_MEMORY_DEFAULT;
+    
+    /* Sized for every right row, items included, before any of it is allocated */
+    ison_error_t result;
+    size_t bytes = table_bytes(right->row_count);
+    if (bytes <= memory_limit) {
+        join_item_t *items = ison_malloc((right->row_count ? right->row_count : 1) * sizeof(join_item_t));
+        if (!items) return ISON_ERROR_MEMORY;
+        size_t count = 0;
+        for (size_t r = 0; r < right->row_count; r++) {
+            if (row_key(right, r, rpos, &items[count].key)) items[count++].row = r;
+        }
+        result = join_in_memory(left, lpos, items, count, kind, out);
+        ison_free(items);
+    } else {
+        size_t partitions = 2;
+        while (partitions < JOIN_MAX_PARTITIONS && bytes / partitions > memory_limit) partitions *= 2;
+        result = join_spilled(left, lpos, right, rpos, partitions, kind, out);
+    }
+    if (result != ISON_OK) ison_join_pairs_free(out);
+    return result;
+}
+
+void ison_join_pairs_free(ison_join_pairs_t *pairs) {
+    if (!pairs) return;
+    ison_free(pairs->left);
+    ison_free(pairs->right);
+    memset(pairs, 0, sizeof(*pairs));
+}
+
+/* Appends right's columns other than skip, renaming those already taken */
+static bool add_right_fields(ison_block_t *out, const ison_block_t *right, size_t skip) {
+    for (size_t f = 0; f < right->field_count; f++) {
+        if (f == skip) continue;
+        const char *name = right->fields[f].name;
+        size_t before = out->field_count;
+        if (ison_field_position(out, name) == ISON_NO_FIELD) {
+            ison_block_add_field(out, name, right->fields[f].type_hint);
+        } else {
+            size_t len = strlen(right->name) + strlen(name) + 2;
+            char *renamed = ison_malloc(len);
+            if (!renamed) return false;
+            snprintf(renamed, len, "%s_%s", right->name, name);
+            ison_block_add_field(out, renamed, right->fields[f].type_hint);
+            ison_free(renamed);
+        }
+        if (out->field_count == before) return false;
+    }
+    return true;
+}
+
+static ison_row_t *joined_row(const ison_block_t *out, const ison_block_t *left, size_t l,
+                              const ison_block_t *right, size_t r, size_t skip) {
+    ison_row_t *row = ison_row_copy(left->rows[l]);
+    if (!row) return NULL;
+    
+    size_t f = left->field_count;
+    for (size_t rf = 0; rf < right->field_count; rf++) {
+        if (rf == skip) continue;
+        const ison_value_t *v = NULL;
+        if (r != ISON_JOIN_NO_MATCH) v = ison_column_value(right->rows[r], rf, right->fields[rf].name);
+        ison_value_t value = v ? ison_value_copy(v) : ison_null();
+        if (!ison_row_append(row, out->fields[f++].name, &value)) {
+            ison_value_free(&value);
+            ison_row_free(row);
+            return NULL;
+        }
+    }
+    return row;
+}
+
+ison_block_t *ison_block_join(const ison_block_t *left, const char *left_col,
+                              const ison_block_t *right, const char *right_col, ison_join_t kind) {
+    ison_join_pairs_t pairs;
+    if (ison_block_join_pairs(left, left_col, right, right_col, kind, 0, &pairs) != ISON_OK) {
+        return NULL;
+    }
+    
+    if (kind == ISON_JOIN_SEMI) {
+        ison_selection_t matched = { pairs.left, pairs.count, pairs.capacity };
+        ison_block_t *out = ison_block_select(left, &matched);
+        ison_join_pairs_free(&pairs);
+        return out;
+    }
+    
+    ison_block_t *out = ison_block_create(left->kind, left->name);
+    size_t skip = ison_field_position(right, right_col);
+    bool ok = out != NULL;
+    for (size_t f = 0; ok && f < left->field_count; f++) {
+        ison_block_add_field(out, left->fields[f].name, left->fields[f].type_hint);
+        ok = out->field_count == f + 1;
+    }
+    ok = ok && add_right_fields(out, right, skip) && ison_block_reserve_rows(out, pairs.count);
+    
+    for (size_t i = 0; ok && i < pairs.count; i++) {
+        ison_row_t *row = joined_row(out, left, pairs.left[i], right, pairs.right[i], skip);
+        ok = row != NULL;
+        if (row) ison_block_take_row(out, row);
+    }
+    ison_join_pairs_free(&pairs);
+    if (!ok) {
+        ison_block_free(out);
+        return NULL;
+    }
+    return out;
+}
@@ -0,0 +1,498 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__PCLMUL__)
+#include <wmmintrin.h>
+#endif
+
+/*
+ * Two-stage JSON parser.
+ *
+ * Stage 1 classifies the input 64 bytes at a time into bitmasks (quotes,
+ * backslashes, operators, whitespace), resolves escapes and string interiors
+ * with carry-propagating bit tricks, and records the offset of every
+ * structural position. Stage 2 walks those offsets, so it never scans
+ * whitespace or string interiors byte by byte to find the next token.
+ */
+
+typedef struct {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;
+    uint64_t ws;
+} json_masks_t;
+
+#if defined(__SSE2__)
+static uint64_t eq_mask(__m128i v[4], char c) {
+    __m128i needle = _mm_set1_epi8(c);
+    uint64_t m0 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[0], needle));
+    uint64_t m1 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[1], needle));
+    uint64_t m2 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[2], needle));
+    uint64_t m3 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[3], needle));
+    return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+
+static void classify_block(const char *block, json_masks_t *m) {
+    __m128i v[4];
+    for (int i = 0; i < 4; i++) {
+        v[i] = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+    }
+    m->quote = eq_mask(v, '"');
+    m->backslash = eq_mask(v, '\\');
+    m->op = eq_mask(v, '{') | eq_mask(v, '}') | eq_mask(v, '[') |
+            eq_mask(v, ']') | eq_mask(v, ':') | eq_mask(v, ',');
+    m->ws = eq_mask(v, ' ') | eq_mask(v, '\t') | eq_mask(v, '\n') | eq_mask(v, '\r');
+}
+#else
+static void classify_block(const char *block, json_masks_t *m) {
+    m->quote = m->backslash = m->op = m->ws = 0;
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        switch (block[i]) {
+            case '"': m->quote |= bit; break;
+            case '\\': m->backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',':
+                m->op |= bit; break;
+            case ' ': case '\t': case '\n': case '\r':
+                m->ws |= bit; break;
+            default: break;
+        }
+    }
+}
+#endif
+
+/* Bit i of the result is the XOR of bits 0..i of x */
+static uint64_t prefix_xor(uint64_t x) {
+#if defined(__PCLMUL__) && defined(__SSE2__)
+    __m128i all_ones = _mm_set1_epi8((char)0xFF);
+    __m128i r = _mm_clmulepi64_si128(_mm_set_epi64x(0, (long long)x), all_ones, 0);
+    return (uint64_t)_mm_cvtsi128_si64(r);
+#else
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+#endif
+}
+
+/* Characters preceded by an odd-length run of backslashes */
+static uint64_t find_escaped(uint64_t backslash, uint64_t *prev_escaped) {
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    
+    backslash &= ~*prev_escaped;
+    uint64_t follows_escape = (backslash << 1) | *prev_escaped;
+    uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+    uint64_t even_seq = odd_starts + backslash;
+    *prev_escaped = even_seq < odd_starts;
+    uint64_t invert_mask = even_seq << 1;
+    return (even_bits ^ invert_mask) & follows_escape;
+}
+
+static int count_trailing_zeros(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+ison_error_t ison_json_index(ison_json_tape_t *tape, const char *text, size_t len) {
+    if (!tape || !text) return ISON_ERROR_INVALID;
+    if (len > UINT32_MAX) return ISON_ERROR_INVALID;
+    
+    tape->text = text;
+    tape->len = len;
+    tape->count = 0;
+    tape->pos = 0;
+    tape->error = 0;
+    
+    uint64_t prev_escaped = 0;
+    uint64_t prev_in_string = 0;
+    uint64_t prev_scalar = 0;
+    
+    for (size_t base = 0; base < len; base += 64) {
+        const char *block = text + base;
+        char tail[64];
+        if (len - base < 64) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, block, len - base);
+            block = tail;
+        }
+        
+        if (tape->count + 64 > tape->capacity) {
+            size_t new_cap = tape->capacity == 0 ? 256 : tape->capacity * 2;
+            while (new_cap < tape->count + 64) new_cap *= 2;
+            uint32_t *new_index = ison_realloc(tape->index, new_cap * sizeof(uint32_t));
+            if (!new_index) return ISON_ERROR_MEMORY;
+            tape->index = new_index;
+            tape->capacity = new_cap;
+        }
+        
+        json_masks_t m;
+        classify_block(block, &m);
+        
+        uint64_t escaped = find_escaped(m.backslash, &prev_escaped);
+        uint64_t quote = m.quote & ~escaped;
+        uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+        prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+        
+        uint64_t op = m.op & ~in_string;
+        uint64_t scalar = ~(m.op | m.ws | m.quote | in_string);
+        uint64_t scalar_start = scalar & ~((scalar << 1) | prev_scalar);
+        prev_scalar = scalar >> 63;
+        
+        uint64_t structural = op | (quote & in_string) | scalar_start;
+        while (structural) {
+            tape->index[tape->count++] = (uint32_t)(base + count_trailing_zeros(structural));
+            structural &= structural - 1;
+        }
+    }
+    
+    if (prev_in_string) return ISON_ERROR_PARSE;
+    return ISON_OK;
+}
+
+void ison_json_tape_free(ison_json_tape_t *tape) {
+    if (!tape) return;
+    ison_free(tape->index);
+    ison_free(tape->scratch);
+    tape->index = NULL;
+    tape->scratch = NULL;
+    tape->count = tape->capacity = tape->scratch_cap = 0;
+}
+
+char ison_json_peek(const ison_json_tape_t *tape) {
+    if (tape->pos >= tape->count) return '\0';
+    return tape->text[tape->index[tape->pos]];
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int parse_hex4(const char *p, const char *end, uint32_t *out) {
+    if (end - p < 4) return 0;
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        int h = hex_value(p[i]);
+        if (h < 0) return 0;
+        v = (v << 4) | (uint32_t)h;
+    }
+    *out = v;
+    return 1;
+}
+
+static char *encode_utf8(char *dst, uint32_t cp) {
+    if (cp < 0x80) {
+        *dst++ = (char)cp;
+    } else if (cp < 0x800) {
+        *dst++ = (char)(0xC0 | (cp >> 6));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *dst++ = (char)(0xE0 | (cp >> 12));
+        *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *dst++ = (char)(0xF0 | (cp >> 18));
+        *dst++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = (char)(0x80 | (cp & 0x3F));
+    }
+    return dst;
+}
+
+/*
+ * Decodes the string whose opening quote is at the current position into dst,
+ * which must hold string_bound() bytes. Escapes never expand, so a single pass
+ * is enough. Returns the decoded length, or (size_t)-1 on malformed input.
+ */
+static size_t decode_string(ison_json_tape_t *tape, char *dst) {
+    const char *src = tape->text + tape->index[tape->pos] + 1;
+    const char *end = tape->text + tape->len;
+    char *start = dst;
+    
+    while (src < end) {
+        char c = *src;
+        if (c == '"') {
+            tape->pos++;
+            *dst = '\0';
+            return (size_t)(dst - start);
+        }
+        if (c != '\\') {
+            *dst++ = c;
+            src++;
+            continue;
+        }
+        if (++src >= end) break;
+        switch (*src++) {
+            case '"': *dst++ = '"'; break;
+            case '\\': *dst++ = '\\'; break;
+            case '/': *dst++ = '/'; break;
+            case 'b': *dst++ = '\b'; break;
+            case 'f': *dst++ = '\f'; break;
+            case 'n': *dst++ = '\n'; break;
+            case 'r': *dst++ = '\r'; break;
+            case 't': *dst++ = '\t'; break;
+            case 'u': {
+                uint32_t cp;
+                if (!parse_hex4(src, end, &cp)) goto fail;
+                src += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    uint32_t lo;
+                    if (end - src >= 6 && src[0] == '\\' && src[1] == 'u' &&
+                        parse_hex4(src + 2, end, &lo) && lo >= 0xDC00 && lo <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        src += 6;
+                    } else {
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+                dst = encode_utf8(dst, cp);
+                break;
+            }
+            default: goto fail;
+        }
+    }
+fail:
+    tape->error = 1;
+    return (size_t)-1;
+}
+
+/* Upper bound on the decoded size of the string at the current position */
+static size_t string_bound(const ison_json_tape_t *tape) {
+    size_t start = tape->index[tape->pos];
+    size_t next = tape->pos + 1 < tape->count ? tape->index[tape->pos + 1] : tape->len;
+    return next - start;
+}
+
+const char *ison_json_parse_key(ison_json_tape_t *tape) {
+    if (ison_json_peek(tape) != '"') {
+        tape->error = 1;
+        return NULL;
+    }
+    
+    size_t bound = string_bound(tape);
+    if (bound > tape->scratch_cap) {
+        size_t new_cap = tape->scratch_cap == 0 ? 64 : tape->scratch_cap;
+        while (new_cap < bound) new_cap *= 2;
+        char *new_scratch = ison_realloc(tape->scratch, new_cap);
+        if (!new_scratch) {
+            tape->error = 1;
+            return NULL;
+        }
+        tape->scratch = new_scratch;
+        tape->scratch_cap = new_cap;
+    }
+    
+    if (decode_string(tape, tape->scratch) == (size_t)-1) return NULL;
+    if (ison_json_peek(tape) != ':') {
+        tape->error = 1;
+        return NULL;
+    }
+    tape->pos++;
+    return tape->scratch;
+}
+
+static const double pow10_exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/*
+ * Integers that fit in int64 are accumulated directly. Decimals with at most
+ * 15 significant digits and a power of ten within 1e22 are exact in double
+ * arithmetic (one multiply or divide); anything longer goes through strtod.
+ */
+static ison_value_t parse_number(ison_json_tape_t *tape, const char *p) {
+    const char *start = p;
+    int negative = 0;
+    if (*p == '-') {
+        negative = 1;
+        p++;
+    }
+    if (!is_digit(*p)) {
+        tape->error = 1;
+        return ison_null();
+    }
+    
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exp10 = 0;
+    int is_integer = 1;
+    
+    while (is_digit(*p)) {
+        if (digits < 19) mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        else exp10++;
+        digits++;
+        p++;
+    }
+    if (*p == '.') {
+        is_integer = 0;
+        p++;
+        while (is_digit(*p)) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                exp10--;
+            }
+            digits++;
+            p++;
+        }
+    }
+    if (*p == 'e' || *p == 'E') {
+        is_integer = 0;
+        p++;
+        int exp_negative = 0;
+        if (*p == '+' || *p == '-') exp_negative = *p++ == '-';
+        int e = 0;
+        while (is_digit(*p)) {
+            if (e < 100000) e = e * 10 + (*p - '0');
+            p++;
+        }
+        exp10 += exp_negative ? -e : e;
+    }
+    
+    if (is_integer && digits <= 19) {
+        if (!negative && mantissa <= (uint64_t)INT64_MAX) return ison_int((int64_t)mantissa);
+        if (negative && mantissa <= (uint64_t)INT64_MAX + 1) {
+            return ison_int((int64_t)(0 - mantissa));
+        }
+    }
+    
+    double d;
+    if (digits <= 15 && exp10 >= -22 && exp10 <= 22) {
+        d = (double)mantissa;
+        d = exp10 < 0 ? d / pow10_exact[-exp10] : d * pow10_exact[exp10];
+        if (negative) d = -d;
+    } else {
+        d = strtod(start, NULL);
+    }
+    
+    if (d >= -9223372036854775808.0 && d < 9223372036854775808.0 && d == (double)(int64_t)d) {
+        return ison_int((int64_t)d);
+    }
+    return ison_float(d);
+}
+
+void ison_json_skip(ison_json_tape_t *tape) {
+    char c = ison_json_peek(tape);
+    if (c != '{' && c != '[') {
+        if (c == '\0' || c == '}' || c == ']' || c == ',' || c == ':') tape->error = 1;
+        else tape->pos++;
+        return;
+    }
+    
+    int depth = 0;
+    while (tape->pos < tape->count) {
+        c = tape->text[tape->index[tape->pos++]];
+        if (c == '{' || c == '[') depth++;
+        else if ((c == '}' || c == ']') && --depth == 0) return;
+    }
+    tape->error = 1;
+}
+
+ison_value_t ison_json_parse_value(ison_json_tape_t *tape) {
+    char c = ison_json_peek(tape);
+    
+    if (c == '"') {
+        ison_value_t v;
+        v.type = ISON_TYPE_STRING;
+        size_t bound = string_bound(tape);
+        if (bound <= sizeof(v.data.small_str)) {
+            v.flags = ISON_VALUE_INLINE;
+            if (decode_string(tape, v.data.small_str) == (size_t)-1) return ison_null();
+            return v;
+        }
+        
+        char *s = ison_malloc(bound);
+        if (!s) {
+            tape->error = 1;
+            return ison_null();
+        }
+        size_t len = decode_string(tape, s);
+        if (len == (size_t)-1) {
+            ison_free(s);
+            return ison_null();
+        }
+        if (len <= ISON_SMALL_STRING_MAX) {
+            /* Escapes or whitespace before the next token inflated the bound */
+            v.flags = ISON_VALUE_INLINE;
+            memcpy(v.data.small_str, s, len + 1);
+            ison_free(s);
+            return v;
+        }
+        v.flags = 0;
+        v.data.string_val = s;
+        return v;
+    }
+    if (c == '{' || c == '[') {
+        ison_json_skip(tape);
+        return ison_null();
+    }
+    if (c == '\0' || c == '}' || c == ']' || c == ',' || c == ':') {
+        tape->error = 1;
+        return ison_null();
+    }
+    
+    const char *p = tape->text + tape->index[tape->pos++];
+    if (strncmp(p, "true", 4) == 0) return ison_bool(1);
+    if (strncmp(p, "false", 5) == 0) return ison_bool(0);
+    if (strncmp(p, "null", 4) == 0) return ison_null();
+    return parse_number(tape, p);
+}
+
+ison_row_t *ison_json_parse_object(ison_json_tape_t *tape) {
+    if (ison_json_peek(tape) != '{') {
+        tape->error = 1;
+        return NULL;
+    }
+    tape->pos++;
+    
+    ison_row_t *row = ison_row_create();
+    if (!row) {
+        tape->error = 1;
+        return NULL;
+    }
+    
+    if (ison_json_peek(tape) == '}') {
+        tape->pos++;
+        return row;
+    }
+    
+    while (!tape->error) {
+        const char *key = ison_json_parse_key(tape);
+        if (!key) break;
+        
+        ison_value_t val = ison_json_parse_value(tape);
+        ison_row_set(row, key, &val);
+        
+        char c = ison_json_peek(tape);
+        tape->pos++;
+        if (c == '}') return row;
+        if (c != ',') tape->error = 1;
+    }
+    
+    ison_row_free(row);
+    return NULL;
+}
@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+static void adjust(size_t *counter, size_t bytes, int sign) {
+    if (sign > 0) {
+        *counter += bytes;
+    } else {
+        *counter -= bytes;
+    }
+}
+
+void ison_memory_account(ison_memory_stats_t *stats, size_t *bucket, size_t bytes, int sign) {
+    adjust(bucket, bytes, sign);
+    adjust(&stats->allocations, 1, sign);
+}
+
+static size_t component_bytes(const char *str) {
+    return str ? strlen(str) + 1 : 0;
+}
+
+void ison_memory_account_string(ison_memory_stats_t *stats, size_t *bucket, const char *str, int sign) {
+    if (str) ison_memory_account(stats, bucket, strlen(str) + 1, sign);
+}
+
+void ison_memory_account_resize(ison_memory_stats_t *stats, size_t *bucket, size_t old_bytes, size_t new_bytes) {
+    if (old_bytes == 0) {
+        ison_memory_account(stats, bucket, new_bytes, 1);
+    } else {
+        *bucket += new_bytes - old_bytes;
+    }
+}
+
+static void account_value(ison_memory_stats_t *stats, const ison_value_t *value, int sign) {
+    size_t *bucket;
+    size_t bytes;
+    
+    if (value->type == ISON_TYPE_STRING && !(value->flags & ISON_VALUE_INLINE) && value->data.string_val) {
+        bucket = &stats->strings;
+        bytes = strlen(value->data.string_val) + 1;
+    } else if (value->type == ISON_TYPE_REFERENCE && value->data.ref_val.id) {
+        const ison_reference_t *ref = &value->data.ref_val;
+        bucket = &stats->references;
+        bytes = component_bytes(ref->id) + component_bytes(ref->ns) + component_bytes(ref->relationship);
+    } else {
+        return;
+    }
+    
+    if (value->flags & ISON_VALUE_BORROWED) {
+        adjust(bucket, bytes, sign);
+        adjust(&stats->borrowed, bytes, sign);
+    } else {
+        ison_memory_account(stats, bucket, bytes, sign);
+    }
+}
+
+void ison_memory_account_row(ison_memory_stats_t *stats, const ison_row_t *row, int sign, bool spare) {
+    if (!stats || !row) return;
+    
+    ison_memory_account(stats, spare ? &stats->spare : &stats->rows, sizeof(ison_row_t), sign);
+    for (const ison_row_entry_t *entry = row->head; entry; entry = entry->next) {
+        ison_memory_account(stats, spare ? &stats->spare : &stats->entries, sizeof(ison_row_entry_t), sign);
+        ison_memory_account_string(stats, spare ? &stats->spare : &stats->keys, entry->key, sign);
+        if (!spare) account_value(stats, &entry->value, sign);
+    }
+}
+
+static void add_stats(ison_memory_stats_t *out, const ison_memory_stats_t *in) {
+    out->blocks += in->blocks;
+    out->fields += in->fields;
+    out->rows += in->rows;
+    out->entries += in->entries;
+    out->keys += in->keys;
+    out->strings += in->strings;
+    out->references += in->references;
+    out->borrowed += in->borrowed;
+    out->spare += in->spare;
+    out->document += in->document;
+    out->arena += in->arena;
+    out->allocations += in->allocations;
+}
+
+void ison_memory_finish_total(ison_memory_stats_t *stats) {
+    stats->total = stats->blocks + stats->fields + stats->rows + stats->entries + stats->keys +
+                   stats->strings + stats->references + stats->spare + stats->document +
+                   stats->arena - stats->borrowed;
+}
+
+void ison_block_memory_stats(const ison_block_t *block, ison_memory_stats_t *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!block) return;
+    
+    add_stats(out, &block->memory);
+    ison_memory_finish_total(out);
+}
+
+void ison_document_memory_stats(const ison_document_t *doc, ison_memory_stats_t *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!doc) return;
+    
+    for (size_t i = 0; i < doc->block_count; i++) {
+        add_stats(out, &doc->blocks[i]->memory);
+    }
+    
+    ison_memory_account(out, &out->document, sizeof(ison_document_t), 1);
+    if (doc->block_capacity) {
+        ison_memory_account(out, &out->document, doc->block_capacity * sizeof(ison_block_t *), 1);
+        ison_memory_account(out, &out->document, doc->block_capacity * sizeof(char *), 1);
+    }
+    if (doc->index_capacity) {
+        ison_memory_account(out, &out->document, doc->index_capacity * sizeof(size_t), 1);
+    }
+    
+    const ison_document_pool_t *pool = doc->pool;
+    if (pool) {
+        for (size_t i = 0; i < pool->spare_capacity; i++) {
+            if (pool->spares[i].block) add_stats(out, &pool->spares[i].block->memory);
+        }
+        
+        ison_memory_account(out, &out->document, sizeof(ison_document_pool_t), 1);
+        size_t buffers[] = {
+            pool->spare_capacity * sizeof(ison_spare_slot_t),
+            pool->text_capacity,
+            pool->line_capacity * sizeof(char *),
+            pool->token_text_capacity,
+            pool->token_capacity * sizeof(char *)
+        };
+        for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+            if (buffers[i]) ison_memory_account(out, &out->document, buffers[i], 1);
+        }
+        ison_row_builder_account(pool->builder, out, &out->document);
+        
+        size_t chunks = 0;
+        out->arena = ison_arena_footprint(&pool->arena, &chunks);
+        out->allocations += chunks;
+    }
+    
+    ison_memory_finish_total(out);
+}
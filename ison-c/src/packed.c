@@ -0,0 +1,403 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+#define NO_STRING ((uint64_t)-1)
+
+typedef struct {
+    uint64_t id;
+    uint64_t ns;
+    uint64_t relationship;
+} packed_ref_t;
+
+typedef struct {
+    char *name;
+    uint64_t kind;
+    size_t rows;
+    size_t fields;
+    uint64_t *field_info;          /* name and type hint offsets, two per field */
+    ison_packed_value_t *cells;
+    ison_packed_value_t *summary;  /* one cell per field, or NULL */
+} packed_block_t;
+
+struct ison_packed {
+    packed_block_t *blocks;
+    size_t block_count;
+    char *arena;
+    size_t arena_len;
+    size_t arena_cap;
+    packed_ref_t *refs;
+    size_t ref_count;
+    size_t ref_cap;
+    uint32_t *ref_slots;      /* open addressing over refs, index + 1 */
+    size_t ref_slot_cap;
+    int failed;
+};
+
+/* Appends len bytes plus a terminator, returning the offset */
+static uint64_t arena_push(ison_packed_t *p, const char *str, size_t len) {
+    if (p->arena_len + len + 1 > p->arena_cap) {
+        size_t new_cap = p->arena_cap == 0 ? 4096 : p->arena_cap;
+        while (new_cap < p->arena_len + len + 1) new_cap *= 2;
+        char *new_arena = ison_realloc(p->arena, new_cap);
+        if (!new_arena) {
+            p->failed = 1;
+            return NO_STRING;
+        }
+        p->arena = new_arena;
+        p->arena_cap = new_cap;
+    }
+    uint64_t offset = p->arena_len;
+    memcpy(p->arena + offset, str, len);
+    p->arena[offset + len] = '\0';
+    p->arena_len += len + 1;
+    return offset;
+}
+
+static uint64_t arena_push_str(ison_packed_t *p, const char *str) {
+    return str ? arena_push(p, str, strlen(str)) : NO_STRING;
+}
+
+static const char *arena_str(const ison_packed_t *p, uint64_t offset) {
+    return offset == NO_STRING ? NULL : p->arena + offset;
+}
+
+static int same_str(const ison_packed_t *p, uint64_t offset, const char *str) {
+    if (offset == NO_STRING || !str) return offset == NO_STRING && !str;
+    return strcmp(p->arena + offset, str) == 0;
+}
+
+static uint64_t ref_hash(const ison_reference_t *ref) {
+    uint64_t h = ref->id ? ison_hash_string(ref->id) : 0;
+    h = h * 31 + (ref->ns ? ison_hash_string(ref->ns) : 0);
+    h = h * 31 + (ref->relationship ? ison_hash_string(ref->relationship) : 0);
+    return h;
+}
+
+static int ref_slots_grow(ison_packed_t *p) {
+    size_t new_cap = p->ref_slot_cap == 0 ? 64 : p->ref_slot_cap * 2;
+    uint32_t *slots = ison_calloc(new_cap, sizeof(uint32_t));
+    if (!slots) return 0;
+    
+    for (size_t i = 0; i < p->ref_count; i++) {
+        const packed_ref_t *r = &p->refs[i];
+        ison_reference_t view = {
+            (char *)arena_str(p, r->id), (char *)arena_str(p, r->ns), (char *)arena_str(p, r->relationship)
+        };
+        size_t slot = (size_t)ref_hash(&view) & (new_cap - 1);
+        while (slots[slot]) slot = (slot + 1) & (new_cap - 1);
+        slots[slot] = (uint32_t)(i + 1);
+    }
+    ison_free(p->ref_slots);
+    p->ref_slots = slots;
+    p->ref_slot_cap = new_cap;
+    return 1;
+}
+
+/* Index of `ref` in the reference table, adding it on first sight */
+static uint64_t intern_ref(ison_packed_t *p, const ison_reference_t *ref) {
+    if ((p->ref_count + 1) * 2 > p->ref_slot_cap && !ref_slots_grow(p)) {
+        p->failed = 1;
+        return 0;
+    }
+    
+    size_t mask = p->ref_slot_cap - 1;
+    size_t slot = (size_t)ref_hash(ref) & mask;
+    while (p->ref_slots[slot]) {
+        const packed_ref_t *r = &p->refs[p->ref_slots[slot] - 1];
+        if (same_str(p, r->id, ref->id) && same_str(p, r->ns, ref->ns) &&
+            same_str(p, r->relationship, ref->relationship)) {
+            return p->ref_slots[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+    
+    if (p->ref_count >= p->ref_cap) {
+        size_t new_cap = p->ref_cap == 0 ? 32 : p->ref_cap * 2;
+        packed_ref_t *refs = ison_realloc(p->refs, new_cap * sizeof(packed_ref_t));
+        if (!refs) {
+            p->failed = 1;
+            return 0;
+        }
+        p->refs = refs;
+        p->ref_cap = new_cap;
+    }
+    
+    packed_ref_t *r = &p->refs[p->ref_count];
+    r->id = arena_push_str(p, ref->id);
+    r->ns = arena_push_str(p, ref->ns);
+    r->relationship = arena_push_str(p, ref->relationship);
+    p->ref_slots[slot] = (uint32_t)(p->ref_count + 1);
+    return p->ref_count++;
+}
+
+static void pack_value(ison_packed_t *p, const ison_value_t *value, ison_packed_value_t *cell) {
+    memset(cell, 0, sizeof(*cell));
+    cell->type = ISON_TYPE_NULL;
+    if (!value) return;
+    
+    switch (value->type) {
+        case ISON_TYPE_BOOL:
+            cell->type = ISON_TYPE_BOOL;
+            cell->payload.bool_val = value->data.bool_val;
+            break;
+        case ISON_TYPE_INT:
+            cell->type = ISON_TYPE_INT;
+            cell->payload.int_val = value->data.int_val;
+            break;
+        case ISON_TYPE_FLOAT:
+            cell->type = ISON_TYPE_FLOAT;
+            cell->payload.float_val = value->data.float_val;
+            break;
+        case ISON_TYPE_STRING: {
+            const char *str = ison_value_string(value);
+            if (!str) break;
+            size_t len = strlen(str);
+            if (len > UINT32_MAX) break;
+            cell->type = ISON_TYPE_STRING;
+            cell->len = (uint32_t)len;
+            if (len <= sizeof(cell->payload.bytes)) {
+                cell->flags = ISON_VALUE_INLINE;
+                memcpy(cell->payload.bytes, str, len);
+            } else {
+                cell->payload.offset = arena_push(p, str, len);
+            }
+            break;
+        }
+        case ISON_TYPE_REFERENCE:
+            cell->type = ISON_TYPE_REFERENCE;
+            cell->payload.offset = intern_ref(p, &value->data.ref_val);
+            break;
+        default:
+            break;
+    }
+}
+
+static void pack_row(ison_packed_t *p, const ison_block_t *block, const ison_row_t *row,
+                     ison_packed_value_t *cells) {
+    for (size_t f = 0; f < block->field_count; f++) {
+        pack_value(p, ison_column_value(row, f, block->fields[f].name), &cells[f]);
+    }
+}
+
+static int pack_block(ison_packed_t *p, const ison_block_t *block, packed_block_t *out) {
+    out->name = ison_malloc(strlen(block->name) + 1);
+    if (!out->name) return 0;
+    strcpy(out->name, block->name);
+    out->kind = arena_push_str(p, block->kind);
+    out->rows = block->row_count;
+    out->fields = block->field_count;
+    if (out->fields == 0) return !p->failed;
+    
+    out->field_info = ison_malloc(out->fields * 2 * sizeof(uint64_t));
+    if (!out->field_info) return 0;
+    for (size_t f = 0; f < out->fields; f++) {
+        out->field_info[2 * f] = arena_push_str(p, block->fields[f].name);
+        out->field_info[2 * f + 1] = arena_push_str(p, block->fields[f].type_hint);
+    }
+    if (block->summary_row) {
+        out->summary = ison_malloc(out->fields * sizeof(ison_packed_value_t));
+        if (!out->summary) return 0;
+        pack_row(p, block, block->summary_row, out->summary);
+    }
+    if (out->rows == 0) return !p->failed;
+    
+    out->cells = ison_malloc(out->rows * out->fields * sizeof(ison_packed_value_t));
+    if (!out->cells) return 0;
+    for (size_t r = 0; r < out->rows; r++) {
+        pack_row(p, block, block->rows[r], out->cells + r * out->fields);
+    }
+    return !p->failed;
+}
+
+ison_packed_t *ison_document_pack(const ison_document_t *doc) {
+    if (!doc) return NULL;
+    
+    ison_packed_t *p = ison_calloc(1, sizeof(ison_packed_t));
+    if (!p) return NULL;
+    if (doc->block_count) {
+        p->blocks = ison_calloc(doc->block_count, sizeof(packed_block_t));
+        if (!p->blocks) {
+            ison_free(p);
+            return NULL;
+        }
+    }
+    
+    for (size_t i = 0; i < doc->block_count; i++) {
+        p->block_count++;
+        if (!pack_block(p, doc->blocks[i], &p->blocks[i])) {
+            ison_packed_free(p);
+            return NULL;
+        }
+    }
+    
+    ison_free(p->ref_slots);
+    p->ref_slots = NULL;
+    p->ref_slot_cap = 0;
+    return p;
+}
+
+void ison_packed_free(ison_packed_t *packed) {
+    if (!packed) return;
+    for (size_t i = 0; i < packed->block_count; i++) {
+        ison_free(packed->blocks[i].name);
+        ison_free(packed->blocks[i].field_info);
+        ison_free(packed->blocks[i].cells);
+        ison_free(packed->blocks[i].summary);
+    }
+    ison_free(packed->blocks);
+    ison_free(packed->arena);
+    ison_free(packed->refs);
+    ison_free(packed->ref_slots);
+    ison_free(packed);
+}
+
+static const packed_block_t *find_block(const ison_packed_t *packed, const char *name) {
+    for (size_t i = 0; packed && name && i < packed->block_count; i++) {
+        if (strcmp(packed->blocks[i].name, name) == 0) return &packed->blocks[i];
+    }
+    return NULL;
+}
+
+const ison_packed_value_t *ison_packed_cells(const ison_packed_t *packed, const char *name,
+                                             size_t *rows, size_t *fields) {
+    if (rows) *rows = 0;
+    if (fields) *fields = 0;
+    const packed_block_t *b = find_block(packed, name);
+    if (!b) return NULL;
+    if (rows) *rows = b->rows;
+    if (fields) *fields = b->fields;
+    return b->cells;
+}
+
+bool ison_packed_decode(const ison_packed_t *packed, const ison_packed_value_t *cell,
+                        ison_value_t *out) {
+    if (!packed || !cell || !out) return false;
+    
+    switch (cell->type) {
+        case ISON_TYPE_NULL:
+            *out = ison_null();
+            return true;
+        case ISON_TYPE_BOOL:
+            *out = ison_bool(cell->payload.bool_val);
+            return true;
+        case ISON_TYPE_INT:
+            *out = ison_int(cell->payload.int_val);
+            return true;
+        case ISON_TYPE_FLOAT:
+            *out = ison_float(cell->payload.float_val);
+            return true;
+        case ISON_TYPE_STRING:
+            out->type = ISON_TYPE_STRING;
+            if (cell->flags & ISON_VALUE_INLINE) {
+                out->flags = ISON_VALUE_INLINE;
+                memcpy(out->data.small_str, cell->payload.bytes, cell->len);
+                out->data.small_str[cell->len] = '\0';
+            } else {
+                out->flags = ISON_VALUE_BORROWED;
+                out->data.string_val = packed->arena + cell->payload.offset;
+            }
+            return true;
+        case ISON_TYPE_REFERENCE: {
+            if (cell->payload.offset >= packed->ref_count) return false;
+            const packed_ref_t *r = &packed->refs[cell->payload.offset];
+            out->type = ISON_TYPE_REFERENCE;
+            out->flags = ISON_VALUE_BORROWED;
+            out->data.ref_val.id = (char *)arena_str(packed, r->id);
+            out->data.ref_val.ns = (char *)arena_str(packed, r->ns);
+            out->data.ref_val.relationship = (char *)arena_str(packed, r->relationship);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+size_t ison_packed_reference_count(const ison_packed_t *packed) {
+    return packed ? packed->ref_count : 0;
+}
+
+/* Row of owned copies of the decoded cells, keyed by block's fields */
+static ison_row_t *unpack_row(const ison_packed_t *packed, const ison_block_t *block,
+                              const ison_packed_value_t *cells) {
+    ison_row_t *row = ison_row_create();
+    for (size_t f = 0; row && f < block->field_count; f++) {
+        ison_value_t view;
+        if (!ison_packed_decode(packed, &cells[f], &view)) {
+            ison_row_free(row);
+            return NULL;
+        }
+        ison_value_t value = ison_value_copy(&view);
+        if (!ison_row_append(row, block->fields[f].name, &value)) {
+            ison_value_free(&value);
+            ison_row_free(row);
+            return NULL;
+        }
+    }
+    return row;
+}
+
+static ison_block_t *unpack_block(const ison_packed_t *packed, const packed_block_t *b) {
+    ison_block_t *block = ison_block_create(arena_str(packed, b->kind), b->name);
+    if (!block) return NULL;
+    for (size_t f = 0; f < b->fields; f++) {
+        ison_block_add_field(block, arena_str(packed, b->field_info[2 * f]),
+                             arena_str(packed, b->field_info[2 * f + 1]));
+    }
+    bool ok = block->field_count == b->fields && ison_block_reserve_rows(block, b->rows);
+    for (size_t r = 0; ok && r < b->rows; r++) {
+        ison_row_t *row = unpack_row(packed, block, b->cells + r * b->fields);
+        ok = row && ison_block_take_row(block, row);
+    }
+    if (ok && b->summary) {
+        ison_row_t *row = unpack_row(packed, block, b->summary);
+        if (row) ison_block_take_summary(block, row);
+        ok = row != NULL;
+    }
+    if (!ok) {
+        ison_block_free(block);
+        return NULL;
+    }
+    return block;
+}
+
+ison_block_t *ison_packed_block(const ison_packed_t *packed, const char *name) {
+    const packed_block_t *b = find_block(packed, name);
+    return b ? unpack_block(packed, b) : NULL;
+}
+
+ison_document_t *ison_packed_unpack(const ison_packed_t *packed) {
+    if (!packed) return NULL;
+    ison_document_t *doc = ison_document_create();
+    for (size_t i = 0; doc && i < packed->block_count; i++) {
+        ison_block_t *block = unpack_block(packed, &packed->blocks[i]);
+        if (block) ison_document_add_block(doc, block);
+        if (!block || ison_document_get(doc, block->name) != block) {
+            ison_document_free(doc);
+            return NULL;
+        }
+    }
+    return doc;
+}
+
+void ison_packed_memory_stats(const ison_packed_t *packed, ison_memory_stats_t *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!packed) return;
+    
+    ison_memory_account(out, &out->blocks, sizeof(ison_packed_t), 1);
+    if (packed->block_count) {
+        ison_memory_account(out, &out->blocks, packed->block_count * sizeof(packed_block_t), 1);
+    }
+    for (size_t i = 0; i < packed->block_count; i++) {
+        const packed_block_t *b = &packed->blocks[i];
+        ison_memory_account_string(out, &out->blocks, b->name, 1);
+        if (b->field_info) ison_memory_account(out, &out->fields, b->fields * 2 * sizeof(uint64_t), 1);
+        if (b->cells) ison_memory_account(out, &out->entries, b->rows * b->fields * sizeof(ison_packed_value_t), 1);
+        if (b->summary) ison_memory_account(out, &out->entries, b->fields * sizeof(ison_packed_value_t), 1);
+    }
+    if (packed->arena_cap) ison_memory_account(out, &out->strings, packed->arena_cap, 1);
+    if (packed->ref_cap) ison_memory_account(out, &out->references, packed->ref_cap * sizeof(packed_ref_t), 1);
+    ison_memory_finish_total(out);
+}
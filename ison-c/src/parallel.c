@@ -0,0 +1,78 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+#ifndef ISON_NO_THREADS
+#include <pthread.h>
+#endif
+
+#define ISON_MAX_THREADS 64
+
+size_t ison_thread_count(void) {
+#ifdef ISON_NO_THREADS
+    return 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) return 1;
+    if (n > ISON_MAX_THREADS) return ISON_MAX_THREADS;
+    return (size_t)n;
+#endif
+}
+
+#ifndef ISON_NO_THREADS
+typedef struct {
+    size_t begin;
+    size_t end;
+    ison_task_fn fn;
+    void *ctx;
+} task_range_t;
+
+static void *run_range(void *arg) {
+    task_range_t *range = arg;
+    for (size_t i = range->begin; i < range->end; i++) {
+        range->fn(i, range->ctx);
+    }
+    return NULL;
+}
+#endif
+
+void ison_parallel_for(size_t count, ison_task_fn fn, void *ctx) {
+    size_t threads = ison_thread_count();
+    if (threads > count) threads = count;
+
+#ifndef ISON_NO_THREADS
+    if (threads > 1) {
+        pthread_t tids[ISON_MAX_THREADS];
+        task_range_t ranges[ISON_MAX_THREADS];
+        size_t started = 0;
+        
+        for (size_t t = 0; t < threads; t++) {
+            ranges[t].begin = count * t / threads;
+            ranges[t].end = count * (t + 1) / threads;
+            ranges[t].fn = fn;
+            ranges[t].ctx = ctx;
+        }
+        for (size_t t = 1; t < threads; t++) {
+            if (pthread_create(&tids[t], NULL, run_range, &ranges[t]) != 0) break;
+            started = t;
+        }
+        
+        run_range(&ranges[0]);
+        for (size_t t = 1; t <= started; t++) {
+            pthread_join(tids[t], NULL);
+        }
+        /* Whatever could not get a thread runs here */
+        for (size_t t = started + 1; t < threads; t++) {
+            run_range(&ranges[t]);
+        }
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < count; i++) {
+        fn(i, ctx);
+    }
+}
@@ -3,20 +3,30 @@
 #include <string.h>
 #include <stdio.h>
 #include "ison.h"
+#include "ison_internal.h"
 
+/*
+ * Lines, tokens and the row builder live in the document pool, and long
+ * strings and references in its arena, so a document reused through
+ * ison_parse_into stops allocating once the buffers have grown to fit.
+ */
 typedef struct {
-    const char *text;
+    ison_document_t *doc;
+    ison_document_pool_t *pool;
     char **lines;
     size_t line_count;
     size_t pos;
+    bool borrow;    /* long strings and references go in the document arena */
 } parser_t;
 
-static char *strdup_safe(const char *str) {
-    if (!str) return NULL;
-    size_t len = strlen(str);
-    char *copy = malloc(len + 1);
-    if (copy) memcpy(copy, str, len + 1);
-    return copy;
+/* Grows buf to hold need elements of elem bytes; NULL (buf untouched) on failure */
+static void *reserve(parser_t *p, void *buf, size_t *cap, size_t need, size_t elem) {
+    if (need <= *cap) return buf;
+    size_t new_cap = *cap ? *cap : 16;
+    while (new_cap < need) new_cap *= 2;
+    void *grown = ison_allocator_realloc(&p->doc->allocator, buf, new_cap * elem);
+    if (grown) *cap = new_cap;
+    return grown;
 }
 
 static void trim_right(char *str) {
@@ -27,69 +37,67 @@ static void trim_right(char *str) {
     }
 }
 
-static char *trim(const char *str) {
-    if (!str) return strdup_safe("");
+/* Trims in place; lines belong to the parser's private copy of the input */
+static char *trim(char *str) {
     while (*str && isspace((unsigned char)*str)) str++;
-    if (!*str) return strdup_safe("");
-    
-    const char *end = str + strlen(str) - 1;
-    while (end > str && isspace((unsigned char)*end)) end--;
-    
-    size_t len = end - str + 1;
-    char *result = malloc(len + 1);
-    if (result) {
-        memcpy(result, str, len);
-        result[len] = '\0';
-    }
-    return result;
+    size_t len = strlen(str);
+    while (len > 0 && isspace((unsigned char)str[len - 1])) str[--len] = '\0';
+    return str;
 }
 
-static char **split_lines(const char *text, size_t *count) {
-    size_t cap = 16;
-    char **lines = malloc(cap * sizeof(char *));
-    *count = 0;
-    
-    const char *p = text;
-    while (*p) {
-        const char *end = p;
+static bool split_lines(parser_t *p, const char *text) {
+    ison_document_pool_t *pool = p->pool;
+    size_t len = strlen(text);
+    char *copy = reserve(p, pool->text, &pool->text_capacity, len + 1, 1);
+    if (!copy) return false;
+    pool->text = copy;
+    memcpy(copy, text, len + 1);
+    
+    p->line_count = 0;
+    char *line = copy;
+    while (*line) {
+        char *end = line;
         while (*end && *end != '\n') end++;
+        int more = *end == '\n';
+        *end = '\0';
+        trim_right(line);
         
-        size_t len = end - p;
-        char *line = malloc(len + 1);
-        if (line) {
-            memcpy(line, p, len);
-            line[len] = '\0';
-            trim_right(line);
-        }
-        
-        if (*count >= cap) {
-            cap *= 2;
-            lines = realloc(lines, cap * sizeof(char *));
-        }
-        lines[(*count)++] = line;
+        char **lines = reserve(p, pool->lines, &pool->line_capacity, p->line_count + 1, sizeof(char *));
+        if (!lines) return false;
+        pool->lines = lines;
+        lines[p->line_count++] = line;
         
-        if (*end == '\n') end++;
-        p = end;
+        line = more ? end + 1 : end;
     }
-    
-    return lines;
+    p->lines = pool->lines;
+    p->pos = 0;
+    return true;
 }
 
-static int is_valid_kind(const char *kind) {
-    return strcmp(kind, "table") == 0 ||
-           strcmp(kind, "object") == 0 ||
-           strcmp(kind, "meta") == 0;
+static int is_valid_kind(const char *kind, size_t len) {
+    return (len == 5 && memcmp(kind, "table", 5) == 0) ||
+           (len == 6 && memcmp(kind, "object", 6) == 0) ||
+           (len == 4 && memcmp(kind, "meta", 4) == 0);
 }
 
-static char **tokenize(const char *line, size_t *count) {
-    size_t cap = 16;
-    char **tokens = malloc(cap * sizeof(char *));
+/*
+ * Tokens are valid until the next call; each is NUL-terminated in
+ * pool->token_text and preceded by a byte that is 1 when the token was
+ * quoted (see token_quoted).
+ */
+static char **tokenize(parser_t *p, const char *line, size_t *count) {
+    ison_document_pool_t *pool = p->pool;
     *count = 0;
     
     size_t len = strlen(line);
-    char *current = malloc(len + 1);
+    char *text = reserve(p, pool->token_text, &pool->token_text_capacity, 2 * len + 3, 1);
+    if (!text) return pool->tokens;
+    pool->token_text = text;
+    
+    char *current = text + 1;
     size_t cur_len = 0;
     int in_quotes = 0;
+    int quoted = 0;
     int escaped = 0;
     
     for (size_t i = 0; i <= len; i++) {
@@ -114,18 +122,21 @@ static char **tokenize(const char *line, size_t *count) {
         
         if (ch == '"') {
             in_quotes = !in_quotes;
+            quoted = 1;
             continue;
         }
         
         if (!in_quotes && (ch == ' ' || ch == '\t' || ch == '\0')) {
-            if (cur_len > 0) {
+            if (cur_len > 0 || quoted) {
+                char **tokens = reserve(p, pool->tokens, &pool->token_capacity, *count + 1, sizeof(char *));
+                if (!tokens) return pool->tokens;
+                pool->tokens = tokens;
+                current[-1] = (char)quoted;
                 current[cur_len] = '\0';
-                if (*count >= cap) {
-                    cap *= 2;
-                    tokens = realloc(tokens, cap * sizeof(char *));
-                }
-                tokens[(*count)++] = strdup_safe(current);
+                tokens[(*count)++] = current;
+                current += cur_len + 2;
                 cur_len = 0;
+                quoted = 0;
             }
             continue;
         }
@@ -133,60 +144,98 @@ static char **tokenize(const char *line, size_t *count) {
         current[cur_len++] = ch;
     }
     
-    free(current);
-    return tokens;
+    return pool->tokens;
 }
 
-static void parse_field_def(const char *field, char **name, char **type_hint) {
+/* True when any part of a token from tokenize was written in quotes */
+static bool token_quoted(const char *token) {
+    return token[-1] != 0;
+}
+
+/* Splits name:type without copying; the type hint is "" when absent */
+static size_t parse_field_def(const char *field, const char **type_hint) {
     const char *colon = strchr(field, ':');
     if (colon && colon != field) {
-        size_t name_len = colon - field;
-        *name = malloc(name_len + 1);
-        memcpy(*name, field, name_len);
-        (*name)[name_len] = '\0';
-        *type_hint = strdup_safe(colon + 1);
-    } else {
-        *name = strdup_safe(field);
-        *type_hint = strdup_safe("");
+        *type_hint = colon + 1;
+        return (size_t)(colon - field);
+    }
+    *type_hint = "";
+    return strlen(field);
+}
+
+/* Installs the field tokens as block's schema unless a recycled block already has it */
+static void set_fields(ison_block_t *block, char **tokens, size_t count) {
+    bool same = block->field_count == count;
+    for (size_t i = 0; same && i < count; i++) {
+        const char *type_hint;
+        size_t name_len = parse_field_def(tokens[i], &type_hint);
+        const ison_field_info_t *field = &block->fields[i];
+        same = strncmp(field->name, tokens[i], name_len) == 0 && field->name[name_len] == '\0' &&
+               strcmp(field->type_hint, type_hint) == 0;
+    }
+    if (same) return;
+    
+    ison_block_clear_fields(block);
+    for (size_t i = 0; i < count; i++) {
+        const char *type_hint;
+        size_t name_len = parse_field_def(tokens[i], &type_hint);
+        tokens[i][name_len] = '\0';
+        ison_block_add_field(block, tokens[i], type_hint);
     }
 }
 
-static int is_all_upper(const char *str) {
-    if (!str || !*str) return 0;
-    for (const char *p = str; *p; p++) {
-        if (*p != '_' && (*p < 'A' || *p > 'Z')) return 0;
+static int is_all_upper(const char *str, size_t len) {
+    if (!str || len == 0) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] != '_' && (str[i] < 'A' || str[i] > 'Z')) return 0;
     }
     return 1;
 }
 
-static ison_reference_t parse_reference(const char *token) {
-    ison_reference_t ref = {NULL, NULL, NULL};
-    if (!token || *token != ':') return ref;
+/* Builds the reference in one arena slice straight from the token */
+static ison_value_t parse_reference(parser_t *p, const char *token) {
+    ison_value_t v = ison_null();
+    v.type = ISON_TYPE_REFERENCE;
+    v.flags = ISON_VALUE_BORROWED;
     
     token++;
-    char *copy = strdup_safe(token);
-    char *colon = strchr(copy, ':');
-    
-    if (!colon) {
-        ref.id = copy;
-        return ref;
+    const char *colon = strchr(token, ':');
+    const char *id = colon ? colon + 1 : token;
+    size_t prefix_len = colon ? (size_t)(colon - token) : 0;
+    bool relationship = colon && is_all_upper(token, prefix_len);
+    
+    v.data.ref_val.id = NULL;
+    if (p->borrow) {
+        v.data.ref_val = ison_reference_make_n(&p->pool->arena, id, strlen(id),
+                                               colon ? token : NULL, prefix_len, relationship);
     }
-    
-    *colon = '\0';
-    char *ns = copy;
-    char *id = colon + 1;
-    
-    if (is_all_upper(ns)) {
-        ref.relationship = strdup_safe(ns);
-    } else {
-        ref.ns = strdup_safe(ns);
+    if (!v.data.ref_val.id) {
+        v.flags = ISON_VALUE_SHARED_REF;
+        v.data.ref_val = ison_reference_make_n(NULL, id, strlen(id),
+                                               colon ? token : NULL, prefix_len, relationship);
     }
-    ref.id = strdup_safe(id);
-    free(copy);
-    return ref;
+    return v;
+}
+
+/* Short strings go inline, longer ones into the arena */
+static ison_value_t make_string(parser_t *p, const char *token) {
+    size_t len = strlen(token);
+    if (len <= ISON_SMALL_STRING_MAX || !p->borrow) return ison_string_n(token, len);
+    
+    char *copy = ison_arena_alloc(&p->pool->arena, len + 1);
+    if (!copy) return ison_string_n(token, len);
+    memcpy(copy, token, len + 1);
+    
+    ison_value_t v = ison_null();
+    v.type = ISON_TYPE_STRING;
+    v.flags = ISON_VALUE_BORROWED;
+    v.data.string_val = copy;
+    return v;
 }
 
-static ison_value_t parse_value_token(const char *token, const char *type_hint) {
+static ison_value_t parse_value_token(parser_t *p, const char *token, const char *type_hint) {
+    if (token && token_quoted(token)) return make_string(p, token);
+    
     if (!token || strcmp(token, "~") == 0 ||
         strcasecmp(token, "null") == 0 ||
         strcasecmp(token, "NULL") == 0) {
@@ -201,8 +250,7 @@ static ison_value_t parse_value_token(const char *token, const char *type_hint)
     }
     
     if (*token == ':') {
-        ison_reference_t ref = parse_reference(token);
-        return ison_ref(&ref);
+        return parse_reference(p, token);
     }
     
     if (type_hint && *type_hint) {
@@ -220,7 +268,7 @@ static ison_value_t parse_value_token(const char *token, const char *type_hint)
             if (strcmp(token, "false") == 0 || strcmp(token, "0") == 0)
                 return ison_bool(0);
         } else if (strcmp(type_hint, "string") == 0) {
-            return ison_string(token);
+            return make_string(p, token);
         }
     }
     
@@ -231,20 +279,29 @@ static ison_value_t parse_value_token(const char *token, const char *type_hint)
     double fval = strtod(token, &end);
     if (*end == '\0') return ison_float(fval);
     
-    return ison_string(token);
+    return make_string(p, token);
+}
+
+/* Parses one data line into a row through the pooled builder */
+static ison_row_t *parse_row(parser_t *p, ison_block_t *block, const char *line) {
+    size_t token_count;
+    char **tokens = tokenize(p, line, &token_count);
+    
+    for (size_t i = 0; i < token_count && i < block->field_count; i++) {
+        ison_value_t val = parse_value_token(p, tokens[i], block->fields[i].type_hint);
+        ison_row_builder_set_at(p->pool->builder, i, &val);
+    }
+    return ison_row_builder_build(p->pool->builder);
 }
 
 static ison_block_t *parse_block(parser_t *p, const char *kind, const char *name) {
-    ison_block_t *block = ison_block_create(kind, name);
+    ison_block_t *block = ison_document_acquire_block(p->doc, kind, name);
     p->pos++;
+    if (!block) return NULL;
     
     while (p->pos < p->line_count) {
         char *line = trim(p->lines[p->pos]);
-        if (strlen(line) > 0 && line[0] != '#') {
-            free(line);
-            break;
-        }
-        free(line);
+        if (strlen(line) > 0 && line[0] != '#') break;
         p->pos++;
     }
     
@@ -252,154 +309,94 @@ static ison_block_t *parse_block(parser_t *p, const char *kind, const char *name
     
     char *fields_line = trim(p->lines[p->pos]);
     size_t field_count;
-    char **field_tokens = tokenize(fields_line, &field_count);
-    
-    for (size_t i = 0; i < field_count; i++) {
-        char *fname, *ftype;
-        parse_field_def(field_tokens[i], &fname, &ftype);
-        ison_block_add_field(block, fname, ftype);
-        free(fname);
-        free(ftype);
-        free(field_tokens[i]);
-    }
-    free(field_tokens);
-    free(fields_line);
+    char **field_tokens = tokenize(p, fields_line, &field_count);
+    set_fields(block, field_tokens, field_count);
     p->pos++;
     
+    p->pool->builder = ison_row_builder_rebind(p->pool->builder, block);
     int in_summary = 0;
     while (p->pos < p->line_count) {
         char *line = trim(p->lines[p->pos]);
         
         if (strlen(line) == 0) {
-            free(line);
             p->pos++;
             break;
         }
         
         if (line[0] == '#') {
-            free(line);
             p->pos++;
             continue;
         }
         
-        if (strchr(line, '.') && line[0] != '"') {
-            char *dot = strchr(line, '.');
-            char *kind_part = malloc(dot - line + 1);
-            memcpy(kind_part, line, dot - line);
-            kind_part[dot - line] = '\0';
-            if (is_valid_kind(kind_part)) {
-                free(kind_part);
-                free(line);
-                break;
-            }
-            free(kind_part);
+        char *dot = strchr(line, '.');
+        if (dot && line[0] != '"' && is_valid_kind(line, (size_t)(dot - line))) {
+            break;
         }
         
         if (strcmp(line, "---") == 0) {
             in_summary = 1;
-            free(line);
             p->pos++;
             continue;
         }
         
-        size_t token_count;
-        char **tokens = tokenize(line, &token_count);
-        ison_row_t *row = ison_row_create();
-        
-        for (size_t i = 0; i < token_count && i < block->field_count; i++) {
-            ison_value_t val = parse_value_token(tokens[i], block->fields[i].type_hint);
-            ison_row_set(row, block->fields[i].name, &val);
-            free(tokens[i]);
-        }
-        free(tokens);
-        
+        ison_row_t *row = parse_row(p, block, line);
         if (in_summary) {
-            ison_block_set_summary(block, row);
+            ison_block_take_summary(block, row);
         } else {
-            ison_block_add_row(block, row);
+            ison_block_take_row(block, row);
         }
-        free(row);
         
-        free(line);
         p->pos++;
     }
     
     return block;
 }
 
-ison_document_t *ison_parse(const char *text, ison_error_t *error) {
-    if (error) *error = ISON_OK;
-    if (!text) return ison_document_create();
-    
+static ison_error_t parse_document(ison_document_t *doc, const char *text, bool borrow) {
     parser_t p;
-    p.text = text;
-    p.lines = split_lines(text, &p.line_count);
-    p.pos = 0;
-    
-    ison_document_t *doc = ison_document_create();
+    p.borrow = borrow;
+    p.doc = doc;
+    p.pool = ison_document_pool(doc);
+    if (!p.pool || !split_lines(&p, text)) return ISON_ERROR_MEMORY;
     
     while (p.pos < p.line_count) {
         char *line = trim(p.lines[p.pos]);
         
         if (strlen(line) == 0 || line[0] == '#') {
-            free(line);
             p.pos++;
             continue;
         }
         
         char *dot = strchr(line, '.');
-        if (dot && line[0] != '"') {
-            size_t kind_len = dot - line;
-            char *kind = malloc(kind_len + 1);
-            memcpy(kind, line, kind_len);
-            kind[kind_len] = '\0';
-            
-            if (is_valid_kind(kind)) {
-                char *name = strdup_safe(dot + 1);
-                ison_block_t *block = parse_block(&p, kind, name);
-                ison_document_add_block(doc, block);
-                free(kind);
-                free(name);
-                free(line);
-                continue;
-            }
-            free(kind);
+        if (dot && line[0] != '"' && is_valid_kind(line, (size_t)(dot - line))) {
+            /* parse_block moves past this line, so it can be split in place */
+            *dot = '\0';
+            ison_block_t *block = parse_block(&p, line, dot + 1);
+            ison_document_add_block(doc, block);
+            continue;
         }
         
-        free(line);
         p.pos++;
     }
     
-    for (size_t i = 0; i < p.line_count; i++) {
-        free(p.lines[i]);
-    }
-    free(p.lines);
-    
-    return doc;
+    return ISON_OK;
 }
 
-ison_document_t *ison_parse_isonl(const char *text, ison_error_t *error) {
-    if (error) *error = ISON_OK;
-    if (!text) return ison_document_create();
-    
-    ison_document_t *doc = ison_document_create();
-    size_t line_count;
-    char **lines = split_lines(text, &line_count);
+static ison_error_t parse_isonl_document(ison_document_t *doc, const char *text, bool borrow) {
+    parser_t p;
+    p.borrow = borrow;
+    p.doc = doc;
+    p.pool = ison_document_pool(doc);
+    if (!p.pool || !split_lines(&p, text)) return ISON_ERROR_MEMORY;
     
-    for (size_t i = 0; i < line_count; i++) {
-        char *line = trim(lines[i]);
-        if (strlen(line) == 0 || line[0] == '#') {
-            free(line);
-            continue;
-        }
+    ison_block_t *bound = NULL;
+    for (size_t i = 0; i < p.line_count; i++) {
+        char *line = trim(p.lines[i]);
+        if (strlen(line) == 0 || line[0] == '#') continue;
         
         char *p1 = strchr(line, '|');
         char *p2 = p1 ? strchr(p1 + 1, '|') : NULL;
-        
-        if (!p1 || !p2) {
-            free(line);
-            continue;
-        }
+        if (!p1 || !p2) continue;
         
         *p1 = '\0';
         *p2 = '\0';
@@ -409,10 +406,7 @@ ison_document_t *ison_parse_isonl(const char *text, ison_error_t *error) {
         char *data_str = p2 + 1;
         
         char *dot = strchr(header, '.');
-        if (!dot) {
-            free(line);
-            continue;
-        }
+        if (!dot) continue;
         
         *dot = '\0';
         char *kind = header;
@@ -420,44 +414,57 @@ ison_document_t *ison_parse_isonl(const char *text, ison_error_t *error) {
         
         ison_block_t *block = ison_document_get(doc, name);
         if (!block) {
-            block = ison_block_create(kind, name);
+            block = ison_document_acquire_block(doc, kind, name);
+            if (!block) continue;
             
             size_t field_count;
-            char **field_tokens = tokenize(fields_str, &field_count);
-            for (size_t j = 0; j < field_count; j++) {
-                char *fname, *ftype;
-                parse_field_def(field_tokens[j], &fname, &ftype);
-                ison_block_add_field(block, fname, ftype);
-                free(fname);
-                free(ftype);
-                free(field_tokens[j]);
-            }
-            free(field_tokens);
-            
+            char **field_tokens = tokenize(&p, fields_str, &field_count);
+            set_fields(block, field_tokens, field_count);
             ison_document_add_block(doc, block);
         }
         
-        size_t data_count;
-        char **data_tokens = tokenize(data_str, &data_count);
-        ison_row_t *row = ison_row_create();
-        
-        for (size_t j = 0; j < data_count && j < block->field_count; j++) {
-            ison_value_t val = parse_value_token(data_tokens[j], block->fields[j].type_hint);
-            ison_row_set(row, block->fields[j].name, &val);
-            free(data_tokens[j]);
+        if (block != bound) {
+            p.pool->builder = ison_row_builder_rebind(p.pool->builder, block);
+            bound = block;
         }
-        free(data_tokens);
-        
-        ison_block_add_row(block, row);
-        free(row);
-        
-        free(line);
+        ison_block_take_row(block, parse_row(&p, block, data_str));
     }
     
-    for (size_t i = 0; i < line_count; i++) {
-        free(lines[i]);
-    }
-    free(lines);
+    return ISON_OK;
+}
+
+ison_document_t *ison_parse(const char *text, ison_error_t *error) {
+    if (error) *error = ISON_OK;
+    
+    ison_document_t *doc = ison_document_create();
+    if (!text || !doc) return doc;
+    
+    ison_error_t err = parse_document(doc, text, false);
+    ison_document_pool_trim(doc);
+    if (error) *error = err;
+    return doc;
+}
+
+ison_document_t *ison_parse_isonl(const char *text, ison_error_t *error) {
+    if (error) *error = ISON_OK;
     
+    ison_document_t *doc = ison_document_create();
+    if (!text || !doc) return doc;
+    
+    ison_error_t err = parse_isonl_document(doc, text, false);
+    ison_document_pool_trim(doc);
+    if (error) *error = err;
     return doc;
 }
+
+ison_error_t ison_parse_into(ison_document_t *doc, const char *text) {
+    if (!doc) return ISON_ERROR_INVALID;
+    ison_document_reset(doc);
+    return text ? parse_document(doc, text, true) : ISON_OK;
+}
+
+ison_error_t ison_parse_isonl_into(ison_document_t *doc, const char *text) {
+    if (!doc) return ISON_ERROR_INVALID;
+    ison_document_reset(doc);
+    return text ? parse_isonl_document(doc, text, true) : ISON_OK;
+}
@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+/* Numbers sort before strings; ints and floats compare by value */
+enum {
+    RKEY_INT,
+    RKEY_FLOAT,
+    RKEY_STRING
+};
+
+typedef struct {
+    int kind;
+    int64_t i;
+    double f;
+    const char *s;        /* borrowed from the row */
+} range_key_t;
+
+typedef struct {
+    range_key_t key;
+    size_t row;
+} range_entry_t;
+
+struct ison_range_index {
+    char *column;
+    range_key_t *keys;    /* sorted */
+    size_t *rows;         /* rows[i] holds keys[i] */
+    size_t count;
+    size_t capacity;
+    range_entry_t *pending;
+    size_t pending_count;
+    size_t pending_capacity;
+};
+
+static int make_key(const ison_value_t *value, range_key_t *key) {
+    if (!value) return 0;
+    switch (value->type) {
+        case ISON_TYPE_INT:
+            key->kind = RKEY_INT;
+            key->i = value->data.int_val;
+            return 1;
+        case ISON_TYPE_FLOAT:
+            if (value->data.float_val != value->data.float_val) return 0;
+            key->kind = RKEY_FLOAT;
+            key->f = value->data.float_val;
+            return 1;
+        case ISON_TYPE_STRING:
+            key->s = ison_value_string(value);
+            if (!key->s) return 0;
+            key->kind = RKEY_STRING;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int key_compare(const range_key_t *a, const range_key_t *b) {
+    int a_str = a->kind == RKEY_STRING;
+    int b_str = b->kind == RKEY_STRING;
+    if (a_str != b_str) return a_str - b_str;
+    if (a_str) return strcmp(a->s, b->s);
+    
+    if (a->kind == RKEY_INT && b->kind == RKEY_INT) {
+        return (a->i > b->i) - (a->i < b->i);
+    }
+    double x = a->kind == RKEY_INT ? (double)a->i : a->f;
+    double y = b->kind == RKEY_INT ? (double)b->i : b->f;
+    return (x > y) - (x < y);
+}
+
+/* Row order breaks ties so the permutation is deterministic */
+static int entry_compare(const void *pa, const void *pb) {
+    const range_entry_t *a = pa;
+    const range_entry_t *b = pb;
+    int c = key_compare(&a->key, &b->key);
+    if (c) return c;
+    return (a->row > b->row) - (a->row < b->row);
+}
+
+static int reserve(ison_range_index_t *index, size_t needed) {
+    if (needed <= index->capacity) return 1;
+    size_t new_cap = index->capacity == 0 ? 16 : index->capacity;
+    while (new_cap < needed) new_cap *= 2;
+    
+    range_key_t *keys = ison_realloc(index->keys, new_cap * sizeof(range_key_t));
+    if (!keys) return 0;
+    index->keys = keys;
+    size_t *rows = ison_realloc(index->rows, new_cap * sizeof(size_t));
+    if (!rows) return 0;
+    index->rows = rows;
+    index->capacity = new_cap;
+    return 1;
+}
+
+static void push_pending(ison_range_index_t *index, const ison_value_t *value, size_t row) {
+    range_entry_t entry;
+    if (!make_key(value, &entry.key)) return;
+    entry.row = row;
+    
+    if (index->pending_count >= index->pending_capacity) {
+        size_t new_cap = index->pending_capacity == 0 ? 16 : index->pending_capacity * 2;
+        range_entry_t *new_pending = ison_realloc(index->pending, new_cap * sizeof(range_entry_t));
+        if (!new_pending) return;
+        index->pending = new_pending;
+        index->pending_capacity = new_cap;
+    }
+    index->pending[index->pending_count++] = entry;
+}
+
+/*
+ * Sorts the pending tail and merges it into the sorted arrays from the back,
+ * so a tail that already sorts after everything (e.g. increasing timestamps)
+ * costs only its own sort.
+ */
+static int flush_pending(ison_range_index_t *index) {
+    size_t p = index->pending_count;
+    if (p == 0) return 1;
+    if (!reserve(index, index->count + p)) return 0;
+    
+    qsort(index->pending, p, sizeof(range_entry_t), entry_compare);
+    
+    size_t i = index->count;
+    size_t out = index->count + p;
+    while (p > 0) {
+        const range_entry_t *tail = &index->pending[p - 1];
+        if (i > 0) {
+            range_entry_t last = { index->keys[i - 1], index->rows[i - 1] };
+            if (entry_compare(&last, tail) > 0) {
+                out--;
+                index->keys[out] = last.key;
+                index->rows[out] = last.row;
+                i--;
+                continue;
+            }
+        }
+        out--;
+        index->keys[out] = tail->key;
+        index->rows[out] = tail->row;
+        p--;
+    }
+    
+    index->count += index->pending_count;
+    index->pending_count = 0;
+    return 1;
+}
+
+static void range_fill(ison_range_index_t *index, const ison_block_t *block) {
+    index->count = 0;
+    index->pending_count = 0;
+    for (size_t r = 0; r < block->row_count; r++) {
+        push_pending(index, ison_row_get_ptr(block->rows[r], index->column), r);
+    }
+    flush_pending(index);
+}
+
+static void range_free(ison_range_index_t *index) {
+    if (!index) return;
+    ison_free(index->column);
+    ison_free(index->keys);
+    ison_free(index->rows);
+    ison_free(index->pending);
+    ison_free(index);
+}
+
+/* First position whose key is > value (after) or >= value (!after) */
+static size_t bound(const ison_range_index_t *index, const range_key_t *key, int after) {
+    size_t lo = 0;
+    size_t hi = index->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = key_compare(&index->keys[mid], key);
+        if (c < 0 || (after && c == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+ison_range_index_t *ison_block_build_range_index(ison_block_t *block, const char *column) {
+    if (!block || !column) return NULL;
+    
+    for (size_t i = 0; i < block->range_index_count; i++) {
+        if (strcmp(block->range_indexes[i]->column, column) == 0) return block->range_indexes[i];
+    }
+    
+    ison_range_index_t **new_indexes = ison_realloc(block->range_indexes,
+                                               (block->range_index_count + 1) * sizeof(ison_range_index_t *));
+    if (!new_indexes) return NULL;
+    block->range_indexes = new_indexes;
+    
+    ison_range_index_t *index = ison_calloc(1, sizeof(ison_range_index_t));
+    if (!index) return NULL;
+    size_t len = strlen(column);
+    index->column = ison_malloc(len + 1);
+    if (!index->column) {
+        range_free(index);
+        return NULL;
+    }
+    memcpy(index->column, column, len + 1);
+    
+    range_fill(index, block);
+    block->range_indexes[block->range_index_count++] = index;
+    return index;
+}
+
+void ison_block_drop_range_index(ison_block_t *block, ison_range_index_t *index) {
+    if (!block || !index) return;
+    for (size_t i = 0; i < block->range_index_count; i++) {
+        if (block->range_indexes[i] != index) continue;
+        range_free(index);
+        block->range_indexes[i] = block->range_indexes[--block->range_index_count];
+        return;
+    }
+}
+
+size_t ison_range_query(ison_range_index_t *index,
+                        const ison_value_t *lo, bool lo_inclusive,
+                        const ison_value_t *hi, bool hi_inclusive,
+                        const size_t **rows) {
+    if (rows) *rows = NULL;
+    if (!index || !flush_pending(index)) return 0;
+    
+    range_key_t key;
+    size_t begin = 0;
+    size_t end = index->count;
+    if (lo) {
+        if (!make_key(lo, &key)) return 0;
+        begin = bound(index, &key, !lo_inclusive);
+    }
+    if (hi) {
+        if (!make_key(hi, &key)) return 0;
+        end = bound(index, &key, hi_inclusive);
+    }
+    if (begin >= end) return 0;
+    
+    if (rows) *rows = index->rows + begin;
+    return end - begin;
+}
+
+size_t ison_range_top(ison_range_index_t *index, size_t n, bool largest, const size_t **rows) {
+    if (rows) *rows = NULL;
+    if (!index || !flush_pending(index)) return 0;
+    
+    if (n > index->count) n = index->count;
+    if (n == 0) return 0;
+    if (rows) *rows = index->rows + (largest ? index->count - n : 0);
+    return n;
+}
+
+void ison_block_range_index_row(ison_block_t *block, size_t row) {
+    for (size_t i = 0; i < block->range_index_count; i++) {
+        ison_range_index_t *index = block->range_indexes[i];
+        push_pending(index, ison_row_get_ptr(block->rows[row], index->column), row);
+    }
+}
+
+void ison_block_rebuild_range_indexes(ison_block_t *block) {
+    for (size_t i = 0; i < block->range_index_count; i++) {
+        range_fill(block->range_indexes[i], block);
+    }
+}
+
+void ison_block_free_range_indexes(ison_block_t *block) {
+    for (size_t i = 0; i < block->range_index_count; i++) {
+        range_free(block->range_indexes[i]);
+    }
+    ison_free(block->range_indexes);
+    block->range_indexes = NULL;
+    block->range_index_count = 0;
+}
@@ -2,40 +2,91 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ison.h"
+#include "ison_internal.h"
 
-static char *strdup_safe(const char *str) {
-    if (!str) return NULL;
-    size_t len = strlen(str);
-    char *copy = malloc(len + 1);
-    if (copy) memcpy(copy, str, len + 1);
-    return copy;
+/*
+ * Lays id, ns and relationship out back to back in one allocation owned by
+ * ref.id (or by the arena), so copying is one malloc and freeing is one free.
+ */
+static ison_reference_t make_single(ison_arena_t *arena, const char *id, size_t id_len,
+                                    const char *ns, size_t ns_len,
+                                    const char *relationship, size_t rel_len) {
+    ison_reference_t ref = {NULL, NULL, NULL};
+    size_t total = id_len + 1;
+    if (ns) total += ns_len + 1;
+    if (relationship) total += rel_len + 1;
+    
+    char *buf = arena ? ison_arena_alloc(arena, total) : ison_malloc(total);
+    if (!buf) return ref;
+    
+    ref.id = buf;
+    memcpy(buf, id, id_len);
+    buf[id_len] = '\0';
+    buf += id_len + 1;
+    if (ns) {
+        ref.ns = buf;
+        memcpy(buf, ns, ns_len);
+        buf[ns_len] = '\0';
+        buf += ns_len + 1;
+    }
+    if (relationship) {
+        ref.relationship = buf;
+        memcpy(buf, relationship, rel_len);
+        buf[rel_len] = '\0';
+    }
+    return ref;
 }
 
 ison_reference_t ison_reference_make(const char *id, const char *ns, const char *relationship) {
     ison_reference_t ref;
-    ref.id = strdup_safe(id);
-    ref.ns = strdup_safe(ns);
-    ref.relationship = strdup_safe(relationship);
+    ref.id = ison_strdup(id);
+    ref.ns = ison_strdup(ns);
+    ref.relationship = ison_strdup(relationship);
+    if ((id && !ref.id) || (ns && !ref.ns) || (relationship && !ref.relationship)) ison_reference_free(&ref);
     return ref;
 }
 
+ison_reference_t ison_reference_copy_shared(const ison_reference_t *ref) {
+    if (!ref || !ref->id) {
+        ison_reference_t empty = {NULL, NULL, NULL};
+        return empty;
+    }
+    return make_single(NULL, ref->id, strlen(ref->id), ref->ns, ref->ns ? strlen(ref->ns) : 0,
+                       ref->relationship, ref->relationship ? strlen(ref->relationship) : 0);
+}
+
+ison_reference_t ison_reference_make_n(ison_arena_t *arena, const char *id, size_t id_len,
+                                       const char *prefix, size_t prefix_len, bool relationship) {
+    if (!prefix) return make_single(arena, id, id_len, NULL, 0, NULL, 0);
+    if (relationship) return make_single(arena, id, id_len, NULL, 0, prefix, prefix_len);
+    return make_single(arena, id, id_len, prefix, prefix_len, NULL, 0);
+}
+
+ison_reference_t ison_reference_copy(const ison_reference_t *ref) {
+    if (!ref) {
+        ison_reference_t empty = {NULL, NULL, NULL};
+        return empty;
+    }
+    return ison_reference_make(ref->id, ref->ns, ref->relationship);
+}
+
 char *ison_reference_to_ison(const ison_reference_t *ref) {
     if (!ref || !ref->id) return NULL;
     
     if (ref->relationship && *ref->relationship) {
         size_t len = strlen(ref->relationship) + strlen(ref->id) + 3;
-        char *result = malloc(len);
+        char *result = ison_malloc(len);
         if (result) sprintf(result, ":%s:%s", ref->relationship, ref->id);
         return result;
     }
     if (ref->ns && *ref->ns) {
         size_t len = strlen(ref->ns) + strlen(ref->id) + 3;
-        char *result = malloc(len);
+        char *result = ison_malloc(len);
         if (result) sprintf(result, ":%s:%s", ref->ns, ref->id);
         return result;
     }
     size_t len = strlen(ref->id) + 2;
-    char *result = malloc(len);
+    char *result = ison_malloc(len);
     if (result) sprintf(result, ":%s", ref->id);
     return result;
 }
@@ -52,9 +103,9 @@ char *ison_reference_get_ns(const ison_reference_t *ref) {
 
 void ison_reference_free(ison_reference_t *ref) {
     if (!ref) return;
-    free(ref->id);
-    free(ref->ns);
-    free(ref->relationship);
+    ison_free(ref->id);
+    ison_free(ref->ns);
+    ison_free(ref->relationship);
     ref->id = NULL;
     ref->ns = NULL;
     ref->relationship = NULL;
@@ -0,0 +1,113 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+struct ison_ref_index {
+    ison_document_t *doc;
+    const char **id_columns;  /* per block position; points at the block's field name */
+    size_t count;
+};
+
+static const char *id_column(const ison_block_t *block) {
+    if (block->field_count == 0) return NULL;
+    for (size_t i = 0; i < block->field_count; i++) {
+        if (strcmp(block->fields[i].name, "id") == 0) return block->fields[i].name;
+    }
+    return block->fields[0].name;
+}
+
+static void build_table(size_t task, void *ctx) {
+    ison_ref_index_t *index = ctx;
+    if (index->id_columns[task]) {
+        ison_block_build_index(index->doc->blocks[task], index->id_columns[task]);
+    }
+}
+
+ison_ref_index_t *ison_ref_index_build(ison_document_t *doc) {
+    if (!doc) return NULL;
+    
+    ison_ref_index_t *index = ison_calloc(1, sizeof(ison_ref_index_t));
+    if (!index) return NULL;
+    index->doc = doc;
+    index->count = doc->block_count;
+    index->id_columns = ison_calloc(index->count ? index->count : 1, sizeof(char *));
+    if (!index->id_columns) {
+        ison_free(index);
+        return NULL;
+    }
+    
+    for (size_t i = 0; i < index->count; i++) {
+        index->id_columns[i] = id_column(doc->blocks[i]);
+    }
+    ison_parallel_for(index->count, build_table, index);
+    return index;
+}
+
+void ison_ref_index_free(ison_ref_index_t *index) {
+    if (!index) return;
+    ison_free(index->id_columns);
+    ison_free(index);
+}
+
+size_t ison_namespace_position(const ison_document_t *doc, const char *ns) {
+    size_t pos = ison_document_position(doc, ns);
+    if (pos) return pos;
+    
+    /* :user:1 may point into "users"; only oversized names touch the heap */
+    char small[64];
+    size_t len = strlen(ns);
+    char *plural = len + 2 <= sizeof(small) ? small : ison_malloc(len + 2);
+    if (!plural) return 0;
+    memcpy(plural, ns, len);
+    plural[len] = 's';
+    plural[len + 1] = '\0';
+    pos = ison_document_position(doc, plural);
+    if (plural != small) ison_free(plural);
+    return pos;
+}
+
+static bool lookup_in(const ison_ref_index_t *index, size_t pos, const ison_value_t *key,
+                      ison_block_t **block, size_t *row) {
+    if (pos >= index->count || !index->id_columns[pos]) return false;
+    
+    ison_block_t *b = index->doc->blocks[pos];
+    ison_index_t *by_id = ison_block_get_index(b, index->id_columns[pos]);
+    if (!by_id) by_id = ison_block_build_index(b, index->id_columns[pos]);
+    
+    const size_t *rows;
+    if (ison_block_find(b, by_id, key, &rows) == 0) return false;
+    if (block) *block = b;
+    if (row) *row = rows[0];
+    return true;
+}
+
+bool ison_ref_index_lookup(const ison_ref_index_t *index, const ison_reference_t *ref,
+                           ison_block_t **block, size_t *row) {
+    if (!index || !ref || !ref->id) return false;
+    
+    ison_value_t key;
+    key.type = ISON_TYPE_STRING;
+    key.flags = 0;
+    key.data.string_val = ref->id;
+    
+    if (ref->ns && *ref->ns) {
+        size_t pos = ison_namespace_position(index->doc, ref->ns);
+        return pos && lookup_in(index, pos - 1, &key, block, row);
+    }
+    
+    for (size_t i = 0; i < index->count; i++) {
+        if (lookup_in(index, i, &key, block, row)) return true;
+    }
+    return false;
+}
+
+ison_row_t *ison_document_resolve(ison_document_t *doc, const ison_reference_t *ref) {
+    if (!doc || !ref) return NULL;
+    if (!doc->ref_index) doc->ref_index = ison_ref_index_build(doc);
+    
+    ison_block_t *block;
+    size_t row;
+    if (!ison_ref_index_lookup(doc->ref_index, ref, &block, &row)) return NULL;
+    return block->rows[row];
+}
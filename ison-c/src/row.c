@@ -1,9 +1,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ison.h"
+#include "ison_internal.h"
 
 ison_row_t *ison_row_create(void) {
-    ison_row_t *row = calloc(1, sizeof(ison_row_t));
+    ison_row_t *row = ison_calloc(1, sizeof(ison_row_t));
     return row;
 }
 
@@ -20,12 +21,12 @@ void ison_row_set(ison_row_t *row, const char *key, const ison_value_t *value) {
         entry = entry->next;
     }
     
-    entry = malloc(sizeof(ison_row_entry_t));
+    entry = ison_malloc(sizeof(ison_row_entry_t));
     if (!entry) return;
     
-    entry->key = malloc(strlen(key) + 1);
+    entry->key = ison_malloc(strlen(key) + 1);
     if (!entry->key) {
-        free(entry);
+        ison_free(entry);
         return;
     }
     strcpy(entry->key, key);
@@ -68,16 +69,65 @@ ison_value_t *ison_row_get_ptr(const ison_row_t *row, const char *key) {
     return NULL;
 }
 
+const ison_value_t *ison_column_value(const ison_row_t *row, size_t pos, const char *name) {
+    const ison_row_entry_t *entry = row->head;
+    for (size_t i = 0; entry && i < pos; i++) entry = entry->next;
+    if (entry && strcmp(entry->key, name) == 0) return &entry->value;
+    return ison_row_get_ptr(row, name);
+}
+
+bool ison_row_append(ison_row_t *row, const char *key, const ison_value_t *value) {
+    ison_row_entry_t *entry = ison_malloc(sizeof(ison_row_entry_t));
+    if (!entry) return false;
+    
+    size_t key_len = strlen(key);
+    entry->key = ison_malloc(key_len + 1);
+    if (!entry->key) {
+        ison_free(entry);
+        return false;
+    }
+    memcpy(entry->key, key, key_len + 1);
+    entry->value = *value;
+    entry->next = NULL;
+    
+    if (row->tail) {
+        row->tail->next = entry;
+    } else {
+        row->head = entry;
+    }
+    row->tail = entry;
+    row->count++;
+    return true;
+}
+
+/* Entries are appended directly: the source keys are already unique */
+ison_row_t *ison_row_copy(const ison_row_t *row) {
+    if (!row) return NULL;
+    
+    ison_row_t *copy = ison_row_create();
+    if (!copy) return NULL;
+    
+    for (const ison_row_entry_t *src = row->head; src; src = src->next) {
+        ison_value_t value = ison_value_copy(&src->value);
+        if (!ison_row_append(copy, src->key, &value)) {
+            ison_value_free(&value);
+            ison_row_free(copy);
+            return NULL;
+        }
+    }
+    return copy;
+}
+
 void ison_row_free(ison_row_t *row) {
     if (!row) return;
     
     ison_row_entry_t *entry = row->head;
     while (entry) {
         ison_row_entry_t *next = entry->next;
-        free(entry->key);
+        ison_free(entry->key);
         ison_value_free(&entry->value);
-        free(entry);
+        ison_free(entry);
         entry = next;
     }
-    free(row);
+    ison_free(row);
 }
@@ -0,0 +1,380 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ison.h"
+#include "ison_internal.h"
+
+/*
+ * Multi-key row sort.
+ *
+ * Every key cell is extracted once into a sort_cell_t (type rank, integer or
+ * double payload, an 8-byte big-endian prefix for strings). When every key
+ * column holds only ints, only bools, or numbers that are exact as doubles,
+ * rows are ordered by an LSD radix sort over 64-bit order-preserving
+ * encodings, one key at a time from the last. Otherwise a stable merge sort
+ * compares the extracted cells and only falls back to the values themselves
+ * on equal string prefixes. Large blocks are cut into chunks sorted on
+ * worker threads and then merged.
+ */
+
+#define SORT_PARALLEL_MIN 32768
+#define SIGN_BIT 0x8000000000000000ULL
+#define EXACT_DOUBLE_INT (1LL << 53)
+
+enum {
+    RANK_NULL = 0,
+    RANK_BOOL,
+    RANK_NUMBER,
+    RANK_STRING,
+    RANK_REFERENCE
+};
+
+typedef enum {
+    RADIX_NONE = 0,
+    RADIX_INT,
+    RADIX_DOUBLE,
+    RADIX_BOOL
+} radix_mode_t;
+
+typedef struct {
+    uint8_t rank;
+    bool is_int;
+    int64_t int_val;
+    double num;
+    uint64_t prefix;
+    const ison_value_t *value;
+} sort_cell_t;
+
+typedef struct {
+    uint64_t key;
+    size_t row;
+} radix_item_t;
+
+typedef struct {
+    const ison_sort_key_t *keys;
+    size_t key_count;
+    const sort_cell_t *cells;   /* cells[row * key_count + k] */
+    radix_mode_t *modes;
+    bool radix;
+    size_t *order;              /* row positions being sorted */
+    size_t *scratch;
+    radix_item_t *items;
+    radix_item_t *items_tmp;
+    size_t row_count;
+    size_t chunk_count;
+} sort_ctx_t;
+
+static uint64_t string_prefix(const char *str) {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; i++) {
+        unsigned char c = str ? (unsigned char)str[i] : 0;
+        prefix = (prefix << 8) | c;
+        if (!c) {
+            prefix <<= 8 * (7 - i);
+            break;
+        }
+    }
+    return prefix;
+}
+
+static void extract(sort_cell_t *cell, const ison_value_t *value) {
+    memset(cell, 0, sizeof(*cell));
+    cell->value = value;
+    if (!value) return;
+    
+    switch (value->type) {
+        case ISON_TYPE_BOOL:
+            cell->rank = RANK_BOOL;
+            cell->int_val = value->data.bool_val;
+            break;
+        case ISON_TYPE_INT:
+            cell->rank = RANK_NUMBER;
+            cell->is_int = true;
+            cell->int_val = value->data.int_val;
+            cell->num = (double)value->data.int_val;
+            break;
+        case ISON_TYPE_FLOAT:
+            cell->rank = RANK_NUMBER;
+            cell->num = value->data.float_val == 0.0 ? 0.0 : value->data.float_val;
+            break;
+        case ISON_TYPE_STRING:
+            cell->rank = RANK_STRING;
+            cell->prefix = string_prefix(ison_value_string(value));
+            break;
+        case ISON_TYPE_REFERENCE:
+            cell->rank = RANK_REFERENCE;
+            cell->prefix = string_prefix(value->data.ref_val.id);
+            break;
+        default:
+            break;
+    }
+}
+
+static int compare_str(const char *a, const char *b) {
+    return strcmp(a ? a : "", b ? b : "");
+}
+
+#define CMP(a, b) (((a) > (b)) - ((a) < (b)))
+
+static int compare_cells(const sort_cell_t *a, const sort_cell_t *b, const ison_sort_key_t *key) {
+    if (a->rank == RANK_NULL || b->rank == RANK_NULL) {
+        if (a->rank == b->rank) return 0;
+        int c = a->rank == RANK_NULL ? -1 : 1;
+        return key->nulls_first ? c : -c;
+    }
+    
+    int c = CMP(a->rank, b->rank);
+    if (c == 0) {
+        switch (a->rank) {
+            case RANK_BOOL:
+                c = CMP(a->int_val, b->int_val);
+                break;
+            case RANK_NUMBER:
+                c = a->is_int && b->is_int ? CMP(a->int_val, b->int_val) : CMP(a->num, b->num);
+                break;
+            case RANK_STRING:
+                c = CMP(a->prefix, b->prefix);
+                if (c == 0) c = strcmp(ison_value_string(a->value), ison_value_string(b->value));
+                break;
+            case RANK_REFERENCE: {
+                const ison_reference_t *x = &a->value->data.ref_val;
+                const ison_reference_t *y = &b->value->data.ref_val;
+                c = CMP(a->prefix, b->prefix);
+                if (c == 0) c = compare_str(x->id, y->id);
+                if (c == 0) c = compare_str(x->ns, y->ns);
+                if (c == 0) c = compare_str(x->relationship, y->relationship);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return key->descending ? -c : c;
+}
+
+int ison_sort_compare(const ison_value_t *a, const ison_value_t *b, const ison_sort_key_t *key) {
+    sort_cell_t x, y;
+    extract(&x, a);
+    extract(&y, b);
+    return compare_cells(&x, &y, key);
+}
+
+static int compare_rows(const sort_ctx_t *ctx, size_t a, size_t b) {
+    for (size_t k = 0; k < ctx->key_count; k++) {
+        int c = compare_cells(&ctx->cells[a * ctx->key_count + k], &ctx->cells[b * ctx->key_count + k],
+                              &ctx->keys[k]);
+        if (c) return c;
+    }
+    return 0;
+}
+
+/* Stable merge of order[lo..mid) and order[mid..hi) through scratch */
+static void merge(const sort_ctx_t *ctx, size_t *order, size_t *scratch,
+                  size_t lo, size_t mid, size_t hi) {
+    size_t i = lo, j = mid, k = lo;
+    while (i < mid && j < hi) {
+        scratch[k++] = compare_rows(ctx, order[j], order[i]) < 0 ? order[j++] : order[i++];
+    }
+    while (i < mid) scratch[k++] = order[i++];
+    while (j < hi) scratch[k++] = order[j++];
+    memcpy(order + lo, scratch + lo, (hi - lo) * sizeof(size_t));
+}
+
+/* Bottom-up merge sort; runs of 16 are insertion-sorted first */
+static void merge_sort(const sort_ctx_t *ctx, size_t *order, size_t *scratch, size_t lo, size_t hi) {
+    const size_t run = 16;
+    for (size_t start = lo; start < hi; start += run) {
+        size_t end = start + run < hi ? start + run : hi;
+        for (size_t i = start + 1; i < end; i++) {
+            size_t row = order[i];
+            size_t j = i;
+            while (j > start && compare_rows(ctx, row, order[j - 1]) < 0) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = row;
+        }
+    }
+    for (size_t width = run; width < hi - lo; width *= 2) {
+        for (size_t start = lo; start + width < hi; start += 2 * width) {
+            size_t mid = start + width;
+            size_t end = mid + width < hi ? mid + width : hi;
+            merge(ctx, order, scratch, start, mid, end);
+        }
+    }
+}
+
+static uint64_t radix_key(const sort_cell_t *cell, radix_mode_t mode, bool descending) {
+    uint64_t key;
+    if (mode == RADIX_DOUBLE) {
+        uint64_t bits;
+        memcpy(&bits, &cell->num, sizeof(bits));
+        key = (bits & SIGN_BIT) ? ~bits : bits ^ SIGN_BIT;
+    } else {
+        key = (uint64_t)cell->int_val ^ SIGN_BIT;
+    }
+    return descending ? ~key : key;
+}
+
+/* Stable LSD radix sort of items by key, skipping bytes every key shares */
+static void radix_pass(radix_item_t *items, radix_item_t *tmp, size_t n) {
+    size_t counts[8][256];
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < n; i++) {
+        for (size_t b = 0; b < 8; b++) counts[b][(items[i].key >> (8 * b)) & 0xFF]++;
+    }
+    
+    for (size_t b = 0; b < 8; b++) {
+        if (counts[b][(items[0].key >> (8 * b)) & 0xFF] == n) continue;
+        size_t offset = 0;
+        for (size_t v = 0; v < 256; v++) {
+            size_t c = counts[b][v];
+            counts[b][v] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            tmp[counts[b][(items[i].key >> (8 * b)) & 0xFF]++] = items[i];
+        }
+        memcpy(items, tmp, n * sizeof(radix_item_t));
+    }
+}
+
+static void radix_sort(const sort_ctx_t *ctx, size_t *order, radix_item_t *items, radix_item_t *tmp,
+                       size_t n) {
+    if (n < 2) return;
+    for (size_t k = ctx->key_count; k-- > 0;) {
+        const ison_sort_key_t *key = &ctx->keys[k];
+        size_t values = 0;
+        for (size_t i = 0; i < n; i++) {
+            const sort_cell_t *cell = &ctx->cells[order[i] * ctx->key_count + k];
+            if (cell->rank == RANK_NULL) continue;
+            items[values].key = radix_key(cell, ctx->modes[k], key->descending);
+            items[values].row = order[i];
+            values++;
+        }
+        if (values > 1) radix_pass(items, tmp, values);
+    
+        /* Nulls keep their relative order and go to one end */
+        size_t nulls = n - values;
+        for (size_t i = 0, w = 0; nulls && i < n; i++) {
+            if (ctx->cells[order[i] * ctx->key_count + k].rank == RANK_NULL) tmp[w++].row = order[i];
+        }
+        size_t value_start = key->nulls_first ? nulls : 0;
+        size_t null_start = key->nulls_first ? 0 : values;
+        for (size_t i = 0; i < values; i++) order[value_start + i] = items[i].row;
+        for (size_t i = 0; i < nulls; i++) order[null_start + i] = tmp[i].row;
+    }
+}
+
+static void sort_chunk(size_t chunk, void *arg) {
+    sort_ctx_t *ctx = arg;
+    size_t lo = ctx->row_count * chunk / ctx->chunk_count;
+    size_t hi = ctx->row_count * (chunk + 1) / ctx->chunk_count;
+    if (ctx->radix) {
+        radix_sort(ctx, ctx->order + lo, ctx->items + lo, ctx->items_tmp + lo, hi - lo);
+    } else {
+        merge_sort(ctx, ctx->order, ctx->scratch, lo, hi);
+    }
+}
+
+static radix_mode_t column_mode(const sort_cell_t *cells, size_t rows, size_t key_count, size_t k) {
+    bool ints = false, floats = false, bools = false, other = false, wide = false;
+    for (size_t r = 0; r < rows; r++) {
+        const sort_cell_t *cell = &cells[r * key_count + k];
+        switch (cell->rank) {
+            case RANK_NULL:
+                break;
+            case RANK_BOOL:
+                bools = true;
+                break;
+            case RANK_NUMBER:
+                if (!cell->is_int) {
+                    floats = true;
+                } else {
+                    ints = true;
+                    if (cell->int_val > EXACT_DOUBLE_INT || cell->int_val < -EXACT_DOUBLE_INT) wide = true;
+                }
+                break;
+            default:
+                other = true;
+                break;
+        }
+    }
+    if (other || (bools && (ints || floats))) return RADIX_NONE;
+    if (bools) return RADIX_BOOL;
+    if (!floats) return RADIX_INT;
+    return wide ? RADIX_NONE : RADIX_DOUBLE;
+}
+
+ison_error_t ison_block_sort(ison_block_t *block, const ison_sort_key_t *keys, size_t key_count) {
+    if (!block || (!keys && key_count)) return ISON_ERROR_INVALID;
+    size_t n = block->row_count;
+    if (n < 2 || key_count == 0) return ISON_OK;
+    
+    sort_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.keys = keys;
+    ctx.key_count = key_count;
+    ctx.row_count = n;
+    
+    sort_cell_t *cells = ison_malloc(n * key_count * sizeof(sort_cell_t));
+    ctx.modes = ison_calloc(key_count, sizeof(radix_mode_t));
+    ctx.order = ison_malloc(n * sizeof(size_t));
+    ison_row_t **sorted = ison_malloc(n * sizeof(ison_row_t *));
+    if (!cells || !ctx.modes || !ctx.order || !sorted) {
+        ison_free(cells);
+        ison_free(ctx.modes);
+        ison_free(ctx.order);
+        ison_free(sorted);
+        return ISON_ERROR_MEMORY;
+    }
+    ctx.cells = cells;
+    
+    for (size_t r = 0; r < n; r++) {
+        ctx.order[r] = r;
+        for (size_t k = 0; k < key_count; k++) {
+            extract(&cells[r * key_count + k], ison_row_get_ptr(block->rows[r], keys[k].field));
+        }
+    }
+    ctx.radix = true;
+    for (size_t k = 0; k < key_count; k++) {
+        ctx.modes[k] = column_mode(cells, n, key_count, k);
+        if (ctx.modes[k] == RADIX_NONE) ctx.radix = false;
+    }
+    
+    ctx.scratch = ison_malloc(n * sizeof(size_t));
+    if (ctx.radix) {
+        ctx.items = ison_malloc(n * sizeof(radix_item_t));
+        ctx.items_tmp = ison_malloc(n * sizeof(radix_item_t));
+    }
+    ison_error_t result = ISON_OK;
+    if (!ctx.scratch || (ctx.radix && (!ctx.items || !ctx.items_tmp))) {
+        result = ISON_ERROR_MEMORY;
+    } else {
+        size_t threads = ison_thread_count();
+        ctx.chunk_count = n >= SORT_PARALLEL_MIN && threads > 1 ? threads : 1;
+        ison_parallel_for(ctx.chunk_count, sort_chunk, &ctx);
+    
+        /* Merge the sorted chunks pairwise */
+        for (size_t width = 1; width < ctx.chunk_count; width *= 2) {
+            for (size_t c = 0; c + width < ctx.chunk_count; c += 2 * width) {
+                size_t lo = n * c / ctx.chunk_count;
+                size_t mid = n * (c + width) / ctx.chunk_count;
+                size_t end = c + 2 * width < ctx.chunk_count ? c + 2 * width : ctx.chunk_count;
+                merge(&ctx, ctx.order, ctx.scratch, lo, mid, n * end / ctx.chunk_count);
+            }
+        }
+    
+        for (size_t i = 0; i < n; i++) sorted[i] = block->rows[ctx.order[i]];
+        memcpy(block->rows, sorted, n * sizeof(ison_row_t *));
+        ison_block_rebuild_indexes(block);
+    }
+    
+    ison_free(cells);
+    ison_free(ctx.modes);
+    ison_free(ctx.order);
+    ison_free(ctx.scratch);
+    ison_free(ctx.items);
+    ison_free(ctx.items_tmp);
+    ison_free(sorted);
+    return result;
+}
@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdio.h>
 #include "ison.h"
+#include "ison_internal.h"
 
 const char *ison_error_string(ison_error_t error) {
     switch (error) {
@@ -13,3 +14,116 @@ const char *ison_error_string(ison_error_t error) {
         default: return "Unknown error";
     }
 }
+
+/* FNV-1a, 64-bit */
+uint64_t ison_hash_bytes(const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+uint64_t ison_hash_string(const char *str) {
+    return ison_hash_bytes(str, strlen(str));
+}
+
+uint64_t ison_hash_combine(uint64_t h, uint64_t v) {
+    return h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+/* Final avalanche of MurmurHash3's 64-bit mixer */
+uint64_t ison_hash_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t hash_str(const char *str) {
+    return ison_hash_string(str ? str : "");
+}
+
+/* True when d holds an int64 exactly; *out receives it */
+static bool float_as_int(double d, int64_t *out) {
+    if (!(d >= -9223372036854775808.0 && d < 9223372036854775808.0)) return false;
+    int64_t i = (int64_t)d;
+    if ((double)i != d) return false;
+    *out = i;
+    return true;
+}
+
+uint64_t ison_value_hash(const ison_value_t *value) {
+    if (!value) return ison_hash_mix(ISON_TYPE_NULL);
+    
+    int64_t whole;
+    switch (value->type) {
+        case ISON_TYPE_BOOL:
+            return ison_hash_mix(((uint64_t)ISON_TYPE_BOOL << 32) | value->data.bool_val);
+        case ISON_TYPE_INT:
+            return ison_hash_mix((uint64_t)value->data.int_val);
+        case ISON_TYPE_FLOAT: {
+            /* Whole floats hash as the int they equal; all NaNs alike */
+            double d = value->data.float_val;
+            if (float_as_int(d, &whole)) return ison_hash_mix((uint64_t)whole);
+            if (d != d) return ison_hash_mix(((uint64_t)ISON_TYPE_FLOAT << 32) | 1);
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof(bits));
+            return ison_hash_mix(bits);
+        }
+        case ISON_TYPE_STRING:
+            return ison_hash_mix(hash_str(ison_value_string(value)) ^ ISON_TYPE_STRING);
+        case ISON_TYPE_REFERENCE: {
+            const ison_reference_t *ref = &value->data.ref_val;
+            uint64_t h = hash_str(ref->id);
+            h = h * 31 + hash_str(ref->ns);
+            h = h * 31 + hash_str(ref->relationship);
+            return ison_hash_mix(h ^ ISON_TYPE_REFERENCE);
+        }
+        default:
+            return ison_hash_mix(ISON_TYPE_NULL);
+    }
+}
+
+static bool same_str(const char *a, const char *b) {
+    return strcmp(a ? a : "", b ? b : "") == 0;
+}
+
+bool ison_value_equal(const ison_value_t *a, const ison_value_t *b) {
+    bool a_null = !a || a->type == ISON_TYPE_NULL;
+    bool b_null = !b || b->type == ISON_TYPE_NULL;
+    if (a_null || b_null) return a_null && b_null;
+    
+    int64_t whole;
+    if (a->type == ISON_TYPE_INT && b->type == ISON_TYPE_INT) {
+        return a->data.int_val == b->data.int_val;
+    }
+    if (a->type == ISON_TYPE_INT && b->type == ISON_TYPE_FLOAT) {
+        return float_as_int(b->data.float_val, &whole) && whole == a->data.int_val;
+    }
+    if (a->type == ISON_TYPE_FLOAT && b->type == ISON_TYPE_INT) {
+        return float_as_int(a->data.float_val, &whole) && whole == b->data.int_val;
+    }
+    if (a->type != b->type) return false;
+    
+    switch (a->type) {
+        case ISON_TYPE_BOOL:
+            return a->data.bool_val == b->data.bool_val;
+        case ISON_TYPE_FLOAT: {
+            double x = a->data.float_val, y = b->data.float_val;
+            return x == y || (x != x && y != y);
+        }
+        case ISON_TYPE_STRING:
+            return same_str(ison_value_string(a), ison_value_string(b));
+        case ISON_TYPE_REFERENCE:
+            return same_str(a->data.ref_val.id, b->data.ref_val.id) &&
+                   same_str(a->data.ref_val.ns, b->data.ref_val.ns) &&
+                   same_str(a->data.ref_val.relationship, b->data.ref_val.relationship);
+        default:
+            return false;
+    }
+}
@@ -1,25 +1,21 @@
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "ison.h"
-
-static char *strdup_safe(const char *str) {
-    if (!str) return NULL;
-    size_t len = strlen(str);
-    char *copy = malloc(len + 1);
-    if (copy) memcpy(copy, str, len + 1);
-    return copy;
-}
+#include "ison_internal.h"
 
 ison_value_t ison_null(void) {
     ison_value_t v;
     v.type = ISON_TYPE_NULL;
+    v.flags = 0;
     return v;
 }
 
 ison_value_t ison_bool(bool value) {
     ison_value_t v;
     v.type = ISON_TYPE_BOOL;
+    v.flags = 0;
     v.data.bool_val = value;
     return v;
 }
@@ -27,6 +23,7 @@ ison_value_t ison_bool(bool value) {
 ison_value_t ison_int(int64_t value) {
     ison_value_t v;
     v.type = ISON_TYPE_INT;
+    v.flags = 0;
     v.data.int_val = value;
     return v;
 }
@@ -34,6 +31,7 @@ ison_value_t ison_int(int64_t value) {
 ison_value_t ison_float(double value) {
     ison_value_t v;
     v.type = ISON_TYPE_FLOAT;
+    v.flags = 0;
     v.data.float_val = value;
     return v;
 }
@@ -45,8 +43,13 @@ ison_value_t ison_string(const char *value) {
 ison_value_t ison_string_n(const char *value, size_t len) {
     ison_value_t v;
     v.type = ISON_TYPE_STRING;
-    if (value) {
-        v.data.string_val = malloc(len + 1);
+    v.flags = 0;
+    if (value && len <= ISON_SMALL_STRING_MAX) {
+        v.flags = ISON_VALUE_INLINE;
+        memcpy(v.data.small_str, value, len);
+        v.data.small_str[len] = '\0';
+    } else if (value) {
+        v.data.string_val = ison_malloc(len + 1);
         if (v.data.string_val) {
             memcpy(v.data.string_val, value, len);
             v.data.string_val[len] = '\0';
@@ -60,15 +63,8 @@ ison_value_t ison_string_n(const char *value, size_t len) {
 ison_value_t ison_ref(const ison_reference_t *ref) {
     ison_value_t v;
     v.type = ISON_TYPE_REFERENCE;
-    if (ref) {
-        v.data.ref_val.id = strdup_safe(ref->id);
-        v.data.ref_val.ns = strdup_safe(ref->ns);
-        v.data.ref_val.relationship = strdup_safe(ref->relationship);
-    } else {
-        v.data.ref_val.id = NULL;
-        v.data.ref_val.ns = NULL;
-        v.data.ref_val.relationship = NULL;
-    }
+    v.flags = ISON_VALUE_SHARED_REF;
+    v.data.ref_val = ison_reference_copy_shared(ref);
     return v;
 }
 
@@ -103,44 +99,89 @@ bool ison_value_as_float(const ison_value_t *value, double *out) {
 
 bool ison_value_as_string(const ison_value_t *value, const char **out) {
     if (!value || value->type != ISON_TYPE_STRING) return false;
-    if (out) *out = value->data.string_val;
+    if (out) *out = ison_value_string(value);
     return true;
 }
 
+const char *ison_value_string(const ison_value_t *value) {
+    if (!value || value->type != ISON_TYPE_STRING) return NULL;
+    if (value->flags & ISON_VALUE_INLINE) return value->data.small_str;
+    return value->data.string_val;
+}
+
 bool ison_value_as_ref(const ison_value_t *value, ison_reference_t *out) {
     if (!value || value->type != ISON_TYPE_REFERENCE) return false;
     if (out) *out = value->data.ref_val;
     return true;
 }
 
+int ison_format_float(char *buf, size_t size, double v) {
+    int n = snprintf(buf, size, "%.15g", v);
+    for (int digits = 16; digits <= 17 && n > 0 && (size_t)n < size && v == v && strtod(buf, NULL) != v; digits++) {
+        n = snprintf(buf, size, "%.*g", digits, v);
+    }
+    if (n <= 0 || (size_t)n + 2 >= size) return n;
+    if (!strpbrk(buf, ".eEn")) {
+        buf[n++] = '.';
+        buf[n++] = '0';
+        buf[n] = '\0';
+    }
+    return n;
+}
+
+/* ASCII case-insensitive match against a lowercase word, as the parser reads keywords */
+static bool is_keyword(const char *str, const char *word) {
+    for (; *str && *word; str++, word++) {
+        if (tolower((unsigned char)*str) != *word) return false;
+    }
+    return *str == *word;
+}
+
+bool ison_string_needs_quotes(const char *str) {
+    if (!*str || strpbrk(str, " \t\n\r\"") || *str == ':' || *str == '#') return true;
+    if (strcmp(str, "~") == 0 || strcmp(str, "---") == 0 || is_keyword(str, "null") ||
+        is_keyword(str, "true") || is_keyword(str, "false")) {
+        return true;
+    }
+    
+    /* Would read back as a number, or as a block header at the start of a line */
+    char *end;
+    strtol(str, &end, 10);
+    if (*end == '\0') return true;
+    strtod(str, &end);
+    if (*end == '\0') return true;
+    const char *dot = strchr(str, '.');
+    return dot && ((dot - str == 5 && memcmp(str, "table", 5) == 0) ||
+                   (dot - str == 6 && memcmp(str, "object", 6) == 0) ||
+                   (dot - str == 4 && memcmp(str, "meta", 4) == 0));
+}
+
 char *ison_value_to_ison(const ison_value_t *value) {
-    if (!value) return strdup_safe("~");
+    if (!value) return ison_strdup("~");
     
     char buf[256];
     switch (value->type) {
         case ISON_TYPE_NULL:
-            return strdup_safe("~");
+            return ison_strdup("~");
         case ISON_TYPE_BOOL:
-            return strdup_safe(value->data.bool_val ? "true" : "false");
+            return ison_strdup(value->data.bool_val ? "true" : "false");
         case ISON_TYPE_INT:
             snprintf(buf, sizeof(buf), "%ld", (long)value->data.int_val);
-            return strdup_safe(buf);
+            return ison_strdup(buf);
         case ISON_TYPE_FLOAT:
-            snprintf(buf, sizeof(buf), "%g", value->data.float_val);
-            return strdup_safe(buf);
+            ison_format_float(buf, sizeof(buf), value->data.float_val);
+            return ison_strdup(buf);
         case ISON_TYPE_STRING: {
-            const char *str = value->data.string_val;
-            if (!str) return strdup_safe("~");
-            int needs_quotes = !*str || strchr(str, ' ') || strchr(str, '\t') || 
-                              strchr(str, '\n') || strchr(str, '"');
-            if (!needs_quotes) return strdup_safe(str);
+            const char *str = ison_value_string(value);
+            if (!str) return ison_strdup("~");
+            if (!ison_string_needs_quotes(str)) return ison_strdup(str);
             
             size_t len = strlen(str);
             size_t extra = 2;
             for (size_t i = 0; i < len; i++) {
                 if (str[i] == '\\' || str[i] == '"' || str[i] == '\n' || str[i] == '\t') extra++;
             }
-            char *result = malloc(len + extra + 1);
+            char *result = ison_malloc(len + extra + 1);
             if (!result) return NULL;
             
             char *p = result;
@@ -161,34 +202,34 @@ char *ison_value_to_ison(const ison_value_t *value) {
         case ISON_TYPE_REFERENCE:
             return ison_reference_to_ison(&value->data.ref_val);
         default:
-            return strdup_safe("~");
+            return ison_strdup("~");
     }
 }
 
 char *ison_value_to_json(const ison_value_t *value) {
-    if (!value) return strdup_safe("null");
+    if (!value) return ison_strdup("null");
     
     char buf[256];
     switch (value->type) {
         case ISON_TYPE_NULL:
-            return strdup_safe("null");
+            return ison_strdup("null");
         case ISON_TYPE_BOOL:
-            return strdup_safe(value->data.bool_val ? "true" : "false");
+            return ison_strdup(value->data.bool_val ? "true" : "false");
         case ISON_TYPE_INT:
             snprintf(buf, sizeof(buf), "%ld", (long)value->data.int_val);
-            return strdup_safe(buf);
+            return ison_strdup(buf);
         case ISON_TYPE_FLOAT:
-            snprintf(buf, sizeof(buf), "%g", value->data.float_val);
-            return strdup_safe(buf);
+            ison_format_float(buf, sizeof(buf), value->data.float_val);
+            return ison_strdup(buf);
         case ISON_TYPE_STRING: {
-            const char *str = value->data.string_val;
-            if (!str) return strdup_safe("null");
+            const char *str = ison_value_string(value);
+            if (!str) return ison_strdup("null");
             size_t len = strlen(str);
             size_t extra = 2;
             for (size_t i = 0; i < len; i++) {
                 if (str[i] == '\\' || str[i] == '"' || str[i] < 0x20) extra++;
             }
-            char *result = malloc(len + extra + 1);
+            char *result = ison_malloc(len + extra + 1);
             if (!result) return NULL;
             
             char *p = result;
@@ -216,18 +257,35 @@ char *ison_value_to_json(const ison_value_t *value) {
         case ISON_TYPE_REFERENCE: {
             char *ref_ison = ison_reference_to_ison(&value->data.ref_val);
             size_t len = strlen(ref_ison);
-            char *result = malloc(len + 3);
+            char *result = ison_malloc(len + 3);
             if (result) {
                 result[0] = '"';
                 memcpy(result + 1, ref_ison, len);
                 result[len + 1] = '"';
                 result[len + 2] = '\0';
             }
-            free(ref_ison);
+            ison_free(ref_ison);
             return result;
         }
         default:
-            return strdup_safe("null");
+            return ison_strdup("null");
+    }
+}
+
+ison_value_t ison_value_copy(const ison_value_t *value) {
+    if (!value) return ison_null();
+    switch (value->type) {
+        case ISON_TYPE_STRING: {
+            const char *str = ison_value_string(value);
+            return str ? ison_string_n(str, strlen(str)) : ison_string(NULL);
+        }
+        case ISON_TYPE_REFERENCE:
+            return ison_ref(&value->data.ref_val);
+        default: {
+            ison_value_t v = *value;
+            v.flags = 0;
+            return v;
+        }
     }
 }
 
@@ -235,11 +293,18 @@ void ison_value_free(ison_value_t *value) {
     if (!value) return;
     switch (value->type) {
         case ISON_TYPE_STRING:
-            free(value->data.string_val);
+            if (!(value->flags & (ISON_VALUE_INLINE | ISON_VALUE_BORROWED))) ison_free(value->data.string_val);
+            value->flags = 0;
             value->data.string_val = NULL;
             break;
         case ISON_TYPE_REFERENCE:
-            ison_reference_free(&value->data.ref_val);
+            if (value->flags & ISON_VALUE_SHARED_REF) {
+                ison_free(value->data.ref_val.id);
+                memset(&value->data.ref_val, 0, sizeof(value->data.ref_val));
+            } else if (!(value->flags & ISON_VALUE_BORROWED)) {
+                ison_reference_free(&value->data.ref_val);
+            }
+            value->flags = 0;
             break;
         default:
             break;
@@ -4,6 +4,51 @@
 #include <assert.h>
 #include "ison.h"
 
+typedef struct {
+    char buf[1024];
+    size_t len;
+} sink_t;
+
+static bool count_visit(size_t node, size_t depth, void *userdata) {
+    (void)node;
+    (void)depth;
+    (*(size_t *)userdata)++;
+    return true;
+}
+
+static void sink_write(const char *data, size_t len, void *userdata) {
+    sink_t *sink = userdata;
+    assert(sink->len + len < sizeof(sink->buf));
+    memcpy(sink->buf + sink->len, data, len);
+    sink->len += len;
+    sink->buf[sink->len] = '\0';
+}
+
+typedef struct {
+    size_t allocs;
+    size_t live;
+} alloc_stats_t;
+
+static void *counting_malloc(size_t size, void *ctx) {
+    alloc_stats_t *stats = ctx;
+    stats->allocs++;
+    stats->live++;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *ctx) {
+    alloc_stats_t *stats = ctx;
+    stats->allocs++;
+    if (!ptr) stats->live++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *ptr, void *ctx) {
+    alloc_stats_t *stats = ctx;
+    stats->live--;
+    free(ptr);
+}
+
 int main(void) {
     printf("Test: ISON Parse Simple Table... ");
     fflush(stdout);
@@ -62,6 +107,7 @@ int main(void) {
     val = ison_string("Alice");
     ison_row_set(row, "name", &val);
     ison_block_add_row(block, row);
+    ison_row_free(row);
     
     ison_document_add_block(doc, block);
     
@@ -74,6 +120,79 @@ int main(void) {
     ison_document_free(doc);
     printf("PASS\n");
     
+    printf("Test: Small strings... ");
+    fflush(stdout);
+    
+    val = ison_string("active");
+    assert((val.flags & ISON_VALUE_INLINE) && strcmp(ison_value_string(&val), "active") == 0);
+    ison_value_t long_val = ison_string("a string too long to be stored inline");
+    assert(!(long_val.flags & ISON_VALUE_INLINE));
+    
+    row = ison_row_create();
+    ison_row_set(row, "status", &val);
+    ison_row_set(row, "note", &long_val);
+    ison_value_t got;
+    const char *status;
+    assert(ison_row_get(row, "status", &got) && ison_value_as_string(&got, &status) && strcmp(status, "active") == 0);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(row, "note")), "a string too long to be stored inline") == 0);
+    ison_row_free(row);
+    
+    doc = ison_from_json("{\"t\": [{\"s\": \"ok\"   , \"l\": \"twenty-four characters!!\"}]}", &err);
+    block = ison_document_get(doc, "t");
+    assert(block && (ison_row_get_ptr(block->rows[0], "s")->flags & ISON_VALUE_INLINE));
+    assert(strcmp(ison_value_string(ison_row_get_ptr(block->rows[0], "l")), "twenty-four characters!!") == 0);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Row ownership... ");
+    fflush(stdout);
+    
+    block = ison_block_create("table", "users");
+    row = ison_row_create();
+    val = ison_string("a name long enough to live on the heap");
+    ison_row_set(row, "name", &val);
+    ison_block_add_row(block, row);
+    assert(block->rows[0] != row);
+    assert(ison_value_string(ison_row_get_ptr(block->rows[0], "name")) != ison_value_string(&val));
+    assert(ison_block_take_row(block, row) && block->rows[1] == row);
+    ison_block_take_summary(block, ison_row_copy(row));
+    assert(strcmp(ison_value_string(ison_row_get_ptr(block->summary_row, "name")),
+                  ison_value_string(&val)) == 0);
+    ison_block_free(block);
+    printf("PASS\n");
+    
+    printf("Test: Row builder... ");
+    fflush(stdout);
+    
+    block = ison_block_create("table", "features");
+    ison_block_add_field(block, "id", "int");
+    ison_block_add_field(block, "label", "string");
+    ison_block_add_field(block, "id", "int");
+    ison_row_builder_t *builder = ison_row_builder_begin(block);
+    assert(builder != NULL);
+    for (int i = 0; i < 3; i++) {
+        val = ison_int(i);
+        ison_row_builder_set_at(builder, 0, &val);
+        val = ison_string(i == 1 ? "a label that does not fit inline" : "short");
+        ison_row_builder_set_at(builder, 1, &val);
+        if (i < 2) assert(ison_row_builder_next_row(builder));
+    }
+    val = ison_int(99);
+    ison_row_builder_set_at(builder, 2, &val);
+    assert(block->row_count == 0);
+    assert(ison_row_builder_commit(builder) == 3 && block->row_count == 3);
+    assert(block->rows[2]->count == 2 && strcmp(block->rows[2]->head->key, "id") == 0);
+    assert(block->rows[2]->head->value.data.int_val == 99);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(block->rows[1], "label")),
+                  "a label that does not fit inline") == 0);
+    
+    builder = ison_row_builder_begin(block);
+    val = ison_string("discarded because nobody commits it");
+    ison_row_builder_set_at(builder, 1, &val);
+    ison_row_builder_abort(builder);
+    ison_block_free(block);
+    printf("PASS\n");
+    
     printf("Test: ISONL Parse... ");
     fflush(stdout);
     
@@ -91,6 +210,911 @@ int main(void) {
     ison_document_free(doc);
     printf("PASS\n");
     
+    printf("Test: Document reuse... ");
+    fflush(stdout);
+    
+    doc = ison_document_create();
+    assert(ison_parse_into(doc, "table.events\nid kind note\n1 click \"first message, long enough for the arena\"\n2 view :user:7\n") == ISON_OK);
+    block = ison_document_get(doc, "events");
+    assert(block && block->row_count == 2);
+    ison_row_t *first_row = block->rows[0];
+    ison_row_entry_t *first_entry = first_row->head;
+    assert(ison_row_get_ptr(first_row, "note")->flags & ISON_VALUE_BORROWED);
+    
+    assert(ison_parse_into(doc, "table.events\nid kind note\n3 scroll \"second message, also too long to inline\"\n") == ISON_OK);
+    assert(ison_document_get(doc, "events") == block && doc->block_count == 1 && block->row_count == 1);
+    assert(block->spare_row_count == 1);
+    assert(ison_value_string(ison_row_get_ptr(block->rows[0], "note")) != NULL);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(block->rows[0], "note")),
+                  "second message, also too long to inline") == 0);
+    assert(block->rows[0]->head == first_entry || block->spare_rows[0]->head == first_entry);
+    
+    assert(ison_parse_isonl_into(doc, "table.events|id kind|9 drag\ntable.other|x|1\n") == ISON_OK);
+    assert(doc->block_count == 2 && ison_document_get(doc, "events") == block && block->field_count == 2);
+    assert(ison_row_get_ptr(block->rows[0], "note") == NULL);
+    output = ison_dumps(doc);
+    assert(strstr(output, "9 drag") != NULL && strstr(output, "table.other") != NULL);
+    free(output);
+    ison_document_reset(doc);
+    assert(doc->block_count == 0 && ison_document_get(doc, "events") == NULL);
+    
+    /* A spare the next parse leaves unused is dropped by the reset after it */
+    ison_memory_stats_t reuse_before, reuse_after;
+    assert(ison_parse_into(doc, "table.other\nx\n2\n") == ISON_OK);
+    ison_document_memory_stats(doc, &reuse_before);
+    assert(ison_parse_into(doc, "table.other\nx\n3\n") == ISON_OK);
+    ison_document_memory_stats(doc, &reuse_after);
+    assert(reuse_after.blocks < reuse_before.blocks);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Allocator hooks... ");
+    fflush(stdout);
+    
+    alloc_stats_t global_stats = {0, 0};
+    alloc_stats_t doc_stats = {0, 0};
+    ison_allocator_t global_alloc = { counting_malloc, counting_realloc, counting_free, &global_stats };
+    ison_allocator_t doc_alloc = { counting_malloc, counting_realloc, counting_free, &doc_stats };
+    ison_set_allocator(&global_alloc);
+    
+    const char *request = "table.orders\nid customer note\n1 :customer:7 \"deliver to the side door please\"\n"
+                          "2 :customer:9 \"leave with the neighbour if nobody is home\"\n";
+    doc = ison_parse(request, &err);
+    assert(doc && err == ISON_OK);
+    output = ison_dumps(doc);
+    assert(output && strstr(output, ":customer:9") != NULL);
+    ison_free(output);
+    ison_document_free(doc);
+    assert(global_stats.allocs > 0 && global_stats.live == 0);
+    
+    doc = ison_document_create_with_allocator(&doc_alloc);
+    assert(ison_parse_into(doc, request) == ISON_OK);
+    assert(ison_parse_into(doc, request) == ISON_OK);
+    size_t global_before = global_stats.allocs;
+    size_t doc_before = doc_stats.allocs;
+    assert(doc_before > 0);
+    assert(ison_parse_into(doc, request) == ISON_OK);
+    assert(global_stats.allocs == global_before && doc_stats.allocs == doc_before);
+    assert(ison_document_get(doc, "orders")->row_count == 2);
+    ison_document_free(doc);
+    assert(global_stats.live == 0 && doc_stats.live == 0);
+    ison_set_allocator(NULL);
+    printf("PASS\n");
+    
+    printf("Test: Memory stats... ");
+    fflush(stdout);
+    
+    alloc_stats_t mem_stats = {0, 0};
+    ison_allocator_t mem_alloc = { counting_malloc, counting_realloc, counting_free, &mem_stats };
+    ison_set_allocator(&mem_alloc);
+    
+    const char *mem_text = "table.orders\nid customer note\n1 :customer:7 \"deliver to the side door please\"\n"
+                           "2 :customer:9 short\n---\n~ ~ \"a summary note that is not inlined\"\n"
+                           "object.config\nname ratio\nmain 0.5\n";
+    ison_memory_stats_t mem;
+    doc = ison_parse(mem_text, &err);
+    ison_document_memory_stats(doc, &mem);
+    assert(mem.references > 0 && mem.strings > 0 && mem.borrowed == 0 && mem.arena == 0);
+    ison_document_free(doc);
+    
+    /* Parsing into a document borrows long strings and references from its arena */
+    doc = ison_document_create();
+    assert(doc && ison_parse_into(doc, mem_text) == ISON_OK);
+    ison_document_memory_stats(doc, &mem);
+    assert(mem.allocations == mem_stats.live);
+    assert(mem.rows == 4 * sizeof(ison_row_t) && mem.entries == 11 * sizeof(ison_row_entry_t));
+    assert(mem.references > 0 && mem.strings > 0 && mem.borrowed == mem.strings + mem.references);
+    assert(mem.arena >= mem.borrowed && mem.spare == 0);
+    assert(mem.total > mem.blocks + mem.fields + mem.rows + mem.entries + mem.keys);
+    
+    block = ison_document_get(doc, "config");
+    ison_memory_stats_t before;
+    ison_block_memory_stats(block, &before);
+    row = ison_row_create();
+    ison_value_t long_name = ison_string("a configuration name past the inline limit");
+    ison_row_set(row, "name", &long_name);
+    ison_block_take_row(block, row);
+    ison_block_memory_stats(block, &mem);
+    assert(mem.strings == before.strings + strlen("a configuration name past the inline limit") + 1);
+    assert(mem.borrowed == 0 && mem.allocations == before.allocations + 4);
+    ison_document_memory_stats(doc, &mem);
+    assert(mem.allocations == mem_stats.live);
+    
+    ison_document_reset(doc);
+    ison_document_memory_stats(doc, &mem);
+    assert(mem.rows == 0 && mem.entries == 0 && mem.strings == 0 && mem.references == 0);
+    assert(mem.spare > 0 && mem.allocations == mem_stats.live);
+    ison_document_free(doc);
+    assert(mem_stats.live == 0);
+    ison_set_allocator(NULL);
+    printf("PASS\n");
+    
+    printf("Test: Column aggregation... ");
+    fflush(stdout);
+    
+    doc = ison_parse("table.sales\nregion units price note\n"
+                     "north 3 2.5 ok\nsouth ~ 4.0 ~\neast 7 1 late\nwest -2 ~ ~\n", &err);
+    assert(doc && err == ISON_OK);
+    block = ison_document_get(doc, "sales");
+    ison_aggregate_t agg;
+    assert(ison_block_aggregate(block, "units", &agg));
+    assert(agg.count == 4 && agg.non_null == 3 && agg.numeric == 3 && agg.integral);
+    assert(agg.int_sum == 8 && agg.int_min == -2 && agg.int_max == 7);
+    assert(ison_block_aggregate(block, "price", &agg));
+    assert(!agg.integral && agg.numeric == 3 && agg.sum == 7.5 && agg.min == 1.0 && agg.max == 4.0 && agg.mean == 2.5);
+    assert(ison_block_aggregate(block, "note", &agg) && agg.numeric == 0 && agg.non_null == 2);
+    assert(!ison_block_aggregate(block, "missing", &agg));
+    
+    ison_agg_t spec[] = { ISON_AGG_COUNT, ISON_AGG_SUM, ISON_AGG_MEAN, ISON_AGG_COUNT_NON_NULL };
+    assert(ison_block_compute_summary(block, spec) == ISON_OK);
+    assert(ison_row_get_ptr(block->summary_row, "region")->data.int_val == 4);
+    assert(ison_row_get_ptr(block->summary_row, "units")->type == ISON_TYPE_INT);
+    assert(ison_row_get_ptr(block->summary_row, "units")->data.int_val == 8);
+    assert(ison_row_get_ptr(block->summary_row, "price")->data.float_val == 2.5);
+    assert(ison_row_get_ptr(block->summary_row, "note")->data.int_val == 2);
+    output = ison_dumps(doc);
+    assert(strstr(output, "---\n4 8 2.5 2") != NULL);
+    free(output);
+    ison_document_free(doc);
+    
+    block = ison_block_create("table", "series");
+    ison_block_add_field(block, "n", "int");
+    ison_block_add_field(block, "x", "float");
+    int64_t want_sum = 0;
+    for (int i = 0; i < 1000; i++) {
+        row = ison_row_create();
+        ison_value_t n = ison_int((i * 37) % 1001 - 500);
+        ison_value_t x = ison_float(i % 3 == 0 ? 0.25 * i : -1.0);
+        want_sum += n.data.int_val;
+        ison_row_set(row, "n", &n);
+        ison_row_set(row, "x", &x);
+        ison_block_take_row(block, row);
+    }
+    assert(ison_block_aggregate(block, "n", &agg) && agg.integral && agg.int_sum == want_sum);
+    assert(agg.int_min == -500 && agg.int_max == 500);
+    assert(ison_block_aggregate(block, "x", &agg) && agg.max == 0.25 * 999 && agg.min == -1.0);
+    doc = ison_document_create();
+    ison_document_add_block(doc, block);
+    ison_packed_t *packed_doc = ison_document_pack(doc);
+    ison_aggregate_t packed_agg;
+    assert(ison_packed_aggregate(packed_doc, "series", 1, &packed_agg));
+    assert(packed_agg.sum == agg.sum && packed_agg.max == agg.max && packed_agg.numeric == 1000);
+    assert(!ison_packed_aggregate(packed_doc, "series", 2, &packed_agg));
+    ison_packed_free(packed_doc);
+    
+    row = ison_row_create();
+    ison_value_t huge = ison_int(INT64_MAX);
+    ison_row_set(row, "n", &huge);
+    ison_block_take_row(block, row);
+    assert(ison_block_aggregate(block, "n", &agg) && !agg.integral);
+    assert(agg.sum > 9.2e18 && agg.int_max == INT64_MAX);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Filter selections... ");
+    fflush(stdout);
+    
+    doc = ison_parse("table.products\nsku name price stock owner\n"
+                     "1 apple 1.5 10 :user:1\n2 apricot 3 0 :user:2\n3 banana ~ 25 :user:1\n"
+                     "4 cherry 7.25 5 ~\n5 avocado 2 x :user:3\n", &err);
+    assert(doc && err == ISON_OK);
+    block = ison_document_get(doc, "products");
+    ison_selection_t cheap, stocked, sel;
+    
+    ison_predicate_t pred = { "price", ISON_CMP_LE, ison_int(2), NULL, 0 };
+    assert(ison_block_filter(block, &pred, &cheap) == ISON_OK);
+    assert(cheap.count == 2 && cheap.rows[0] == 0 && cheap.rows[1] == 4);
+    
+    pred = (ison_predicate_t){ "stock", ISON_CMP_GT, ison_int(0), NULL, 0 };
+    assert(ison_block_filter(block, &pred, &stocked) == ISON_OK);
+    assert(stocked.count == 3 && stocked.rows[2] == 3);
+    pred.op = ISON_CMP_NE;
+    assert(ison_block_filter(block, &pred, &sel) == ISON_OK && sel.count == 4);
+    ison_selection_free(&sel);
+    
+    assert(ison_selection_and(&cheap, &stocked, &sel) == ISON_OK);
+    assert(sel.count == 1 && sel.rows[0] == 0);
+    ison_selection_free(&sel);
+    assert(ison_selection_or(&cheap, &stocked, &sel) == ISON_OK);
+    assert(sel.count == 4 && sel.rows[3] == 4);
+    
+    pred = (ison_predicate_t){ "name", ISON_CMP_PREFIX, ison_string("a"), NULL, 0 };
+    assert(ison_block_filter_refine(block, &pred, &sel) == ISON_OK);
+    assert(sel.count == 2 && sel.rows[0] == 0 && sel.rows[1] == 4);
+    ison_selection_free(&sel);
+    
+    ison_reference_t owner_ref = { "1", "user", NULL };
+    ison_value_t owners[] = { ison_string("1"), { ISON_TYPE_REFERENCE, ISON_VALUE_BORROWED, { .ref_val = owner_ref } } };
+    pred = (ison_predicate_t){ "owner", ISON_CMP_IN, ison_null(), owners, 2 };
+    assert(ison_block_filter(block, &pred, &sel) == ISON_OK);
+    assert(sel.count == 2 && sel.rows[0] == 0 && sel.rows[1] == 2);
+    ison_selection_free(&sel);
+    pred = (ison_predicate_t){ "price", ISON_CMP_IS_NULL, ison_null(), NULL, 0 };
+    assert(ison_block_filter(block, &pred, &sel) == ISON_OK && sel.count == 1 && sel.rows[0] == 2);
+    ison_selection_free(&sel);
+    
+    output = ison_dumps_selection(block, &stocked, NULL);
+    assert(strcmp(output, "table.products\nsku name price stock owner\n"
+                          "1 apple 1.5 10 :user:1\n3 banana ~ 25 :user:1\n4 cherry 7.25 5 ~\n") == 0);
+    free(output);
+    assert(ison_block_aggregate_selection(block, "price", &stocked, &agg));
+    assert(agg.count == 3 && agg.numeric == 2 && agg.sum == 8.75);
+    ison_block_t *subset = ison_block_select(block, &cheap);
+    assert(subset && subset->row_count == 2 && subset->field_count == 5);
+    assert(ison_row_get_ptr(subset->rows[1], "name") != ison_row_get_ptr(block->rows[4], "name"));
+    assert(strcmp(ison_value_string(ison_row_get_ptr(subset->rows[1], "name")), "avocado") == 0);
+    ison_block_free(subset);
+    ison_selection_free(&cheap);
+    ison_selection_free(&stocked);
+    ison_document_free(doc);
+    
+    block = ison_block_create("table", "wide");
+    ison_block_add_field(block, "n", "int");
+    for (int i = 0; i < 3000; i++) {
+        row = ison_row_create();
+        ison_value_t n = ison_int(i % 7);
+        ison_row_set(row, "n", &n);
+        ison_block_take_row(block, row);
+    }
+    pred = (ison_predicate_t){ "n", ISON_CMP_GE, ison_int(5), NULL, 0 };
+    assert(ison_block_filter(block, &pred, &sel) == ISON_OK && sel.count == 856);
+    pred.op = ISON_CMP_EQ;
+    pred.value = ison_float(6.0);
+    assert(ison_block_filter_refine(block, &pred, &sel) == ISON_OK && sel.count == 428);
+    for (size_t i = 0; i < sel.count; i++) assert(sel.rows[i] % 7 == 6);
+    ison_selection_free(&sel);
+    ison_block_free(block);
+    printf("PASS\n");
+    
+    printf("Test: Block sort... ");
+    fflush(stdout);
+    
+    doc = ison_parse("table.people\nid team name score\n"
+                     "1 red \"carol long-name\" 7\n2 blue alice 9\n3 red \"carol long-name b\" ~\n"
+                     "4 ~ bob 9\n5 blue dave 2.5\n6 red anna 7\n", &err);
+    assert(doc && err == ISON_OK);
+    block = ison_document_get(doc, "people");
+    ison_index_t *id_index = ison_block_build_index(block, "id");
+    
+    ison_sort_key_t by_team_name[] = { { "team", false, false }, { "name", false, false } };
+    assert(ison_block_sort(block, by_team_name, 2) == ISON_OK);
+    int64_t expect_ids[] = { 2, 5, 6, 1, 3, 4 };
+    for (size_t i = 0; i < 6; i++) {
+        assert(ison_row_get_ptr(block->rows[i], "id")->data.int_val == expect_ids[i]);
+    }
+    ison_value_t find_id = ison_int(4);
+    const size_t *found;
+    assert(ison_block_find(block, id_index, &find_id, &found) == 1 && found[0] == 5);
+    
+    ison_sort_key_t by_score[] = { { "score", true, true } };
+    assert(ison_block_sort(block, by_score, 1) == ISON_OK);
+    int64_t expect_scores[] = { 3, 2, 4, 6, 1, 5 };
+    for (size_t i = 0; i < 6; i++) {
+        assert(ison_row_get_ptr(block->rows[i], "id")->data.int_val == expect_scores[i]);
+    }
+    ison_document_free(doc);
+    
+    block = ison_block_create("table", "big");
+    ison_block_add_field(block, "k", "int");
+    ison_block_add_field(block, "v", "float");
+    for (int i = 0; i < 40000; i++) {
+        row = ison_row_create();
+        ison_value_t k = ison_int((i * 7919) % 1000 - 500);
+        ison_value_t v = i % 10 == 0 ? ison_null() : ison_float((double)((i * 31) % 977) / 8.0);
+        ison_row_set(row, "k", &k);
+        ison_row_set(row, "v", &v);
+        ison_block_take_row(block, row);
+    }
+    ison_sort_key_t by_k_v[] = { { "k", false, false }, { "v", true, false } };
+    assert(ison_block_sort(block, by_k_v, 2) == ISON_OK);
+    for (size_t i = 1; i < block->row_count; i++) {
+        int64_t k0 = ison_row_get_ptr(block->rows[i - 1], "k")->data.int_val;
+        int64_t k1 = ison_row_get_ptr(block->rows[i], "k")->data.int_val;
+        assert(k0 <= k1);
+        if (k0 < k1) continue;
+        ison_value_t *v0 = ison_row_get_ptr(block->rows[i - 1], "v");
+        ison_value_t *v1 = ison_row_get_ptr(block->rows[i], "v");
+        assert(v1->type == ISON_TYPE_NULL || (v0->type == ISON_TYPE_FLOAT && v0->data.float_val >= v1->data.float_val));
+    }
+    ison_sort_key_t by_text[] = { { "k", false, false } };
+    ison_value_t odd = ison_string("not a number");
+    ison_row_set(block->rows[0], "k", &odd);
+    assert(ison_block_sort(block, by_text, 1) == ISON_OK);
+    assert(ison_row_get_ptr(block->rows[block->row_count - 1], "k")->type == ISON_TYPE_STRING);
+    for (size_t i = 1; i + 1 < block->row_count; i++) {
+        assert(ison_row_get_ptr(block->rows[i - 1], "k")->data.int_val <=
+               ison_row_get_ptr(block->rows[i], "k")->data.int_val);
+    }
+    ison_block_free(block);
+    printf("PASS\n");
+    
+    printf("Test: Group by... ");
+    fflush(stdout);
+    
+    doc = ison_parse("table.requests\nendpoint status latency\n"
+                     "/a 200 10\n/b 200 30\n/a 500 20.5\n/b 200 ~\n\"/a\" 200 12\n~ 404 5\n/c 200 :x:1\n",
+                     &err);
+    assert(doc && err == ISON_OK);
+    block = ison_document_get(doc, "requests");
+    const char *by_endpoint[] = { "endpoint" };
+    ison_group_agg_t per_endpoint[] = {
+        { NULL, ISON_AGG_COUNT, NULL },
+        { "latency", ISON_AGG_MEAN, NULL },
+        { "latency", ISON_AGG_MAX, "worst" },
+        { "latency", ISON_AGG_COUNT_NON_NULL, NULL }
+    };
+    ison_block_t *grouped = ison_block_group_by(block, by_endpoint, 1, per_endpoint, 4);
+    assert(grouped && grouped->row_count == 4 && grouped->field_count == 5);
+    assert(strcmp(grouped->fields[1].name, "count") == 0);
+    assert(strcmp(grouped->fields[2].name, "avg_latency") == 0);
+    assert(strcmp(grouped->fields[3].name, "worst") == 0);
+    assert(strcmp(grouped->fields[4].name, "count_latency") == 0);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(grouped->rows[0], "endpoint")), "/a") == 0);
+    assert(ison_row_get_ptr(grouped->rows[0], "count")->data.int_val == 3);
+    assert(ison_row_get_ptr(grouped->rows[0], "avg_latency")->data.float_val == 42.5 / 3);
+    assert(ison_row_get_ptr(grouped->rows[0], "worst")->data.float_val == 20.5);
+    assert(ison_row_get_ptr(grouped->rows[1], "worst")->type == ISON_TYPE_INT);
+    assert(ison_row_get_ptr(grouped->rows[1], "count_latency")->data.int_val == 1);
+    assert(ison_row_get_ptr(grouped->rows[2], "endpoint")->type == ISON_TYPE_NULL);
+    assert(ison_row_get_ptr(grouped->rows[3], "avg_latency")->type == ISON_TYPE_NULL);
+    assert(ison_row_get_ptr(grouped->rows[3], "count_latency")->data.int_val == 1);
+    ison_block_free(grouped);
+    
+    const char *by_pair[] = { "endpoint", "status" };
+    ison_group_agg_t total[] = { { "latency", ISON_AGG_SUM, NULL } };
+    grouped = ison_block_group_by(block, by_pair, 2, total, 1);
+    assert(grouped && grouped->row_count == 5);
+    assert(ison_row_get_ptr(grouped->rows[0], "sum_latency")->data.int_val == 22);
+    assert(ison_row_get_ptr(grouped->rows[2], "status")->data.int_val == 500);
+    ison_block_free(grouped);
+    const char *by_region[] = { "region" };
+    assert(ison_block_group_by(block, by_region, 1, total, 1) == NULL);
+    ison_document_free(doc);
+    
+    block = ison_block_create("table", "events");
+    ison_block_add_field(block, "k", "int");
+    ison_block_add_field(block, "v", "int");
+    for (int i = 0; i < 100000; i++) {
+        row = ison_row_create();
+        ison_value_t k = i % 3 == 0 ? ison_float((double)(i % 1000)) : ison_int(i % 1000);
+        ison_value_t v = ison_int(i);
+        ison_row_set(row, "k", &k);
+        ison_row_set(row, "v", &v);
+        ison_block_take_row(block, row);
+    }
+    const char *by_k[] = { "k" };
+    ison_group_agg_t sums[] = { { "v", ISON_AGG_SUM, NULL }, { "v", ISON_AGG_MIN, NULL } };
+    grouped = ison_block_group_by(block, by_k, 1, sums, 2);
+    assert(grouped && grouped->row_count == 1000);
+    for (size_t g = 0; g < grouped->row_count; g++) {
+        /* Keys 0..999 first appear in order; each group is {g, g + 1000, ...} */
+        assert(ison_row_get_ptr(grouped->rows[g], "min_v")->data.int_val == (int64_t)g);
+        assert(ison_row_get_ptr(grouped->rows[g], "sum_v")->data.int_val ==
+               (int64_t)(100 * g + 1000 * 4950));
+    }
+    ison_block_free(grouped);
+    ison_block_free(block);
+    printf("PASS\n");
+    
+    printf("Test: Block join... ");
+    fflush(stdout);
+    
+    doc = ison_parse("table.users\nid name\n1 Alice\n2 Bob\n\"3\" Carol\n2 Bobby\n\n"
+                     "table.orders\nid user total\n10 :user:2 5\n11 :user:9 7\n12 :user:1 3\n"
+                     "13 ~ 1\n14 3 8\n", &err);
+    assert(doc && err == ISON_OK);
+    ison_block_t *purchases = ison_document_get(doc, "orders");
+    users = ison_document_get(doc, "users");
+    
+    ison_join_pairs_t pairs;
+    assert(ison_block_join_pairs(purchases, "user", users, "id", ISON_JOIN_INNER, 0, &pairs) == ISON_OK);
+    size_t expect_left[] = { 0, 0, 2, 4 }, expect_right[] = { 1, 3, 0, 2 };
+    assert(pairs.count == 4);
+    for (size_t i = 0; i < pairs.count; i++) {
+        assert(pairs.left[i] == expect_left[i] && pairs.right[i] == expect_right[i]);
+    }
+    ison_join_pairs_free(&pairs);
+    assert(ison_block_join_pairs(purchases, "user", users, "id", ISON_JOIN_SEMI, 0, &pairs) == ISON_OK);
+    assert(pairs.count == 3 && pairs.left[0] == 0 && pairs.right[0] == 1 && pairs.left[2] == 4);
+    ison_join_pairs_free(&pairs);
+    assert(ison_block_join_pairs(purchases, "buyer", users, "id", ISON_JOIN_INNER, 0, &pairs) == ISON_ERROR_INVALID);
+    
+    ison_block_t *joined = ison_block_join(purchases, "user", users, "id", ISON_JOIN_LEFT);
+    assert(joined && joined->row_count == 6 && joined->field_count == 4);
+    assert(strcmp(joined->fields[3].name, "name") == 0);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(joined->rows[1], "name")), "Bobby") == 0);
+    assert(ison_row_get_ptr(joined->rows[2], "id")->data.int_val == 11);
+    assert(ison_row_get_ptr(joined->rows[2], "name")->type == ISON_TYPE_NULL);
+    assert(ison_row_get_ptr(joined->rows[4], "name")->type == ISON_TYPE_NULL);
+    ison_block_free(joined);
+    joined = ison_block_join(users, "id", purchases, "user", ISON_JOIN_INNER);
+    assert(joined && joined->row_count == 4 && strcmp(joined->fields[2].name, "orders_id") == 0);
+    assert(ison_row_get_ptr(joined->rows[0], "orders_id")->data.int_val == 12);
+    ison_block_free(joined);
+    ison_document_free(doc);
+    
+    ison_block_t *facts = ison_block_create("table", "facts");
+    ison_block_t *dims = ison_block_create("table", "dims");
+    ison_block_add_field(facts, "k", "string");
+    ison_block_add_field(dims, "k", "int");
+    for (int i = 0; i < 5000; i++) {
+        char text[16];
+        snprintf(text, sizeof(text), i % 2 ? "%d" : "k%d", i % 3000);
+        row = ison_row_create();
+        ison_value_t k = ison_string(text);
+        ison_row_set(row, "k", &k);
+        ison_block_take_row(facts, row);
+    
+        row = ison_row_create();
+        k = i % 2 ? ison_int(i) : ison_string(text);
+        ison_row_set(row, "k", &k);
+        ison_block_take_row(dims, row);
+    }
+    row = ison_row_create();
+    val = ison_null();
+    ison_row_set(row, "k", &val);
+    ison_block_take_row(facts, row);
+    ison_join_pairs_t spilled;
+    assert(ison_block_join_pairs(facts, "k", dims, "k", ISON_JOIN_LEFT, 0, &pairs) == ISON_OK);
+    assert(ison_block_join_pairs(facts, "k", dims, "k", ISON_JOIN_LEFT, 4096, &spilled) == ISON_OK);
+    assert(pairs.count == spilled.count && pairs.count > facts->row_count);
+    assert(memcmp(pairs.left, spilled.left, pairs.count * sizeof(size_t)) == 0);
+    assert(memcmp(pairs.right, spilled.right, pairs.count * sizeof(size_t)) == 0);
+    ison_join_pairs_free(&pairs);
+    ison_join_pairs_free(&spilled);
+    ison_block_free(facts);
+    ison_block_free(dims);
+    printf("PASS\n");
+    
+    printf("Test: Distinct values... ");
+    fflush(stdout);
+    
+    doc = ison_parse("table.events\nid user kind\n1 :user:1 click\n2 :user:2 view\n1 :user:1 click\n"
+                     "3 :user:1 click\n1.0 :user:1 click\n4 ~ view\n5 ~ click\n", &err);
+    assert(doc && err == ISON_OK);
+    block = ison_document_get(doc, "events");
+    assert(ison_block_count_distinct(block, "user") == 3);
+    assert(ison_block_count_distinct(block, "nope") == (size_t)-1);
+    ison_block_t *distinct = ison_block_distinct(block, "kind");
+    assert(distinct && distinct->row_count == 2);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(distinct->rows[1], "kind")), "view") == 0);
+    ison_block_free(distinct);
+    distinct = ison_block_distinct(block, "user");
+    assert(distinct && distinct->row_count == 3);
+    assert(ison_row_get_ptr(distinct->rows[1], "user")->type == ISON_TYPE_REFERENCE);
+    assert(ison_row_get_ptr(distinct->rows[2], "user")->type == ISON_TYPE_NULL);
+    ison_block_free(distinct);
+    
+    ison_index_t *by_kind = ison_block_build_index(block, "kind");
+    size_t removed;
+    assert(ison_block_dedup(block, NULL, 0, &removed) == ISON_OK && removed == 2);
+    assert(block->row_count == 5 && ison_row_get_ptr(block->rows[2], "id")->data.int_val == 3);
+    const char *user_kind[] = { "user", "kind" };
+    assert(ison_block_dedup(block, user_kind, 2, &removed) == ISON_OK && removed == 1);
+    assert(block->row_count == 4 && ison_row_get_ptr(block->rows[2], "id")->data.int_val == 4);
+    val = ison_string("click");
+    assert(ison_block_find(block, by_kind, &val, &found) == 2 && found[1] == 3);
+    const char *bad_cols[] = { "nope" };
+    assert(ison_block_dedup(block, bad_cols, 1, &removed) == ISON_ERROR_INVALID);
+    ison_document_free(doc);
+    
+    val = ison_int(7);
+    ison_value_t same = ison_float(7.0);
+    ison_value_t nan_a = ison_float(0.0 / 0.0), nan_b = ison_float(0.0 / 0.0);
+    assert(ison_value_equal(&val, &same) && ison_value_hash(&val) == ison_value_hash(&same));
+    assert(ison_value_equal(&nan_a, &nan_b) && ison_value_hash(&nan_a) == ison_value_hash(&nan_b));
+    assert(ison_value_equal(NULL, &(ison_value_t){ .type = ISON_TYPE_NULL }));
+    ison_value_t no_str = ison_string(NULL), empty = ison_string("");
+    assert(ison_value_equal(&no_str, &no_str) && ison_value_equal(&no_str, &empty));
+    assert(ison_value_hash(&no_str) == ison_value_hash(&empty));
+    
+    ison_hll_t *hll = ison_hll_create(12);
+    ison_hll_t *other = ison_hll_create(12);
+    assert(hll && other && ison_hll_create(3) == NULL);
+    for (int i = 0; i < 20000; i++) {
+        val = ison_int(i);
+        ison_hll_add(i % 2 ? hll : other, &val);
+    }
+    for (int i = 0; i < 20000; i++) {
+        val = ison_int(i);
+        ison_hll_add(hll, &val);
+    }
+    assert(ison_hll_merge(hll, other));
+    double estimate = ison_hll_estimate(hll);
+    assert(estimate > 19000 && estimate < 21000);
+    ison_hll_free(other);
+    ison_hll_free(hll);
+    
+    block = ison_block_create("table", "clicks");
+    ison_block_add_field(block, "user", "ref");
+    for (int i = 0; i < 120000; i++) {
+        char id[16];
+        snprintf(id, sizeof(id), "%d", i % 50000);
+        row = ison_row_create();
+        val.type = ISON_TYPE_REFERENCE;
+        val.flags = 0;
+        val.data.ref_val = ison_reference_make(id, "user", NULL);
+        ison_row_set(row, "user", &val);
+        ison_block_take_row(block, row);
+    }
+    estimate = ison_block_estimate_distinct(block, "user");
+    assert(estimate > 48000 && estimate < 52000);
+    assert(ison_block_count_distinct(block, "user") == 50000);
+    ison_block_free(block);
+    printf("PASS\n");
+    
+    printf("Test: Document diff... ");
+    fflush(stdout);
+    
+    const char *old_text = "table.users\nid name score\n1 Alice 10\n2 Bob 20\n3 Cara 30\n\n"
+                         "table.tags\nname weight\nred 1\nblue 2\nred 1\n\n"
+                         "table.old\nx\n1\n";
+    const char *new_text = "table.users\nid name score\n3 Cara 31\n1 Alice 10\n4 Dan 40\n\n"
+                        "table.tags\nname weight\nred 1\nblue 2.5\nred 1\n\n"
+                        "table.fresh\ny\ntrue\n";
+    ison_document_t *doc_a = ison_parse(old_text, &err);
+    ison_document_t *doc_b = ison_parse(new_text, &err);
+    assert(doc_a && doc_b);
+    ison_document_t *patch = ison_document_diff(doc_a, doc_b);
+    assert(patch && strcmp(patch->blocks[0]->name, "_diff") == 0);
+    ison_block_t *meta = patch->blocks[0];
+    assert(meta->row_count == 4);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(meta->rows[0], "key")), "id") == 0);
+    assert(ison_row_get_ptr(meta->rows[1], "key")->type == ISON_TYPE_NULL);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(meta->rows[2], "op")), "add") == 0);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(meta->rows[3], "op")), "remove") == 0);
+    
+    block = ison_document_get(patch, "users");
+    assert(block && block->row_count == 3);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(block->rows[0], "_op")), "change") == 0);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(block->rows[0], "_cols")), "score") == 0);
+    assert(ison_row_get_ptr(block->rows[0], "name")->type == ISON_TYPE_NULL);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(block->rows[1], "_op")), "add") == 0);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(block->rows[2], "_op")), "remove") == 0);
+    assert(ison_row_get_ptr(block->rows[2], "id")->data.int_val == 2);
+    block = ison_document_get(patch, "tags");
+    assert(block && block->row_count == 2);
+    
+    /* The patch survives a trip through ISON text */
+    output = ison_dumps(patch);
+    assert(output);
+    ison_document_free(patch);
+    patch = ison_parse(output, &err);
+    ison_free(output);
+    assert(patch && err == ISON_OK);
+    assert(ison_document_apply_patch(doc_a, patch) == ISON_OK);
+    assert(doc_a->block_count == 3 && !ison_document_get(doc_a, "old"));
+    block = ison_document_get(doc_a, "users");
+    assert(block->row_count == 3 && ison_row_get_ptr(block->rows[2], "id")->data.int_val == 4);
+    assert(ison_row_get_ptr(block->rows[1], "score")->data.int_val == 31);
+    assert(ison_document_apply_patch(doc_a, patch) == ISON_ERROR_INVALID);
+    ison_document_free(patch);
+    patch = ison_document_diff(doc_a, doc_b);
+    assert(patch && patch->block_count == 1 && patch->blocks[0]->row_count == 0);
+    ison_document_free(patch);
+    
+    /* Repeated ids fall back to row hashes */
+    ison_document_t *doc_c = ison_parse("table.users\nid name score\n1 Alice 10\n1 Alice 10\n", &err);
+    patch = ison_document_diff(doc_c, doc_b);
+    assert(patch && ison_row_get_ptr(patch->blocks[0]->rows[0], "key")->type == ISON_TYPE_NULL);
+    assert(ison_document_apply_patch(doc_c, patch) == ISON_OK);
+    ison_document_free(patch);
+    patch = ison_document_diff(doc_c, doc_b);
+    assert(patch && patch->blocks[0]->row_count == 0);
+    ison_document_free(patch);
+    ison_document_free(doc_c);
+    
+    /* String cells that look like numbers keep their type through a text patch */
+    doc_c = ison_parse("table.codes\nid code note\n1 \"42\" short\n2 \"7\" ~\n\n"
+                       "table.bag\nv\n\"7\"\n\"7\"\n", &err);
+    ison_document_t *doc_d = ison_parse("table.codes\nid code note\n1 \"43\" a_note_too_long_to_inline\n\n"
+                                        "table.bag\nv\n\"7\"\n", &err);
+    patch = ison_document_diff(doc_c, doc_d);
+    output = ison_dumps(patch);
+    ison_document_free(patch);
+    patch = ison_parse(output, &err);
+    ison_free(output);
+    assert(patch && ison_document_apply_patch(doc_c, patch) == ISON_OK);
+    ison_document_free(patch);
+    block = ison_document_get(doc_c, "codes");
+    assert(block->row_count == 1 && ison_row_get_ptr(block->rows[0], "code")->type == ISON_TYPE_STRING);
+    ison_block_t *recount = ison_block_select(block, NULL);
+    ison_memory_stats_t applied_stats, recount_stats;
+    ison_block_memory_stats(block, &applied_stats);
+    ison_block_memory_stats(recount, &recount_stats);
+    assert(applied_stats.strings == recount_stats.strings && applied_stats.strings > 0);
+    assert(applied_stats.entries == recount_stats.entries);
+    ison_block_free(recount);
+    assert(ison_document_get(doc_c, "bag")->row_count == 1);
+    patch = ison_document_diff(doc_c, doc_d);
+    assert(patch && patch->blocks[0]->row_count == 0);
+    ison_document_free(patch);
+    ison_document_free(doc_d);
+    ison_document_free(doc_c);
+    
+    /* Summary rows are changed, dropped, added and carried with whole blocks */
+    doc_c = ison_parse("table.t\nid v\n1 2\n---\n~ 2\n\ntable.s\nid v\n1 1\n---\n~ 1\n\n"
+                       "table.u\nid v\n1 1\n", &err);
+    doc_d = ison_parse("table.t\nid v\n1 2\n---\n~ 3\n\ntable.s\nid v\n1 1\n\n"
+                       "table.u\nid v\n1 1\n---\n~ 1\n\ntable.n\nk\nx\n---\nall\n", &err);
+    patch = ison_document_diff(doc_c, doc_d);
+    assert(patch && patch->blocks[0]->row_count == 4);
+    output = ison_dumps(patch);
+    ison_document_free(patch);
+    patch = ison_parse(output, &err);
+    ison_free(output);
+    assert(patch && ison_document_apply_patch(doc_c, patch) == ISON_OK);
+    ison_document_free(patch);
+    assert(ison_row_get_ptr(ison_document_get(doc_c, "t")->summary_row, "v")->data.int_val == 3);
+    assert(!ison_document_get(doc_c, "s")->summary_row);
+    assert(ison_document_get(doc_c, "u")->summary_row);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(ison_document_get(doc_c, "n")->summary_row, "k")), "all") == 0);
+    patch = ison_document_diff(doc_c, doc_d);
+    assert(patch && patch->blocks[0]->row_count == 0);
+    ison_document_free(patch);
+    ison_document_free(doc_d);
+    ison_document_free(doc_c);
+    
+    /* Rows align by the key column the options name */
+    doc_c = ison_parse("table.stock\nsku qty\nA 1\nB 2\n", &err);
+    doc_d = ison_parse("table.stock\nsku qty\nB 3\nA 1\n", &err);
+    ison_diff_options_t dopts = ison_default_diff_options();
+    dopts.key = NULL;
+    patch = ison_document_diff_with_options(doc_c, doc_d, &dopts);
+    assert(patch && ison_row_get_ptr(patch->blocks[0]->rows[0], "key")->type == ISON_TYPE_NULL);
+    ison_document_free(patch);
+    dopts.key = "sku";
+    patch = ison_document_diff_with_options(doc_c, doc_d, &dopts);
+    assert(patch && strcmp(ison_value_string(ison_row_get_ptr(patch->blocks[0]->rows[0], "key")), "sku") == 0);
+    block = ison_document_get(patch, "stock");
+    assert(block->row_count == 1 && strcmp(ison_value_string(ison_row_get_ptr(block->rows[0], "_op")), "change") == 0);
+    assert(ison_document_apply_patch(doc_c, patch) == ISON_OK);
+    ison_document_free(patch);
+    assert(ison_row_get_ptr(ison_document_get(doc_c, "stock")->rows[1], "qty")->data.int_val == 3);
+    ison_document_free(doc_d);
+    ison_document_free(doc_c);
+    
+    /* b emptied out: the unsummary row reads no cells of b */
+    doc_c = ison_parse("table.e\nid v\n1 1\n---\n~ 1\n", &err);
+    doc_d = ison_parse("table.e\nid v\n", &err);
+    assert(doc_c && doc_d && ison_document_get(doc_d, "e")->row_count == 0);
+    patch = ison_document_diff(doc_c, doc_d);
+    assert(patch && ison_document_get(patch, "e")->row_count == 2);
+    assert(ison_document_apply_patch(doc_c, patch) == ISON_OK);
+    ison_document_free(patch);
+    block = ison_document_get(doc_c, "e");
+    assert(block->row_count == 0 && !block->summary_row);
+    ison_document_free(doc_d);
+    ison_document_free(doc_c);
+    ison_document_free(doc_b);
+    ison_document_free(doc_a);
+    printf("PASS\n");
+    
+    printf("Test: ISONL merge... ");
+    fflush(stdout);
+    
+    const char *shard_paths[] = { "test_merge_0.isonl", "test_merge_1.isonl", "test_merge_2.isonl" };
+    assert(ison_write_file(shard_paths[0], "table.log|ts:int msg|1 a\ntable.log|ts:int msg|5 b\n"
+                                           "table.log|ts:int msg|~ z\n") == ISON_OK);
+    assert(ison_write_file(shard_paths[1], "# worker 1\ntable.log|ts:int msg|2 c\n\n"
+                                           "table.err|ts code|3.5 404\ntable.log|ts:int msg|5 d") == ISON_OK);
+    assert(ison_write_file(shard_paths[2], "") == ISON_OK);
+    assert(isonl_merge(shard_paths, 3, "ts", "test_merge_out.isonl") == ISON_OK);
+    output = ison_read_file("test_merge_out.isonl", NULL);
+    assert(output && strcmp(output, "table.log|ts:int msg|1 a\ntable.log|ts:int msg|2 c\n"
+                                    "table.err|ts code|3.5 404\ntable.log|ts:int msg|5 b\n"
+                                    "table.log|ts:int msg|5 d\ntable.log|ts:int msg|~ z") == 0);
+    ison_free(output);
+    
+    /* Merged output reads back like ison_dumps_isonl output */
+    doc = ison_load_isonl("test_merge_out.isonl", &err);
+    assert(doc && err == ISON_OK && ison_document_get(doc, "log")->row_count == 5);
+    output = ison_dumps_isonl(doc);
+    ison_document_free(doc);
+    doc = ison_parse_isonl(output, &err);
+    char *again = ison_dumps_isonl(doc);
+    assert(strcmp(output, again) == 0);
+    ison_free(again);
+    ison_free(output);
+    ison_document_free(doc);
+    
+    const char *no_such[] = { "test_merge_missing.isonl" };
+    assert(isonl_merge(no_such, 1, "ts", "test_merge_out.isonl") == ISON_ERROR_IO);
+    for (int i = 0; i < 3; i++) remove(shard_paths[i]);
+    remove("test_merge_out.isonl");
+    printf("PASS\n");
+    
+    printf("Test: ISONL external sort... ");
+    fflush(stdout);
+    
+    doc = ison_document_create();
+    block = ison_block_create("table", "log");
+    ison_block_add_field(block, "ts", "int");
+    ison_block_add_field(block, "msg", NULL);
+    for (int i = 0; i < 24000; i++) {
+        char msg[32];
+        snprintf(msg, sizeof(msg), "m%d", i % 977);
+        row = ison_row_create();
+        val = i % 50 ? ison_int((i * 7919) % 1000) : ison_null();
+        ison_row_set(row, "ts", &val);
+        val = ison_string(msg);
+        ison_row_set(row, "msg", &val);
+        ison_block_take_row(block, row);
+    }
+    ison_document_add_block(doc, block);
+    assert(ison_dump_isonl(doc, "test_sort_in.isonl") == ISON_OK);
+    
+    const ison_sort_key_t by_ts[] = { { "ts", false, false } };
+    const ison_sort_key_t by_msg_ts[] = { { "msg", true, false }, { "ts", false, true } };
+    const ison_sort_key_t *sort_specs[] = { by_ts, by_msg_ts };
+    size_t sort_spec_counts[] = { 1, 2 };
+    char *sorted_by_ts = NULL;
+    for (int s = 0; s < 2; s++) {
+        /* A tiny limit forces well over a merge fan-in's worth of runs */
+        assert(isonl_sort_file("test_sort_in.isonl", "test_sort_out.isonl", sort_specs[s],
+                               sort_spec_counts[s], 1) == ISON_OK);
+        output = ison_read_file("test_sort_out.isonl", NULL);
+        assert(ison_block_sort(block, sort_specs[s], sort_spec_counts[s]) == ISON_OK);
+        char *expected = ison_dumps_isonl(doc);
+        assert(output && expected && strcmp(output, expected) == 0);
+        ison_free(expected);
+        if (s == 0) sorted_by_ts = output;
+        else ison_free(output);
+    }
+    
+    /* In one batch, sorting in place */
+    assert(isonl_sort_file("test_sort_in.isonl", "test_sort_in.isonl", by_ts, 1, 0) == ISON_OK);
+    output = ison_read_file("test_sort_in.isonl", NULL);
+    assert(output && strcmp(output, sorted_by_ts) == 0);
+    ison_free(sorted_by_ts);
+    ison_free(output);
+    ison_document_free(doc);
+    assert(isonl_sort_file("test_sort_missing.isonl", "test_sort_out.isonl", by_ts, 1, 0) == ISON_ERROR_IO);
+    assert(isonl_sort_file("test_sort_in.isonl", "test_sort_out.isonl", by_ts, 0, 0) == ISON_ERROR_INVALID);
+    remove("test_sort_in.isonl");
+    remove("test_sort_out.isonl");
+    
+    /* Floats keep their type and every digit through encode and decode */
+    const char *float_lines = "table.m|x|2.0\ntable.m|x|0.1\ntable.m|x|3.141592653589793\ntable.m|x|1e+300";
+    doc = ison_parse_isonl(float_lines, &err);
+    output = ison_dumps_isonl(doc);
+    assert(output && strcmp(output, float_lines) == 0);
+    ison_free(output);
+    ison_document_free(doc);
+    
+    /* Strings that read like other values stay strings after re-encoding */
+    assert(ison_write_file("test_sort_in.isonl", "table.m|k v|2 \"42\"\ntable.m|k v|1 \"true\"\n"
+                                                "table.m|k v|3 \"~\"\n") == ISON_OK);
+    const ison_sort_key_t by_k_sort[] = { { "k", false, false } };
+    assert(isonl_sort_file("test_sort_in.isonl", "test_sort_out.isonl", by_k_sort, 1, 0) == ISON_OK);
+    doc = ison_load_isonl("test_sort_out.isonl", &err);
+    block = ison_document_get(doc, "m");
+    assert(block && block->row_count == 3);
+    const char *texts[] = { "true", "42", "~" };
+    for (int i = 0; i < 3; i++) {
+        const ison_value_t *v = ison_row_get_ptr(block->rows[i], "v");
+        assert(v->type == ISON_TYPE_STRING && strcmp(ison_value_string(v), texts[i]) == 0);
+    }
+    ison_document_free(doc);
+    remove("test_sort_in.isonl");
+    remove("test_sort_out.isonl");
+    
+    const char *tricky[] = { "", "-7", "1e5", "inf", "NULL", "False", ":user:1", "#x", "---",
+                             "table.x", "a\\b", "plain" };
+    doc = ison_document_create();
+    block = ison_block_create("table", "t");
+    ison_block_add_field(block, "a", NULL);
+    ison_block_add_field(block, "b", NULL);
+    for (size_t i = 0; i < sizeof(tricky) / sizeof(tricky[0]); i++) {
+        row = ison_row_create();
+        val = ison_string(tricky[i]);
+        ison_row_set(row, "a", &val);
+        ison_row_set(row, "b", &val);
+        ison_block_take_row(block, row);
+    }
+    ison_document_add_block(doc, block);
+    char *tricky_texts[] = { ison_dumps(doc), ison_dumps_isonl(doc) };
+    ison_document_free(doc);
+    for (int f = 0; f < 2; f++) {
+        doc = f ? ison_parse_isonl(tricky_texts[f], &err) : ison_parse(tricky_texts[f], &err);
+        block = ison_document_get(doc, "t");
+        assert(block && block->row_count == sizeof(tricky) / sizeof(tricky[0]));
+        for (size_t i = 0; i < block->row_count; i++) {
+            const ison_value_t *v = ison_row_get_ptr(block->rows[i], "a");
+            assert(v->type == ISON_TYPE_STRING && strcmp(ison_value_string(v), tricky[i]) == 0);
+            assert(ison_value_equal(v, ison_row_get_ptr(block->rows[i], "b")));
+        }
+        ison_document_free(doc);
+        ison_free(tricky_texts[f]);
+    }
+    printf("PASS\n");
+    
+    printf("Test: Block lookup index... ");
+    fflush(stdout);
+    
+    doc = ison_document_create();
+    char block_name[32];
+    for (int i = 0; i < 300; i++) {
+        snprintf(block_name, sizeof(block_name), "t%d", i);
+        ison_document_add_block(doc, ison_block_create("table", block_name));
+    }
+    ison_document_add_block(doc, ison_block_create("object", "t7"));
+    assert(doc->block_count == 300 && doc->order_count == 300);
+    for (int i = 0; i < 300; i++) {
+        snprintf(block_name, sizeof(block_name), "t%d", i);
+        block = ison_document_get(doc, block_name);
+        assert(block != NULL && strcmp(block->name, block_name) == 0);
+        assert(strcmp(doc->order[i], block_name) == 0);
+    }
+    assert(strcmp(ison_document_get(doc, "t7")->kind, "object") == 0);
+    assert(ison_document_get(doc, "t300") == NULL);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Column hash index... ");
+    fflush(stdout);
+    
+    doc = ison_parse("table.users\nid name\n1 Alice\n2 Bob\n3 Alice\n", &err);
+    users = ison_document_get(doc, "users");
+    ison_index_t *by_id = ison_block_build_index(users, "id");
+    ison_index_t *by_name = ison_block_build_index(users, "name");
+    assert(by_id && by_name && ison_block_build_index(users, "id") == by_id);
+    
+    const size_t *hits;
+    val = ison_int(2);
+    assert(ison_block_find(users, by_id, &val, &hits) == 1 && hits[0] == 1);
+    val = ison_string("Alice");
+    assert(ison_block_find(users, by_name, &val, &hits) == 2 && hits[0] == 0 && hits[1] == 2);
+    ison_value_free(&val);
+    
+    row = ison_row_create();
+    val = ison_int(42);
+    ison_row_set(row, "id", &val);
+    ison_block_add_row(users, row);
+    ison_row_free(row);
+    
+    ison_reference_t target = ison_reference_make("42", "users", NULL);
+    val = ison_ref(&target);
+    assert(ison_block_find(users, by_id, &val, &hits) == 1 && hits[0] == 3);
+    ison_value_free(&val);
+    ison_reference_free(&target);
+    val = ison_int(7);
+    assert(ison_block_find(users, by_id, &val, &hits) == 0 && hits == NULL);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Range index... ");
+    fflush(stdout);
+    
+    doc = ison_parse("table.catalog\nid price tag\n1 9.5 b\n2 3 a\n3 12 c\n4 ~ a\n5 7 d\n", &err);
+    ison_block_t *catalog = ison_document_get(doc, "catalog");
+    ison_range_index_t *by_price = ison_block_build_range_index(catalog, "price");
+    ison_range_index_t *by_tag = ison_block_build_range_index(catalog, "tag");
+    assert(by_price && by_tag && ison_block_build_range_index(catalog, "price") == by_price);
+    
+    ison_value_t lo = ison_int(3), hi = ison_float(9.5);
+    assert(ison_range_query(by_price, &lo, true, &hi, true, &hits) == 3);
+    assert(hits[0] == 1 && hits[1] == 4 && hits[2] == 0);
+    assert(ison_range_query(by_price, &lo, false, &hi, false, &hits) == 1 && hits[0] == 4);
+    assert(ison_range_query(by_price, NULL, false, NULL, false, &hits) == 4);
+    assert(ison_range_top(by_price, 2, true, &hits) == 2 && hits[0] == 0 && hits[1] == 2);
+    
+    row = ison_row_create();
+    val = ison_int(1);
+    ison_row_set(row, "price", &val);
+    ison_block_add_row(catalog, row);
+    ison_row_free(row);
+    assert(ison_range_top(by_price, 1, false, &hits) == 1 && hits[0] == 5);
+    
+    lo = ison_string("b");
+    assert(ison_range_query(by_tag, &lo, true, NULL, false, &hits) == 3);
+    assert(hits[0] == 0 && hits[1] == 2 && hits[2] == 4);
+    ison_value_free(&lo);
+    ison_block_drop_range_index(catalog, by_tag);
+    assert(catalog->range_index_count == 1);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
     printf("Test: ISON to JSON... ");
     fflush(stdout);
     
@@ -106,6 +1130,12 @@ int main(void) {
     assert(strstr(json, "\"id\"") != NULL);
     assert(strstr(json, "\"name\"") != NULL);
     free(json);
+    
+    /* Floats keep every digit, as in ISON text */
+    val = ison_float(0.1 + 0.2);
+    json = ison_value_to_json(&val);
+    assert(json && strcmp(json, "0.30000000000000004") == 0);
+    ison_free(json);
     printf("PASS\n");
     
     printf("Test: References... ");
@@ -136,10 +1166,295 @@ int main(void) {
     ref_val = ison_row_get_ptr(orders->rows[2], "user_id");
     assert(strcmp(ref_val->data.ref_val.relationship, "OWNS") == 0);
     assert(strcmp(ref_val->data.ref_val.id, "5") == 0);
+    assert(ref_val->data.ref_val.relationship == ref_val->data.ref_val.id + 2);
+    
+    ison_value_t value_copy = ison_value_copy(ref_val);
+    assert(value_copy.flags == ISON_VALUE_SHARED_REF);
+    assert(value_copy.data.ref_val.relationship == value_copy.data.ref_val.id + 2);
+    ison_value_free(&value_copy);
+    assert(value_copy.data.ref_val.id == NULL);
+    
+    ison_reference_t ref_copy = ison_reference_copy(&ref_val->data.ref_val);
+    assert(ison_reference_is_relationship(&ref_copy) && strcmp(ref_copy.relationship, "OWNS") == 0);
+    ison_reference_free(&ref_copy);
+    
+    ref_copy.id = malloc(3);
+    ref_copy.ns = malloc(5);
+    ref_copy.relationship = NULL;
+    strcpy(ref_copy.id, "42");
+    strcpy(ref_copy.ns, "user");
+    ison_reference_free(&ref_copy);
+    assert(ref_copy.id == NULL && ref_copy.ns == NULL);
     
     ison_document_free(doc);
     printf("PASS\n");
     
+    printf("Test: Reference resolution... ");
+    fflush(stdout);
+    
+    doc = ison_parse(
+        "table.users\nid name\n1 Alice\n42 Bob\n\n"
+        "table.teams\nslug title\ncore Core\n\n"
+        "table.orders\nid user team owner\n1 :user:42 :teams:core :OWNS:1\n", &err);
+    orders = ison_document_get(doc, "orders");
+    
+    ref_val = ison_row_get_ptr(orders->rows[0], "user");
+    ison_row_t *target_row = ison_document_resolve(doc, &ref_val->data.ref_val);
+    assert(target_row != NULL);
+    assert(strcmp(ison_value_string(ison_row_get_ptr(target_row, "name")), "Bob") == 0);
+    
+    ref_val = ison_row_get_ptr(orders->rows[0], "team");
+    target_row = ison_document_resolve(doc, &ref_val->data.ref_val);
+    assert(target_row && strcmp(ison_value_string(ison_row_get_ptr(target_row, "title")), "Core") == 0);
+    
+    ref_val = ison_row_get_ptr(orders->rows[0], "owner");
+    ison_block_t *target_block;
+    size_t target_index;
+    assert(ison_ref_index_lookup(doc->ref_index, &ref_val->data.ref_val, &target_block, &target_index));
+    assert(strcmp(target_block->name, "users") == 0 && target_index == 0);
+    
+    ison_reference_t missing = {"9", "users", NULL};
+    assert(ison_document_resolve(doc, &missing) == NULL);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Packed values... ");
+    fflush(stdout);
+    
+    doc = ison_parse("table.orders\nid user total note\n1 :user:7 9.5 rush\n2 :user:7 ~ \"leave at the back door\"\n3 :OWNS:8 12 true\n---\n~ ~ 21.5 ~\n", &err);
+    ison_packed_t *packed = ison_document_pack(doc);
+    assert(packed && sizeof(ison_packed_value_t) == 16);
+    size_t packed_rows, packed_fields;
+    const ison_packed_value_t *cells = ison_packed_cells(packed, "orders", &packed_rows, &packed_fields);
+    assert(cells && packed_rows == 3 && packed_fields == 4);
+    assert(ison_packed_reference_count(packed) == 2);
+    assert(cells[1].payload.offset == cells[5].payload.offset);
+    
+    ison_value_t decoded;
+    assert(ison_packed_decode(packed, &cells[2], &decoded) && decoded.data.float_val == 9.5);
+    assert(ison_packed_decode(packed, &cells[6], &decoded) && decoded.type == ISON_TYPE_NULL);
+    assert(ison_packed_decode(packed, &cells[3], &decoded) && strcmp(ison_value_string(&decoded), "rush") == 0);
+    assert(ison_packed_decode(packed, &cells[7], &decoded) && (decoded.flags & ISON_VALUE_BORROWED));
+    assert(strcmp(ison_value_string(&decoded), "leave at the back door") == 0);
+    ison_value_free(&decoded);
+    assert(ison_packed_decode(packed, &cells[9], &decoded) && decoded.type == ISON_TYPE_REFERENCE);
+    assert(strcmp(decoded.data.ref_val.id, "8") == 0 && strcmp(decoded.data.ref_val.relationship, "OWNS") == 0);
+    ison_value_free(&decoded);
+    assert(ison_packed_cells(packed, "missing", NULL, NULL) == NULL);
+    
+    /* The packed form stands alone once the rows are gone */
+    output = ison_dumps(doc);
+    ison_document_free(doc);
+    doc = ison_packed_unpack(packed);
+    char *unpacked = ison_dumps(doc);
+    assert(output && unpacked && strcmp(output, unpacked) == 0);
+    ison_free(unpacked);
+    ison_free(output);
+    ison_document_free(doc);
+    block = ison_packed_block(packed, "orders");
+    assert(block && block->row_count == 3 && ison_packed_block(packed, "missing") == NULL);
+    ison_block_free(block);
+    ison_packed_free(packed);
+    
+    /* Numeric cells take about half the memory of rows */
+    doc = ison_document_create();
+    block = ison_block_create("table", "grid");
+    ison_block_add_field(block, "x", "int");
+    ison_block_add_field(block, "y", "float");
+    for (int i = 0; i < 1000; i++) {
+        row = ison_row_create();
+        val = ison_int(i);
+        ison_row_set(row, "x", &val);
+        val = ison_float(i * 0.5);
+        ison_row_set(row, "y", &val);
+        ison_block_take_row(block, row);
+    }
+    ison_document_add_block(doc, block);
+    packed = ison_document_pack(doc);
+    ison_memory_stats_t row_mem, packed_mem;
+    ison_document_memory_stats(doc, &row_mem);
+    ison_packed_memory_stats(packed, &packed_mem);
+    assert(packed_mem.entries == 2000 * sizeof(ison_packed_value_t));
+    assert(packed_mem.total * 2 < row_mem.rows + row_mem.entries);
+    ison_packed_free(packed);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: Relationship graph... ");
+    fflush(stdout);
+    
+    doc = ison_parse(
+        "table.people\nid name manager team\n"
+        "1 Ann ~ :MEMBER_OF:10\n"
+        "2 Bob :REPORTS_TO:1 :MEMBER_OF:10\n"
+        "3 Cy :REPORTS_TO:2 ~\n"
+        "4 Di :REPORTS_TO:2 :MEMBER_OF:10\n\n"
+        "table.teams\nid name\n10 Core\n", &err);
+    ison_graph_t *graph = ison_graph_build(doc);
+    assert(graph != NULL);
+    assert(ison_graph_node_count(graph) == 5 && ison_graph_edge_count(graph) == 6);
+    
+    int reports_to = ison_graph_relationship(graph, "REPORTS_TO");
+    assert(reports_to >= 0 && ison_graph_relationship(graph, "OWNS") == -1);
+    
+    size_t cy, *hop;
+    assert(ison_graph_node(graph, ison_document_get(doc, "people"), 2, &cy));
+    size_t visited_count = 0;
+    assert(ison_graph_bfs(graph, cy, reports_to, 10, count_visit, &visited_count) == ISON_OK);
+    assert(visited_count == 3);
+    visited_count = 0;
+    assert(ison_graph_dfs(graph, cy, -1, 10, count_visit, &visited_count) == ISON_OK);
+    assert(visited_count == 4);
+    
+    size_t hops = ison_graph_khop(graph, 3, -1, 2, &hop);
+    assert(hops == 3 && hop[0] == 4 && hop[1] == 1 && hop[2] == 0);
+    ison_block_t *hop_block;
+    size_t hop_row;
+    assert(ison_graph_node_row(graph, hop[0], &hop_block, &hop_row));
+    assert(strcmp(hop_block->name, "teams") == 0 && hop_row == 0);
+    free(hop);
+    
+    ison_graph_free(graph);
+    ison_document_free(doc);
+    
+    /* A type hint naming a block picks the target over document order */
+    doc = ison_parse("table.people\nid team:team\n1 :MEMBER_OF:1\n2 :MEMBER_OF:1\n\n"
+                     "table.teams\nid name\n1 Core\n", &err);
+    graph = ison_graph_build(doc);
+    const uint32_t *members;
+    assert(graph && ison_graph_edge_count(graph) == 2);
+    assert(ison_graph_neighbors(graph, 1, -1, &members) == 1 && members[0] == 2);
+    ison_graph_free(graph);
+    ison_document_free(doc);
+    printf("PASS\n");
+    
+    printf("Test: JSON to ISON... ");
+    fflush(stdout);
+    
+    const char *json_doc =
+        "{\"users\": [\n"
+        "  {\"id\": 1, \"name\": \"Al \\\"the pal\\\" \\\\ \\u00e9\\ud83d\\ude00\", \"score\": -2.5e1},\n"
+        "  {\"id\": 9007199254740993, \"name\": \"padding padding padding padding padding padding\","
+        " \"score\": 0.1, \"extra\": {\"skip\": [1, 2, \"]\"]}}\n"
+        " ],\n"
+        " \"config\": {\"debug\": true, \"level\": null},\n"
+        " \"version\": 3}";
+    
+    doc = ison_from_json(json_doc, &err);
+    assert(doc != NULL && err == ISON_OK);
+    users = ison_document_get(doc, "users");
+    assert(users != NULL && users->row_count == 2 && users->field_count == 4);
+    assert(ison_value_is_null(ison_row_get_ptr(users->rows[1], "extra")));
+    
+    const char *str;
+    int64_t ival;
+    double fval;
+    assert(ison_value_as_string(ison_row_get_ptr(users->rows[0], "name"), &str));
+    assert(strcmp(str, "Al \"the pal\" \\ \xc3\xa9\xf0\x9f\x98\x80") == 0);
+    assert(ison_value_as_float(ison_row_get_ptr(users->rows[0], "score"), &fval) && fval == -25.0);
+    assert(ison_value_as_int(ison_row_get_ptr(users->rows[1], "id"), &ival) && ival == 9007199254740993LL);
+    assert(ison_value_as_float(ison_row_get_ptr(users->rows[1], "score"), &fval) && fval == 0.1);
+    
+    ison_block_t *config = ison_document_get(doc, "config");
+    assert(config != NULL && strcmp(config->kind, "object") == 0 && config->row_count == 1);
+    assert(ison_value_is_null(ison_row_get_ptr(config->rows[0], "level")));
+    ison_document_free(doc);
+    
+    assert(ison_from_json("{\"a\": [1, 2}", &err) == NULL && err == ISON_ERROR_PARSE);
+    assert(ison_from_json("{\"a\": \"open", &err) == NULL && err == ISON_ERROR_PARSE);
+    printf("PASS\n");
+    
+    printf("Test: JSON normalization... ");
+    fflush(stdout);
+    
+    const char *nested_json =
+        "{\"orders\": ["
+        "  {\"id\": 1, \"user\": {\"id\": 42, \"name\": \"Ann\"}, \"items\": [{\"sku\": \"A\"}, {\"sku\": \"B\"}]},"
+        "  {\"id\": 2, \"user\": {\"id\": 42, \"name\": \"Ann\"}, \"tags\": [\"rush\"]}"
+        "]}";
+    
+    ison_fromdict_options_t fopts = ison_default_fromdict_options();
+    fopts.auto_refs = 1;
+    fopts.smart_order = 1;
+    doc = ison_from_json_with_options(nested_json, &fopts, &err);
+    assert(doc != NULL && err == ISON_OK);
+    assert(doc->block_count == 4);
+    
+    /* Referenced tables come first: user before orders, orders before items/tags */
+    assert(strcmp(doc->order[0], "user") == 0);
+    assert(strcmp(doc->order[1], "orders") == 0);
+    
+    ison_block_t *user = ison_document_get(doc, "user");
+    assert(user->row_count == 1);
+    orders = ison_document_get(doc, "orders");
+    ref_val = ison_row_get_ptr(orders->rows[1], "user");
+    assert(ref_val && ref_val->type == ISON_TYPE_REFERENCE);
+    assert(strcmp(ref_val->data.ref_val.ns, "user") == 0 && strcmp(ref_val->data.ref_val.id, "42") == 0);
+    
+    ison_block_t *items = ison_document_get(doc, "items");
+    assert(items->row_count == 2);
+    ref_val = ison_row_get_ptr(items->rows[1], "orders_id");
+    assert(ref_val && strcmp(ref_val->data.ref_val.ns, "orders") == 0 && strcmp(ref_val->data.ref_val.id, "1") == 0);
+    ison_block_t *tags = ison_document_get(doc, "tags");
+    ref_val = ison_row_get_ptr(tags->rows[0], "orders_id");
+    assert(ref_val && strcmp(ref_val->data.ref_val.id, "2") == 0);
+    
+    output = ison_dumps(doc);
+    assert(strstr(output, "table.items\nsku id orders_id\nA 1 :orders:1\nB 2 :orders:1\n") != NULL);
+    free(output);
+    ison_document_free(doc);
+    
+    doc = ison_from_json_with_options("{\"orders\": [{\"id\": 1, \"customer\": {\"id\": 1.5}},"
+                                      " {\"id\": 2, \"customer\": {\"id\": true}}]}", &fopts, &err);
+    assert(doc != NULL && err == ISON_OK);
+    orders = ison_document_get(doc, "orders");
+    ref_val = ison_row_get_ptr(orders->rows[0], "customer");
+    assert(ref_val && strcmp(ref_val->data.ref_val.id, "1.5") == 0);
+    ref_val = ison_row_get_ptr(orders->rows[1], "customer");
+    assert(ref_val && strcmp(ref_val->data.ref_val.id, "true") == 0);
+    ison_document_free(doc);
+    assert(ison_from_json_with_options("{\"orders\": [{\"id\": 1, \"customer\": {\"id\": \"a b\"}}]}",
+                                       &fopts, &err) == NULL && err == ISON_ERROR_INVALID);
+    printf("PASS\n");
+    
+    printf("Test: Streaming JSON to ISON... ");
+    fflush(stdout);
+    
+    const char *json_input =
+        "[{\"id\": 1, \"name\": \"Alice\"},\n"
+        " {\"id\": 2, \"email\": \"b@x.io\", \"tags\": [1, {\"a\": \"]\"}]},\n"
+        " {\"id\": 3, \"name\": \"Carol Ann\", \"late\": true}]";
+    
+    sink_t sink = {{0}, 0};
+    ison_json_stream_options_t sopts = ison_default_json_stream_options();
+    sopts.name = "users";
+    sopts.header_sample = 2;
+    ison_json_stream_t *stream = ison_json_stream_create(&sopts, sink_write, &sink);
+    assert(stream != NULL);
+    for (size_t off = 0, n = strlen(json_input); off < n; off += 5) {
+        size_t chunk = n - off < 5 ? n - off : 5;
+        assert(ison_json_stream_feed(stream, json_input + off, chunk) == ISON_OK);
+    }
+    assert(ison_json_stream_finish(stream) == ISON_OK);
+    ison_json_stream_free(stream);
+    assert(strcmp(sink.buf,
+        "table.users\n"
+        "id name email tags\n"
+        "1 Alice ~ ~\n"
+        "2 ~ b@x.io ~\n"
+        "3 \"Carol Ann\" ~ ~\n") == 0);
+    
+    sink.len = 0;
+    sopts.isonl = 1;
+    stream = ison_json_stream_create(&sopts, sink_write, &sink);
+    const char *ndjson = "{\"id\": 7}\n{\"id\": 8}\n";
+    assert(ison_json_stream_feed(stream, ndjson, strlen(ndjson)) == ISON_OK);
+    assert(ison_json_stream_finish(stream) == ISON_OK);
+    ison_json_stream_free(stream);
+    assert(strcmp(sink.buf, "table.users|id|7\ntable.users|id|8\n") == 0);
+    printf("PASS\n");
+    
     printf("\nAll advanced tests passed!\n");
     return 0;
 }
+    
\ No newline at end of file
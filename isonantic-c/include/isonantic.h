@@ -203,6 +203,28 @@ typedef struct {
 
 extern IsonanticINamespace I;
 
+/* ==================== Allocator ==================== */
+
+/* Allocation hooks; ctx is passed back to every call */
+typedef struct {
+    void* (*malloc_fn)(size_t size, void* ctx);
+    void* (*realloc_fn)(void* ptr, size_t size, void* ctx);
+    void (*free_fn)(void* ptr, void* ctx);
+    void* ctx;
+} IsonanticAllocator;
+
+/*
+ * All allocations go through the allocator set here (libc by default; NULL
+ * restores it). Set it before creating any schema or value, and release
+ * strings returned by the library with isonantic_free.
+ */
+void isonantic_set_allocator(const IsonanticAllocator* allocator);
+void* isonantic_malloc(size_t size);
+void* isonantic_calloc(size_t count, size_t size);
+void* isonantic_realloc(void* ptr, size_t size);
+void isonantic_free(void* ptr);
+char* isonantic_strdup(const char* str);
+
 /* ==================== Utility Functions ==================== */
 
 IsonanticValue* isonantic_value_create_string(const char* str);
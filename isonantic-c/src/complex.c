@@ -80,16 +80,16 @@ static void object_free_schema(IsonanticSchema* schema) {
     if (s->base.refinements != NULL) {
         int size = isonantic_array_size(s->base.refinements);
         for (int i = 0; i < size; i++) {
-            free(isonantic_array_get(s->base.refinements, i));
+            isonantic_free(isonantic_array_get(s->base.refinements, i));
         }
         isonantic_array_free(s->base.refinements);
     }
-    free(s->base.description);
-    free(s);
+    isonantic_free(s->base.description);
+    isonantic_free(s);
 }
 
 IsonanticSchema* isonantic_object_create(IsonanticDict* fields) {
-    IsonanticObjectSchema* schema = (IsonanticObjectSchema*)malloc(sizeof(IsonanticObjectSchema));
+    IsonanticObjectSchema* schema = (IsonanticObjectSchema*)isonantic_malloc(sizeof(IsonanticObjectSchema));
     if (schema == NULL) return NULL;
     memset(schema, 0, sizeof(IsonanticObjectSchema));
     schema->base.validate = object_validate;
@@ -99,7 +99,7 @@ IsonanticSchema* isonantic_object_create(IsonanticDict* fields) {
 }
 
 IsonanticSchema* isonantic_document_create(IsonanticDict* blocks) {
-    IsonanticDocumentSchema* schema = (IsonanticDocumentSchema*)malloc(sizeof(IsonanticDocumentSchema));
+    IsonanticDocumentSchema* schema = (IsonanticDocumentSchema*)isonantic_malloc(sizeof(IsonanticDocumentSchema));
     if (schema == NULL) return NULL;
     memset(schema, 0, sizeof(IsonanticDocumentSchema));
     schema->blocks = blocks;
@@ -59,19 +59,19 @@ void isonantic_schema_set_default(IsonanticSchema* schema, IsonanticValue* value
 
 void isonantic_schema_set_description(IsonanticSchema* schema, const char* desc) {
     if (schema == NULL || desc == NULL) return;
-    free(schema->description);
-    schema->description = strdup(desc);
+    isonantic_free(schema->description);
+    schema->description = isonantic_strdup(desc);
 }
 
 void isonantic_schema_add_refinement(IsonanticSchema* schema, IsonanticRefinementFn fn, void* user_data, const char* message) {
     if (schema == NULL || fn == NULL) return;
 
     /* Create refinement struct */
-    IsonanticRefinement* refinement = (IsonanticRefinement*)malloc(sizeof(IsonanticRefinement));
+    IsonanticRefinement* refinement = (IsonanticRefinement*)isonantic_malloc(sizeof(IsonanticRefinement));
     if (refinement == NULL) return;
     refinement->fn = fn;
     refinement->user_data = user_data;
-    refinement->error_message = message ? strdup(message) : NULL;
+    refinement->error_message = message ? isonantic_strdup(message) : NULL;
 
     if (schema->refinements == NULL) {
         schema->refinements = isonantic_array_create(4);
@@ -192,7 +192,7 @@ static IsonanticValidationErrors* string_validate(IsonanticSchema* schema, Isona
                 isonantic_validation_errors_add(errors, curr);
                 curr = curr->next;
             }
-            free(refinements);
+            isonantic_free(refinements);
         }
     }
 
@@ -202,26 +202,26 @@ static IsonanticValidationErrors* string_validate(IsonanticSchema* schema, Isona
 static void string_free_schema(IsonanticSchema* schema) {
     if (schema == NULL) return;
     IsonanticStringSchema* s = (IsonanticStringSchema*)schema;
-    free(s->min_len);
-    free(s->max_len);
-    free(s->exact_len);
+    isonantic_free(s->min_len);
+    isonantic_free(s->max_len);
+    isonantic_free(s->exact_len);
     if (s->pattern != NULL) {
         regfree((regex_t*)s->pattern);
-        free(s->pattern);
+        isonantic_free(s->pattern);
     }
     if (s->base.refinements != NULL) {
         int size = isonantic_array_size(s->base.refinements);
         for (int i = 0; i < size; i++) {
-            free(isonantic_array_get(s->base.refinements, i));
+            isonantic_free(isonantic_array_get(s->base.refinements, i));
         }
         isonantic_array_free(s->base.refinements);
     }
-    free(s->base.description);
-    free(s);
+    isonantic_free(s->base.description);
+    isonantic_free(s);
 }
 
 IsonanticSchema* isonantic_string_create(void) {
-    IsonanticStringSchema* schema = (IsonanticStringSchema*)malloc(sizeof(IsonanticStringSchema));
+    IsonanticStringSchema* schema = (IsonanticStringSchema*)isonantic_malloc(sizeof(IsonanticStringSchema));
     if (schema == NULL) return NULL;
     memset(schema, 0, sizeof(IsonanticStringSchema));
     schema->base.validate = string_validate;
@@ -232,7 +232,7 @@ IsonanticSchema* isonantic_string_create(void) {
 IsonanticSchema* isonantic_string_min(IsonanticSchema* schema, int n) {
     if (schema == NULL) return NULL;
     IsonanticStringSchema* s = (IsonanticStringSchema*)schema;
-    s->min_len = (int*)malloc(sizeof(int));
+    s->min_len = (int*)isonantic_malloc(sizeof(int));
     *s->min_len = n;
     return schema;
 }
@@ -240,7 +240,7 @@ IsonanticSchema* isonantic_string_min(IsonanticSchema* schema, int n) {
 IsonanticSchema* isonantic_string_max(IsonanticSchema* schema, int n) {
     if (schema == NULL) return NULL;
     IsonanticStringSchema* s = (IsonanticStringSchema*)schema;
-    s->max_len = (int*)malloc(sizeof(int));
+    s->max_len = (int*)isonantic_malloc(sizeof(int));
     *s->max_len = n;
     return schema;
 }
@@ -248,7 +248,7 @@ IsonanticSchema* isonantic_string_max(IsonanticSchema* schema, int n) {
 IsonanticSchema* isonantic_string_length(IsonanticSchema* schema, int n) {
     if (schema == NULL) return NULL;
     IsonanticStringSchema* s = (IsonanticStringSchema*)schema;
-    s->exact_len = (int*)malloc(sizeof(int));
+    s->exact_len = (int*)isonantic_malloc(sizeof(int));
     *s->exact_len = n;
     return schema;
 }
@@ -268,10 +268,10 @@ IsonanticSchema* isonantic_string_url(IsonanticSchema* schema) {
 IsonanticSchema* isonantic_string_regex(IsonanticSchema* schema, const char* pattern) {
     if (schema == NULL || pattern == NULL) return NULL;
     IsonanticStringSchema* s = (IsonanticStringSchema*)schema;
-    regex_t* regex = (regex_t*)malloc(sizeof(regex_t));
+    regex_t* regex = (regex_t*)isonantic_malloc(sizeof(regex_t));
     if (regex == NULL) return schema;
     if (regcomp(regex, pattern, REG_EXTENDED) != 0) {
-        free(regex);
+        isonantic_free(regex);
         return schema;
     }
     s->pattern = regex;
@@ -396,7 +396,7 @@ static IsonanticValidationErrors* number_validate(IsonanticSchema* schema, Isona
                 isonantic_validation_errors_add(errors, curr);
                 curr = curr->next;
             }
-            free(refinements);
+            isonantic_free(refinements);
         }
     }
 
@@ -406,21 +406,21 @@ static IsonanticValidationErrors* number_validate(IsonanticSchema* schema, Isona
 static void number_free_schema(IsonanticSchema* schema) {
     if (schema == NULL) return;
     IsonanticNumberSchema* s = (IsonanticNumberSchema*)schema;
-    free(s->min_val);
-    free(s->max_val);
+    isonantic_free(s->min_val);
+    isonantic_free(s->max_val);
     if (s->base.refinements != NULL) {
         int size = isonantic_array_size(s->base.refinements);
         for (int i = 0; i < size; i++) {
-            free(isonantic_array_get(s->base.refinements, i));
+            isonantic_free(isonantic_array_get(s->base.refinements, i));
         }
         isonantic_array_free(s->base.refinements);
     }
-    free(s->base.description);
-    free(s);
+    isonantic_free(s->base.description);
+    isonantic_free(s);
 }
 
 IsonanticSchema* isonantic_number_create(void) {
-    IsonanticNumberSchema* schema = (IsonanticNumberSchema*)malloc(sizeof(IsonanticNumberSchema));
+    IsonanticNumberSchema* schema = (IsonanticNumberSchema*)isonantic_malloc(sizeof(IsonanticNumberSchema));
     if (schema == NULL) return NULL;
     memset(schema, 0, sizeof(IsonanticNumberSchema));
     schema->base.validate = number_validate;
@@ -438,7 +438,7 @@ IsonanticSchema* isonantic_int_create(void) {
 IsonanticSchema* isonantic_number_min(IsonanticSchema* schema, double n) {
     if (schema == NULL) return NULL;
     IsonanticNumberSchema* s = (IsonanticNumberSchema*)schema;
-    s->min_val = (double*)malloc(sizeof(double));
+    s->min_val = (double*)isonantic_malloc(sizeof(double));
     *s->min_val = n;
     return schema;
 }
@@ -446,7 +446,7 @@ IsonanticSchema* isonantic_number_min(IsonanticSchema* schema, double n) {
 IsonanticSchema* isonantic_number_max(IsonanticSchema* schema, double n) {
     if (schema == NULL) return NULL;
     IsonanticNumberSchema* s = (IsonanticNumberSchema*)schema;
-    s->max_val = (double*)malloc(sizeof(double));
+    s->max_val = (double*)isonantic_malloc(sizeof(double));
     *s->max_val = n;
     return schema;
 }
@@ -533,16 +533,16 @@ static void boolean_free_schema(IsonanticSchema* schema) {
     if (s->base.refinements != NULL) {
         int size = isonantic_array_size(s->base.refinements);
         for (int i = 0; i < size; i++) {
-            free(isonantic_array_get(s->base.refinements, i));
+            isonantic_free(isonantic_array_get(s->base.refinements, i));
         }
         isonantic_array_free(s->base.refinements);
     }
-    free(s->base.description);
-    free(s);
+    isonantic_free(s->base.description);
+    isonantic_free(s);
 }
 
 IsonanticSchema* isonantic_boolean_create(void) {
-    IsonanticBooleanSchema* schema = (IsonanticBooleanSchema*)malloc(sizeof(IsonanticBooleanSchema));
+    IsonanticBooleanSchema* schema = (IsonanticBooleanSchema*)isonantic_malloc(sizeof(IsonanticBooleanSchema));
     if (schema == NULL) return NULL;
     memset(schema, 0, sizeof(IsonanticBooleanSchema));
     schema->base.validate = boolean_validate;
@@ -585,11 +585,11 @@ static IsonanticValidationErrors* null_validate(IsonanticSchema* schema, Isonant
 
 static void null_free_schema(IsonanticSchema* schema) {
     if (schema == NULL) return;
-    free(schema);
+    isonantic_free(schema);
 }
 
 IsonanticSchema* isonantic_null_create(void) {
-    IsonanticSchema* schema = (IsonanticSchema*)malloc(sizeof(IsonanticSchema));
+    IsonanticSchema* schema = (IsonanticSchema*)isonantic_malloc(sizeof(IsonanticSchema));
     if (schema == NULL) return NULL;
     memset(schema, 0, sizeof(IsonanticSchema));
     schema->validate = null_validate;
@@ -674,21 +674,21 @@ static IsonanticValidationErrors* ref_validate(IsonanticSchema* schema, Isonanti
 static void ref_free_schema(IsonanticSchema* schema) {
     if (schema == NULL) return;
     IsonanticRefSchema* s = (IsonanticRefSchema*)schema;
-    free(s->ns);
-    free(s->relationship);
+    isonantic_free(s->ns);
+    isonantic_free(s->relationship);
     if (s->base.refinements != NULL) {
         int size = isonantic_array_size(s->base.refinements);
         for (int i = 0; i < size; i++) {
-            free(isonantic_array_get(s->base.refinements, i));
+            isonantic_free(isonantic_array_get(s->base.refinements, i));
         }
         isonantic_array_free(s->base.refinements);
     }
-    free(s->base.description);
-    free(s);
+    isonantic_free(s->base.description);
+    isonantic_free(s);
 }
 
 IsonanticSchema* isonantic_ref_create(void) {
-    IsonanticRefSchema* schema = (IsonanticRefSchema*)malloc(sizeof(IsonanticRefSchema));
+    IsonanticRefSchema* schema = (IsonanticRefSchema*)isonantic_malloc(sizeof(IsonanticRefSchema));
     if (schema == NULL) return NULL;
     memset(schema, 0, sizeof(IsonanticRefSchema));
     schema->base.validate = ref_validate;
@@ -699,14 +699,14 @@ IsonanticSchema* isonantic_ref_create(void) {
 IsonanticSchema* isonantic_ref_namespace(IsonanticSchema* schema, const char* ns) {
     if (schema == NULL) return NULL;
     IsonanticRefSchema* s = (IsonanticRefSchema*)schema;
-    s->ns = strdup(ns);
+    s->ns = isonantic_strdup(ns);
     return schema;
 }
 
 IsonanticSchema* isonantic_ref_relationship(IsonanticSchema* schema, const char* rel) {
     if (schema == NULL) return NULL;
     IsonanticRefSchema* s = (IsonanticRefSchema*)schema;
-    s->relationship = strdup(rel);
+    s->relationship = isonantic_strdup(rel);
     return schema;
 }
 
@@ -729,6 +729,6 @@ void isonantic_schema_free(IsonanticSchema* schema) {
     if (schema->free_schema != NULL) {
         schema->free_schema(schema);
     } else {
-        free(schema);
+        isonantic_free(schema);
     }
 }
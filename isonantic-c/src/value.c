@@ -8,19 +8,76 @@
 #include <string.h>
 #include "isonantic.h"
 
+/* ==================== Allocator ==================== */
+
+static void* libc_malloc(size_t size, void* ctx) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void* libc_realloc(void* ptr, size_t size, void* ctx) {
+    (void)ctx;
+    return realloc(ptr, size);
+}
+
+static void libc_free(void* ptr, void* ctx) {
+    (void)ctx;
+    free(ptr);
+}
+
+static IsonanticAllocator allocator = { libc_malloc, libc_realloc, libc_free, NULL };
+
+void isonantic_set_allocator(const IsonanticAllocator* custom) {
+    if (custom != NULL && custom->malloc_fn && custom->realloc_fn && custom->free_fn) {
+        allocator = *custom;
+        return;
+    }
+    allocator.malloc_fn = libc_malloc;
+    allocator.realloc_fn = libc_realloc;
+    allocator.free_fn = libc_free;
+    allocator.ctx = NULL;
+}
+
+void* isonantic_malloc(size_t size) {
+    return allocator.malloc_fn(size, allocator.ctx);
+}
+
+void* isonantic_calloc(size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+    void* ptr = isonantic_malloc(count * size);
+    if (ptr != NULL) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void* isonantic_realloc(void* ptr, size_t size) {
+    return allocator.realloc_fn(ptr, size, allocator.ctx);
+}
+
+void isonantic_free(void* ptr) {
+    if (ptr != NULL) allocator.free_fn(ptr, allocator.ctx);
+}
+
+char* isonantic_strdup(const char* str) {
+    if (str == NULL) return NULL;
+    size_t len = strlen(str);
+    char* copy = (char*)isonantic_malloc(len + 1);
+    if (copy != NULL) memcpy(copy, str, len + 1);
+    return copy;
+}
+
 /* ==================== Value Functions ==================== */
 
 IsonanticValue* isonantic_value_create_string(const char* str) {
     if (str == NULL) return NULL;
-    IsonanticValue* value = (IsonanticValue*)malloc(sizeof(IsonanticValue));
+    IsonanticValue* value = (IsonanticValue*)isonantic_malloc(sizeof(IsonanticValue));
     if (value == NULL) return NULL;
     value->type = ISONANTIC_VALUE_STRING;
-    value->data.string_value = strdup(str);
+    value->data.string_value = isonantic_strdup(str);
     return value;
 }
 
 IsonanticValue* isonantic_value_create_number(double num) {
-    IsonanticValue* value = (IsonanticValue*)malloc(sizeof(IsonanticValue));
+    IsonanticValue* value = (IsonanticValue*)isonantic_malloc(sizeof(IsonanticValue));
     if (value == NULL) return NULL;
     value->type = ISONANTIC_VALUE_NUMBER;
     value->data.number_value = num;
@@ -28,7 +85,7 @@ IsonanticValue* isonantic_value_create_number(double num) {
 }
 
 IsonanticValue* isonantic_value_create_boolean(bool val) {
-    IsonanticValue* value = (IsonanticValue*)malloc(sizeof(IsonanticValue));
+    IsonanticValue* value = (IsonanticValue*)isonantic_malloc(sizeof(IsonanticValue));
     if (value == NULL) return NULL;
     value->type = ISONANTIC_VALUE_BOOLEAN;
     value->data.boolean_value = val;
@@ -36,7 +93,7 @@ IsonanticValue* isonantic_value_create_boolean(bool val) {
 }
 
 IsonanticValue* isonantic_value_create_null(void) {
-    IsonanticValue* value = (IsonanticValue*)malloc(sizeof(IsonanticValue));
+    IsonanticValue* value = (IsonanticValue*)isonantic_malloc(sizeof(IsonanticValue));
     if (value == NULL) return NULL;
     value->type = ISONANTIC_VALUE_NULL;
     value->data.string_value = NULL;
@@ -45,10 +102,10 @@ IsonanticValue* isonantic_value_create_null(void) {
 
 IsonanticValue* isonantic_value_create_ref(const char* ref) {
     if (ref == NULL) return NULL;
-    IsonanticValue* value = (IsonanticValue*)malloc(sizeof(IsonanticValue));
+    IsonanticValue* value = (IsonanticValue*)isonantic_malloc(sizeof(IsonanticValue));
     if (value == NULL) return NULL;
     value->type = ISONANTIC_VALUE_REFERENCE;
-    value->data.ref_value = strdup(ref);
+    value->data.ref_value = isonantic_strdup(ref);
     return value;
 }
 
@@ -56,10 +113,10 @@ void isonantic_value_free(IsonanticValue* value) {
     if (value == NULL) return;
     switch (value->type) {
         case ISONANTIC_VALUE_STRING:
-            free(value->data.string_value);
+            isonantic_free(value->data.string_value);
             break;
         case ISONANTIC_VALUE_REFERENCE:
-            free(value->data.ref_value);
+            isonantic_free(value->data.ref_value);
             break;
         case ISONANTIC_VALUE_OBJECT:
             isonantic_dict_free(value->data.object_value);
@@ -70,7 +127,7 @@ void isonantic_value_free(IsonanticValue* value) {
         default:
             break;
     }
-    free(value);
+    isonantic_free(value);
 }
 
 /* ==================== Dictionary Functions ==================== */
@@ -85,11 +142,11 @@ static unsigned int dict_hash(const char* key) {
 
 IsonanticDict* isonantic_dict_create(int capacity) {
     if (capacity <= 0) capacity = 16;
-    IsonanticDict* dict = (IsonanticDict*)malloc(sizeof(IsonanticDict));
+    IsonanticDict* dict = (IsonanticDict*)isonantic_malloc(sizeof(IsonanticDict));
     if (dict == NULL) return NULL;
-    dict->buckets = (IsonanticDictEntry**)calloc(capacity, sizeof(IsonanticDictEntry*));
+    dict->buckets = (IsonanticDictEntry**)isonantic_calloc(capacity, sizeof(IsonanticDictEntry*));
     if (dict->buckets == NULL) {
-        free(dict);
+        isonantic_free(dict);
         return NULL;
     }
     dict->capacity = capacity;
@@ -111,9 +168,9 @@ void isonantic_dict_set(IsonanticDict* dict, const char* key, void* value) {
     }
 
     /* Add new entry */
-    IsonanticDictEntry* new_entry = (IsonanticDictEntry*)malloc(sizeof(IsonanticDictEntry));
+    IsonanticDictEntry* new_entry = (IsonanticDictEntry*)isonantic_malloc(sizeof(IsonanticDictEntry));
     if (new_entry == NULL) return;
-    new_entry->key = strdup(key);
+    new_entry->key = isonantic_strdup(key);
     new_entry->value = value;
     new_entry->next = dict->buckets[dict_hash(key) % dict->capacity];
     dict->buckets[dict_hash(key) % dict->capacity] = new_entry;
@@ -143,9 +200,9 @@ int isonantic_dict_size(IsonanticDict* dict) {
 
 static void dict_entry_free(IsonanticDictEntry* entry) {
     if (entry == NULL) return;
-    free(entry->key);
+    isonantic_free(entry->key);
     dict_entry_free(entry->next);
-    free(entry);
+    isonantic_free(entry);
 }
 
 void isonantic_dict_free(IsonanticDict* dict) {
@@ -153,19 +210,19 @@ void isonantic_dict_free(IsonanticDict* dict) {
     for (int i = 0; i < dict->capacity; i++) {
         dict_entry_free(dict->buckets[i]);
     }
-    free(dict->buckets);
-    free(dict);
+    isonantic_free(dict->buckets);
+    isonantic_free(dict);
 }
 
 /* ==================== Array Functions ==================== */
 
 IsonanticArray* isonantic_array_create(int capacity) {
     if (capacity <= 0) capacity = 16;
-    IsonanticArray* arr = (IsonanticArray*)malloc(sizeof(IsonanticArray));
+    IsonanticArray* arr = (IsonanticArray*)isonantic_malloc(sizeof(IsonanticArray));
     if (arr == NULL) return NULL;
-    arr->items = (void**)malloc(capacity * sizeof(void*));
+    arr->items = (void**)isonantic_malloc(capacity * sizeof(void*));
     if (arr->items == NULL) {
-        free(arr);
+        isonantic_free(arr);
         return NULL;
     }
     arr->size = 0;
@@ -177,7 +234,7 @@ void isonantic_array_add(IsonanticArray* arr, void* item) {
     if (arr == NULL) return;
     if (arr->size >= arr->capacity) {
         int new_capacity = arr->capacity * 2;
-        void** new_items = (void**)realloc(arr->items, new_capacity * sizeof(void*));
+        void** new_items = (void**)isonantic_realloc(arr->items, new_capacity * sizeof(void*));
         if (new_items == NULL) return;
         arr->items = new_items;
         arr->capacity = new_capacity;
@@ -197,17 +254,17 @@ int isonantic_array_size(IsonanticArray* arr) {
 
 void isonantic_array_free(IsonanticArray* arr) {
     if (arr == NULL) return;
-    free(arr->items);
-    free(arr);
+    isonantic_free(arr->items);
+    isonantic_free(arr);
 }
 
 /* ==================== Validation Error Functions ==================== */
 
 IsonanticValidationError* isonantic_validation_error_create(const char* field, const char* message, IsonanticValue* value) {
-    IsonanticValidationError* error = (IsonanticValidationError*)malloc(sizeof(IsonanticValidationError));
+    IsonanticValidationError* error = (IsonanticValidationError*)isonantic_malloc(sizeof(IsonanticValidationError));
     if (error == NULL) return NULL;
-    error->field = field ? strdup(field) : NULL;
-    error->message = message ? strdup(message) : NULL;
+    error->field = field ? isonantic_strdup(field) : NULL;
+    error->message = message ? isonantic_strdup(message) : NULL;
     error->value = value;
     error->next = NULL;
     return error;
@@ -225,7 +282,7 @@ void isonantic_validation_errors_add(IsonanticValidationErrors* errors, Isonanti
 }
 
 IsonanticValidationErrors* isonantic_validation_errors_create(void) {
-    IsonanticValidationErrors* errors = (IsonanticValidationErrors*)malloc(sizeof(IsonanticValidationErrors));
+    IsonanticValidationErrors* errors = (IsonanticValidationErrors*)isonantic_malloc(sizeof(IsonanticValidationErrors));
     if (errors == NULL) return NULL;
     errors->head = errors->tail = NULL;
     errors->count = 0;
@@ -242,22 +299,22 @@ int isonantic_validation_errors_count(IsonanticValidationErrors* errors) {
 
 static void validation_error_free(IsonanticValidationError* error) {
     if (error == NULL) return;
-    free(error->field);
-    free(error->message);
+    isonantic_free(error->field);
+    isonantic_free(error->message);
     /* Don't free value - caller owns it */
     validation_error_free(error->next);
-    free(error);
+    isonantic_free(error);
 }
 
 void isonantic_validation_errors_free(IsonanticValidationErrors* errors) {
     if (errors == NULL) return;
     validation_error_free(errors->head);
-    free(errors);
+    isonantic_free(errors);
 }
 
 char* isonantic_validation_errors_to_string(IsonanticValidationErrors* errors) {
     if (errors == NULL || errors->head == NULL) {
-        char* result = strdup("");
+        char* result = isonantic_strdup("");
         return result;
     }
 
@@ -269,7 +326,7 @@ char* isonantic_validation_errors_to_string(IsonanticValidationErrors* errors) {
         curr = curr->next;
     }
 
-    char* result = (char*)malloc(total_len + 1);
+    char* result = (char*)isonantic_malloc(total_len + 1);
     if (result == NULL) return NULL;
     result[0] = '\0';
 
@@ -217,6 +217,46 @@ static void test_ref_required(void) {
     isonantic_schema_free(schema);
 }
 
+/* Allocator Test */
+
+static int live_allocations = 0;
+
+static void* counting_malloc(size_t size, void* ctx) {
+    (void)ctx;
+    live_allocations++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* ptr, size_t size, void* ctx) {
+    (void)ctx;
+    if (ptr == NULL) live_allocations++;
+    return realloc(ptr, size);
+}
+
+static void counting_free(void* ptr, void* ctx) {
+    (void)ctx;
+    live_allocations--;
+    free(ptr);
+}
+
+static void test_custom_allocator(void) {
+    printf("Test: Custom Allocator\n");
+    IsonanticAllocator counting = { counting_malloc, counting_realloc, counting_free, NULL };
+    isonantic_set_allocator(&counting);
+
+    IsonanticSchema* schema = isonantic_string_min(isonantic_string_create(), 5);
+    IsonanticValue* val = isonantic_value_create_string("hi");
+    IsonanticValidationErrors* err = schema->validate(schema, val);
+    ASSERT_NOT_NULL(err);
+    ASSERT_TRUE(live_allocations > 0);
+    if (err) isonantic_validation_errors_free(err);
+    isonantic_value_free(val);
+    isonantic_schema_free(schema);
+    ASSERT_TRUE(live_allocations == 0);
+
+    isonantic_set_allocator(NULL);
+}
+
 /* Version Test */
 
 static void test_version(void) {
@@ -239,6 +279,7 @@ int main(void) {
     test_number_positive();
     test_boolean_required();
     test_ref_required();
+    test_custom_allocator();
 
     printf("\n=== Results ===\n");
     printf("Passed: %d\n", tests_passed);